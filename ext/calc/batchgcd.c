@@ -0,0 +1,347 @@
+#include "calc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* Calc.batch_gcd: Bernstein's batch gcd.
+ *
+ * For integers x_1 .. x_n, gcd(x_i, product of the others) is found for every
+ * i at once in quasi-linear time, instead of comparing every pair.  A
+ * product tree is built from the leaves up to P = x_1 * .. * x_n, then P is
+ * reduced down a remainder tree, each node modulo the square of the product
+ * at the same place, so the leaves get P mod x_i^2.  That is x_i times
+ * (P / x_i mod x_i), whose gcd with x_i is the result.
+ *
+ * Nodes are multiplied and reduced with zmul_fast and zmod_fast, so the big
+ * ones near the root use NTT, with its three convolutions on separate threads
+ * if Calc.config(:threads) allows.  libcalc isn't thread safe, so otherwise
+ * nodes are done one at a time.
+ *
+ * Every level of both trees is read in order, so levels can be streamed to
+ * temporary files (the tmpdir option) and only a few nodes are in memory at
+ * any time.
+ */
+
+/* one level of a tree, in memory or in a file */
+typedef struct {
+    FILE *fp;                   /* NULL if in memory */
+    ZVALUE *z;                  /* the nodes, or for a file the two last read */
+    long count;
+    long pos;                   /* next node to read or write */
+} LEVEL;
+
+/* state of a batch gcd, so that everything can be freed by batch_gcd_free if
+ * an interrupt or an I/O error raises part way through */
+typedef struct {
+    VALUE values;
+    VALUE tmpdir;
+    VALUE result;
+    LEVEL *prod;                /* the product tree, from the leaves up */
+    LEVEL rem;                  /* the remainder tree level being read */
+    LEVEL next;                 /* the remainder tree level being written */
+    long n;
+    long nlevels;
+} BATCHGCD;
+
+static void
+level_init(LEVEL * l, long count, VALUE tmpdir)
+{
+    VALUE path;
+    int fd;
+
+    l->count = count;
+    l->pos = 0;
+    l->z = NULL;
+    l->fp = NULL;
+    if (NIL_P(tmpdir)) {
+        l->z = ZALLOC_N(ZVALUE, count);
+        return;
+    }
+    path = rb_str_dup(tmpdir);
+    rb_str_cat2(path, "/calc_batch_gcd_XXXXXX");
+    fd = mkstemp(RSTRING_PTR(path));
+    if (fd < 0) {
+        rb_sys_fail_str(path);
+    }
+    unlink(RSTRING_PTR(path));
+    l->fp = fdopen(fd, "w+b");
+    if (!l->fp) {
+        close(fd);
+        rb_sys_fail_str(path);
+    }
+    l->z = ZALLOC_N(ZVALUE, 2);
+}
+
+/* appends z to the level, which takes ownership of it */
+static void
+level_put(LEVEL * l, ZVALUE z)
+{
+    if (l->fp) {
+        if (fwrite(&z.len, sizeof(LEN), 1, l->fp) != 1
+            || fwrite(z.v, sizeof(HALF), z.len, l->fp) != (size_t) z.len) {
+            zfree(z);
+            rb_sys_fail("batch_gcd");
+        }
+        zfree(z);
+    }
+    else {
+        l->z[l->pos] = z;
+    }
+    l->pos++;
+}
+
+/* switches the level from writing to reading from the start */
+static void
+level_rewind(LEVEL * l)
+{
+    l->pos = 0;
+    if (l->fp && fseek(l->fp, 0L, SEEK_SET) != 0) {
+        rb_sys_fail("batch_gcd");
+    }
+}
+
+/* the next node.  nodes are only lent, pass them to level_done when finished
+ * with them.  at most two nodes read from a file can be lent at once. */
+static void
+level_get(LEVEL * l, ZVALUE * z)
+{
+    ZVALUE *slot;
+    LEN len;
+
+    if (l->fp) {
+        slot = &l->z[l->pos % 2];
+        if (fread(&len, sizeof(LEN), 1, l->fp) != 1) {
+            rb_sys_fail("batch_gcd");
+        }
+        slot->len = len;
+        slot->sign = 0;
+        slot->v = alloc(len);
+        if (fread(slot->v, sizeof(HALF), len, l->fp) != (size_t) len) {
+            rb_sys_fail("batch_gcd");
+        }
+        *z = *slot;
+    }
+    else {
+        *z = l->z[l->pos];
+    }
+    l->pos++;
+}
+
+static void
+level_done(LEVEL * l, ZVALUE z)
+{
+    int i;
+
+    if (l->fp) {
+        for (i = 0; i < 2; i++) {
+            if (l->z[i].v == z.v) {
+                zfree(l->z[i]);
+                l->z[i].v = NULL;
+            }
+        }
+    }
+}
+
+/* frees the level's nodes and closes its file.  safe to call on a level that
+ * was never used, only partly filled, or already freed. */
+static void
+level_free(LEVEL * l)
+{
+    long i, nodes;
+
+    nodes = l->fp ? 2 : l->count;
+    if (l->fp) {
+        fclose(l->fp);
+    }
+    if (l->z) {
+        for (i = 0; i < nodes; i++) {
+            zfree(l->z[i]);
+        }
+        xfree(l->z);
+    }
+    MEMZERO(l, LEVEL, 1);
+}
+
+static VALUE
+batch_gcd_run(VALUE arg)
+{
+    BATCHGCD *bg = (BATCHGCD *) arg;
+    LEVEL *prod;
+    NUMBER *q;
+    ZVALUE a, b, r, sq, t;
+    long i, j, count;
+
+    for (bg->nlevels = 1, count = bg->n; count > 1; count = (count + 1) / 2) {
+        bg->nlevels++;
+    }
+    prod = bg->prod = ZALLOC_N(LEVEL, bg->nlevels);
+    level_init(&prod[0], bg->n, bg->tmpdir);
+    for (i = 0; i < bg->n; i++) {
+        q = value_to_number(rb_ary_entry(bg->values, i), 0);
+        zcopy(q->num, &a);
+        a.sign = 0;
+        qfree(q);
+        level_put(&prod[0], a);
+    }
+    if (bg->n == 1) {
+        rb_ary_push(bg->result, wrap_number(itoq(1)));
+        return bg->result;
+    }
+
+    /* product tree */
+    for (i = 0; i + 1 < bg->nlevels; i++) {
+        level_rewind(&prod[i]);
+        level_init(&prod[i + 1], (prod[i].count + 1) / 2, bg->tmpdir);
+        for (j = 0; j + 1 < prod[i].count; j += 2) {
+            level_get(&prod[i], &a);
+            level_get(&prod[i], &b);
+            zmul_fast(a, b, &t);
+            level_done(&prod[i], a);
+            level_done(&prod[i], b);
+            level_put(&prod[i + 1], t);
+        }
+        if (j < prod[i].count) {
+            level_get(&prod[i], &a);
+            zcopy(a, &t);
+            level_done(&prod[i], a);
+            level_put(&prod[i + 1], t);
+        }
+        rb_thread_check_ints();
+    }
+
+    /* remainder tree.  the root is its own remainder mod its square. */
+    level_rewind(&prod[bg->nlevels - 1]);
+    level_get(&prod[bg->nlevels - 1], &a);
+    zcopy(a, &t);
+    level_done(&prod[bg->nlevels - 1], a);
+    level_free(&prod[bg->nlevels - 1]);
+    level_init(&bg->rem, 1, bg->tmpdir);
+    level_put(&bg->rem, t);
+    for (i = bg->nlevels - 2; i >= 0; i--) {
+        level_rewind(&prod[i]);
+        level_rewind(&bg->rem);
+        if (i > 0) {
+            level_init(&bg->next, prod[i].count, bg->tmpdir);
+        }
+        for (j = 0; j < prod[i].count; j++) {
+            if (j % 2 == 0) {
+                level_get(&bg->rem, &r);
+            }
+            level_get(&prod[i], &a);
+            zsquare_fast(a, &sq);
+            zmod_fast(r, sq, &t);
+            zfree(sq);
+            if (i > 0) {
+                level_put(&bg->next, t);
+            }
+            else {
+                /* t = P mod a^2 is a multiple of a */
+                zequo(t, a, &b);
+                zfree(t);
+                q = qalloc();
+                zgcd(a, b, &q->num);
+                zfree(b);
+                rb_ary_push(bg->result, wrap_number(q));
+            }
+            level_done(&prod[i], a);
+            if (j % 2 == 1 || j + 1 == prod[i].count) {
+                level_done(&bg->rem, r);
+            }
+        }
+        level_free(&prod[i]);
+        level_free(&bg->rem);
+        bg->rem = bg->next;
+        MEMZERO(&bg->next, LEVEL, 1);
+        rb_thread_check_ints();
+    }
+
+    return bg->result;
+}
+
+static VALUE
+batch_gcd_free(VALUE arg)
+{
+    BATCHGCD *bg = (BATCHGCD *) arg;
+    long i;
+
+    if (bg->prod) {
+        for (i = 0; i < bg->nlevels; i++) {
+            level_free(&bg->prod[i]);
+        }
+        xfree(bg->prod);
+    }
+    level_free(&bg->rem);
+    level_free(&bg->next);
+    return Qnil;
+}
+
+/* GCD of each integer with the product of all the others
+ *
+ * Returns gcd(values[i], product of every other value) for each i, but in
+ * quasi-linear time using product and remainder trees (Bernstein's
+ * batch gcd), so a large set of moduli can be screened for shared factors
+ * without testing every pair.  A result other than 1 means that value shares
+ * a factor with at least one of the others.
+ *
+ * The trees hold about log2(values.size) times the size of the input.  If
+ * that won't fit in memory, pass a directory in tmpdir and each level is
+ * streamed to a temporary file there instead (the files are removed as soon
+ * as they are created, so nothing is left behind).
+ *
+ * @param values [Array<Integer,Calc::Q>] non-zero integers
+ * @param tmpdir [String] directory for temporary files (default: keep
+ *  everything in memory)
+ * @return [Array<Calc::Q>]
+ * @raise [Calc::MathError] if any value is zero or not an integer
+ * @raise [SystemCallError] if a temporary file can't be written or read
+ * @example
+ *  Calc.batch_gcd([33, 35, 91, 143]) #=> [Calc::Q(11), Calc::Q(7), Calc::Q(91), Calc::Q(143)]
+ */
+VALUE
+calc_batch_gcd(int argc, VALUE * argv, VALUE klass)
+{
+    static ID keywords[1];
+    VALUE values, opts, tmpdir;
+    BATCHGCD bg;
+    NUMBER *q;
+    long i;
+    setup_math_error();
+
+    rb_scan_args(argc, argv, "1:", &values, &opts);
+    if (!keywords[0]) {
+        keywords[0] = rb_intern("tmpdir");
+    }
+    tmpdir = Qundef;
+    if (!NIL_P(opts)) {
+        rb_get_kwargs(opts, keywords, 0, 1, &tmpdir);
+    }
+    tmpdir = (tmpdir == Qundef || NIL_P(tmpdir)) ? Qnil : rb_str_dup(FilePathValue(tmpdir));
+    values = rb_Array(values);
+
+    /* check everything first so nothing is leaked by a bad argument */
+    for (i = 0; i < RARRAY_LEN(values); i++) {
+        q = value_to_number(rb_ary_entry(values, i), 0);
+        if (qisfrac(q)) {
+            qfree(q);
+            rb_raise(e_MathError, "non-integer for batch_gcd");
+        }
+        if (qiszero(q)) {
+            qfree(q);
+            rb_raise(e_MathError, "zero for batch_gcd");
+        }
+        qfree(q);
+    }
+
+    bg.values = values;
+    bg.tmpdir = tmpdir;
+    bg.n = RARRAY_LEN(values);
+    bg.result = rb_ary_new2(bg.n);
+    if (bg.n == 0) {
+        return bg.result;
+    }
+    bg.prod = NULL;
+    bg.nlevels = 0;
+    MEMZERO(&bg.rem, LEVEL, 1);
+    MEMZERO(&bg.next, LEVEL, 1);
+    return rb_ensure(batch_gcd_run, (VALUE) & bg, batch_gcd_free, (VALUE) & bg);
+}
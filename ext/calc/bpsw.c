@@ -0,0 +1,279 @@
+#include "calc.h"
+
+/* Baillie-PSW primality test, for prime?, nextprime and prevprime beyond
+ * libcalc's 2^32 limit.
+ *
+ * A number passes if it has no small prime factor, is a strong probable
+ * prime to base 2 (a Miller-Rabin test using libcalc's REDC, ie Montgomery,
+ * arithmetic), and is a strong Lucas probable prime with Selfridge's
+ * parameters.  No composite is known to pass, and there are none below 2^64.
+ *
+ * nextprime and prevprime keep the remainders of the candidate modulo the
+ * small primes, so most candidates are rejected without any multiple
+ * precision arithmetic.
+ */
+
+/* *z = *z mod n, in place */
+static void
+reduce(ZVALUE * z, ZVALUE n)
+{
+    ZVALUE tmp;
+
+    zmod(*z, n, &tmp, 0);
+    zfree(*z);
+    *z = tmp;
+}
+
+/* *z = *z / 2 mod n (n odd), in place */
+static void
+halve(ZVALUE * z, ZVALUE n)
+{
+    ZVALUE tmp;
+
+    if (zisodd(*z)) {
+        zadd(*z, n, &tmp);
+        zfree(*z);
+        *z = tmp;
+    }
+    zshift(*z, -1L, &tmp);
+    zfree(*z);
+    *z = tmp;
+}
+
+/* strong probable prime test to base 2.  n must be odd and > 2. */
+static BOOL
+zsprp2(ZVALUE n)
+{
+    REDC *rp;
+    ZVALUE d, two, x, minus_one, tmp;
+    long s, r;
+    BOOL result;
+
+    /* n - 1 = d * 2^s with d odd */
+    zsub(n, _one_, &tmp);
+    s = zlowbit(tmp);
+    zshift(tmp, -s, &d);
+    zfree(tmp);
+
+    rp = zredcalloc(n);
+    itoz(2L, &tmp);
+    zredcencode(rp, tmp, &two);
+    zfree(tmp);
+    zredcpower(rp, two, d, &x);
+    zfree(two);
+    zfree(d);
+
+    /* -1 in REDC form is n - R mod n */
+    zsub(n, rp->one, &minus_one);
+
+    result = (zcmp(x, rp->one) == 0 || zcmp(x, minus_one) == 0);
+    for (r = 1; !result && r < s; r++) {
+        zredcsquare(rp, x, &tmp);
+        zfree(x);
+        x = tmp;
+        if (zcmp(x, minus_one) == 0) {
+            result = TRUE;
+        }
+        else if (zcmp(x, rp->one) == 0) {
+            break;
+        }
+    }
+    zfree(x);
+    zfree(minus_one);
+    zredcfree(rp);
+    return result;
+}
+
+/* TRUE if n is a perfect square */
+static BOOL
+zsquarep(ZVALUE n)
+{
+    ZVALUE root, square;
+    BOOL result;
+
+    zsqrt(n, &root, 0);
+    zsquare(root, &square);
+    result = (zcmp(square, n) == 0);
+    zfree(root);
+    zfree(square);
+    return result;
+}
+
+/* strong Lucas probable prime test with Selfridge's parameters: D is the
+ * first of 5, -7, 9, -11, ... with jacobi(D, n) = -1, P = 1 and
+ * Q = (1 - D) / 4.  n must be odd, > 2 and not a perfect square. */
+static BOOL
+zslprp(ZVALUE n)
+{
+    ZVALUE d, zd, zq, u, v, qk, tmp, tmp2;
+    long dval, s, r, bit;
+    BOOL result;
+
+    for (dval = 5;; dval = (dval > 0) ? -dval - 2 : -dval + 2) {
+        itoz(dval, &zd);
+        reduce(&zd, n);
+        r = zjacobi(zd, n);
+        if (r == -1) {
+            break;
+        }
+        zfree(zd);
+        if (r == 0) {
+            /* D and n have a common factor, and n is much larger than D */
+            return FALSE;
+        }
+    }
+    itoz((1 - dval) / 4, &zq);
+    reduce(&zq, n);
+
+    /* n + 1 = d * 2^s with d odd */
+    zadd(n, _one_, &tmp);
+    s = zlowbit(tmp);
+    zshift(tmp, -s, &d);
+    zfree(tmp);
+
+    /* U_1 = 1, V_1 = P = 1, Q^1 */
+    itoz(1L, &u);
+    itoz(1L, &v);
+    zcopy(zq, &qk);
+    for (bit = zhighbit(d) - 1; bit >= 0; bit--) {
+        /* U_2k = U_k * V_k, V_2k = V_k^2 - 2 Q^k */
+        zmul(u, v, &tmp);
+        zfree(u);
+        u = tmp;
+        reduce(&u, n);
+        zsquare(v, &tmp);
+        zshift(qk, 1L, &tmp2);
+        zfree(v);
+        zsub(tmp, tmp2, &v);
+        zfree(tmp);
+        zfree(tmp2);
+        reduce(&v, n);
+        zsquare(qk, &tmp);
+        zfree(qk);
+        qk = tmp;
+        reduce(&qk, n);
+
+        if ((d.v[bit / BASEB] >> (bit % BASEB)) & 1) {
+            /* U_k+1 = (P U_k + V_k) / 2, V_k+1 = (D U_k + P V_k) / 2 */
+            zadd(u, v, &tmp);
+            zmul(zd, u, &tmp2);
+            zfree(u);
+            u = tmp;
+            reduce(&u, n);
+            halve(&u, n);
+            zadd(tmp2, v, &tmp);
+            zfree(tmp2);
+            zfree(v);
+            v = tmp;
+            reduce(&v, n);
+            halve(&v, n);
+            zmul(qk, zq, &tmp);
+            zfree(qk);
+            qk = tmp;
+            reduce(&qk, n);
+        }
+    }
+
+    result = (ziszero(u) || ziszero(v));
+    for (r = 1; !result && r < s; r++) {
+        /* V_2k = V_k^2 - 2 Q^k */
+        zsquare(v, &tmp);
+        zshift(qk, 1L, &tmp2);
+        zfree(v);
+        zsub(tmp, tmp2, &v);
+        zfree(tmp);
+        zfree(tmp2);
+        reduce(&v, n);
+        result = ziszero(v);
+        if (!result && r + 1 < s) {
+            zsquare(qk, &tmp);
+            zfree(qk);
+            qk = tmp;
+            reduce(&qk, n);
+        }
+    }
+    zfree(u);
+    zfree(v);
+    zfree(qk);
+    zfree(d);
+    zfree(zd);
+    zfree(zq);
+    return result;
+}
+
+/* the base 2 and Lucas tests, for odd n > 2^32 without small factors */
+static BOOL
+zbpsw_tests(ZVALUE n)
+{
+    return zsprp2(n) && !zsquarep(n) && zslprp(n);
+}
+
+/* TRUE if abs(n) is prime (or a BPSW probable prime if it is > 2^32) */
+BOOL
+zbpsw(ZVALUE n)
+{
+    const uint32_t *small_primes;
+    long small_count, i;
+    FLAG small;
+
+    small = zisprime(n);
+    if (small >= 0) {
+        return small;
+    }
+    n.sign = 0;
+    small_primes = small_prime_table(&small_count);
+    for (i = 1; i < small_count; i++) {
+        if (zmodi(n, small_primes[i]) == 0) {
+            return FALSE;
+        }
+    }
+    return zbpsw_tests(n);
+}
+
+/* sets *res to the first prime after abs(n) if dir > 0, or before abs(n) if
+ * dir < 0.  abs(n) must be at least 2^32 - the primes are too far apart
+ * below that for the remainders to be worth keeping. */
+void
+zbpsw_step(ZVALUE n, int dir, ZVALUE * res)
+{
+    ZVALUE start, offset, cand;
+    const uint32_t *small_primes;
+    long *rems, small_count, i, k, p;
+    BOOL maybe;
+
+    small_primes = small_prime_table(&small_count);
+    n.sign = 0;
+
+    /* start is the first odd number after (or before) n */
+    itoz(zisodd(n) ? 2L * dir : dir, &offset);
+    zadd(n, offset, &start);
+    zfree(offset);
+
+    rems = ALLOC_N(long, small_count);
+    for (i = 1; i < small_count; i++) {
+        rems[i] = zmodi(start, small_primes[i]);
+    }
+    for (k = 0;; k++) {
+        maybe = TRUE;
+        for (i = 1; i < small_count; i++) {
+            p = small_primes[i];
+            if (rems[i] == 0) {
+                maybe = FALSE;
+            }
+            rems[i] = (rems[i] + 2 * dir + p) % p;
+        }
+        if (!maybe) {
+            continue;
+        }
+        itoz(2L * dir * k, &offset);
+        zadd(start, offset, &cand);
+        zfree(offset);
+        if (zbpsw_tests(cand)) {
+            break;
+        }
+        zfree(cand);
+    }
+    xfree(rems);
+    zfree(start);
+    *res = cand;
+}
@@ -0,0 +1,316 @@
+#include <math.h>
+#include "calc.h"
+
+/* Binary splitting evaluation of pi, e, ln(2) and ln(10).
+ *
+ * Each constant is the sum of a hypergeometric series, ie one where the ratio
+ * of successive terms is a ratio of small polynomials in the term number.  A
+ * range of terms is summed exactly as a fraction by splitting it in half,
+ * summing each half recursively and combining the two with a few
+ * multiplications.  The integers involved have roughly the same size as
+ * their range, so the expensive multiplications near the top of the tree are
+ * balanced and can take advantage of zmul_fast.  The final fraction is
+ * converted to a fixed point value with a single division.
+ *
+ * Used by the constant cache (constants.c) when more than
+ * BSPLIT_THRESHOLD bits are wanted; libcalc's own series are fine below that.
+ */
+
+/* fixed point results are calculated with this many extra bits, which covers
+ * the truncation errors of the final division(s) */
+#define BSPLIT_GUARD_BITS 16
+
+/* Chudnovsky: each term adds log2(640320^3 / 1728) bits */
+#define CHUDNOVSKY_BITS_PER_TERM 47.11
+#define CHUDNOVSKY_A 13591409L
+#define CHUDNOVSKY_B 545140134L
+#define CHUDNOVSKY_C 640320L
+
+typedef struct {
+    ZVALUE p;
+    ZVALUE q;
+    ZVALUE t;
+} SPLIT;
+
+static void
+split_free(SPLIT * s, int need_p)
+{
+    if (need_p) {
+        zfree(s->p);
+    }
+    zfree(s->q);
+    zfree(s->t);
+}
+
+/* res = z1 * z2 + z3 * z4 */
+static void
+zmuladd2(ZVALUE z1, ZVALUE z2, ZVALUE z3, ZVALUE z4, ZVALUE * res)
+{
+    ZVALUE a, b;
+
+    zmul_fast(z1, z2, &a);
+    zmul_fast(z3, z4, &b);
+    zadd(a, b, res);
+    zfree(a);
+    zfree(b);
+}
+
+/* returns a NUMBER for z / 2^bits.  z is consumed. */
+static NUMBER *
+fixed_to_number(ZVALUE z, long bits)
+{
+    NUMBER *num, *den, *res;
+
+    num = qalloc();
+    num->num = z;
+    den = qbitvalue(bits);
+    res = qqdiv(num, den);
+    qfree(num);
+    qfree(den);
+    return res;
+}
+
+/* returns floor(num * 2^bits / den) */
+static void
+zfixed_quo(ZVALUE num, ZVALUE den, long bits, ZVALUE * res)
+{
+    ZVALUE tmp;
+
+    zshift(num, bits, &tmp);
+    zquo(tmp, den, res, 0);
+    zfree(tmp);
+}
+
+/* Chudnovsky series:
+ *
+ *   1/pi = 12 / 640320^(3/2) * sum(k>=0) (-1)^k (6k)! (A + Bk) / ((3k)! k!^3 640320^3k)
+ *
+ * for terms [a, b), p and q are the products of the term ratios' numerators
+ * and denominators, and t / q is the sum of the terms relative to term a. */
+static void
+chudnovsky_split(long a, long b, SPLIT * s, int need_p)
+{
+    SPLIT l, r;
+    ZVALUE tmp, tmp2, tmp3;
+    long m;
+
+    if (b - a == 1) {
+        if (a == 0) {
+            itoz(1L, &s->p);
+            itoz(1L, &s->q);
+        }
+        else {
+            itoz(6 * a - 5, &tmp);
+            zmuli(tmp, 2 * a - 1, &tmp2);
+            zfree(tmp);
+            zmuli(tmp2, 6 * a - 1, &s->p);
+            zfree(tmp2);
+
+            /* a^3 * 640320^3 / 24 */
+            itoz(a, &tmp);
+            zmuli(tmp, a, &tmp2);
+            zfree(tmp);
+            zmuli(tmp2, a, &tmp);
+            zfree(tmp2);
+            zmuli(tmp, CHUDNOVSKY_C, &tmp2);
+            zfree(tmp);
+            zmuli(tmp2, CHUDNOVSKY_C, &tmp);
+            zfree(tmp2);
+            zmuli(tmp, CHUDNOVSKY_C / 24, &s->q);
+            zfree(tmp);
+        }
+        itoz(a, &tmp);
+        zmuli(tmp, CHUDNOVSKY_B, &tmp2);
+        zfree(tmp);
+        itoz(CHUDNOVSKY_A, &tmp);
+        zadd(tmp, tmp2, &tmp3);
+        zfree(tmp);
+        zfree(tmp2);
+        zmul_fast(s->p, tmp3, &s->t);
+        zfree(tmp3);
+        if (a & 1) {
+            s->t.sign = !s->t.sign;
+        }
+        if (!need_p) {
+            zfree(s->p);
+        }
+        return;
+    }
+
+    m = a + (b - a) / 2;
+    chudnovsky_split(a, m, &l, 1);
+    chudnovsky_split(m, b, &r, need_p);
+    if (need_p) {
+        zmul_fast(l.p, r.p, &s->p);
+    }
+    zmul_fast(l.q, r.q, &s->q);
+    zmuladd2(l.t, r.q, l.p, r.t, &s->t);
+    split_free(&l, 1);
+    split_free(&r, need_p);
+}
+
+/* returns pi to within 2^-bits */
+NUMBER *
+bsplit_pi(long bits)
+{
+    SPLIT s;
+    ZVALUE tmp, root, num, res;
+    long n, fbits;
+
+    fbits = bits + BSPLIT_GUARD_BITS;
+    n = (long) (fbits / CHUDNOVSKY_BITS_PER_TERM) + 2;
+    chudnovsky_split(0, n, &s, 0);
+
+    /* pi = 426880 * sqrt(10005) * q / t */
+    itoz(10005L, &tmp);
+    zshift(tmp, 2 * fbits, &num);
+    zfree(tmp);
+    zsqrt(num, &root, 0);
+    zfree(num);
+    zmuli(s.q, 426880L, &tmp);
+    zmul_fast(tmp, root, &num);
+    zfree(tmp);
+    zfree(root);
+    zquo(num, s.t, &res, 0);
+    zfree(num);
+    split_free(&s, 0);
+    return fixed_to_number(res, fbits);
+}
+
+/* e = sum(k>=0) 1/k!.  for terms (a, b], q = (a+1)(a+2)...b and p / q is
+ * the sum of the terms relative to term a. */
+static void
+e_split(long a, long b, SPLIT * s)
+{
+    SPLIT l, r;
+    ZVALUE tmp;
+    long m;
+
+    if (b - a == 1) {
+        itoz(1L, &s->p);
+        itoz(b, &s->q);
+        return;
+    }
+    m = a + (b - a) / 2;
+    e_split(a, m, &l);
+    e_split(m, b, &r);
+    zmul_fast(l.p, r.q, &tmp);
+    zadd(tmp, r.p, &s->p);
+    zfree(tmp);
+    zmul_fast(l.q, r.q, &s->q);
+    zfree(l.p);
+    zfree(l.q);
+    zfree(r.p);
+    zfree(r.q);
+}
+
+/* returns e to within 2^-bits */
+NUMBER *
+bsplit_e(long bits)
+{
+    SPLIT s;
+    ZVALUE num, res;
+    double log2fact = 0.0;
+    long n, fbits;
+
+    /* the terms after n are less than 2/(n+1)! */
+    fbits = bits + BSPLIT_GUARD_BITS;
+    for (n = 1; log2fact < fbits + 2; n++) {
+        log2fact += log((double) (n + 1)) / log(2.0);
+    }
+    e_split(0, n, &s);
+
+    /* e = 1 + p / q */
+    zadd(s.p, s.q, &num);
+    zfixed_quo(num, s.q, fbits, &res);
+    zfree(num);
+    zfree(s.p);
+    zfree(s.q);
+    return fixed_to_number(res, fbits);
+}
+
+/* atanh(1/x) = sum(k>=0) 1 / ((2k+1) x^(2k+1)).  for terms [a, b), q is the
+ * product of the term ratios' denominators (x^2 each, or x for the first
+ * term), p is the product of the 2k+1 divisors and t / (p * q) is the sum of
+ * the terms relative to term a. */
+static void
+atanh_split(long x, long a, long b, SPLIT * s)
+{
+    SPLIT l, r;
+    ZVALUE tmp;
+    long m;
+
+    if (b - a == 1) {
+        itoz(2 * a + 1, &s->p);
+        itoz((a == 0) ? x : x * x, &s->q);
+        itoz(1L, &s->t);
+        return;
+    }
+    m = a + (b - a) / 2;
+    atanh_split(x, a, m, &l);
+    atanh_split(x, m, b, &r);
+    zmul_fast(l.p, r.p, &s->p);
+    zmul_fast(l.q, r.q, &s->q);
+    zmul_fast(r.p, r.q, &tmp);
+    zmuladd2(tmp, l.t, l.p, r.t, &s->t);
+    zfree(tmp);
+    split_free(&l, 1);
+    split_free(&r, 1);
+}
+
+/* returns floor(atanh(1/x) * 2^fbits) */
+static void
+atanh_fixed(long x, long fbits, ZVALUE * res)
+{
+    SPLIT s;
+    ZVALUE den;
+    long n;
+
+    n = (long) (fbits / (2.0 * log((double) x) / log(2.0))) + 2;
+    atanh_split(x, 0, n, &s);
+    zmul_fast(s.p, s.q, &den);
+    zfixed_quo(s.t, den, fbits, res);
+    zfree(den);
+    split_free(&s, 1);
+}
+
+/* returns c1 * atanh(1/31) + c2 * atanh(1/49) + c3 * atanh(1/161) to within
+ * 2^-bits.  ln(2), ln(3) and ln(5) are all integer combinations of these. */
+static NUMBER *
+atanh_combination(long c1, long c2, long c3, long bits)
+{
+    static const long xs[3] = { 31, 49, 161 };
+    ZVALUE sum, term, tmp, tmp2;
+    long cs[3], fbits;
+    int i;
+
+    cs[0] = c1;
+    cs[1] = c2;
+    cs[2] = c3;
+    fbits = bits + BSPLIT_GUARD_BITS;
+    itoz(0L, &sum);
+    for (i = 0; i < 3; i++) {
+        atanh_fixed(xs[i], fbits, &term);
+        zmuli(term, cs[i], &tmp);
+        zfree(term);
+        zadd(sum, tmp, &tmp2);
+        zfree(sum);
+        zfree(tmp);
+        sum = tmp2;
+    }
+    return fixed_to_number(sum, fbits);
+}
+
+/* returns ln(2) to within 2^-bits */
+NUMBER *
+bsplit_ln2(long bits)
+{
+    return atanh_combination(14L, 10L, 6L, bits);
+}
+
+/* returns ln(10) to within 2^-bits */
+NUMBER *
+bsplit_ln10(long bits)
+{
+    return atanh_combination(46L, 34L, 20L, bits);
+}
@@ -123,11 +123,11 @@ trans_function(int argc, VALUE * argv, VALUE self, COMPLEX * (*f) (COMPLEX *, NU
     setup_math_error();
 
     if (rb_scan_args(argc, argv, "01", &epsilon) == 0) {
-        cresult = (*f) (DATA_PTR(self), conf->epsilon);
+        cresult = memo_cfunc(f, DATA_PTR(self), conf->epsilon);
     }
     else {
         qepsilon = value_to_number(epsilon, 1);
-        cresult = (*f) (DATA_PTR(self), qepsilon);
+        cresult = memo_cfunc(f, DATA_PTR(self), qepsilon);
         qfree(qepsilon);
     }
     if (!cresult) {
@@ -164,6 +164,224 @@ trans_function2(int argc, VALUE * argv, VALUE self,
     return wrap_complex(cresult);
 }
 
+/* same as trans_function(), for the functions c_trig_ratio() calculates */
+static VALUE
+trig_ratio_function(int argc, VALUE * argv, VALUE self, BOOL hyperbolic, int num, int den)
+{
+    VALUE epsilon;
+    COMPLEX *cresult;
+    NUMBER *qepsilon;
+    setup_math_error();
+
+    if (rb_scan_args(argc, argv, "01", &epsilon) == 0) {
+        cresult = c_trig_ratio(DATA_PTR(self), conf->epsilon, hyperbolic, num, den);
+    }
+    else {
+        qepsilon = value_to_number(epsilon, 1);
+        cresult = c_trig_ratio(DATA_PTR(self), qepsilon, hyperbolic, num, den);
+        qfree(qepsilon);
+    }
+    if (!cresult) {
+        rb_raise(e_MathError, "Complex transcendental function returned NULL");
+    }
+    return wrap_complex(cresult);
+}
+
+/*****************************************************************************
+ * fused sin/cos and sinh/cosh                                               *
+ *****************************************************************************/
+
+/* extra bits c_trig_ratio() always calculates sin and cos to */
+#define TRIG_RATIO_GUARD_BITS 8
+
+/* extra bits added each time a result is too close to halfway between two
+ * multiples of epsilon to round, and the most that will be added */
+#define TRIG_RATIO_TIE_STEP 32
+#define TRIG_RATIO_TIE_BITS 128
+
+/* sets *vsinh and *vcosh to sinh(c) and cosh(c) to within about epsilon,
+ * from one complex exponential w = exp(+-c) as (w - 1/w)/2 and (w + 1/w)/2.
+ * the sign is chosen so that |w| >= 1, making 1/w no less accurate than w.
+ * the results aren't rounded to a multiple of epsilon.  both are set to NULL
+ * if c_exp() returns NULL. */
+void
+c_sinhcosh(COMPLEX * c, NUMBER * epsilon, COMPLEX ** vsinh, COMPLEX ** vcosh)
+{
+    COMPLEX *z, *w, *winv, *ctmp;
+    BOOL neg;
+
+    neg = qisneg(c->real);
+    z = neg ? c_neg(c) : clink(c);
+    w = c_exp(z, epsilon);
+    comfree(z);
+    if (!w) {
+        *vsinh = *vcosh = NULL;
+        return;
+    }
+    winv = c_inv(w);
+    ctmp = c_sub(w, winv);
+    *vsinh = c_scale(ctmp, -1);
+    comfree(ctmp);
+    ctmp = c_add(w, winv);
+    *vcosh = c_scale(ctmp, -1);
+    comfree(ctmp);
+    comfree(w);
+    comfree(winv);
+    if (neg) {
+        ctmp = c_neg(*vsinh);
+        comfree(*vsinh);
+        *vsinh = ctmp;
+    }
+}
+
+/* same as c_sinhcosh() for sin(c) and cos(c), which are -i*sinh(i*c) and
+ * cosh(i*c) */
+void
+c_sincos(COMPLEX * c, NUMBER * epsilon, COMPLEX ** vsin, COMPLEX ** vcos)
+{
+    COMPLEX *ic, *csinh;
+    NUMBER *qtmp;
+
+    qtmp = qneg(c->imag);
+    ic = qqtoc(qtmp, c->real);
+    qfree(qtmp);
+    c_sinhcosh(ic, epsilon, &csinh, vcos);
+    comfree(ic);
+    if (!csinh) {
+        *vsin = NULL;
+        return;
+    }
+    qtmp = qneg(csinh->real);
+    *vsin = qqtoc(csinh->imag, qtmp);
+    qfree(qtmp);
+    comfree(csinh);
+}
+
+/* floor(log2(|c|^2)) for non-zero c */
+static long
+c_ilog2_norm(COMPLEX * c)
+{
+    NUMBER *q1, *q2, *qnorm;
+    long n;
+
+    q1 = qsquare(c->real);
+    q2 = qsquare(c->imag);
+    qnorm = qqadd(q1, q2);
+    n = qilog2(qnorm);
+    qfree(q1);
+    qfree(q2);
+    qfree(qnorm);
+    return n;
+}
+
+/* log2 of an upper bound for (1 + |num/den|) / |den|, the most an error in
+ * num or den is magnified in num/den.  num is NULL for 1. */
+static long
+ratio_bits(COMPLEX * num, COMPLEX * den)
+{
+    long lo_den, hi_num, n;
+
+    /* |den| >= 2^lo_den, |num| <= 2^hi_num */
+    n = c_ilog2_norm(den);
+    lo_den = n >= 0 ? n / 2 : -((1 - n) / 2);
+    hi_num = 0;
+    if (num && !ciszero(num)) {
+        n = c_ilog2_norm(num) + 1;
+        hi_num = n >= 0 ? (n + 1) / 2 : -(-n / 2);
+    }
+    return 2 + (hi_num > lo_den ? hi_num - lo_den : 0) - lo_den;
+}
+
+/* true if q/epsilon is within 2^-k of halfway between two integers */
+static BOOL
+near_half(NUMBER * q, NUMBER * epsilon, long k)
+{
+    NUMBER *t, *f, *d;
+    BOOL result;
+
+    t = qqdiv(q, epsilon);
+    f = qfrac(t);
+    qfree(t);
+    t = qqabs(f);
+    qfree(f);
+    d = qsub(t, &_qonehalf_);
+    qfree(t);
+    result = qiszero(d) || qilog2(d) < -k;
+    qfree(d);
+    return result;
+}
+
+/* returns num/den rounded to a multiple of epsilon, where num and den are
+ * each C_RATIO_ONE (1), C_RATIO_SIN or C_RATIO_COS of c (sinh and cosh if
+ * hyperbolic), eg tan is (C_RATIO_SIN, C_RATIO_COS) and csc is
+ * (C_RATIO_ONE, C_RATIO_SIN).
+ *
+ * sin and cos come from one c_sincos() or c_sinhcosh(), evaluated to enough
+ * extra bits that the division magnifies their error to less than
+ * epsilon/16; they are calculated again if the first guess at the bits needed
+ * was too low, or if a part of num/den is too close to halfway between two
+ * multiples of epsilon to tell which is nearer. */
+COMPLEX *
+c_trig_ratio(COMPLEX * c, NUMBER * epsilon, BOOL hyperbolic, int num, int den)
+{
+    COMPLEX *parts[3], *cquot, *cresult;
+    NUMBER *eps1, *qre, *qim;
+    long bits, need, tie_bits;
+
+    /* sin and sinh are only 0 at 0 */
+    if (den == C_RATIO_SIN && ciszero(c)) {
+        math_error("Division by zero");
+    }
+    bits = TRIG_RATIO_GUARD_BITS;
+    tie_bits = 0;
+    for (;;) {
+        eps1 = qscale(epsilon, -bits);
+        if (hyperbolic) {
+            c_sinhcosh(c, eps1, &parts[C_RATIO_SIN], &parts[C_RATIO_COS]);
+        }
+        else {
+            c_sincos(c, eps1, &parts[C_RATIO_SIN], &parts[C_RATIO_COS]);
+        }
+        qfree(eps1);
+        if (!parts[C_RATIO_SIN]) {
+            return NULL;
+        }
+        parts[C_RATIO_ONE] = NULL;
+        if (ciszero(parts[den])) {
+            /* den is smaller than eps1 */
+            need = 2 * bits;
+        }
+        else {
+            need = ratio_bits(parts[num], parts[den]) + 3;
+        }
+        if (need > bits) {
+            comfree(parts[C_RATIO_SIN]);
+            comfree(parts[C_RATIO_COS]);
+            bits = need;
+            continue;
+        }
+        cquot = num == C_RATIO_ONE ? c_inv(parts[den]) : c_div(parts[num], parts[den]);
+        comfree(parts[C_RATIO_SIN]);
+        comfree(parts[C_RATIO_COS]);
+        /* the error in cquot is less than epsilon * 2^(need - bits - 4) */
+        if (tie_bits >= TRIG_RATIO_TIE_BITS
+            || (!near_half(cquot->real, epsilon, bits - need + 3)
+                && !near_half(cquot->imag, epsilon, bits - need + 3))) {
+            break;
+        }
+        comfree(cquot);
+        bits += TRIG_RATIO_TIE_STEP;
+        tie_bits += TRIG_RATIO_TIE_STEP;
+    }
+    qre = qmappr(cquot->real, epsilon, 24L);
+    qim = qmappr(cquot->imag, epsilon, 24L);
+    comfree(cquot);
+    cresult = qqtoc(qre, qim);
+    qfree(qre);
+    qfree(qim);
+    return cresult;
+}
+
 /*****************************************************************************
  * instance method implementations                                           *
  *****************************************************************************/
@@ -475,6 +693,58 @@ cc_cosh(int argc, VALUE * argv, VALUE self)
     return trans_function(argc, argv, self, &c_cosh);
 }
 
+/* Trigonometric cotangent
+ *
+ * @param eps [Calc::Q] (optional) calculation accuracy
+ * @return [Calc::C]
+ * @example
+ *  Calc::C(2,3).cot #=> Calc::C(-0.00373971037633695666-0.99675779656935831046i)
+ */
+static VALUE
+cc_cot(int argc, VALUE * argv, VALUE self)
+{
+    return trig_ratio_function(argc, argv, self, FALSE, C_RATIO_COS, C_RATIO_SIN);
+}
+
+/* Hyperbolic cotangent
+ *
+ * @param eps [Calc::Q] (optional) calculation accuracy
+ * @return [Calc::C]
+ * @example
+ *  Calc::C(2,3).coth #=> Calc::C(1.03574663776499539611+0.01060478347033710175i)
+ */
+static VALUE
+cc_coth(int argc, VALUE * argv, VALUE self)
+{
+    return trig_ratio_function(argc, argv, self, TRUE, C_RATIO_COS, C_RATIO_SIN);
+}
+
+/* Trigonometric cosecant
+ *
+ * @param eps [Calc::Q] (optional) calculation accuracy
+ * @return [Calc::C]
+ * @example
+ *  Calc::C(2,3).csc #=> Calc::C(0.09047320975320743981+0.04120098628857412646i)
+ */
+static VALUE
+cc_csc(int argc, VALUE * argv, VALUE self)
+{
+    return trig_ratio_function(argc, argv, self, FALSE, C_RATIO_ONE, C_RATIO_SIN);
+}
+
+/* Hyperbolic cosecant
+ *
+ * @param eps [Calc::Q] (optional) calculation accuracy
+ * @return [Calc::C]
+ * @example
+ *  Calc::C(2,3).csch #=> Calc::C(-0.27254866146294019951-0.04030057885689152188i)
+ */
+static VALUE
+cc_csch(int argc, VALUE * argv, VALUE self)
+{
+    return trig_ratio_function(argc, argv, self, TRUE, C_RATIO_ONE, C_RATIO_SIN);
+}
+
 /* Returns true if the number is real and even
  *
  * @return [Boolean]
@@ -682,6 +952,32 @@ cc_realp(VALUE self)
     return cisreal((COMPLEX *) DATA_PTR(self)) ? Qtrue : Qfalse;
 }
 
+/* Trigonometric secant
+ *
+ * @param eps [Calc::Q] (optional) calculation accuracy
+ * @return [Calc::C]
+ * @example
+ *  Calc::C(2,3).sec #=> Calc::C(-0.04167496441114427005+0.09061113719623759653i)
+ */
+static VALUE
+cc_sec(int argc, VALUE * argv, VALUE self)
+{
+    return trig_ratio_function(argc, argv, self, FALSE, C_RATIO_ONE, C_RATIO_COS);
+}
+
+/* Hyperbolic secant
+ *
+ * @param eps [Calc::Q] (optional) calculation accuracy
+ * @return [Calc::C]
+ * @example
+ *  Calc::C(2,3).sech #=> Calc::C(-0.26351297515838930964-0.03621163655876852087i)
+ */
+static VALUE
+cc_sech(int argc, VALUE * argv, VALUE self)
+{
+    return trig_ratio_function(argc, argv, self, TRUE, C_RATIO_ONE, C_RATIO_COS);
+}
+
 /* Trigonometric sine
  *
  * @param eps [Calc::Q] (optional) calculation accuracy
@@ -708,6 +1004,32 @@ cc_sinh(int argc, VALUE * argv, VALUE self)
     return trans_function(argc, argv, self, &c_sinh);
 }
 
+/* Trigonometric tangent
+ *
+ * @param eps [Calc::Q] (optional) calculation accuracy
+ * @return [Calc::C]
+ * @example
+ *  Calc::C(2,3).tan #=> Calc::C(-0.00376402564150424829+1.00323862735360980145i)
+ */
+static VALUE
+cc_tan(int argc, VALUE * argv, VALUE self)
+{
+    return trig_ratio_function(argc, argv, self, FALSE, C_RATIO_SIN, C_RATIO_COS);
+}
+
+/* Hyperbolic tangent
+ *
+ * @param eps [Calc::Q] (optional) calculation accuracy
+ * @return [Calc::C]
+ * @example
+ *  Calc::C(2,3).tanh #=> Calc::C(0.96538587902213312428-0.00988437503832249372i)
+ */
+static VALUE
+cc_tanh(int argc, VALUE * argv, VALUE self)
+{
+    return trig_ratio_function(argc, argv, self, TRUE, C_RATIO_SIN, C_RATIO_COS);
+}
+
 /* Returns true if real and imaginary parts are both zero
  *
  * @return [Boolean]
@@ -752,6 +1074,10 @@ define_calc_c(VALUE m)
     rb_define_method(cC, "atanh", cc_atanh, -1);
     rb_define_method(cC, "cos", cc_cos, -1);
     rb_define_method(cC, "cosh", cc_cosh, -1);
+    rb_define_method(cC, "cot", cc_cot, -1);
+    rb_define_method(cC, "coth", cc_coth, -1);
+    rb_define_method(cC, "csc", cc_csc, -1);
+    rb_define_method(cC, "csch", cc_csch, -1);
     rb_define_method(cC, "even?", cc_evenp, 0);
     rb_define_method(cC, "exp", cc_exp, -1);
     rb_define_method(cC, "frac", cc_frac, 0);
@@ -765,8 +1091,12 @@ define_calc_c(VALUE m)
     rb_define_method(cC, "power", cc_power, -1);
     rb_define_method(cC, "re", cc_re, 0);
     rb_define_method(cC, "real?", cc_realp, 0);
+    rb_define_method(cC, "sec", cc_sec, -1);
+    rb_define_method(cC, "sech", cc_sech, -1);
     rb_define_method(cC, "sin", cc_sin, -1);
     rb_define_method(cC, "sinh", cc_sinh, -1);
+    rb_define_method(cC, "tan", cc_tan, -1);
+    rb_define_method(cC, "tanh", cc_tanh, -1);
     rb_define_method(cC, "zero?", cc_zerop, 0);
 
     rb_define_alias(cC, "**", "power");
@@ -105,11 +105,11 @@ calc_pi(int argc, VALUE * argv, VALUE self)
     setup_math_error();
 
     if (rb_scan_args(argc, argv, "01", &epsilon) == 0) {
-        qresult = qpi(conf->epsilon);
+        qresult = qpi_cached(conf->epsilon);
     }
     else {
         qepsilon = value_to_number(epsilon, 1);
-        qresult = qpi(qepsilon);
+        qresult = qpi_cached(qepsilon);
         qfree(qepsilon);
     }
     return wrap_number(qresult);
@@ -178,15 +178,32 @@ Init_calc(void)
     libcalc_call_me_first();
 
     m = rb_define_module("Calc");
+    rb_define_module_function(m, "batch_gcd", calc_batch_gcd, -1);
+    rb_define_module_function(m, "clear_memo", calc_clear_memo, 0);
+    rb_define_module_function(m, "compile", calc_compile, -1);
     rb_define_module_function(m, "config", calc_config, -1);
+    rb_define_module_function(m, "constant_cache_stats", calc_constant_cache_stats, 0);
+    rb_define_module_function(m, "crt", calc_crt, 2);
+    rb_define_module_function(m, "digits_of", calc_digits_of, -1);
+    rb_define_module_function(m, "each_prime", calc_each_prime, -1);
+    rb_define_module_function(m, "fib_each", calc_fib_each, -1);
     rb_define_module_function(m, "freebernoulli", calc_freebernoulli, 0);
     rb_define_module_function(m, "freeeuler", calc_freeeuler, 0);
     rb_define_module_function(m, "hnrmod", calc_hnrmod, 4);
+    rb_define_module_function(m, "memo_stats", calc_memo_stats, 0);
     rb_define_module_function(m, "pi", calc_pi, -1);
     rb_define_module_function(m, "polar", calc_polar, -1);
+    rb_define_module_function(m, "ptest_many", calc_ptest_many, -1);
+    rb_define_module_function(m, "rational_reconstruct", calc_rational_reconstruct, 2);
     rb_define_module_function(m, "version", calc_version, 0);
     define_calc_math_error(m);
     define_calc_numeric(m);
     define_calc_q(m);
     define_calc_c(m);
+    define_calc_polynomial(m);
+    define_calc_modcontext(m);
+    define_calc_digitstream(m);
+    define_calc_expression(m);
+    define_calc_fixed(m);
+    define_calc_unreduced(m);
 }
@@ -14,10 +14,41 @@ extern char *version(void);
 #include <calc/config.h>
 #include <calc/lib_calc.h>
 
+/* batchgcd.c */
+extern VALUE calc_batch_gcd(int argc, VALUE * argv, VALUE klass);
+
+/* bpsw.c */
+extern BOOL zbpsw(ZVALUE n);
+extern void zbpsw_step(ZVALUE n, int dir, ZVALUE * res);
+
+/* bsplit.c */
+#define BSPLIT_THRESHOLD 2048   /* minimum bits for binary splitting */
+extern NUMBER *bsplit_e(long bits);
+extern NUMBER *bsplit_ln10(long bits);
+extern NUMBER *bsplit_ln2(long bits);
+extern NUMBER *bsplit_pi(long bits);
+
+/* cfrac.c */
+extern VALUE cq_continued_fraction(VALUE self);
+extern VALUE cq_convergents(int argc, VALUE * argv, VALUE self);
+
 /* config.c */
 extern VALUE calc_config(int argc, VALUE * argv, VALUE klass);
 extern long value_to_mode(VALUE v);
 
+/* constants.c */
+#define CONSTANT_PI 0
+#define CONSTANT_E 1
+#define CONSTANT_LN2 2
+#define CONSTANT_LN10 3
+extern long constant_cache_limit;
+extern NUMBER *constant_value(int which, NUMBER * epsilon, long rnd);
+extern void constant_cache_set_limit(long limit);
+extern VALUE calc_constant_cache_stats(VALUE klass);
+extern NUMBER *qexp_cached(NUMBER * q, NUMBER * epsilon);
+extern NUMBER *qln_cached(NUMBER * q, NUMBER * epsilon);
+extern NUMBER *qpi_cached(NUMBER * epsilon);
+
 /* convert.c */
 extern NUMBER *value_to_number(VALUE arg, int string_allowed);
 extern COMPLEX *value_to_complex(VALUE arg);
@@ -25,6 +56,42 @@ extern long value_to_long(VALUE n);
 extern VALUE wrap_complex(COMPLEX * c);
 extern VALUE wrap_number(NUMBER * n);
 
+/* crt.c */
+extern VALUE calc_crt(VALUE klass, VALUE residues, VALUE moduli);
+extern VALUE calc_rational_reconstruct(VALUE klass, VALUE a, VALUE m);
+
+/* digits.c */
+extern VALUE cDigitStream;      /* Calc::DigitStream class */
+extern VALUE calc_digits_of(int argc, VALUE * argv, VALUE klass);
+extern void define_calc_digitstream(VALUE m);
+
+/* expression.c */
+extern VALUE cExpression;       /* Calc::Expression class */
+extern VALUE calc_compile(int argc, VALUE * argv, VALUE klass);
+extern void define_calc_expression(VALUE m);
+
+/* factorial.c */
+extern long fact_exponent(long n, long p);
+extern NUMBER *qcomb_fast(NUMBER * q1, NUMBER * q2);
+extern NUMBER *qfact_fast(NUMBER * q);
+extern NUMBER *qlcmfact_fast(NUMBER * q);
+extern NUMBER *qperm_fast(NUMBER * q1, NUMBER * q2);
+extern NUMBER *qpfact_fast(NUMBER * q);
+extern void zprimepower_product(const uint32_t * primes, const long *exps, long count,
+                                ZVALUE * res);
+
+/* factorize.c */
+extern long zfactorize(ZVALUE n, double seconds, ZVALUE ** factors, long **exps);
+
+/* fib.c */
+extern VALUE calc_fib_each(int argc, VALUE * argv, VALUE klass);
+extern NUMBER *qfib_fast(NUMBER * q, NUMBER * m);
+extern NUMBER *qlucas_fast(NUMBER * q, NUMBER * m);
+
+/* fixed.c */
+extern VALUE cFixed;            /* Calc::Fixed class */
+extern void define_calc_fixed(VALUE m);
+
 /* math_error.c */
 extern VALUE e_MathError;       /* Calc::MathError class (exception) */
 extern void define_calc_math_error();
@@ -35,10 +102,57 @@ extern void setup_math_error();
 #define setup_math_error() ((void)0)
 #endif
 
+/* memo.c */
+extern long memo_limit;         /* Calc.config(:memo) */
+extern VALUE calc_clear_memo(VALUE klass);
+extern VALUE calc_memo_stats(VALUE klass);
+extern COMPLEX *memo_cfunc(COMPLEX * (*f) (COMPLEX *, NUMBER *), COMPLEX * c,
+                           NUMBER * epsilon);
+extern COMPLEX *memo_csqrt(COMPLEX * c, NUMBER * epsilon, long R);
+extern NUMBER *memo_qfunc(NUMBER * (*f) (NUMBER *, NUMBER *), NUMBER * q, NUMBER * epsilon);
+extern NUMBER *memo_qsqrt(NUMBER * q, NUMBER * epsilon, long R);
+extern void memo_set_limit(long limit);
+
+/* modcontext.c */
+extern VALUE cModContext;       /* Calc::ModContext class */
+extern void define_calc_modcontext(VALUE m);
+
+/* mont.c */
+extern int limb_cmp(const HALF * a, const HALF * b, LEN len);
+extern HALF limb_add(HALF * a, const HALF * b, LEN len);
+extern HALF limb_sub(HALF * a, const HALF * b, LEN len);
+extern void mod_double(HALF * a, const HALF * n, LEN len);
+extern void mod_add(const HALF * a, const HALF * b, const HALF * n, LEN len, HALF * r);
+extern void mod_sub(const HALF * a, const HALF * b, const HALF * n, LEN len, HALF * r);
+extern HALF mont_ninv(const HALF * n);
+extern void mont_one(HALF * one, const HALF * n, LEN len);
+extern void mont_mul(const HALF * a, const HALF * b, const HALF * n, LEN len, HALF ninv,
+                     HALF * t, HALF * r);
+
 /* numeric.c */
 extern VALUE cNumeric;          /* Calc::Numeric module */
 extern void define_calc_numeric(VALUE m);
 
+/* parallel.c */
+extern long calc_threads;       /* Calc.config(:threads) */
+extern void parallel_run(void *(*fn) (void *), void **args, int n);
+extern void call_without_gvl(void *(*fn) (void *), void *data, volatile int *cancel);
+
+/* pix.c */
+extern int64_t pix_large(int64_t x);
+
+/* polynomial.c */
+extern VALUE cPolynomial;       /* Calc::Polynomial class */
+extern void define_calc_polynomial(VALUE m);
+
+/* primes.c */
+extern uint32_t *prime_sieve(long n, long *count);
+extern const uint32_t *small_prime_table(long *count);
+extern VALUE calc_each_prime(int argc, VALUE * argv, VALUE klass);
+
+/* ptest.c */
+extern VALUE calc_ptest_many(int argc, VALUE * argv, VALUE klass);
+
 /* q.c (rational numbers) */
 extern const rb_data_type_t calc_q_type;
 extern VALUE cQ;                /* Calc::Q class */
@@ -46,6 +160,12 @@ extern VALUE cQ;                /* Calc::Q class */
 extern VALUE cq_alloc(VALUE klass);
 extern void define_calc_q(VALUE m);
 
+/* qdouble.c */
+extern NUMBER *double_epsilon_value(void);
+extern void double_epsilon_set(NUMBER * q);
+extern NUMBER *qtrans_double(NUMBER * (*f) (NUMBER *, NUMBER *), NUMBER * q,
+                             NUMBER * epsilon);
+
 /* c.c (complex numbers) */
 extern const rb_data_type_t calc_c_type;
 extern VALUE cC;                /* Calc::C class */
@@ -53,6 +173,27 @@ extern VALUE cC;                /* Calc::C class */
 extern VALUE cc_alloc(VALUE klass);
 extern void define_calc_c(VALUE m);
 
+#define C_RATIO_ONE 0           /* c_trig_ratio() numerator of 1 */
+#define C_RATIO_SIN 1           /* sin (or sinh) */
+#define C_RATIO_COS 2           /* cos (or cosh) */
+extern void c_sincos(COMPLEX * c, NUMBER * epsilon, COMPLEX ** vsin, COMPLEX ** vcos);
+extern void c_sinhcosh(COMPLEX * c, NUMBER * epsilon, COMPLEX ** vsinh, COMPLEX ** vcosh);
+extern COMPLEX *c_trig_ratio(COMPLEX * c, NUMBER * epsilon, BOOL hyperbolic, int num, int den);
+
+/* unreduced.c */
+#define UNREDUCED_THRESHOLD_DEFAULT 1024 /* bits of denominator before reducing */
+extern VALUE cUnreduced;        /* Calc::Unreduced class */
+extern long unreduced_threshold;        /* Calc.config(:unreduced) */
+extern void define_calc_unreduced(VALUE m);
+
+/* zmul.c */
+extern long ntt_threshold;      /* minimum HALFs for NTT multiplication */
+extern void zmod_fast(ZVALUE z, ZVALUE m, ZVALUE * res);
+extern void zmul_fast(ZVALUE z1, ZVALUE z2, ZVALUE * res);
+extern void zsquare_fast(ZVALUE z, ZVALUE * res);
+extern NUMBER *qmul_fast(NUMBER * q1, NUMBER * q2);
+extern NUMBER *qpowi_fast(NUMBER * q, NUMBER * e);
+
 /*** macros ***/
 
 /* initialize new ruby values */
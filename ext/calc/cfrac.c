@@ -0,0 +1,424 @@
+#include "calc.h"
+
+/* Calc::Q#continued_fraction and #convergents.
+ *
+ * The partial quotients of num/den are those of the euclidean algorithm on
+ * num and den.  Rather than divide the full numbers for every quotient, the
+ * quotients are found with Lehmer's method: the algorithm runs on the
+ * leading 62 bits of both numbers, keeping the quotients which are certain
+ * to be right (Knuth's test, TAOCP 4.5.2 algorithm L), then the full numbers
+ * are updated for all of them at once with one linear combination.  Each
+ * quotient is yielded as soon as its batch is known, so the expansion can be
+ * abandoned at any point without calculating the rest.
+ *
+ * Convergents p/q come from the usual recurrences.  The error of p/q is
+ * r / (den * q), where r is the remainder after the quotient of p/q, so
+ * checking it against eps needs no division.
+ */
+
+/* leading bits used for Lehmer steps; cofactors then fit in an int64_t */
+#define LEHMER_BITS 62
+
+typedef struct {
+    NUMBER *self;               /* the number being expanded */
+    ZVALUE x;                   /* the remaining fraction is x / y, x > y >= 0 */
+    ZVALUE y;
+    ZVALUE den;                 /* copy of self->den */
+    BOOL convergents;           /* yield convergents rather than quotients */
+    ZVALUE p[2];                /* numerators of the last two convergents */
+    ZVALUE q[2];                /* denominators of the last two convergents */
+    NUMBER *max_den;            /* stop before a convergent with larger den */
+    NUMBER *eps;                /* stop after a convergent within eps */
+    ZVALUE r;                   /* remainder being emitted, if v isn't NULL */
+} CFRAC;
+
+/* res = z * s for a signed 64 bit s */
+static void
+zmul_int64(ZVALUE z, int64_t s, ZVALUE * res)
+{
+    ZVALUE t;
+
+    utoz((FULL) (s < 0 ? -(uint64_t) s : (uint64_t) s), &t);
+    zmul(z, t, res);
+    zfree(t);
+    if (s < 0 && !ziszero(*res)) {
+        res->sign = !res->sign;
+    }
+}
+
+/* is r / (den * q) <= eps?  sizes decide it unless they are close. */
+static BOOL
+cf_within_eps(CFRAC * cf, ZVALUE r, ZVALUE q)
+{
+    ZVALUE lhs, rhs, t;
+    long lbits, rbits;
+    BOOL result;
+
+    if (ziszero(r)) {
+        return TRUE;
+    }
+    if (qiszero(cf->eps)) {
+        return FALSE;
+    }
+    lbits = zhighbit(r) + zhighbit(cf->eps->den);
+    rbits = zhighbit(cf->eps->num) + zhighbit(cf->den) + zhighbit(q);
+    if (lbits + 2 <= rbits) {
+        return TRUE;
+    }
+    if (lbits >= rbits + 3) {
+        return FALSE;
+    }
+    zmul(r, cf->eps->den, &lhs);
+    zmul(cf->eps->num, cf->den, &t);
+    zmul(t, q, &rhs);
+    zfree(t);
+    result = (zrel(lhs, rhs) <= 0);
+    zfree(lhs);
+    zfree(rhs);
+    return result;
+}
+
+/* handles the next partial quotient a (taking ownership of it); r is the
+ * remainder which follows it.  returns FALSE when the expansion should
+ * stop. */
+static BOOL
+cf_emit(CFRAC * cf, ZVALUE a, ZVALUE r)
+{
+    NUMBER *result;
+    ZVALUE t, p, q;
+
+    if (!cf->convergents) {
+        result = qalloc();
+        result->num = a;
+        rb_yield(wrap_number(result));
+        return TRUE;
+    }
+    zmul(a, cf->p[1], &t);
+    zadd(t, cf->p[0], &p);
+    zfree(t);
+    zmul(a, cf->q[1], &t);
+    zadd(t, cf->q[0], &q);
+    zfree(t);
+    zfree(a);
+    zfree(cf->p[0]);
+    zfree(cf->q[0]);
+    cf->p[0] = cf->p[1];
+    cf->q[0] = cf->q[1];
+    cf->p[1] = p;
+    cf->q[1] = q;
+    if (cf->max_den && zrel(q, cf->max_den->num) > 0) {
+        return FALSE;
+    }
+    result = qalloc();
+    zcopy(p, &result->num);
+    zfree(result->den);
+    zcopy(q, &result->den);
+    rb_yield(wrap_number(result));
+    return !(cf->eps && cf_within_eps(cf, r, q));
+}
+
+/* frees the remainder kept in cf->r, if any */
+static void
+cf_free_r(CFRAC * cf)
+{
+    if (cf->r.v) {
+        zfree(cf->r);
+        cf->r.v = NULL;
+    }
+}
+
+/* one quotient by full division */
+static BOOL
+cf_divide(CFRAC * cf)
+{
+    ZVALUE a, r;
+
+    zdiv(cf->x, cf->y, &a, &r, 0);
+    zfree(cf->x);
+    cf->x = cf->y;
+    cf->y = r;
+    return cf_emit(cf, a, r);
+}
+
+/* as many quotients as Lehmer's method finds from the leading bits, or one
+ * by full division if it finds none */
+static BOOL
+cf_lehmer(CFRAC * cf)
+{
+    uint64_t qs[2 * LEHMER_BITS];
+    int64_t xh, yh, A, B, C, D, T, q1;
+    ZVALUE t1, t2, nx, ny, a;
+    long shift;
+    int i, n;
+
+    shift = zhighbit(cf->x) + 1 - LEHMER_BITS;
+    zshift(cf->x, -shift, &t1);
+    xh = (int64_t) ztou(t1);
+    zfree(t1);
+    zshift(cf->y, -shift, &t1);
+    yh = (int64_t) ztou(t1);
+    zfree(t1);
+
+    A = 1;
+    B = 0;
+    C = 0;
+    D = 1;
+    n = 0;
+    while (yh + C != 0 && yh + D != 0) {
+        q1 = (xh + A) / (yh + C);
+        if (q1 != (xh + B) / (yh + D)) {
+            break;
+        }
+        qs[n++] = (uint64_t) q1;
+        T = A - q1 * C;
+        A = C;
+        C = T;
+        T = B - q1 * D;
+        B = D;
+        D = T;
+        T = xh - q1 * yh;
+        xh = yh;
+        yh = T;
+    }
+    if (n == 0) {
+        return cf_divide(cf);
+    }
+
+    /* emit the quotients first, in case of early exit; remainders are only
+     * needed to check eps, and then each comes from the cofactors.  they are
+     * kept in cf->r so cf_free releases them if the block breaks out. */
+    A = 1;
+    B = 0;
+    C = 0;
+    D = 1;
+    for (i = 0; i < n; i++) {
+        T = A - (int64_t) qs[i] * C;
+        A = C;
+        C = T;
+        T = B - (int64_t) qs[i] * D;
+        B = D;
+        D = T;
+        utoz((FULL) qs[i], &a);
+        if (cf->convergents && cf->eps) {
+            zmul_int64(cf->x, C, &t1);
+            zmul_int64(cf->y, D, &t2);
+            zadd(t1, t2, &cf->r);
+            zfree(t1);
+            zfree(t2);
+            cf->r.sign = 0;
+        }
+        if (!cf_emit(cf, a, cf->r.v ? cf->r : _one_)) {
+            cf_free_r(cf);
+            return FALSE;
+        }
+        cf_free_r(cf);
+    }
+    zmul_int64(cf->x, A, &t1);
+    zmul_int64(cf->y, B, &t2);
+    zadd(t1, t2, &nx);
+    zfree(t1);
+    zfree(t2);
+    zmul_int64(cf->x, C, &t1);
+    zmul_int64(cf->y, D, &t2);
+    zadd(t1, t2, &ny);
+    zfree(t1);
+    zfree(t2);
+    zfree(cf->x);
+    zfree(cf->y);
+    nx.sign = 0;
+    ny.sign = 0;
+    cf->x = nx;
+    cf->y = ny;
+    return TRUE;
+}
+
+/* the rest of the quotients, once x is below 2^64 */
+static BOOL
+cf_small(CFRAC * cf)
+{
+    FULL x, y, a;
+    ZVALUE za;
+
+    x = ztou(cf->x);
+    y = ztou(cf->y);
+    while (y != 0) {
+        a = x / y;
+        utoz(x % y, &cf->r);
+        x = y;
+        y = ztou(cf->r);
+        utoz(a, &za);
+        if (!cf_emit(cf, za, cf->r)) {
+            cf_free_r(cf);
+            return FALSE;
+        }
+        cf_free_r(cf);
+    }
+    zfree(cf->y);
+    itoz(0, &cf->y);
+    return TRUE;
+}
+
+/* sets up cf for self and yields the integer part (or 0th convergent).
+ * returns FALSE if there is nothing more to do. */
+static BOOL
+cf_start(CFRAC * cf)
+{
+    ZVALUE a, r;
+
+    zdiv(cf->self->num, cf->self->den, &a, &r, 0);
+    zcopy(cf->self->den, &cf->den);
+    zcopy(cf->self->den, &cf->x);
+    cf->y = r;
+    if (cf->convergents) {
+        /* p[1]/q[1] = 1/0 and p[0]/q[0] = 0/1 start the recurrences */
+        itoz(0, &cf->p[0]);
+        itoz(1, &cf->p[1]);
+        itoz(1, &cf->q[0]);
+        itoz(0, &cf->q[1]);
+    }
+    return cf_emit(cf, a, r);
+}
+
+static VALUE
+cf_loop(VALUE arg)
+{
+    CFRAC *cf = (CFRAC *) arg;
+
+    if (!cf_start(cf)) {
+        return Qnil;
+    }
+    while (!ziszero(cf->y)) {
+        if (zhighbit(cf->x) < 64) {
+            cf_small(cf);
+            break;
+        }
+        if (!cf_lehmer(cf)) {
+            break;
+        }
+    }
+    return Qnil;
+}
+
+static VALUE
+cf_free(VALUE arg)
+{
+    CFRAC *cf = (CFRAC *) arg;
+
+    zfree(cf->x);
+    zfree(cf->y);
+    zfree(cf->den);
+    cf_free_r(cf);
+    if (cf->convergents) {
+        zfree(cf->p[0]);
+        zfree(cf->p[1]);
+        zfree(cf->q[0]);
+        zfree(cf->q[1]);
+    }
+    if (cf->max_den) {
+        qfree(cf->max_den);
+    }
+    if (cf->eps) {
+        qfree(cf->eps);
+    }
+    return Qnil;
+}
+
+/* Continued fraction expansion
+ *
+ * Yields the partial quotients a0, a1, a2, ... of self, so that self is
+ * a0 + 1/(a1 + 1/(a2 + ...)).  a0 is self.floor and the rest are positive.
+ * They are found a few at a time from the leading bits of the remaining
+ * fraction (Lehmer's method), so stopping early is cheap.
+ *
+ * @return [nil,Enumerator] nil, or an Enumerator if no block is given
+ * @yield [Calc::Q]
+ * @example
+ *  Calc::Q(415, 93).continued_fraction.to_a #=> [Calc::Q(4), Calc::Q(2), Calc::Q(6), Calc::Q(7)]
+ *  Calc.pi.continued_fraction.first(5) #=> [Calc::Q(3), Calc::Q(7), Calc::Q(15), Calc::Q(1), Calc::Q(292)]
+ * @see #convergents
+ */
+VALUE
+cq_continued_fraction(VALUE self)
+{
+    CFRAC cf;
+    setup_math_error();
+
+    RETURN_ENUMERATOR(self, 0, 0);
+    cf.self = DATA_PTR(self);
+    cf.convergents = FALSE;
+    cf.max_den = NULL;
+    cf.eps = NULL;
+    cf.r.v = NULL;
+    rb_ensure(cf_loop, (VALUE) & cf, cf_free, (VALUE) & cf);
+    return Qnil;
+}
+
+/* Convergents of the continued fraction expansion
+ *
+ * Yields the successive convergents of self (see #continued_fraction),
+ * which are its best approximations: each is closer to self than any
+ * fraction with a smaller denominator.  The last one is self.
+ *
+ * This is much faster than repeated #cfsim, as each convergent comes from
+ * the two before it rather than expanding self again.
+ *
+ * @param den [Integer] stop before the first convergent with a denominator
+ *  greater than this
+ * @param eps [Numeric] stop after the first convergent within eps of self
+ * @return [nil,Enumerator] nil, or an Enumerator if no block is given
+ * @yield [Calc::Q]
+ * @raise [Calc::MathError] if den or eps is negative
+ * @example
+ *  Calc.pi.convergents(den: 30000).map { |x| x.to_s(:frac) } #=> ["3", "22/7", "333/106", "355/113"]
+ *  Calc.pi.convergents(eps: 1e-9).to_a.last.to_s(:frac) #=> "103993/33102"
+ * @see #cfsim
+ */
+VALUE
+cq_convergents(int argc, VALUE * argv, VALUE self)
+{
+    static ID keywords[2];
+    CFRAC cf;
+    NUMBER *q;
+    VALUE opts, values[2];
+    BOOL neg;
+    int i;
+    setup_math_error();
+
+    RETURN_ENUMERATOR(self, argc, argv);
+    rb_scan_args(argc, argv, "0:", &opts);
+    if (!keywords[0]) {
+        keywords[0] = rb_intern("den");
+        keywords[1] = rb_intern("eps");
+    }
+    values[0] = values[1] = Qundef;
+    if (!NIL_P(opts)) {
+        rb_get_kwargs(opts, keywords, 0, 2, values);
+    }
+    /* check both limits first so nothing is leaked by a bad one */
+    for (i = 0; i < 2; i++) {
+        if (values[i] == Qundef) {
+            values[i] = Qnil;
+        }
+        if (!NIL_P(values[i])) {
+            q = value_to_number(values[i], 1);
+            neg = qisneg(q);
+            qfree(q);
+            if (neg) {
+                rb_raise(e_MathError, "negative limit for convergents");
+            }
+        }
+    }
+    cf.self = DATA_PTR(self);
+    cf.convergents = TRUE;
+    cf.max_den = NIL_P(values[0]) ? NULL : value_to_number(values[0], 1);
+    cf.eps = NIL_P(values[1]) ? NULL : value_to_number(values[1], 1);
+    cf.r.v = NULL;
+    if (cf.max_den && qisfrac(cf.max_den)) {
+        /* denominators are integers */
+        NUMBER *t = qint(cf.max_den);
+        qfree(cf.max_den);
+        cf.max_den = t;
+    }
+    rb_ensure(cf_loop, (VALUE) & cf, cf_free, (VALUE) & cf);
+    return Qnil;
+}
@@ -28,6 +28,15 @@ static nametype2 modes[] = {
     {NULL, 0}
 };
 
+/* config types that aren't part of libcalc (numbered well clear of calc's
+ * CONFIG_* values) */
+#define CONFIG_NTT 1001
+#define CONFIG_CONSTANT_CACHE 1002
+#define CONFIG_THREADS 1003
+#define CONFIG_UNREDUCED 1004
+#define CONFIG_MEMO 1005
+#define CONFIG_DOUBLE_EPSILON 1006
+
 /* config types we support - a subset of "configs[]" in calc's config.c */
 
 static nametype2 configs[] = {
@@ -42,6 +51,12 @@ static nametype2 configs[] = {
     {"cfappr", CONFIG_CFAPPR},
     {"cfsim", CONFIG_CFSIM},
     {"round", CONFIG_ROUND},
+    {"ntt", CONFIG_NTT},
+    {"constant_cache", CONFIG_CONSTANT_CACHE},
+    {"threads", CONFIG_THREADS},
+    {"unreduced", CONFIG_UNREDUCED},
+    {"memo", CONFIG_MEMO},
+    {"double_epsilon", CONFIG_DOUBLE_EPSILON},
     {NULL, 0}
 };
 
@@ -232,6 +247,46 @@ calc_config(int argc, VALUE * argv, VALUE klass)
             conf->round = value_to_len(new_value, "round");
         break;
 
+    case CONFIG_NTT:
+        old_value = LONG2FIX(ntt_threshold);
+        if (args == 2)
+            ntt_threshold = value_to_len(new_value, "ntt");
+        break;
+
+    case CONFIG_CONSTANT_CACHE:
+        old_value = LONG2NUM(constant_cache_limit);
+        if (args == 2)
+            constant_cache_set_limit(value_to_len(new_value, "constant_cache"));
+        break;
+
+    case CONFIG_THREADS:
+        old_value = LONG2FIX(calc_threads);
+        if (args == 2) {
+            long threads = value_to_len(new_value, "threads");
+            if (threads < 1)
+                rb_raise(e_MathError, "Zero value for threads");
+            calc_threads = threads;
+        }
+        break;
+
+    case CONFIG_UNREDUCED:
+        old_value = LONG2FIX(unreduced_threshold);
+        if (args == 2)
+            unreduced_threshold = value_to_len(new_value, "unreduced");
+        break;
+
+    case CONFIG_MEMO:
+        old_value = LONG2NUM(memo_limit);
+        if (args == 2)
+            memo_set_limit(value_to_len(new_value, "memo"));
+        break;
+
+    case CONFIG_DOUBLE_EPSILON:
+        old_value = wrap_number(qlink(double_epsilon_value()));
+        if (args == 2)
+            double_epsilon_set(value_to_number(new_value, 1));
+        break;
+
     default:
         rb_raise(rb_eArgError, "Invalid or unsupported config parameter");
     }
@@ -0,0 +1,264 @@
+#include "calc.h"
+
+/* Process-wide cache of mathematical constants.
+ *
+ * For each constant, the most precise value calculated so far is kept.  A
+ * request for the constant to within some epsilon is served by rounding the
+ * cached value to a multiple of epsilon (in the same mode as libcalc rounds its
+ * own result), so it is only calculated again if a more precise value is
+ * needed.  The total size of cached values is limited by
+ * Calc.config(:constant_cache) bytes; 0 disables the cache.
+ */
+
+/* extra bits calculated beyond the requested epsilon, so that rounding the
+ * cached value to epsilon almost always gives the same result as libcalc.
+ * it can differ when the value is within 2^-32 epsilon of halfway between
+ * two multiples of epsilon. */
+#define CONSTANT_GUARD_BITS 32
+
+/* never calculate fewer bits than this */
+#define CONSTANT_MIN_BITS 128
+
+#define CONSTANT_CACHE_DEFAULT (64L * 1024 * 1024)
+
+long constant_cache_limit = CONSTANT_CACHE_DEFAULT;
+
+typedef struct {
+    const char *name;
+    NUMBER *(*compute) (long bits);     /* value to within 2^-bits */
+    NUMBER *value;              /* best value so far, or NULL */
+    long bits;                  /* value is within 2^-bits */
+    long hits;
+    long misses;
+} CONSTANT;
+
+/* the compute functions use libcalc for modest precision and binary
+ * splitting (bsplit.c) beyond that */
+
+static NUMBER *
+compute_pi(long bits)
+{
+    NUMBER *eps, *r;
+
+    if (bits >= BSPLIT_THRESHOLD) {
+        return bsplit_pi(bits);
+    }
+    eps = qbitvalue(-bits);
+    r = qpi(eps);
+    qfree(eps);
+    return r;
+}
+
+static NUMBER *
+compute_e(long bits)
+{
+    NUMBER *eps, *r;
+
+    if (bits >= BSPLIT_THRESHOLD) {
+        return bsplit_e(bits);
+    }
+    eps = qbitvalue(-bits);
+    r = qexp(&_qone_, eps);
+    qfree(eps);
+    return r;
+}
+
+static NUMBER *
+compute_ln(long n, long bits)
+{
+    NUMBER *eps, *q, *r;
+
+    eps = qbitvalue(-bits);
+    q = itoq(n);
+    r = qln(q, eps);
+    qfree(q);
+    qfree(eps);
+    return r;
+}
+
+static NUMBER *
+compute_ln2(long bits)
+{
+    if (bits >= BSPLIT_THRESHOLD) {
+        return bsplit_ln2(bits);
+    }
+    return compute_ln(2, bits);
+}
+
+static NUMBER *
+compute_ln10(long bits)
+{
+    if (bits >= BSPLIT_THRESHOLD) {
+        return bsplit_ln10(bits);
+    }
+    return compute_ln(10, bits);
+}
+
+static CONSTANT constants[] = {
+    {"pi", compute_pi, NULL, 0, 0, 0},
+    {"e", compute_e, NULL, 0, 0, 0},
+    {"ln2", compute_ln2, NULL, 0, 0, 0},
+    {"ln10", compute_ln10, NULL, 0, 0, 0},
+    {NULL, NULL, NULL, 0, 0, 0}
+};
+
+static long
+number_bytes(NUMBER * q)
+{
+    return q ? (long) ((q->num.len + q->den.len) * sizeof(HALF)) : 0;
+}
+
+static long
+cache_bytes(void)
+{
+    CONSTANT *cp;
+    long total = 0;
+
+    for (cp = constants; cp->name; cp++) {
+        total += number_bytes(cp->value);
+    }
+    return total;
+}
+
+/* store a new value for cp, evicting other constants if needed to stay
+ * within constant_cache_limit.  values bigger than the limit aren't cached. */
+static void
+cache_store(CONSTANT * cp, NUMBER * value, long bits)
+{
+    CONSTANT *other;
+    long size;
+
+    size = number_bytes(value);
+    if (size > constant_cache_limit) {
+        return;
+    }
+    if (cp->value) {
+        qfree(cp->value);
+        cp->value = NULL;
+    }
+    for (other = constants; other->name && cache_bytes() + size > constant_cache_limit;
+         other++) {
+        if (other->value) {
+            qfree(other->value);
+            other->value = NULL;
+            other->bits = 0;
+        }
+    }
+    cp->value = qlink(value);
+    cp->bits = bits;
+}
+
+/* returns constant number `which` (CONSTANT_PI etc) rounded to a multiple of
+ * epsilon with rounding mode rnd */
+NUMBER *
+constant_value(int which, NUMBER * epsilon, long rnd)
+{
+    CONSTANT *cp = &constants[which];
+    NUMBER *value, *result;
+    long bits;
+
+    bits = CONSTANT_GUARD_BITS - qilog2(epsilon);
+    if (bits < CONSTANT_MIN_BITS) {
+        bits = CONSTANT_MIN_BITS;
+    }
+    if (cp->value && cp->bits >= bits) {
+        cp->hits++;
+        return qmappr(cp->value, epsilon, rnd);
+    }
+    cp->misses++;
+    value = (*cp->compute) (bits + 1);
+    if (constant_cache_limit > 0) {
+        cache_store(cp, value, bits);
+    }
+    result = qmappr(value, epsilon, rnd);
+    qfree(value);
+    return result;
+}
+
+/* versions of libcalc functions which use the cache where possible */
+
+NUMBER *
+qpi_cached(NUMBER * epsilon)
+{
+    if (qisneg(epsilon) || qiszero(epsilon)) {
+        /* let libcalc raise the error */
+        return qpi(epsilon);
+    }
+    /* qpi() always rounds to nearest */
+    return constant_value(CONSTANT_PI, epsilon, 24L);
+}
+
+NUMBER *
+qexp_cached(NUMBER * q, NUMBER * epsilon)
+{
+    if (qisone(q) && !qisneg(epsilon) && !qiszero(epsilon)) {
+        return constant_value(CONSTANT_E, epsilon, conf->appr);
+    }
+    return qexp(q, epsilon);
+}
+
+NUMBER *
+qln_cached(NUMBER * q, NUMBER * epsilon)
+{
+    if (qisint(q) && zistiny(q->num) && !qisneg(q) && !qisneg(epsilon)
+        && !qiszero(epsilon)) {
+        if (q->num.v[0] == 2) {
+            return constant_value(CONSTANT_LN2, epsilon, conf->appr);
+        }
+        if (q->num.v[0] == 10) {
+            return constant_value(CONSTANT_LN10, epsilon, conf->appr);
+        }
+    }
+    return qln(q, epsilon);
+}
+
+/* Returns statistics about the constant cache
+ *
+ * The result is a hash containing a hash for each cached constant (pi, e,
+ * ln2 and ln10) with the number of bits of the cached value, its size in
+ * bytes, and the number of requests which used (hits) or replaced (misses)
+ * the cached value.  It also includes the total size of the cache and the
+ * limit set by Calc.config(:constant_cache).
+ *
+ * @return [Hash]
+ * @example
+ *  Calc.pi("1e-100")
+ *  Calc.constant_cache_stats[:pi][:bits] #=> 365
+ */
+VALUE
+calc_constant_cache_stats(VALUE klass)
+{
+    CONSTANT *cp;
+    VALUE result, stats;
+
+    result = rb_hash_new();
+    for (cp = constants; cp->name; cp++) {
+        stats = rb_hash_new();
+        rb_hash_aset(stats, ID2SYM(rb_intern("bits")), LONG2NUM(cp->value ? cp->bits : 0));
+        rb_hash_aset(stats, ID2SYM(rb_intern("bytes")), LONG2NUM(number_bytes(cp->value)));
+        rb_hash_aset(stats, ID2SYM(rb_intern("hits")), LONG2NUM(cp->hits));
+        rb_hash_aset(stats, ID2SYM(rb_intern("misses")), LONG2NUM(cp->misses));
+        rb_hash_aset(result, ID2SYM(rb_intern(cp->name)), stats);
+    }
+    rb_hash_aset(result, ID2SYM(rb_intern("bytes")), LONG2NUM(cache_bytes()));
+    rb_hash_aset(result, ID2SYM(rb_intern("limit")), LONG2NUM(constant_cache_limit));
+    return result;
+}
+
+/* sets the cache limit, evicting everything if it has been exceeded */
+void
+constant_cache_set_limit(long limit)
+{
+    CONSTANT *cp;
+
+    constant_cache_limit = limit;
+    if (cache_bytes() > limit) {
+        for (cp = constants; cp->name; cp++) {
+            if (cp->value) {
+                qfree(cp->value);
+                cp->value = NULL;
+                cp->bits = 0;
+            }
+        }
+    }
+}
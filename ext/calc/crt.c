@@ -0,0 +1,537 @@
+#include "calc.h"
+
+/* Calc.crt and Calc.rational_reconstruct.
+ *
+ * crt combines residues modulo pairwise coprime m_1 .. m_n in a product tree
+ * (with products of the moduli at each node).  M / m_i mod m_i comes from a
+ * remainder tree, as in batchgcd.c, and is inverted to give c_i.  Then the
+ * terms r_i c_i M / m_i are summed back up the tree, each node being
+ * left * (product under right) + right * (product under left), and the sum
+ * is reduced modulo M.
+ *
+ * rational_reconstruct needs the first remainder below sqrt(m / 2) in the
+ * euclidean algorithm for m and a, with its cofactor.  Large numbers are
+ * reduced by running the algorithm on their leading bits only, recursively
+ * (the half-gcd method), then applying the matrix of quotients found to the
+ * whole numbers.  The last few quotients from the leading bits may be wrong;
+ * they are undone until the numbers are a valid pair of remainders again.
+ */
+
+/* products of the moduli, level 0 being the moduli themselves */
+typedef struct {
+    ZVALUE **z;
+    long *count;
+    long nlevels;
+} PTREE;
+
+static void
+ptree_build(PTREE * t, ZVALUE * leaves, long n)
+{
+    long i, j, count;
+
+    for (t->nlevels = 1, count = n; count > 1; count = (count + 1) / 2) {
+        t->nlevels++;
+    }
+    t->z = ALLOC_N(ZVALUE *, t->nlevels);
+    t->count = ALLOC_N(long, t->nlevels);
+    t->z[0] = leaves;
+    t->count[0] = n;
+    for (i = 1; i < t->nlevels; i++) {
+        t->count[i] = (t->count[i - 1] + 1) / 2;
+        t->z[i] = ALLOC_N(ZVALUE, t->count[i]);
+        for (j = 0; j < t->count[i]; j++) {
+            if (2 * j + 1 < t->count[i - 1]) {
+                zmul_fast(t->z[i - 1][2 * j], t->z[i - 1][2 * j + 1], &t->z[i][j]);
+            }
+            else {
+                zcopy(t->z[i - 1][2 * j], &t->z[i][j]);
+            }
+        }
+    }
+}
+
+static void
+ptree_free(PTREE * t)
+{
+    long i, j;
+
+    for (i = 0; i < t->nlevels; i++) {
+        for (j = 0; j < t->count[i]; j++) {
+            zfree(t->z[i][j]);
+        }
+        xfree(t->z[i]);
+    }
+    xfree(t->z);
+    xfree(t->count);
+}
+
+/* res[i] = (M / m_i) mod m_i, where M is the root of the tree */
+static void
+ptree_cofactors(PTREE * t, ZVALUE * res)
+{
+    ZVALUE *rem, *next, sq, r;
+    long i, j;
+
+    rem = ALLOC_N(ZVALUE, 1);
+    zcopy(t->z[t->nlevels - 1][0], &rem[0]);
+    for (i = t->nlevels - 2; i >= 0; i--) {
+        next = ALLOC_N(ZVALUE, t->count[i]);
+        for (j = 0; j < t->count[i]; j++) {
+            zsquare_fast(t->z[i][j], &sq);
+            zmod_fast(rem[j / 2], sq, &next[j]);
+            zfree(sq);
+        }
+        for (j = 0; j < t->count[i + 1]; j++) {
+            zfree(rem[j]);
+        }
+        xfree(rem);
+        rem = next;
+    }
+    for (j = 0; j < t->count[0]; j++) {
+        zequo(rem[j], t->z[0][j], &r);
+        zmod(r, t->z[0][j], &res[j], 0);
+        zfree(r);
+        zfree(rem[j]);
+    }
+    xfree(rem);
+}
+
+/* raises an error if any of the values in ary aren't integers, or if zero_ok
+ * is FALSE and any are zero */
+static void
+check_integers(VALUE ary, long n, BOOL zero_ok, const char *what)
+{
+    NUMBER *q;
+    BOOL frac, zero;
+    long i;
+
+    for (i = 0; i < n; i++) {
+        q = value_to_number(rb_ary_entry(ary, i), 0);
+        frac = qisfrac(q);
+        zero = qiszero(q);
+        qfree(q);
+        if (frac || (!zero_ok && zero)) {
+            rb_raise(e_MathError, "%s %s for crt", frac ? "non-integer" : "zero", what);
+        }
+    }
+}
+
+/* returns a new array of copies of the integers in ary, which check_integers
+ * has already accepted */
+static ZVALUE *
+integer_array(VALUE ary, long n)
+{
+    ZVALUE *z;
+    NUMBER *q;
+    long i;
+
+    z = ALLOC_N(ZVALUE, n);
+    for (i = 0; i < n; i++) {
+        q = value_to_number(rb_ary_entry(ary, i), 0);
+        zcopy(q->num, &z[i]);
+        qfree(q);
+    }
+    return z;
+}
+
+/* Chinese remainder theorem
+ *
+ * Returns the x with 0 <= x < moduli.inject(:*).abs and x % moduli[i] ==
+ * residues[i] % moduli[i] for every i.  Moduli must be pairwise coprime.
+ *
+ * Unlike combining one residue at a time with minv, this uses a product tree
+ * (and fast multiplication), so it takes quasi-linear time in the total size
+ * of the moduli.
+ *
+ * @param residues [Array<Integer,Calc::Q>]
+ * @param moduli [Array<Integer,Calc::Q>] the same number of non-zero moduli
+ * @return [Calc::Q]
+ * @raise [ArgumentError] if the arrays are different lengths
+ * @raise [Calc::MathError] if any values aren't integers, a modulus is zero,
+ *  or the moduli aren't coprime
+ * @example
+ *  Calc.crt([2, 3, 2], [3, 5, 7]) #=> Calc::Q(23)
+ */
+VALUE
+calc_crt(VALUE klass, VALUE residues, VALUE moduli)
+{
+    PTREE t;
+    NUMBER *qa, *qm, *qinv, *result;
+    ZVALUE *m, *r, *v, *next, t1, t2;
+    long i, j, n;
+    setup_math_error();
+
+    residues = rb_Array(residues);
+    moduli = rb_Array(moduli);
+    n = RARRAY_LEN(moduli);
+    if (RARRAY_LEN(residues) != n) {
+        rb_raise(rb_eArgError, "crt needs one residue for each modulus (%ld for %ld)",
+                 RARRAY_LEN(residues), n);
+    }
+    if (n == 0) {
+        return wrap_number(qalloc());
+    }
+    /* check everything first so nothing is leaked by a bad argument */
+    check_integers(moduli, n, FALSE, "modulus");
+    check_integers(residues, n, TRUE, "residue");
+    m = integer_array(moduli, n);
+    for (i = 0; i < n; i++) {
+        m[i].sign = 0;
+    }
+    r = integer_array(residues, n);
+    ptree_build(&t, m, n);
+
+    /* v[i] = r_i / (M / m_i) mod m_i */
+    v = ALLOC_N(ZVALUE, n);
+    ptree_cofactors(&t, v);
+    for (i = 0; i < n; i++) {
+        if (!zrelprime(v[i], m[i])) {
+            for (j = 0; j < n; j++) {
+                zfree(v[j]);
+                zfree(r[j]);
+            }
+            xfree(v);
+            xfree(r);
+            ptree_free(&t);
+            rb_raise(e_MathError, "moduli for crt aren't coprime");
+        }
+    }
+    for (i = 0; i < n; i++) {
+        qa = qalloc();
+        qa->num = v[i];
+        qm = qalloc();
+        zcopy(m[i], &qm->num);
+        qinv = qminv(qa, qm);
+        zmod(r[i], m[i], &t1, 0);
+        zmul(t1, qinv->num, &t2);
+        zfree(t1);
+        zmod(t2, m[i], &v[i], 0);
+        zfree(t2);
+        zfree(r[i]);
+        qfree(qinv);
+        qfree(qm);
+        qfree(qa);
+    }
+    xfree(r);
+
+    /* sum the terms back up the tree */
+    for (i = 0; i + 1 < t.nlevels; i++) {
+        next = ALLOC_N(ZVALUE, t.count[i + 1]);
+        for (j = 0; j < t.count[i + 1]; j++) {
+            if (2 * j + 1 < t.count[i]) {
+                zmul_fast(v[2 * j], t.z[i][2 * j + 1], &t1);
+                zmul_fast(v[2 * j + 1], t.z[i][2 * j], &t2);
+                zadd(t1, t2, &next[j]);
+                zfree(t1);
+                zfree(t2);
+                zfree(v[2 * j]);
+                zfree(v[2 * j + 1]);
+            }
+            else {
+                next[j] = v[2 * j];
+            }
+        }
+        xfree(v);
+        v = next;
+    }
+    result = qalloc();
+    zmod_fast(v[0], t.z[t.nlevels - 1][0], &result->num);
+    zfree(v[0]);
+    xfree(v);
+    ptree_free(&t);
+    return wrap_number(result);
+}
+
+/*** rational reconstruction ***/
+
+#define HGCD_DIRECT_BITS 2048   /* numbers below this size get plain euclidean steps */
+#define HGCD_GUARD 64           /* extra leading bits used in the recursive step */
+
+/* a list of quotients from the euclidean algorithm */
+typedef struct {
+    ZVALUE *q;
+    long count;
+    long size;
+} QLIST;
+
+static void
+qlist_push(QLIST * l, ZVALUE q)
+{
+    if (l->count == l->size) {
+        l->size = l->size ? 2 * l->size : 16;
+        REALLOC_N(l->q, ZVALUE, l->size);
+    }
+    l->q[l->count++] = q;
+}
+
+static void
+qlist_free(QLIST * l)
+{
+    long i;
+
+    for (i = 0; i < l->count; i++) {
+        zfree(l->q[i]);
+    }
+    if (l->q) {
+        xfree(l->q);
+    }
+}
+
+/* r = a * b for 2x2 matrices stored by rows */
+static void
+matrix_mul(const ZVALUE * a, const ZVALUE * b, ZVALUE * r)
+{
+    ZVALUE t1, t2;
+    int i, j;
+
+    for (i = 0; i < 2; i++) {
+        for (j = 0; j < 2; j++) {
+            zmul_fast(a[2 * i], b[j], &t1);
+            zmul_fast(a[2 * i + 1], b[2 + j], &t2);
+            zadd(t1, t2, &r[2 * i + j]);
+            zfree(t1);
+            zfree(t2);
+        }
+    }
+}
+
+/* m = the product of [q 1; 1 0] for the quotients first .. last - 1, so
+ * that (a, b) = m (a', b') if a', b' are the remainders after those steps */
+static void
+qlist_matrix(const QLIST * l, long first, long last, ZVALUE * m)
+{
+    ZVALUE left[4], right[4];
+    long mid;
+    int i;
+
+    if (last - first <= 1) {
+        if (last == first) {
+            itoz(1, &m[0]);
+        }
+        else {
+            zcopy(l->q[first], &m[0]);
+        }
+        itoz(last - first, &m[1]);
+        itoz(last - first, &m[2]);
+        itoz(1 - (last - first), &m[3]);
+        return;
+    }
+    mid = (first + last) / 2;
+    qlist_matrix(l, first, mid, left);
+    qlist_matrix(l, mid, last, right);
+    matrix_mul(left, right, m);
+    for (i = 0; i < 4; i++) {
+        zfree(left[i]);
+        zfree(right[i]);
+    }
+}
+
+/* (a, b) = (b, a mod b), pushing the quotient */
+static void
+euclid_step(ZVALUE * a, ZVALUE * b, QLIST * ql)
+{
+    ZVALUE q, r;
+
+    zdiv(*a, *b, &q, &r, 0);
+    zfree(*a);
+    *a = *b;
+    *b = r;
+    qlist_push(ql, q);
+}
+
+/* applies euclidean steps to a > b >= 0 while b >= 2^target, pushing the
+ * quotients onto ql */
+static void
+hgcd_reduce(ZVALUE * a, ZVALUE * b, long target, QLIST * ql)
+{
+    QLIST sub;
+    ZVALUE a1, b1, m[4], x, y, t1, t2;
+    long n, d, k, i;
+
+    while (!ziszero(*b) && zhighbit(*b) >= target) {
+        n = zhighbit(*a) + 1;
+        d = n - target <= HGCD_DIRECT_BITS ? n - target : (n - target) / 2;
+        if (2 * d + HGCD_GUARD > n / 2) {
+            d = (n / 2 - HGCD_GUARD) / 2;
+        }
+        if (n <= HGCD_DIRECT_BITS || d < HGCD_GUARD) {
+            euclid_step(a, b, ql);
+            continue;
+        }
+
+        /* reduce the leading 2d + guard bits by d bits */
+        k = n - 2 * d - HGCD_GUARD;
+        zshift(*a, -k, &a1);
+        zshift(*b, -k, &b1);
+        sub.q = NULL;
+        sub.count = sub.size = 0;
+        if (zrel(a1, b1) > 0) {
+            hgcd_reduce(&a1, &b1, d + HGCD_GUARD, &sub);
+        }
+        zfree(a1);
+        zfree(b1);
+        if (sub.count == 0) {
+            qlist_free(&sub);
+            euclid_step(a, b, ql);
+            continue;
+        }
+
+        /* (x, y) = m^-1 (a, b); det m = (-1)^count */
+        qlist_matrix(&sub, 0, sub.count, m);
+        zmul_fast(m[3], *a, &t1);
+        zmul_fast(m[1], *b, &t2);
+        zsub(t1, t2, &x);
+        zfree(t1);
+        zfree(t2);
+        zmul_fast(m[0], *b, &t1);
+        zmul_fast(m[2], *a, &t2);
+        zsub(t1, t2, &y);
+        zfree(t1);
+        zfree(t2);
+        for (i = 0; i < 4; i++) {
+            zfree(m[i]);
+        }
+        if (sub.count % 2) {
+            x.sign = !x.sign && !ziszero(x);
+            y.sign = !y.sign && !ziszero(y);
+        }
+
+        /* undo quotients until x > y >= 0 (then every quotient was right) and
+         * x hasn't gone below the target */
+        while (sub.count > 0 && (zisneg(y) || zrel(x, y) <= 0 || zhighbit(x) < target)) {
+            sub.count--;
+            zmul(sub.q[sub.count], x, &t1);
+            zadd(t1, y, &t2);
+            zfree(t1);
+            zfree(y);
+            zfree(sub.q[sub.count]);
+            y = x;
+            x = t2;
+        }
+        zfree(*a);
+        zfree(*b);
+        *a = x;
+        *b = y;
+        for (i = 0; i < sub.count; i++) {
+            qlist_push(ql, sub.q[i]);
+        }
+        if (sub.count == 0) {
+            /* the leading bits were misleading from the start */
+            euclid_step(a, b, ql);
+        }
+        sub.count = 0;
+        qlist_free(&sub);
+    }
+}
+
+/* the rational reconstruction of a mod m, or NULL if there isn't one */
+static NUMBER *
+qratrecon(NUMBER * qa, ZVALUE m)
+{
+    QLIST ql;
+    ZVALUE a, b, bound, half, mat[4], g;
+    NUMBER *r;
+    BOOL odd;
+
+    zshift(m, -1, &half);
+    zsqrt(half, &bound, 0);
+    zfree(half);
+    zcopy(m, &a);
+    zmod(qa->num, m, &b, 0);
+    ql.q = NULL;
+    ql.count = ql.size = 0;
+    hgcd_reduce(&a, &b, zhighbit(bound) + 1, &ql);
+    while (zrel(b, bound) > 0) {
+        euclid_step(&a, &b, &ql);
+    }
+    zfree(a);
+
+    /* b = det * (mat[0] * a - mat[2] * m), so the denominator is +-mat[0] */
+    qlist_matrix(&ql, 0, ql.count, mat);
+    odd = ql.count % 2;
+    qlist_free(&ql);
+    zfree(mat[1]);
+    zfree(mat[2]);
+    zfree(mat[3]);
+    r = NULL;
+    zgcd(b, mat[0], &g);
+    if (zrel(mat[0], bound) <= 0 && zisone(g)) {
+        r = qalloc();
+        r->num = b;
+        r->den = mat[0];
+        if (odd && !ziszero(b)) {
+            r->num.sign = 1;
+        }
+    }
+    else {
+        zfree(b);
+        zfree(mat[0]);
+    }
+    zfree(g);
+    zfree(bound);
+    return r;
+}
+
+/* Rational reconstruction
+ *
+ * Returns the fraction n/d with n/d == a mod m (ie n == a * d mod m) and
+ * |n| and d both at most sqrt(m/2), which is unique if it exists.  This
+ * recovers a rational result from a calculation done modulo m, eg a large
+ * prime or the product of several primes combined with Calc.crt.
+ *
+ * The euclidean algorithm needed is done by the half-gcd method, which is
+ * much faster than the usual one for large m.
+ *
+ * a may be an array, in which case each element is reconstructed with the
+ * same modulus and an array is returned.
+ *
+ * @param a [Integer,Calc::Q,Array<Integer,Calc::Q>]
+ * @param m [Integer,Calc::Q] modulus, at least 2
+ * @return [Calc::Q,Array<Calc::Q>]
+ * @raise [Calc::MathError] if a or m isn't an integer, m is less than 2, or
+ *  there is no such fraction
+ * @example
+ *  Calc.rational_reconstruct(333335, 1000003) #=> Calc::Q(2/3)
+ *  Calc.rational_reconstruct([333335, 500002], 1000003) #=> [Calc::Q(2/3), Calc::Q(1/2)]
+ */
+VALUE
+calc_rational_reconstruct(VALUE klass, VALUE a, VALUE m)
+{
+    NUMBER *qa, *qm, *r;
+    VALUE result;
+    BOOL frac;
+    long i;
+    setup_math_error();
+
+    result = RB_TYPE_P(a, T_ARRAY) ? rb_ary_new2(RARRAY_LEN(a)) : Qnil;
+    /* check everything first so nothing is leaked by a bad argument */
+    for (i = 0; i < (NIL_P(result) ? 1 : RARRAY_LEN(a)); i++) {
+        qa = value_to_number(NIL_P(result) ? a : rb_ary_entry(a, i), 0);
+        frac = qisfrac(qa);
+        qfree(qa);
+        if (frac) {
+            rb_raise(e_MathError, "non-integer for rational_reconstruct");
+        }
+    }
+    qm = value_to_number(m, 0);
+    if (qisfrac(qm) || zrel(qm->num, _one_) <= 0) {
+        qfree(qm);
+        rb_raise(e_MathError, "modulus for rational_reconstruct must be an integer > 1");
+    }
+    for (i = 0; i < (NIL_P(result) ? 1 : RARRAY_LEN(a)); i++) {
+        qa = value_to_number(NIL_P(result) ? a : rb_ary_entry(a, i), 0);
+        r = qratrecon(qa, qm->num);
+        qfree(qa);
+        if (!r) {
+            qfree(qm);
+            rb_raise(e_MathError, "no rational reconstruction");
+        }
+        if (NIL_P(result)) {
+            qfree(qm);
+            return wrap_number(r);
+        }
+        rb_ary_push(result, wrap_number(r));
+    }
+    qfree(qm);
+    return result;
+}
@@ -0,0 +1,619 @@
+#include <math.h>
+#include "calc.h"
+
+/* Document-class: Calc::DigitStream
+ *
+ * Streams the digits of pi, e or a square root in chunks.
+ *
+ * Asking Calc.pi for more digits starts again from nothing, and the result
+ * still has to be converted to a string.  A DigitStream keeps the state of
+ * the calculation between chunks, so each call to #next only does the work
+ * for the new digits.  The state grows with the number of digits produced.
+ *
+ * pi and e are the sums of hypergeometric series (Gosper's series for pi,
+ * whose term ratio tends to 4/27, about 0.83 decimal digits per term).  New
+ * terms are summed by binary splitting and folded into the running
+ * remainder, and a digit is only produced once the bound on the rest of the
+ * series shows it can't change.
+ * Square roots use the long hand method, a chunk of digits at a time.
+ *
+ * The first chunk is the integer part; after that every chunk is the next
+ * `chunk` digits after the point.  A stream can be copied with #dup to
+ * checkpoint it: the copy continues from the same position independently.
+ *
+ * @example
+ *  s = Calc.digits_of(:pi, chunk: 10)
+ *  s.next #=> "3"
+ *  s.next #=> "1415926535"
+ *  s.next #=> "8979323846"
+ */
+VALUE cDigitStream;
+
+/* extra bits of the series to sum before trying for a chunk of digits */
+#define DIGITS_GUARD_BITS 40
+
+/* term n of a series is a(n) * p(1)...p(n) / (q(1)...q(n)) */
+typedef void (*SERIES_TERM) (long n, long *p, long *q, long *a);
+
+typedef struct {
+    long base;
+    long chunk;                 /* digits in each chunk after the first */
+    long pos;                   /* digits produced after the point */
+    BOOL started;               /* integer part has been produced */
+    ZVALUE bm;                  /* base^chunk */
+    SERIES_TERM term;           /* NULL for square roots */
+    /* series: the terms so far sum to t / q.  with D the digits produced
+     * as an integer, t * base^pos = D * q + r and u = p * base^pos. */
+    long n;                     /* number of terms summed */
+    ZVALUE q;
+    ZVALUE u;
+    /* square roots of x: s is the digits produced as an integer, so
+     * s = isqrt(floor(x * base^(2 * pos))).  c / den is the part of x *
+     * base^(2 * pos) not included in s^2 + r. */
+    ZVALUE s;
+    ZVALUE c;
+    ZVALUE den;
+    ZVALUE r;                   /* remainder, for both */
+} DIGITS;
+
+/* Gosper: pi = sum(n>=0) (50n - 6) / (2^n * comb(3n, n)) */
+static void
+pi_term(long n, long *p, long *q, long *a)
+{
+    *p = (n == 0) ? 1 : n * (2 * n - 1);
+    *q = (n == 0) ? 1 : 3 * (3 * n - 1) * (3 * n - 2);
+    *a = 50 * n - 6;
+}
+
+/* e = sum(n>=0) 1 / n! */
+static void
+e_term(long n, long *p, long *q, long *a)
+{
+    *p = 1;
+    *q = (n == 0) ? 1 : n;
+    *a = 1;
+}
+
+typedef struct {
+    ZVALUE p;
+    ZVALUE q;
+    ZVALUE t;
+} SPLIT;
+
+/* for terms [a, b), p and q are the products of p(n) and q(n), and t / q is
+ * the sum of the terms relative to term a - 1 */
+static void
+series_split(SERIES_TERM term, long a, long b, SPLIT * s)
+{
+    SPLIT l, r;
+    ZVALUE tmp, tmp2;
+    long m, tp, tq, ta;
+
+    if (b - a == 1) {
+        term(a, &tp, &tq, &ta);
+        itoz(tp, &s->p);
+        itoz(tq, &s->q);
+        zmuli(s->p, ta, &s->t);
+        return;
+    }
+    m = a + (b - a) / 2;
+    series_split(term, a, m, &l);
+    series_split(term, m, b, &r);
+    zmul_fast(l.p, r.p, &s->p);
+    zmul_fast(l.q, r.q, &s->q);
+    zmul_fast(l.t, r.q, &tmp);
+    zmul_fast(l.p, r.t, &tmp2);
+    zadd(tmp, tmp2, &s->t);
+    zfree(tmp);
+    zfree(tmp2);
+    zfree(l.p);
+    zfree(l.q);
+    zfree(l.t);
+    zfree(r.p);
+    zfree(r.q);
+    zfree(r.t);
+}
+
+/* sums more terms, until the next one is about 2^-bits of the last */
+static void
+series_extend(DIGITS * d, long bits)
+{
+    SPLIT s;
+    ZVALUE tmp, tmp2;
+    double per_term;
+    long count, tp, tq, ta;
+
+    /* terms get smaller faster as n increases, so the ratio of the next
+     * term gives an upper bound on the number needed */
+    d->term(d->n, &tp, &tq, &ta);
+    per_term = log((double) tq / tp) / log(2.0);
+    count = (long) (bits / (per_term < 1.0 ? 1.0 : per_term)) + 1;
+    series_split(d->term, d->n, d->n + count, &s);
+    zmul_fast(d->r, s.q, &tmp);
+    zmul_fast(d->u, s.t, &tmp2);
+    zfree(d->r);
+    zadd(tmp, tmp2, &d->r);
+    zfree(tmp);
+    zfree(tmp2);
+    zmul_fast(d->q, s.q, &tmp);
+    zfree(d->q);
+    d->q = tmp;
+    zmul_fast(d->u, s.p, &tmp);
+    zfree(d->u);
+    d->u = tmp;
+    zfree(s.p);
+    zfree(s.q);
+    zfree(s.t);
+    d->n += count;
+}
+
+/* the next m digits of a series as an integer */
+static void
+series_next(DIGITS * d, long m, ZVALUE bm, ZVALUE * res)
+{
+    ZVALUE y, digits, rem, lhs, rhs, tmp;
+    long want, gap, tp, tq, ta;
+    BOOL ok;
+
+    want = (long) (m * log((double) d->base) / log(2.0)) + DIGITS_GUARD_BITS;
+    for (;;) {
+        gap = zhighbit(d->q) - zhighbit(d->u);
+        if (gap < want) {
+            series_extend(d, want - gap);
+            rb_thread_check_ints();
+            continue;
+        }
+        zmul(d->r, bm, &y);
+        zdiv(y, d->q, &digits, &rem, 0);
+        zfree(y);
+
+        /* the terms from n on are positive with ratio at most 1/2, so they
+         * add less than twice term n.  the digits are right if that can't
+         * carry into them: rem + 2 * term(n) * q * base^(pos+m) < q. */
+        d->term(d->n, &tp, &tq, &ta);
+        zsub(d->q, rem, &tmp);
+        zmuli(tmp, tq, &lhs);
+        zfree(tmp);
+        zmul(d->u, bm, &tmp);
+        zmuli(tmp, 2 * ta, &rhs);
+        zfree(tmp);
+        zmuli(rhs, tp, &tmp);
+        zfree(rhs);
+        ok = (zrel(lhs, tmp) > 0);
+        zfree(lhs);
+        zfree(tmp);
+        if (ok) {
+            break;
+        }
+        zfree(digits);
+        zfree(rem);
+        want += DIGITS_GUARD_BITS;
+    }
+    zfree(d->r);
+    d->r = rem;
+    zmul(d->u, bm, &tmp);
+    zfree(d->u);
+    d->u = tmp;
+    *res = digits;
+}
+
+/* the next m digits of a square root as an integer */
+static void
+sqrt_next(DIGITS * d, ZVALUE bm, ZVALUE * res)
+{
+    ZVALUE b2m, t, f, rr, sb, n, root, tmp, tmp2;
+
+    /* bring in the next 2m digits of x */
+    zsquare(bm, &b2m);
+    zmul(d->c, b2m, &t);
+    zfree(d->c);
+    zdiv(t, d->den, &f, &d->c, 0);
+    zfree(t);
+    zmul(d->r, b2m, &t);
+    zfree(b2m);
+    zadd(t, f, &rr);
+    zfree(t);
+    zfree(f);
+
+    /* find the largest digits with (s * bm + digits)^2 <= s^2 * bm^2 + rr */
+    zmul(d->s, bm, &sb);
+    if (zrel(d->s, bm) < 0) {
+        /* few digits so far: the estimate below could be far out */
+        zsquare(sb, &t);
+        zadd(t, rr, &n);
+        zfree(t);
+        zsqrt(n, &root, 0);
+        zsub(root, sb, res);
+        zsquare(root, &t);
+        zfree(d->r);
+        zsub(n, t, &d->r);
+        zfree(t);
+        zfree(n);
+    }
+    else {
+        /* rr / (2 * s * bm) is at most one too big */
+        zshift(sb, 1, &t);
+        zquo(rr, t, res, 0);
+        for (;;) {
+            zmul(t, *res, &tmp);
+            zsquare(*res, &tmp2);
+            zadd(tmp, tmp2, &n);
+            zfree(tmp);
+            zfree(tmp2);
+            if (zrel(n, rr) <= 0) {
+                break;
+            }
+            zfree(n);
+            itoz(1L, &tmp);
+            zsub(*res, tmp, &tmp2);
+            zfree(tmp);
+            zfree(*res);
+            *res = tmp2;
+        }
+        zfree(t);
+        zfree(d->r);
+        zsub(rr, n, &d->r);
+        zfree(n);
+        zadd(sb, *res, &root);
+    }
+    zfree(rr);
+    zfree(sb);
+    zfree(d->s);
+    d->s = root;
+}
+
+/* z in the stream's base, padded with zeros to width digits.  frees z. */
+static VALUE
+digits_to_str(ZVALUE z, long base, long width)
+{
+    static const char chars[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+    VALUE result;
+    ZVALUE tmp;
+    char *buf;
+    long len, pos, i, w, bw, rem;
+
+    /* w digits at a time, with base^w fitting in a long */
+    for (w = 1, bw = base; bw <= 0x7fffffffL / base; w++) {
+        bw *= base;
+    }
+    len = width;
+    if (len == 0) {
+        len = (long) ((zhighbit(z) + 1) / (log((double) base) / log(2.0))) + w + 1;
+    }
+    result = rb_str_buf_new(len);
+    buf = RSTRING_PTR(result);
+    pos = len;
+    while (pos > 0 && (width > 0 || !ziszero(z) || pos == len)) {
+        rem = zdivi(z, bw, &tmp);
+        zfree(z);
+        z = tmp;
+        for (i = 0; i < w && pos > 0; i++) {
+            buf[--pos] = chars[rem % base];
+            rem /= base;
+        }
+    }
+    zfree(z);
+    /* drop leading zeros of the integer part */
+    if (width == 0) {
+        while (pos < len - 1 && buf[pos] == '0') {
+            pos++;
+        }
+    }
+    memmove(buf, buf + pos, len - pos);
+    rb_str_set_len(result, len - pos);
+    return result;
+}
+
+static void
+cdigits_free(void *p)
+{
+    DIGITS *d = (DIGITS *) p;
+
+    if (d) {
+        zfree(d->bm);
+        zfree(d->q);
+        zfree(d->u);
+        zfree(d->s);
+        zfree(d->c);
+        zfree(d->den);
+        zfree(d->r);
+        xfree(d);
+    }
+}
+
+const rb_data_type_t calc_digitstream_type = {
+    "Calc::DigitStream",
+    {0, cdigits_free, 0},
+    0, 0
+#ifdef RUBY_TYPED_FREE_IMMEDIATELY
+        , RUBY_TYPED_FREE_IMMEDIATELY
+#endif
+};
+
+static VALUE
+cdigits_alloc(VALUE klass)
+{
+    return TypedData_Wrap_Struct(klass, &calc_digitstream_type, 0);
+}
+
+static DIGITS *
+get_digits(VALUE self)
+{
+    DIGITS *d = rb_check_typeddata(self, &calc_digitstream_type);
+
+    if (!d) {
+        rb_raise(rb_eArgError, "uninitialized Calc::DigitStream");
+    }
+    return d;
+}
+
+/* Creates a stream of digits
+ *
+ * Calc.digits_of is the same as Calc::DigitStream.new.
+ *
+ * @param source [Symbol] :pi, :e or :sqrt
+ * @param x [Numeric,String] for :sqrt, the non-negative number to take the
+ *  square root of
+ * @param base [Integer] base of the digits, 2 to 36 (default 10)
+ * @param chunk [Integer] number of digits in each chunk after the integer
+ *  part (default 100)
+ * @raise [ArgumentError] for an unknown source, base or chunk size
+ * @raise [Calc::MathError] if x is negative
+ * @example
+ *  Calc::DigitStream.new(:e, chunk: 5).first(3) #=> ["2", "71828", "18284"]
+ *  Calc::DigitStream.new(:sqrt, 2, base: 2, chunk: 8).first(2) #=> ["1", "01101010"]
+ */
+static VALUE
+cdigits_initialize(int argc, VALUE * argv, VALUE self)
+{
+    static ID keywords[2];
+    VALUE source, x, opts, values[2];
+    DIGITS *d;
+    NUMBER *q = NULL;
+    SERIES_TERM term = NULL;
+    ZVALUE tmp, tmp2, ip;
+    long base, chunk, tp, tq, ta;
+    setup_math_error();
+
+    rb_scan_args(argc, argv, "11:", &source, &x, &opts);
+    if (!keywords[0]) {
+        keywords[0] = rb_intern("base");
+        keywords[1] = rb_intern("chunk");
+    }
+    values[0] = values[1] = Qundef;
+    if (!NIL_P(opts)) {
+        rb_get_kwargs(opts, keywords, 0, 2, values);
+    }
+    base = (values[0] == Qundef) ? 10 : value_to_long(values[0]);
+    chunk = (values[1] == Qundef) ? 100 : value_to_long(values[1]);
+    if (base < 2 || base > 36) {
+        rb_raise(rb_eArgError, "base for Calc::DigitStream must be 2 to 36");
+    }
+    if (chunk < 1) {
+        rb_raise(rb_eArgError, "chunk for Calc::DigitStream must be positive");
+    }
+    if (source == ID2SYM(rb_intern("pi"))) {
+        term = pi_term;
+    }
+    else if (source == ID2SYM(rb_intern("e"))) {
+        term = e_term;
+    }
+    else if (source != ID2SYM(rb_intern("sqrt"))) {
+        rb_raise(rb_eArgError, "unknown source for Calc::DigitStream (expected :pi, :e or :sqrt)");
+    }
+    if (term && !NIL_P(x)) {
+        rb_raise(rb_eArgError, "only :sqrt takes a number");
+    }
+    if (!term) {
+        if (NIL_P(x)) {
+            rb_raise(rb_eArgError, "missing number for :sqrt");
+        }
+        q = value_to_number(x, 1);
+        if (qisneg(q)) {
+            qfree(q);
+            rb_raise(e_MathError, "square root of negative number for Calc::DigitStream");
+        }
+    }
+
+    if (DATA_PTR(self)) {
+        cdigits_free(DATA_PTR(self));
+        DATA_PTR(self) = 0;
+    }
+    d = ALLOC(DIGITS);
+    d->base = base;
+    d->chunk = chunk;
+    d->pos = 0;
+    d->started = FALSE;
+    itoz(base, &tmp);
+    itoz(chunk, &tmp2);
+    zpowi(tmp, tmp2, &d->bm);
+    zfree(tmp);
+    zfree(tmp2);
+    d->term = term;
+    if (term) {
+        /* the first term.  r is t until the integer part is produced. */
+        term(0, &tp, &tq, &ta);
+        d->n = 1;
+        itoz(tq, &d->q);
+        itoz(tp, &d->u);
+        itoz(ta * tp, &d->r);
+        itoz(0L, &d->s);
+        itoz(0L, &d->c);
+        itoz(0L, &d->den);
+    }
+    else {
+        d->n = 0;
+        itoz(0L, &d->q);
+        itoz(0L, &d->u);
+        zcopy(q->den, &d->den);
+        zdiv(q->num, q->den, &ip, &d->c, 0);
+        zsqrt(ip, &d->s, 0);
+        zsquare(d->s, &tmp);
+        zsub(ip, tmp, &d->r);
+        zfree(tmp);
+        zfree(ip);
+        qfree(q);
+    }
+    DATA_PTR(self) = d;
+    return self;
+}
+
+static VALUE
+cdigits_initialize_copy(VALUE obj, VALUE orig)
+{
+    DIGITS *d, *dorig;
+
+    if (obj == orig) {
+        return obj;
+    }
+    dorig = get_digits(orig);
+    if (DATA_PTR(obj)) {
+        cdigits_free(DATA_PTR(obj));
+        DATA_PTR(obj) = 0;
+    }
+    d = ALLOC(DIGITS);
+    *d = *dorig;
+    zcopy(dorig->bm, &d->bm);
+    zcopy(dorig->q, &d->q);
+    zcopy(dorig->u, &d->u);
+    zcopy(dorig->s, &d->s);
+    zcopy(dorig->c, &d->c);
+    zcopy(dorig->den, &d->den);
+    zcopy(dorig->r, &d->r);
+    DATA_PTR(obj) = d;
+    return obj;
+}
+
+/* Base of the digits
+ *
+ * @return [Integer]
+ */
+static VALUE
+cdigits_base(VALUE self)
+{
+    return LONG2NUM(get_digits(self)->base);
+}
+
+/* Number of digits in each chunk after the integer part
+ *
+ * @return [Integer]
+ */
+static VALUE
+cdigits_chunk(VALUE self)
+{
+    return LONG2NUM(get_digits(self)->chunk);
+}
+
+/* Returns the next chunk of digits
+ *
+ * The first call returns the integer part, and each call after that the
+ * next `chunk` digits after the point.  Digits above 9 are lower case
+ * letters, as in Integer#to_s.
+ *
+ * @return [String]
+ * @example
+ *  s = Calc.digits_of(:pi, chunk: 4)
+ *  s.next #=> "3"
+ *  s.next #=> "1415"
+ */
+static VALUE
+cdigits_next(VALUE self)
+{
+    DIGITS *d;
+    ZVALUE digits, one;
+    setup_math_error();
+
+    d = get_digits(self);
+    if (!d->started) {
+        if (d->term) {
+            itoz(1L, &one);
+            series_next(d, 0, one, &digits);
+            zfree(one);
+        }
+        else {
+            zcopy(d->s, &digits);
+        }
+        d->started = TRUE;
+        return digits_to_str(digits, d->base, 0);
+    }
+    if (d->term) {
+        series_next(d, d->chunk, d->bm, &digits);
+    }
+    else {
+        sqrt_next(d, d->bm, &digits);
+    }
+    d->pos += d->chunk;
+    return digits_to_str(digits, d->base, d->chunk);
+}
+
+/* Yields chunks of digits, starting from the current position
+ *
+ * The stream is endless, so use a method like Enumerable#first or break out
+ * of the block.  Chunks taken this way are used up just as with #next.
+ *
+ * @return [Enumerator] if no block is given
+ * @yield [String]
+ * @example
+ *  s = Calc.digits_of(:e, chunk: 5)
+ *  s.first(2) #=> ["2", "71828"]
+ *  s.first(2) #=> ["18284", "59045"]
+ */
+static VALUE
+cdigits_each(VALUE self)
+{
+    RETURN_ENUMERATOR(self, 0, 0);
+    for (;;) {
+        rb_yield(cdigits_next(self));
+    }
+    return self;
+}
+
+/* Number of digits produced after the point
+ *
+ * @return [Integer]
+ */
+static VALUE
+cdigits_position(VALUE self)
+{
+    return LONG2NUM(get_digits(self)->pos);
+}
+
+/* Stream of the digits of pi, e or a square root
+ *
+ * Returns a Calc::DigitStream, which produces the digits in chunks and keeps
+ * its state between them, so getting more digits doesn't repeat the work
+ * for the ones already produced.
+ *
+ * @param source [Symbol] :pi, :e or :sqrt
+ * @param x [Numeric,String] for :sqrt, the non-negative number to take the
+ *  square root of
+ * @param base [Integer] base of the digits, 2 to 36 (default 10)
+ * @param chunk [Integer] number of digits in each chunk after the integer
+ *  part (default 100)
+ * @return [Calc::DigitStream]
+ * @example
+ *  Calc.digits_of(:pi, chunk: 10).first(3) #=> ["3", "1415926535", "8979323846"]
+ *  Calc.digits_of(:sqrt, 2, base: 16, chunk: 8).first(2) #=> ["1", "6a09e667"]
+ */
+VALUE
+calc_digits_of(int argc, VALUE * argv, VALUE klass)
+{
+    VALUE obj = cdigits_alloc(cDigitStream);
+
+    return cdigits_initialize(argc, argv, obj);
+}
+
+void
+define_calc_digitstream(VALUE m)
+{
+    cDigitStream = rb_define_class_under(m, "DigitStream", rb_cObject);
+    rb_include_module(cDigitStream, rb_mEnumerable);
+    rb_define_alloc_func(cDigitStream, cdigits_alloc);
+    rb_define_method(cDigitStream, "initialize", cdigits_initialize, -1);
+    rb_define_method(cDigitStream, "initialize_copy", cdigits_initialize_copy, 1);
+    rb_define_method(cDigitStream, "base", cdigits_base, 0);
+    rb_define_method(cDigitStream, "chunk", cdigits_chunk, 0);
+    rb_define_method(cDigitStream, "each", cdigits_each, 0);
+    rb_define_method(cDigitStream, "next", cdigits_next, 0);
+    rb_define_method(cDigitStream, "position", cdigits_position, 0);
+}
@@ -0,0 +1,1160 @@
+#include <ctype.h>
+#include <string.h>
+#include <ruby/util.h>
+#include "calc.h"
+
+/* Document-class: Calc::Expression
+ *
+ * Arithmetic expression compiled for repeated evaluation.
+ *
+ * Evaluating a formula like `a*x^2 + b*sqrt(y) - c/x` with Calc::Q objects
+ * makes a ruby method call for every operation, each converting its
+ * argument and wrapping its result in a new object.  Calc.compile parses the
+ * expression once into a short list of instructions for a stack machine,
+ * which #call runs entirely in C.  Constants are converted when the
+ * expression is compiled (and operations on constants alone are done then),
+ * and the stack of intermediate values belongs to the expression, so is
+ * reused by every call.
+ *
+ * Expressions use calc's operators and precedence: + - * / ^ (or **), unary
+ * minus and parentheses, with numeric literals (optionally with an exponent,
+ * or an "i" suffix for imaginary numbers), the constant pi and the functions
+ * sqrt, exp, ln, log (base 10), sin, cos, tan, atan, sinh, cosh, tanh and
+ * abs.  Results are the same as from the same operations on Calc::Q and
+ * Calc::C: a real result is a Calc::Q, otherwise a Calc::C.
+ *
+ * @example
+ *  f = Calc.compile("a*x^2 + b*sqrt(y) - c/x", vars: %i[a b c x y])
+ *  f.call(a: 1, b: 2, c: 3, x: 4, y: 9)              #=> Calc::Q(21.25)
+ *  f.call_many([[1, 2, 3, 4, 9], [0, 0, 1, 1, -1]]) #=> [Calc::Q(21.25), Calc::Q(-1)]
+ */
+VALUE cExpression;
+
+/* parentheses, unary operators and chains of ^ deeper than this are refused
+ * rather than risking the C stack */
+#define EXPRESSION_MAX_NESTING 1000
+
+/* a value on the stack: real values are kept as a NUMBER so that real
+ * arithmetic doesn't go through libcalc's complex functions */
+typedef struct {
+    NUMBER *q;                  /* real value, or NULL */
+    COMPLEX *c;                 /* non-real value, when q is NULL */
+} REG;
+
+/* instructions.  the binary operators pop two values and push the result;
+ * the others push a value or replace the top one. */
+enum {
+    OP_CONST,                   /* push consts[arg] */
+    OP_VAR,                     /* push vars[arg] */
+    OP_PI,                      /* push pi */
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_POW,
+    OP_POWI,                    /* top ^ consts[arg], an integer */
+    OP_NEG,
+    OP_FUNC                     /* function arg of top */
+};
+
+typedef struct {
+    int op;
+    long arg;
+} INSN;
+
+/* functions, in the same order as function_names */
+enum {
+    F_ABS, F_ATAN, F_COS, F_COSH, F_EXP, F_LN, F_LOG, F_SIN, F_SINH, F_SQRT, F_TAN, F_TANH
+};
+
+static const char *const function_names[] = {
+    "abs", "atan", "cos", "cosh", "exp", "ln", "log", "sin", "sinh", "sqrt", "tan", "tanh",
+    NULL
+};
+
+typedef struct {
+    char *source;
+    INSN *code;
+    long ncode;
+    REG *consts;
+    long nconsts;
+    ID *names;                  /* variable names */
+    long nvars;
+    REG *vars;                  /* values of the variables for the current call */
+    REG *regs;                  /* the stack */
+    long depth;                 /* size of the stack */
+    long sp;                    /* values on the stack (left over if a call raised) */
+    NUMBER *epsilon;            /* NULL to use Calc.config(:epsilon) */
+} EXPR;
+
+typedef struct {
+    EXPR *e;
+    const char *start;
+    const char *p;
+    long code_size;
+    long consts_size;
+    long names_size;
+    long depth;                 /* stack depth after the instructions so far */
+    long nesting;
+    BOOL infer;                 /* unknown names are new variables */
+} PARSER;
+
+static void
+reg_clear(REG * r)
+{
+    if (r->q) {
+        qfree(r->q);
+        r->q = NULL;
+    }
+    if (r->c) {
+        comfree(r->c);
+        r->c = NULL;
+    }
+}
+
+static void
+reg_link(REG * dest, REG * src)
+{
+    dest->q = src->q ? qlink(src->q) : NULL;
+    dest->c = src->c ? clink(src->c) : NULL;
+}
+
+/* stores a complex result, as a NUMBER if it is real (as calc does) */
+static void
+reg_set_complex(REG * r, COMPLEX * c)
+{
+    if (cisreal(c)) {
+        r->q = qlink(c->real);
+        r->c = NULL;
+        comfree(c);
+    }
+    else {
+        r->q = NULL;
+        r->c = c;
+    }
+}
+
+/* a new reference to the value as a COMPLEX */
+static COMPLEX *
+reg_complex(REG * r)
+{
+    COMPLEX *c;
+
+    if (r->c) {
+        return clink(r->c);
+    }
+    c = comalloc();
+    qfree(c->real);
+    c->real = qlink(r->q);
+    return c;
+}
+
+/* res = a op b.  see cq_power for the cases of ^ */
+static void
+reg_binary(int op, REG * a, REG * b, NUMBER * epsilon, REG * res)
+{
+    COMPLEX *ca, *cb, *cres;
+
+    res->c = NULL;
+    if (a->q && b->q) {
+        switch (op) {
+        case OP_ADD:
+            res->q = qqadd(a->q, b->q);
+            return;
+        case OP_SUB:
+            res->q = qsub(a->q, b->q);
+            return;
+        case OP_MUL:
+            res->q = qmul_fast(a->q, b->q);
+            return;
+        case OP_DIV:
+            res->q = qqdiv(a->q, b->q);
+            return;
+        }
+        if (qisint(b->q)) {
+            res->q = qpowi_fast(a->q, b->q);
+            if (!res->q) {
+                res->q = qpowi(a->q, b->q);
+            }
+            return;
+        }
+        if (!qisneg(a->q)) {
+            res->q = qpower(a->q, b->q, epsilon);
+            return;
+        }
+    }
+    else if (op == OP_POW && b->q && qisint(b->q)) {
+        reg_set_complex(res, c_powi(a->c, b->q));
+        return;
+    }
+    if (op == OP_DIV && b->q && qiszero(b->q)) {
+        math_error("Division by zero");
+    }
+    ca = reg_complex(a);
+    cb = reg_complex(b);
+    switch (op) {
+    case OP_ADD:
+        cres = c_add(ca, cb);
+        break;
+    case OP_SUB:
+        cres = c_sub(ca, cb);
+        break;
+    case OP_MUL:
+        cres = c_mul(ca, cb);
+        break;
+    case OP_DIV:
+        cres = c_div(ca, cb);
+        break;
+    default:
+        cres = c_power(ca, cb, epsilon);
+    }
+    comfree(ca);
+    comfree(cb);
+    reg_set_complex(res, cres);
+}
+
+static void
+reg_negate(REG * r, REG * res)
+{
+    if (r->q) {
+        res->q = qneg(r->q);
+        res->c = NULL;
+    }
+    else {
+        reg_set_complex(res, c_neg(r->c));
+    }
+}
+
+/* res = f(r).  like trans_function and log_function, the complex version is
+ * used for non-real results. */
+static void
+reg_function(int f, REG * r, NUMBER * epsilon, REG * res)
+{
+    NUMBER *q, *tmp;
+    COMPLEX *c, *cres;
+
+    res->q = NULL;
+    res->c = NULL;
+    q = r->q;
+    if (q) {
+        switch (f) {
+        case F_ABS:
+            res->q = qqabs(q);
+            break;
+        case F_ATAN:
+            res->q = qatan(q, epsilon);
+            break;
+        case F_COS:
+            res->q = qcos(q, epsilon);
+            break;
+        case F_COSH:
+            res->q = qcosh(q, epsilon);
+            break;
+        case F_EXP:
+            res->q = qexp_cached(q, epsilon);
+            break;
+        case F_LN:
+            if (qispos(q)) {
+                res->q = qln_cached(q, epsilon);
+            }
+            break;
+        case F_LOG:
+            if (qispos(q)) {
+                res->q = qlog(q, epsilon);
+            }
+            break;
+        case F_SIN:
+            res->q = qsin(q, epsilon);
+            break;
+        case F_SINH:
+            res->q = qsinh(q, epsilon);
+            break;
+        case F_SQRT:
+            if (!qisneg(q)) {
+                res->q = qsqrt(q, epsilon, conf->sqrt);
+            }
+            else {
+                tmp = qneg(q);
+                c = comalloc();
+                qfree(c->imag);
+                c->imag = qsqrt(tmp, epsilon, conf->sqrt);
+                qfree(tmp);
+                reg_set_complex(res, c);
+            }
+            return;
+        case F_TAN:
+            res->q = qtan(q, epsilon);
+            break;
+        case F_TANH:
+            res->q = qtanh(q, epsilon);
+            break;
+        }
+        if (res->q) {
+            return;
+        }
+    }
+    c = reg_complex(r);
+    switch (f) {
+    case F_ABS:
+        res->q = qhypot(c->real, c->imag, epsilon);
+        comfree(c);
+        return;
+    case F_ATAN:
+        cres = c_atan(c, epsilon);
+        break;
+    case F_COS:
+        cres = c_cos(c, epsilon);
+        break;
+    case F_COSH:
+        cres = c_cosh(c, epsilon);
+        break;
+    case F_EXP:
+        cres = c_exp(c, epsilon);
+        break;
+    case F_LN:
+        cres = c_ln(c, epsilon);
+        break;
+    case F_LOG:
+        cres = c_log(c, epsilon);
+        break;
+    case F_SIN:
+        cres = c_sin(c, epsilon);
+        break;
+    case F_SINH:
+        cres = c_sinh(c, epsilon);
+        break;
+    case F_SQRT:
+        cres = c_sqrt(c, epsilon, conf->sqrt);
+        break;
+    case F_TAN:
+        cres = c_trig_ratio(c, epsilon, FALSE, C_RATIO_SIN, C_RATIO_COS);
+        break;
+    default:
+        cres = c_trig_ratio(c, epsilon, TRUE, C_RATIO_SIN, C_RATIO_COS);
+    }
+    comfree(c);
+    if (!cres) {
+        rb_raise(e_MathError, "Unhandled NULL from complex version of %s", function_names[f]);
+    }
+    reg_set_complex(res, cres);
+}
+
+/* runs the instructions, leaving the result on the stack */
+static void
+expr_run(EXPR * e, NUMBER * epsilon)
+{
+    const INSN *insn, *end;
+    REG *top, res;
+
+    while (e->sp > 0) {
+        reg_clear(&e->regs[--e->sp]);
+    }
+    end = e->code + e->ncode;
+    for (insn = e->code; insn < end; insn++) {
+        /* one past the top of the stack */
+        top = e->regs + e->sp;
+        switch (insn->op) {
+        case OP_CONST:
+            reg_link(top, &e->consts[insn->arg]);
+            e->sp++;
+            break;
+        case OP_VAR:
+            reg_link(top, &e->vars[insn->arg]);
+            e->sp++;
+            break;
+        case OP_PI:
+            top->c = NULL;
+            top->q = qpi_cached(epsilon);
+            e->sp++;
+            break;
+        case OP_POWI:
+            reg_binary(OP_POW, top - 1, &e->consts[insn->arg], epsilon, &res);
+            reg_clear(top - 1);
+            top[-1] = res;
+            break;
+        case OP_NEG:
+            reg_negate(top - 1, &res);
+            reg_clear(top - 1);
+            top[-1] = res;
+            break;
+        case OP_FUNC:
+            reg_function(insn->arg, top - 1, epsilon, &res);
+            reg_clear(top - 1);
+            top[-1] = res;
+            break;
+        default:
+            reg_binary(insn->op, top - 2, top - 1, epsilon, &res);
+            reg_clear(top - 2);
+            reg_clear(top - 1);
+            top[-2] = res;
+            e->sp--;
+        }
+    }
+}
+
+static void
+cexpr_free(void *p)
+{
+    EXPR *e = (EXPR *) p;
+    long i;
+
+    if (e) {
+        for (i = 0; i < e->nconsts; i++) {
+            reg_clear(&e->consts[i]);
+        }
+        for (i = 0; i < e->sp; i++) {
+            reg_clear(&e->regs[i]);
+        }
+        if (e->vars) {
+            for (i = 0; i < e->nvars; i++) {
+                reg_clear(&e->vars[i]);
+            }
+        }
+        if (e->epsilon) {
+            qfree(e->epsilon);
+        }
+        xfree(e->source);
+        xfree(e->code);
+        xfree(e->consts);
+        xfree(e->names);
+        xfree(e->vars);
+        xfree(e->regs);
+        xfree(e);
+    }
+}
+
+const rb_data_type_t calc_expression_type = {
+    "Calc::Expression",
+    {0, cexpr_free, 0},
+    0, 0
+#ifdef RUBY_TYPED_FREE_IMMEDIATELY
+        , RUBY_TYPED_FREE_IMMEDIATELY
+#endif
+};
+
+static VALUE
+cexpr_alloc(VALUE klass)
+{
+    return TypedData_Wrap_Struct(klass, &calc_expression_type, 0);
+}
+
+static EXPR *
+get_expr(VALUE self)
+{
+    EXPR *e = rb_check_typeddata(self, &calc_expression_type);
+
+    if (!e) {
+        rb_raise(rb_eArgError, "uninitialized Calc::Expression");
+    }
+    return e;
+}
+
+/*** parser ***/
+
+static void parse_expr(PARSER * ps);
+
+static void
+parse_error(PARSER * ps, const char *message)
+{
+    rb_raise(rb_eArgError, "%s at position %ld of expression \"%s\"", message,
+             (long) (ps->p - ps->start), ps->start);
+}
+
+static void
+skip_space(PARSER * ps)
+{
+    while (isspace((unsigned char) *ps->p)) {
+        ps->p++;
+    }
+}
+
+static int
+is_name_char(char ch)
+{
+    return isalnum((unsigned char) ch) || ch == '_';
+}
+
+static void
+expect(PARSER * ps, char ch, const char *message)
+{
+    skip_space(ps);
+    if (*ps->p != ch) {
+        parse_error(ps, message);
+    }
+    ps->p++;
+}
+
+static void
+emit(PARSER * ps, int op, long arg)
+{
+    EXPR *e = ps->e;
+
+    if (e->ncode == ps->code_size) {
+        ps->code_size = ps->code_size * 2 + 16;
+        REALLOC_N(e->code, INSN, ps->code_size);
+    }
+    e->code[e->ncode].op = op;
+    e->code[e->ncode].arg = arg;
+    e->ncode++;
+    if (op == OP_CONST || op == OP_VAR || op == OP_PI) {
+        if (++ps->depth > e->depth) {
+            e->depth = ps->depth;
+        }
+    }
+    else if (op >= OP_ADD && op <= OP_POW) {
+        ps->depth--;
+    }
+}
+
+/* adds a constant, taking ownership of the value in r */
+static void
+emit_const(PARSER * ps, REG * r)
+{
+    EXPR *e = ps->e;
+
+    if (e->nconsts == ps->consts_size) {
+        ps->consts_size = ps->consts_size * 2 + 8;
+        REALLOC_N(e->consts, REG, ps->consts_size);
+    }
+    e->consts[e->nconsts++] = *r;
+    emit(ps, OP_CONST, e->nconsts - 1);
+}
+
+/* the last instruction if it pushes a constant (and so is a whole operand) */
+static INSN *
+last_const(PARSER * ps, long back)
+{
+    EXPR *e = ps->e;
+    INSN *insn;
+
+    if (e->ncode < back) {
+        return NULL;
+    }
+    insn = &e->code[e->ncode - back];
+    return (insn->op == OP_CONST) ? insn : NULL;
+}
+
+/* emits a binary operator.  exact operations on two constants are done now;
+ * a constant integer power becomes OP_POWI. */
+static void
+emit_binary(PARSER * ps, int op)
+{
+    EXPR *e = ps->e;
+    INSN *a, *b;
+    REG *exponent, res;
+
+    b = last_const(ps, 1);
+    a = b ? last_const(ps, 2) : NULL;
+    if (b && op == OP_POW) {
+        exponent = &e->consts[b->arg];
+        if (!exponent->q || !qisint(exponent->q)) {
+            b = a = NULL;
+        }
+        else if (!a) {
+            b->op = OP_POWI;
+            ps->depth--;
+            return;
+        }
+    }
+    if (a && b) {
+        reg_binary(op, &e->consts[a->arg], &e->consts[b->arg], conf->epsilon, &res);
+        reg_clear(&e->consts[a->arg]);
+        e->consts[a->arg] = res;
+        if (b->arg == e->nconsts - 1) {
+            reg_clear(&e->consts[--e->nconsts]);
+        }
+        e->ncode--;
+        ps->depth--;
+        return;
+    }
+    emit(ps, op, 0);
+}
+
+static void
+emit_negate(PARSER * ps)
+{
+    INSN *a = last_const(ps, 1);
+    REG *r, res;
+
+    if (a) {
+        r = &ps->e->consts[a->arg];
+        reg_negate(r, &res);
+        reg_clear(r);
+        *r = res;
+        return;
+    }
+    emit(ps, OP_NEG, 0);
+}
+
+/* digits with an optional point and exponent, and an optional "i" */
+static void
+parse_number(PARSER * ps)
+{
+    const char *s = ps->p;
+    const char *p = ps->p;
+    COMPLEX *c;
+    REG r;
+
+    while (isdigit((unsigned char) *p)) {
+        p++;
+    }
+    if (*p == '.') {
+        p++;
+        while (isdigit((unsigned char) *p)) {
+            p++;
+        }
+    }
+    if ((*p == 'e' || *p == 'E')
+        && (isdigit((unsigned char) p[1])
+            || ((p[1] == '+' || p[1] == '-') && isdigit((unsigned char) p[2])))) {
+        p += 2;
+        while (isdigit((unsigned char) *p)) {
+            p++;
+        }
+    }
+    r.q = value_to_number(rb_str_new(s, p - s), 1);
+    r.c = NULL;
+    if (*p == 'i' && !is_name_char(p[1])) {
+        p++;
+        c = comalloc();
+        qfree(c->imag);
+        c->imag = r.q;
+        reg_set_complex(&r, c);
+    }
+    ps->p = p;
+    emit_const(ps, &r);
+    if (is_name_char(*p)) {
+        parse_error(ps, "invalid number");
+    }
+}
+
+static long
+variable_index(EXPR * e, ID id)
+{
+    long i;
+
+    for (i = 0; i < e->nvars; i++) {
+        if (e->names[i] == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* a variable, pi, or a function call */
+static void
+parse_name(PARSER * ps)
+{
+    EXPR *e = ps->e;
+    const char *s = ps->p;
+    long len, i;
+    ID id;
+
+    while (is_name_char(*ps->p)) {
+        ps->p++;
+    }
+    len = ps->p - s;
+    skip_space(ps);
+    if (*ps->p == '(') {
+        for (i = 0; function_names[i]; i++) {
+            if ((long) strlen(function_names[i]) == len
+                && strncmp(function_names[i], s, len) == 0) {
+                break;
+            }
+        }
+        if (!function_names[i]) {
+            ps->p = s;
+            parse_error(ps, "unknown function");
+        }
+        ps->p++;
+        parse_expr(ps);
+        expect(ps, ')', "expected ')'");
+        emit(ps, OP_FUNC, i);
+        return;
+    }
+    id = rb_intern2(s, len);
+    i = variable_index(e, id);
+    if (i >= 0) {
+        emit(ps, OP_VAR, i);
+    }
+    else if (len == 2 && strncmp(s, "pi", 2) == 0) {
+        emit(ps, OP_PI, 0);
+    }
+    else if (ps->infer) {
+        if (e->nvars == ps->names_size) {
+            ps->names_size = ps->names_size * 2 + 4;
+            REALLOC_N(e->names, ID, ps->names_size);
+        }
+        e->names[e->nvars++] = id;
+        emit(ps, OP_VAR, e->nvars - 1);
+    }
+    else {
+        ps->p = s;
+        parse_error(ps, "unknown variable");
+    }
+}
+
+static void
+parse_primary(PARSER * ps)
+{
+    char ch;
+
+    skip_space(ps);
+    ch = *ps->p;
+    if (ch == '(') {
+        ps->p++;
+        parse_expr(ps);
+        expect(ps, ')', "expected ')'");
+    }
+    else if (isdigit((unsigned char) ch) || (ch == '.' && isdigit((unsigned char) ps->p[1]))) {
+        parse_number(ps);
+    }
+    else if (isalpha((unsigned char) ch) || ch == '_') {
+        parse_name(ps);
+    }
+    else {
+        parse_error(ps, ch ? "unexpected character" : "unexpected end");
+    }
+}
+
+static void parse_unary(PARSER * ps);
+
+/* ^ is right associative and binds tighter than unary minus, as in calc:
+ * -2^2 is -4 and 2^-1 is 0.5 */
+static void
+parse_power(PARSER * ps)
+{
+    parse_primary(ps);
+    skip_space(ps);
+    if (*ps->p == '^' || (ps->p[0] == '*' && ps->p[1] == '*')) {
+        ps->p += (*ps->p == '^') ? 1 : 2;
+        if (++ps->nesting > EXPRESSION_MAX_NESTING) {
+            parse_error(ps, "too deeply nested");
+        }
+        parse_unary(ps);
+        emit_binary(ps, OP_POW);
+        ps->nesting--;
+    }
+}
+
+static void
+parse_unary(PARSER * ps)
+{
+    skip_space(ps);
+    if (*ps->p == '-' || *ps->p == '+') {
+        if (++ps->nesting > EXPRESSION_MAX_NESTING) {
+            parse_error(ps, "too deeply nested");
+        }
+        if (*ps->p++ == '-') {
+            parse_unary(ps);
+            emit_negate(ps);
+        }
+        else {
+            parse_unary(ps);
+        }
+        ps->nesting--;
+    }
+    else {
+        parse_power(ps);
+    }
+}
+
+static void
+parse_term(PARSER * ps)
+{
+    int op;
+
+    parse_unary(ps);
+    for (;;) {
+        skip_space(ps);
+        if (*ps->p == '*') {
+            op = OP_MUL;
+        }
+        else if (*ps->p == '/') {
+            op = OP_DIV;
+        }
+        else {
+            return;
+        }
+        ps->p++;
+        parse_unary(ps);
+        emit_binary(ps, op);
+    }
+}
+
+static void
+parse_expr(PARSER * ps)
+{
+    int op;
+
+    if (++ps->nesting > EXPRESSION_MAX_NESTING) {
+        parse_error(ps, "too deeply nested");
+    }
+    parse_term(ps);
+    for (;;) {
+        skip_space(ps);
+        if (*ps->p == '+') {
+            op = OP_ADD;
+        }
+        else if (*ps->p == '-') {
+            op = OP_SUB;
+        }
+        else {
+            break;
+        }
+        ps->p++;
+        parse_term(ps);
+        emit_binary(ps, op);
+    }
+    ps->nesting--;
+}
+
+/*** calling ***/
+
+static VALUE
+expr_vars(EXPR * e)
+{
+    VALUE result;
+    long i;
+
+    result = rb_ary_new2(e->nvars);
+    for (i = 0; i < e->nvars; i++) {
+        rb_ary_push(result, ID2SYM(e->names[i]));
+    }
+    return result;
+}
+
+/* finds the value of each variable in the arguments to #call (a hash, or
+ * values in the order of #vars), converting any which aren't a Fixnum,
+ * Calc::Q or Calc::C.  nothing is stored in the expression yet, because
+ * converting can call ruby code and so let another thread use it. */
+static void
+expr_lookup(EXPR * e, int argc, const VALUE * argv, VALUE * values)
+{
+    VALUE h, v;
+    long i;
+
+    if (argc == 1 && RB_TYPE_P(argv[0], T_HASH)) {
+        h = argv[0];
+        for (i = 0; i < e->nvars; i++) {
+            v = rb_hash_lookup2(h, ID2SYM(e->names[i]), Qundef);
+            if (v == Qundef) {
+                v = rb_hash_lookup2(h, rb_id2str(e->names[i]), Qundef);
+            }
+            if (v == Qundef) {
+                rb_raise(rb_eArgError, "missing value for %s", rb_id2name(e->names[i]));
+            }
+            values[i] = v;
+        }
+        if ((long) RHASH_SIZE(h) > e->nvars) {
+            rb_raise(rb_eArgError, "unknown variable (expected %" PRIsVALUE ")", expr_vars(e));
+        }
+    }
+    else if (argc != e->nvars) {
+        rb_raise(rb_eArgError, "wrong number of values (given %d, expected %ld)", argc,
+                 e->nvars);
+    }
+    else {
+        for (i = 0; i < e->nvars; i++) {
+            values[i] = argv[i];
+        }
+    }
+    for (i = 0; i < e->nvars; i++) {
+        v = values[i];
+        if (RB_TYPE_P(v, T_COMPLEX)) {
+            values[i] = wrap_complex(value_to_complex(v));
+        }
+        else if (!FIXNUM_P(v) && !CALC_Q_P(v) && !CALC_C_P(v)) {
+            values[i] = wrap_number(value_to_number(v, 1));
+        }
+    }
+}
+
+/* binds the values found by expr_lookup and evaluates */
+static VALUE
+expr_eval(EXPR * e, const VALUE * values)
+{
+    REG result;
+    long i;
+    VALUE v;
+
+    for (i = 0; i < e->nvars; i++) {
+        reg_clear(&e->vars[i]);
+        v = values[i];
+        if (FIXNUM_P(v)) {
+            e->vars[i].q = itoq(FIX2LONG(v));
+        }
+        else if (CALC_Q_P(v)) {
+            e->vars[i].q = qlink((NUMBER *) DATA_PTR(v));
+        }
+        else {
+            reg_set_complex(&e->vars[i], clink((COMPLEX *) DATA_PTR(v)));
+        }
+    }
+    expr_run(e, e->epsilon ? e->epsilon : conf->epsilon);
+    result = e->regs[0];
+    e->sp = 0;
+    return result.q ? wrap_number(result.q) : wrap_complex(result.c);
+}
+
+/* Compiles an expression
+ *
+ * Calc.compile is the same as Calc::Expression.new.
+ *
+ * @param source [String] the expression
+ * @param vars [Array<Symbol>] (optional) names of the variables, in the order
+ *  for positional arguments to #call.  by default, every name in the
+ *  expression which isn't a function or pi, in the order they appear.
+ * @param eps [Numeric,Calc::Q] (optional) accuracy of transcendental
+ *  functions, defaults to Calc.config(:epsilon) when called
+ * @raise [ArgumentError] if the expression is invalid or uses a name not in
+ *  vars
+ * @example
+ *  Calc::Expression.new("x^2 - 2*x").call(x: 3) #=> Calc::Q(3)
+ */
+static VALUE
+cexpr_initialize(int argc, VALUE * argv, VALUE self)
+{
+    static ID keywords[2];
+    VALUE source, opts, values[2], name;
+    PARSER ps;
+    EXPR *e;
+    NUMBER *qepsilon = NULL;
+    long i;
+    ID id;
+    setup_math_error();
+
+    rb_scan_args(argc, argv, "1:", &source, &opts);
+    if (!keywords[0]) {
+        keywords[0] = rb_intern("vars");
+        keywords[1] = rb_intern("eps");
+    }
+    values[0] = values[1] = Qundef;
+    if (!NIL_P(opts)) {
+        rb_get_kwargs(opts, keywords, 0, 2, values);
+    }
+    if (values[0] != Qundef && !NIL_P(values[0])) {
+        Check_Type(values[0], T_ARRAY);
+    }
+    if (values[1] != Qundef && !NIL_P(values[1])) {
+        qepsilon = value_to_number(values[1], 1);
+        if (!qispos(qepsilon)) {
+            qfree(qepsilon);
+            rb_raise(e_MathError, "Invalid epsilon value for Calc::Expression");
+        }
+    }
+
+    if (DATA_PTR(self)) {
+        cexpr_free(DATA_PTR(self));
+        DATA_PTR(self) = 0;
+    }
+    e = ZALLOC_N(EXPR, 1);
+    DATA_PTR(self) = e;
+    e->epsilon = qepsilon;
+    e->source = ruby_strdup(StringValueCStr(source));
+    memset(&ps, 0, sizeof(ps));
+    ps.e = e;
+    ps.start = ps.p = e->source;
+    if (values[0] == Qundef || NIL_P(values[0])) {
+        ps.infer = TRUE;
+    }
+    else {
+        ps.names_size = RARRAY_LEN(values[0]);
+        e->names = ALLOC_N(ID, ps.names_size ? ps.names_size : 1);
+        for (i = 0; i < ps.names_size; i++) {
+            name = RARRAY_AREF(values[0], i);
+            id = rb_to_id(name);
+            if (variable_index(e, id) >= 0) {
+                rb_raise(rb_eArgError, "duplicate variable %" PRIsVALUE, name);
+            }
+            e->names[e->nvars++] = id;
+        }
+    }
+    parse_expr(&ps);
+    skip_space(&ps);
+    if (*ps.p) {
+        parse_error(&ps, *ps.p == ')' ? "unmatched ')'" : "unexpected character");
+    }
+    e->regs = ALLOC_N(REG, e->depth);
+    e->vars = ZALLOC_N(REG, e->nvars ? e->nvars : 1);
+    return self;
+}
+
+static VALUE
+cexpr_initialize_copy(VALUE obj, VALUE orig)
+{
+    EXPR *e, *eorig;
+    long i;
+
+    if (obj == orig) {
+        return obj;
+    }
+    eorig = get_expr(orig);
+    if (DATA_PTR(obj)) {
+        cexpr_free(DATA_PTR(obj));
+        DATA_PTR(obj) = 0;
+    }
+    e = ZALLOC_N(EXPR, 1);
+    DATA_PTR(obj) = e;
+    e->source = ruby_strdup(eorig->source);
+    e->code = ALLOC_N(INSN, eorig->ncode);
+    MEMCPY(e->code, eorig->code, INSN, eorig->ncode);
+    e->ncode = eorig->ncode;
+    e->consts = ALLOC_N(REG, eorig->nconsts ? eorig->nconsts : 1);
+    for (i = 0; i < eorig->nconsts; i++) {
+        reg_link(&e->consts[i], &eorig->consts[i]);
+    }
+    e->nconsts = eorig->nconsts;
+    e->names = ALLOC_N(ID, eorig->nvars ? eorig->nvars : 1);
+    MEMCPY(e->names, eorig->names, ID, eorig->nvars);
+    e->nvars = eorig->nvars;
+    e->vars = ZALLOC_N(REG, e->nvars ? e->nvars : 1);
+    e->depth = eorig->depth;
+    e->regs = ALLOC_N(REG, e->depth);
+    e->epsilon = eorig->epsilon ? qlink(eorig->epsilon) : NULL;
+    return obj;
+}
+
+/* Evaluates the expression
+ *
+ * Values can be given as a hash of variable names, or in the order of #vars.
+ *
+ * @return [Calc::Q,Calc::C]
+ * @raise [ArgumentError] if a value is missing, or not for a variable
+ * @example
+ *  f = Calc.compile("x^2 + y", vars: %i[x y])
+ *  f.call(x: 3, y: Calc::Q(1, 2)) #=> Calc::Q(9.5)
+ *  f.call(2, "1e-3")              #=> Calc::Q(4.001)
+ *  f.call(x: Complex(0, 1), y: 1) #=> Calc::Q(0)
+ */
+static VALUE
+cexpr_call(int argc, VALUE * argv, VALUE self)
+{
+    EXPR *e;
+    VALUE *values;
+    setup_math_error();
+
+    e = get_expr(self);
+    values = ALLOCA_N(VALUE, e->nvars ? e->nvars : 1);
+    expr_lookup(e, argc, argv, values);
+    return expr_eval(e, values);
+}
+
+/* Evaluates the expression for each of a list of bindings
+ *
+ * Each binding is a hash or an array of values as for #call (or just the
+ * value if there is only one variable).
+ *
+ * @param bindings [Enumerable]
+ * @return [Array<Calc::Q,Calc::C>]
+ * @example
+ *  f = Calc.compile("1/x + y")
+ *  f.call_many([{ x: 2, y: 1 }, [4, 0]]) #=> [Calc::Q(1.5), Calc::Q(0.25)]
+ *  Calc.compile("sqrt(x)").call_many(1..4).last #=> Calc::Q(2)
+ */
+static VALUE
+cexpr_call_many(VALUE self, VALUE bindings)
+{
+    EXPR *e;
+    VALUE list, item, result, *args, *values;
+    long i, j, n;
+    setup_math_error();
+
+    e = get_expr(self);
+    list = rb_check_array_type(bindings);
+    if (NIL_P(list)) {
+        list = rb_convert_type(rb_funcall(bindings, rb_intern("to_a"), 0), T_ARRAY, "Array",
+                               "to_ary");
+    }
+    values = ALLOCA_N(VALUE, e->nvars ? e->nvars : 1);
+    args = ALLOCA_N(VALUE, e->nvars + 1);
+    result = rb_ary_new2(RARRAY_LEN(list));
+    for (i = 0; i < RARRAY_LEN(list); i++) {
+        item = rb_ary_entry(list, i);
+        if (RB_TYPE_P(item, T_ARRAY)) {
+            /* copied, as converting the values can run ruby code which
+             * changes the array.  any more than nvars is an error anyway. */
+            n = RARRAY_LEN(item);
+            for (j = 0; j < n && j <= e->nvars; j++) {
+                args[j] = rb_ary_entry(item, j);
+            }
+            expr_lookup(e, (int) n, args, values);
+        }
+        else {
+            expr_lookup(e, 1, &item, values);
+        }
+        rb_ary_push(result, expr_eval(e, values));
+    }
+    return result;
+}
+
+/* @return [String] */
+static VALUE
+cexpr_inspect(VALUE self)
+{
+    return rb_sprintf("Calc::Expression(%s)", get_expr(self)->source);
+}
+
+/* The expression as it was given
+ *
+ * @return [String]
+ */
+static VALUE
+cexpr_to_s(VALUE self)
+{
+    return rb_str_new_cstr(get_expr(self)->source);
+}
+
+/* Names of the variables, in the order for positional arguments to #call
+ *
+ * @return [Array<Symbol>]
+ * @example
+ *  Calc.compile("y * sin(x) + y").vars #=> [:y, :x]
+ */
+static VALUE
+cexpr_vars(VALUE self)
+{
+    return expr_vars(get_expr(self));
+}
+
+/* Compiles an expression for fast repeated evaluation
+ *
+ * Parses the expression once and returns a Calc::Expression, whose #call and
+ * #call_many evaluate it in C without making a ruby method call for each
+ * operation.  See Calc::Expression for the syntax.
+ *
+ * @param source [String] the expression
+ * @param vars [Array<Symbol>] (optional) names of the variables, in the order
+ *  for positional arguments to #call.  by default, every name in the
+ *  expression which isn't a function or pi, in the order they appear.
+ * @param eps [Numeric,Calc::Q] (optional) accuracy of transcendental
+ *  functions, defaults to Calc.config(:epsilon) when called
+ * @return [Calc::Expression]
+ * @raise [ArgumentError] if the expression is invalid or uses a name not in
+ *  vars
+ * @example
+ *  f = Calc.compile("a*x^2 + b*sqrt(y) - c/x", vars: %i[a b c x y])
+ *  f.call(a: 1, b: 2, c: 3, x: 4, y: 9) #=> Calc::Q(21.25)
+ */
+VALUE
+calc_compile(int argc, VALUE * argv, VALUE klass)
+{
+    VALUE obj = cexpr_alloc(cExpression);
+
+    return cexpr_initialize(argc, argv, obj);
+}
+
+void
+define_calc_expression(VALUE m)
+{
+    cExpression = rb_define_class_under(m, "Expression", rb_cObject);
+    rb_define_alloc_func(cExpression, cexpr_alloc);
+    rb_define_method(cExpression, "initialize", cexpr_initialize, -1);
+    rb_define_method(cExpression, "initialize_copy", cexpr_initialize_copy, 1);
+    rb_define_method(cExpression, "call", cexpr_call, -1);
+    rb_define_method(cExpression, "call_many", cexpr_call_many, 1);
+    rb_define_method(cExpression, "inspect", cexpr_inspect, 0);
+    rb_define_method(cExpression, "to_s", cexpr_to_s, 0);
+    rb_define_method(cExpression, "vars", cexpr_vars, 0);
+    rb_define_alias(cExpression, "[]", "call");
+}
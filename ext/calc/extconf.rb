@@ -26,4 +26,11 @@ else
   end
 end
 
+# NTT multiplication (zmul.c) needs 128 bit integers
+have_type("__int128")
+
+# long calculations (eg pix) release the GVL and can be split across threads
+have_header("ruby/thread.h")
+have_header("pthread.h") && have_library("pthread", "pthread_create")
+
 create_makefile("calc/calc")
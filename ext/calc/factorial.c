@@ -0,0 +1,343 @@
+#include "calc.h"
+
+/* Factorials and related functions, calculated from their prime factors.
+ *
+ * libcalc calculates fact, lcmfact, pfact, perm and comb by multiplying an
+ * accumulator by one small number at a time, which takes quadratic time.
+ * Here each result is written as a product of prime powers, and the primes
+ * are multiplied in a balanced product tree so that the big multiplications
+ * have operands of similar size (and can use zmul_fast).  Factorials use
+ * Luschny's prime swing algorithm:
+ *
+ *   n! = (n/2)!^2 * swing(n)
+ *
+ * where swing(n) = n! / (n/2)!^2 has a simple prime factorisation.
+ *
+ * The *_fast functions fall back to libcalc for arguments they don't handle,
+ * which also lets libcalc raise its usual errors.
+ */
+
+/* factorials up to this fit in a FULL */
+#define FACT_SMALL 20
+
+/* binomial coefficients C(n, k) with smaller k are left to libcalc */
+#define COMB_SMALL 32
+
+/* ... and with k < n / COMB_SIEVE_RATIO are calculated as a product of k
+ * integers divided by k!, rather than sieving all primes up to n */
+#define COMB_SIEVE_RATIO 64
+
+/* sets res to the product of count FULLs */
+static void
+zproduct_tree(const FULL * words, long count, ZVALUE * res)
+{
+    ZVALUE left, right;
+    long half;
+
+    if (count == 0) {
+        itoz(1L, res);
+        return;
+    }
+    if (count == 1) {
+        utoz(words[0], res);
+        return;
+    }
+    half = count / 2;
+    zproduct_tree(words, half, &left);
+    zproduct_tree(words + half, count - half, &right);
+    zmul_fast(left, right, res);
+    zfree(left);
+    zfree(right);
+}
+
+/* appends n to the product being packed into words[*count] */
+static void
+pack_word(FULL * words, long *count, FULL n)
+{
+    if (*count > 0 && words[*count - 1] <= ((FULL) ~0) / n) {
+        words[*count - 1] *= n;
+    }
+    else {
+        words[(*count)++] = n;
+    }
+}
+
+/* sets res to the product of primes[i]^exps[i] for i < count.
+ *
+ * the primes whose exponent has bit j set are multiplied together for each
+ * j, and the results combined by repeated squaring, so large exponents (eg
+ * the power of 2 in a factorial) cost no more than a few squarings. */
+void
+zprimepower_product(const uint32_t * primes, const long *exps, long count, ZVALUE * res)
+{
+    ZVALUE acc, sq, part;
+    FULL *words;
+    long i, nwords, maxexp = 0;
+    int bit;
+
+    for (i = 0; i < count; i++) {
+        if (exps[i] > maxexp) {
+            maxexp = exps[i];
+        }
+    }
+    itoz(1L, &acc);
+    if (maxexp == 0) {
+        *res = acc;
+        return;
+    }
+    words = ALLOC_N(FULL, count);
+    for (bit = 0; (maxexp >> bit) > 1; bit++);
+    for (; bit >= 0; bit--) {
+        nwords = 0;
+        for (i = 0; i < count; i++) {
+            if ((exps[i] >> bit) & 1) {
+                pack_word(words, &nwords, primes[i]);
+            }
+        }
+        zproduct_tree(words, nwords, &part);
+        zsquare_fast(acc, &sq);
+        zfree(acc);
+        zmul_fast(sq, part, &acc);
+        zfree(sq);
+        zfree(part);
+    }
+    xfree(words);
+    *res = acc;
+}
+
+/* sets res to the product of the integers lo..hi (which must be positive) */
+static void
+zrange_product(long lo, long hi, ZVALUE * res)
+{
+    FULL *words;
+    long n, nwords = 0;
+
+    words = ALLOC_N(FULL, hi - lo + 1);
+    for (n = lo; n <= hi; n++) {
+        pack_word(words, &nwords, (FULL) n);
+    }
+    zproduct_tree(words, nwords, res);
+    xfree(words);
+}
+
+/* exponent of the prime p in n! (Legendre's formula) */
+long
+fact_exponent(long n, long p)
+{
+    long e = 0;
+
+    while (n >= p) {
+        n /= p;
+        e += n;
+    }
+    return e;
+}
+
+/* number of primes in the table which are <= n */
+static long
+primes_upto(const uint32_t * primes, long count, long n)
+{
+    long lo = 0, hi = count, mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if ((long) primes[mid] <= n) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* sets res to n!, using primes (all primes <= n) and exps as scratch space */
+static void
+zfact_swing(long n, const uint32_t * primes, long count, long *exps, ZVALUE * res)
+{
+    ZVALUE half, sq, swing;
+    FULL f = 1;
+    long i, k, q;
+
+    if (n <= FACT_SMALL) {
+        for (i = 2; i <= n; i++) {
+            f *= (FULL) i;
+        }
+        utoz(f, res);
+        return;
+    }
+    zfact_swing(n / 2, primes, count, exps, &half);
+
+    /* the exponent of p in swing(n) is the number of odd n / p^i */
+    k = primes_upto(primes, count, n);
+    for (i = 0; i < k; i++) {
+        exps[i] = 0;
+        for (q = n / primes[i]; q > 0; q /= primes[i]) {
+            exps[i] += q & 1;
+        }
+    }
+    zprimepower_product(primes, exps, k, &swing);
+    zsquare_fast(half, &sq);
+    zfree(half);
+    zmul_fast(sq, swing, res);
+    zfree(sq);
+    zfree(swing);
+}
+
+/* sets res to n! */
+static void
+zfact_fast(long n, ZVALUE * res)
+{
+    uint32_t *primes;
+    long *exps, count;
+
+    primes = prime_sieve(n, &count);
+    exps = ALLOC_N(long, count + 1);
+    zfact_swing(n, primes, count, exps, res);
+    xfree(exps);
+    xfree(primes);
+}
+
+/* returns q! */
+NUMBER *
+qfact_fast(NUMBER * q)
+{
+    NUMBER *r;
+
+    if (qisfrac(q) || qisneg(q) || zge24b(q->num)) {
+        return qfact(q);
+    }
+    r = qalloc();
+    zfact_fast(qtoi(q), &r->num);
+    return r;
+}
+
+/* returns the lcm of 1..q, ie the product of the largest power of each prime
+ * which is <= q */
+NUMBER *
+qlcmfact_fast(NUMBER * q)
+{
+    NUMBER *r;
+    uint32_t *primes;
+    long *exps, i, n, m, count;
+
+    if (qisfrac(q) || qisneg(q) || zge24b(q->num)) {
+        return qlcmfact(q);
+    }
+    n = qtoi(q);
+    primes = prime_sieve(n, &count);
+    exps = ALLOC_N(long, count + 1);
+    for (i = 0; i < count; i++) {
+        exps[i] = 0;
+        for (m = n; m >= primes[i]; m /= primes[i]) {
+            exps[i]++;
+        }
+    }
+    r = qalloc();
+    zprimepower_product(primes, exps, count, &r->num);
+    xfree(exps);
+    xfree(primes);
+    return r;
+}
+
+/* returns the product of the primes <= q */
+NUMBER *
+qpfact_fast(NUMBER * q)
+{
+    NUMBER *r;
+    uint32_t *primes;
+    long *exps, i, count;
+
+    if (qisfrac(q) || qisneg(q) || zge24b(q->num)) {
+        return qpfact(q);
+    }
+    primes = prime_sieve(qtoi(q), &count);
+    exps = ALLOC_N(long, count + 1);
+    for (i = 0; i < count; i++) {
+        exps[i] = 1;
+    }
+    r = qalloc();
+    zprimepower_product(primes, exps, count, &r->num);
+    xfree(exps);
+    xfree(primes);
+    return r;
+}
+
+/* returns q1! / (q1 - q2)!.  when q2 is at least half of q1 most of q1! is
+ * needed, so it is calculated from prime exponents; otherwise the integers
+ * q1 - q2 + 1 .. q1 are multiplied directly. */
+NUMBER *
+qperm_fast(NUMBER * q1, NUMBER * q2)
+{
+    NUMBER *r;
+    uint32_t *primes;
+    long *exps, i, n, k, count;
+
+    if (qisfrac(q1) || qisneg(q1) || zge31b(q1->num) || qisfrac(q2) || qisneg(q2)
+        || qrel(q2, q1) > 0 || qiszero(q2) || qisone(q2)) {
+        return qperm(q1, q2);
+    }
+    n = qtoi(q1);
+    k = qtoi(q2);
+    r = qalloc();
+    if (2 * k < n) {
+        zrange_product(n - k + 1, n, &r->num);
+        return r;
+    }
+    primes = prime_sieve(n, &count);
+    exps = ALLOC_N(long, count + 1);
+    for (i = 0; i < count; i++) {
+        exps[i] = fact_exponent(n, primes[i]) - fact_exponent(n - k, primes[i]);
+    }
+    zprimepower_product(primes, exps, count, &r->num);
+    xfree(exps);
+    xfree(primes);
+    return r;
+}
+
+/* returns the binomial coefficient C(q1, q2), or NULL (like qcomb) if q2 is
+ * too large.
+ *
+ * the exponent of each prime p in C(n, k) is the number of carries when k
+ * and n - k are added in base p (Kummer's theorem), or equivalently the
+ * difference of the exponents of p in n!, k! and (n - k)! (Legendre). */
+NUMBER *
+qcomb_fast(NUMBER * q1, NUMBER * q2)
+{
+    NUMBER *r;
+    ZVALUE num, den;
+    uint32_t *primes;
+    long *exps, i, n, k, count;
+
+    if (qisfrac(q1) || qisneg(q1) || zge31b(q1->num) || qisfrac(q2) || qisneg(q2)
+        || qrel(q2, q1) > 0) {
+        return qcomb(q1, q2);
+    }
+    n = qtoi(q1);
+    k = qtoi(q2);
+    if (k > n - k) {
+        k = n - k;
+    }
+    if (k < COMB_SMALL) {
+        return qcomb(q1, q2);
+    }
+    r = qalloc();
+    if (k < n / COMB_SIEVE_RATIO) {
+        zrange_product(n - k + 1, n, &num);
+        zfact_fast(k, &den);
+        zequo(num, den, &r->num);
+        zfree(num);
+        zfree(den);
+        return r;
+    }
+    primes = prime_sieve(n, &count);
+    exps = ALLOC_N(long, count + 1);
+    for (i = 0; i < count; i++) {
+        exps[i] = fact_exponent(n, primes[i]) - fact_exponent(k, primes[i])
+            - fact_exponent(n - k, primes[i]);
+    }
+    zprimepower_product(primes, exps, count, &r->num);
+    xfree(exps);
+    xfree(primes);
+    return r;
+}
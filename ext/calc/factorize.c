@@ -0,0 +1,1889 @@
+#include "calc.h"
+
+/* Complete factorization of integers, for Calc::Q#factorize.
+ *
+ * libcalc's factor and lfactor only do trial division, so this tries methods
+ * in increasing order of cost until every factor is a (BPSW probable) prime:
+ *
+ *  - trial division by the primes below 2^16
+ *  - a perfect power check
+ *  - Pollard's rho method with Brent's cycle finding, for factors up to about
+ *    ten digits
+ *  - Lenstra's elliptic curve method (ECM), whose cost depends mostly on the
+ *    size of the factor found.  Curves run without the GVL, several at a
+ *    time on Calc.config(:threads) threads, using the arithmetic in mont.c.
+ *  - the self initializing quadratic sieve (SIQS), whose cost depends only on
+ *    the size of the number.  It is used for cofactors up to 100 digits.
+ *
+ * An optional budget in seconds stops the search; composites which couldn't
+ * be split by then are returned as they are.
+ */
+
+#define TRIAL_LIMIT 65535       /* trial division limit */
+#define RHO_SHORT 20000L        /* rho iterations before moving on to ECM */
+#define ECM_WINDOW 210          /* stage 2 pairs primes around multiples of 2 * this */
+#define ECM_B2_MULT 50          /* stage 2 limit as a multiple of b1 */
+#define ECM_MAX_B2 250000000    /* largest stage 2 limit, so the primes fit in 55MB */
+#define SIQS_MAX_DIGITS 100     /* larger numbers only get ECM */
+#define SIQS_EXTRA 64           /* relations beyond the factor base size */
+#define SIQS_MAX_A 20           /* most primes in A */
+#define SIQS_BLOCK 32768        /* sieve block size, to fit in the L1 cache */
+
+typedef struct {
+    ZVALUE z;
+    long e;
+} FACTOR;
+
+typedef struct {
+    double deadline;            /* stop after this (seconds), or 0 for no limit */
+    BOOL expired;
+    int state;                  /* from rb_protect(), if an interrupt raised */
+    FACTOR *factors;            /* found so far */
+    long count;
+    long size;
+} FACTORIZE;
+
+static double
+now_seconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static VALUE
+check_ints(VALUE arg)
+{
+    rb_thread_check_ints();
+    return Qnil;
+}
+
+/* checks for interrupts, then returns TRUE if the budget has run out.  an
+ * exception raised by an interrupt is held in fz->state and counts as
+ * running out of time, so everything is freed on the way back to
+ * zfactorize(), which then raises it. */
+static BOOL
+out_of_time(FACTORIZE * fz)
+{
+    if (!fz->state) {
+        rb_protect(check_ints, Qnil, &fz->state);
+    }
+    if (fz->state || (fz->deadline > 0 && now_seconds() > fz->deadline)) {
+        fz->expired = TRUE;
+    }
+    return fz->expired;
+}
+
+/* records factor z (taking ownership of it) with exponent e */
+static void
+add_factor(FACTORIZE * fz, ZVALUE z, long e)
+{
+    if (fz->count == fz->size) {
+        fz->size = fz->size ? fz->size * 2 : 16;
+        REALLOC_N(fz->factors, FACTOR, fz->size);
+    }
+    fz->factors[fz->count].z = z;
+    fz->factors[fz->count].e = e;
+    fz->count++;
+}
+
+/* views an array of len HALFs as a ZVALUE, without copying it */
+static ZVALUE
+limb_view(HALF * a, LEN len)
+{
+    ZVALUE z;
+
+    while (len > 1 && a[len - 1] == 0) {
+        len--;
+    }
+    z.v = a;
+    z.len = len;
+    z.sign = 0;
+    return z;
+}
+
+/* copies z mod n in Montgomery form (ie z * 2^(BASEB * n.len) mod n) to r */
+static void
+to_mont(ZVALUE z, ZVALUE n, HALF * r)
+{
+    ZVALUE t1, t2;
+
+    zshift(z, (long) BASEB * n.len, &t1);
+    zmod(t1, n, &t2, 0);
+    zfree(t1);
+    memset(r, 0, n.len * sizeof(HALF));
+    memcpy(r, t2.v, t2.len * sizeof(HALF));
+    zfree(t2);
+}
+
+/* a^e mod p for p < 2^32 */
+static uint64_t
+powmod32(uint64_t a, uint64_t e, uint64_t p)
+{
+    uint64_t r = 1;
+
+    a %= p;
+    while (e) {
+        if (e & 1) {
+            r = r * a % p;
+        }
+        a = a * a % p;
+        e >>= 1;
+    }
+    return r;
+}
+
+/* 1/a mod p, for a not a multiple of p */
+static uint32_t
+invmod32(uint32_t a, uint32_t p)
+{
+    int64_t t = 0, newt = 1, r = p, newr = a % p, q, tmp;
+
+    while (newr) {
+        q = r / newr;
+        tmp = t - q * newt;
+        t = newt;
+        newt = tmp;
+        tmp = r - q * newr;
+        r = newr;
+        newr = tmp;
+    }
+    return (uint32_t) (t < 0 ? t + p : t);
+}
+
+/* square root of a quadratic residue a mod the odd prime p (Tonelli-Shanks) */
+static uint32_t
+sqrtmod32(uint32_t a, uint32_t p)
+{
+    uint64_t q, z, c, r, t, b;
+    long s, m, i;
+
+    a %= p;
+    if (a == 0) {
+        return 0;
+    }
+    if (p % 4 == 3) {
+        return (uint32_t) powmod32(a, (p + 1) / 4, p);
+    }
+    for (q = p - 1, s = 0; !(q & 1); q >>= 1, s++);
+    for (z = 2; powmod32(z, (p - 1) / 2, p) != p - 1; z++);
+    c = powmod32(z, q, p);
+    r = powmod32(a, (q + 1) / 2, p);
+    t = powmod32(a, q, p);
+    m = s;
+    while (t != 1) {
+        for (i = 0, b = t; b != 1; i++) {
+            b = b * b % p;
+        }
+        b = c;
+        while (--m > i) {
+            b = b * b % p;
+        }
+        m = i;
+        r = r * b % p;
+        c = b * b % p;
+        t = t * c % p;
+    }
+    return (uint32_t) r;
+}
+
+/*
+ * perfect powers
+ */
+
+/* sets *res to floor(n^(1/k)) */
+static void
+ziroot(ZVALUE n, long k, ZVALUE * res)
+{
+    ZVALUE x, y, zk1, xp, t1, t2;
+
+    if (k == 2) {
+        zsqrt(n, res, 0);
+        return;
+    }
+    itoz(k - 1, &zk1);
+    zbitvalue(zhighbit(n) / k + 1, &x);
+    for (;;) {
+        /* y = ((k - 1) x + n / x^(k - 1)) / k */
+        zpowi(x, zk1, &xp);
+        zquo(n, xp, &t1, 0);
+        zfree(xp);
+        zmuli(x, k - 1, &t2);
+        zadd(t1, t2, &xp);
+        zfree(t1);
+        zfree(t2);
+        zdivi(xp, k, &y);
+        zfree(xp);
+        if (zrel(y, x) >= 0) {
+            zfree(y);
+            break;
+        }
+        zfree(x);
+        x = y;
+    }
+    zfree(zk1);
+    *res = x;
+}
+
+/* if n is a perfect k'th power for some prime k, sets *root and returns k,
+ * otherwise returns 0.  n must have no factors below 2^16. */
+static long
+zperfect_power(ZVALUE n, ZVALUE * root)
+{
+    const uint32_t *small_primes;
+    ZVALUE r, zk, pw;
+    long small_count, i, k, bits;
+    BOOL exact;
+
+    bits = zhighbit(n) + 1;
+    small_primes = small_prime_table(&small_count);
+    for (i = 0; i < small_count && small_primes[i] * 16 <= bits; i++) {
+        k = small_primes[i];
+        ziroot(n, k, &r);
+        itoz(k, &zk);
+        zpowi(r, zk, &pw);
+        exact = (zcmp(pw, n) == 0);
+        zfree(zk);
+        zfree(pw);
+        if (exact) {
+            *root = r;
+            return k;
+        }
+        zfree(r);
+    }
+    return 0;
+}
+
+/*
+ * Pollard rho
+ */
+
+/* y = y^2 + c mod n */
+static void
+rho_step(ZVALUE * y, long c, ZVALUE n)
+{
+    ZVALUE t1, t2;
+
+    zsquare(*y, &t1);
+    zfree(*y);
+    itoz(c, &t2);
+    zadd(t1, t2, y);
+    zfree(t1);
+    zfree(t2);
+    zmod(*y, n, &t1, 0);
+    zfree(*y);
+    *y = t1;
+}
+
+/* q = q * (x - y) mod n */
+static void
+rho_accumulate(ZVALUE * q, ZVALUE x, ZVALUE y, ZVALUE n)
+{
+    ZVALUE t1, t2;
+
+    zsub(x, y, &t1);
+    zmul(*q, t1, &t2);
+    zfree(t1);
+    zfree(*q);
+    zmod(t2, n, q, 0);
+    zfree(t2);
+}
+
+/* Pollard rho with Brent's cycle finding and the differences multiplied
+ * together in batches of 128, using x^2 + c.  returns TRUE and sets *res to a
+ * proper factor of n if one turns up within about limit iterations (no limit
+ * if limit is 0). */
+static BOOL
+rho(FACTORIZE * fz, ZVALUE n, long c, long limit, ZVALUE * res)
+{
+    ZVALUE x, y, ys, q, g;
+    long r, k, i, steps, m = 128;
+    BOOL found = FALSE, done = FALSE;
+
+    itoz(2L, &y);
+    itoz(1L, &q);
+    itoz(1L, &g);
+    zcopy(y, &ys);
+    zcopy(y, &x);
+    for (r = 1, steps = 0; !done && (limit == 0 || steps < limit); r *= 2) {
+        zfree(x);
+        zcopy(y, &x);
+        for (i = 0; i < r; i++) {
+            rho_step(&y, c, n);
+        }
+        for (k = 0; k < r && !done; k += m) {
+            zfree(ys);
+            zcopy(y, &ys);
+            for (i = 0; i < m && i < r - k; i++) {
+                rho_step(&y, c, n);
+                rho_accumulate(&q, x, y, n);
+            }
+            steps += i;
+            zfree(g);
+            zgcd(q, n, &g);
+            if (!zisone(g)) {
+                done = TRUE;
+            }
+            else if ((steps & 0xffff) < m && out_of_time(fz)) {
+                break;
+            }
+        }
+        if (fz->expired) {
+            break;
+        }
+    }
+    if (done && zcmp(g, n) == 0) {
+        /* the batch overshot; go back one step at a time */
+        do {
+            rho_step(&ys, c, n);
+            zfree(q);
+            zsub(x, ys, &q);
+            zfree(g);
+            zgcd(q, n, &g);
+        } while (zisone(g));
+    }
+    if (done && zcmp(g, n) != 0) {
+        found = TRUE;
+        *res = g;
+    }
+    else {
+        zfree(g);
+    }
+    zfree(x);
+    zfree(y);
+    zfree(ys);
+    zfree(q);
+    return found;
+}
+
+/*
+ * elliptic curve method, with Montgomery curves B y^2 = x^3 + A x^2 + x in
+ * (X:Z) coordinates.  Curves are chosen with Suyama's parametrization, which
+ * gives group orders divisible by 12.
+ */
+
+typedef struct ecmjob ECMJOB;
+
+typedef struct {
+    HALF *x;                    /* starting point, Montgomery form */
+    HALF *z;
+    HALF *a24;                  /* (A + 2) / 4, Montgomery form */
+    HALF *g1;                   /* Z after stage 1 */
+    HALF *g2;                   /* Z times the stage 2 differences */
+} ECMCURVE;
+
+typedef struct {
+    ECMJOB *job;
+    long first;                 /* curves [first, last) */
+    long last;
+    HALF *scratch;
+} ECMPIECE;
+
+struct ecmjob {
+    HALF *n;
+    LEN len;
+    HALF ninv;
+    uint32_t b1;
+    uint32_t b2;
+    uint32_t *primes;           /* primes up to b2 */
+    long nprimes;
+    ECMCURVE *curves;
+    long ncurves;
+    ECMPIECE *pieces;
+    void **args;
+    int npieces;
+    volatile int cancel;
+};
+
+/* modular arithmetic for one thread */
+typedef struct {
+    const HALF *n;
+    LEN len;
+    HALF ninv;
+    const HALF *a24;
+    HALF *t;                    /* len + 2 HALFs, for mont_mul */
+    HALF *u;                    /* len HALFs each */
+    HALF *v;
+    HALF *w;
+} ECMARITH;
+
+#define ECM_SCRATCH(len) ((ECM_WINDOW + 20) * (len) + 2)
+
+static void
+emul(ECMARITH * e, const HALF * a, const HALF * b, HALF * r)
+{
+    mont_mul(a, b, e->n, e->len, e->ninv, e->t, r);
+}
+
+/* (rx:rz) = 2 (x:z) */
+static void
+ecm_double(ECMARITH * e, const HALF * x, const HALF * z, HALF * rx, HALF * rz)
+{
+    mod_add(x, z, e->n, e->len, e->u);
+    emul(e, e->u, e->u, e->u);
+    mod_sub(x, z, e->n, e->len, e->v);
+    emul(e, e->v, e->v, e->v);
+    emul(e, e->u, e->v, rx);
+    mod_sub(e->u, e->v, e->n, e->len, e->w);
+    emul(e, e->a24, e->w, e->u);
+    mod_add(e->u, e->v, e->n, e->len, e->u);
+    emul(e, e->w, e->u, rz);
+}
+
+/* (rx:rz) = P + Q, given P - Q = (xd:zd).  the result may overwrite P or Q
+ * but not P - Q. */
+static void
+ecm_add(ECMARITH * e, const HALF * xp, const HALF * zp, const HALF * xq, const HALF * zq,
+        const HALF * xd, const HALF * zd, HALF * rx, HALF * rz)
+{
+    mod_sub(xp, zp, e->n, e->len, e->u);
+    mod_add(xq, zq, e->n, e->len, e->v);
+    emul(e, e->u, e->v, e->u);
+    mod_add(xp, zp, e->n, e->len, e->w);
+    mod_sub(xq, zq, e->n, e->len, e->v);
+    emul(e, e->w, e->v, e->v);
+    mod_add(e->u, e->v, e->n, e->len, e->w);
+    emul(e, e->w, e->w, e->w);
+    mod_sub(e->u, e->v, e->n, e->len, e->u);
+    emul(e, e->u, e->u, e->u);
+    emul(e, zd, e->w, rx);
+    emul(e, xd, e->u, rz);
+}
+
+/* (x:z) = k (x:z) with Montgomery's ladder.  s is scratch of 4 len HALFs. */
+static void
+ecm_ladder(ECMARITH * e, uint64_t k, HALF * x, HALF * z, HALF * s)
+{
+    LEN len = e->len;
+    HALF *x0 = s, *z0 = s + len, *x1 = s + 2 * len, *z1 = s + 3 * len;
+    int bit;
+
+    if (k <= 1) {
+        return;
+    }
+    memcpy(x0, x, len * sizeof(HALF));
+    memcpy(z0, z, len * sizeof(HALF));
+    ecm_double(e, x, z, x1, z1);
+    for (bit = 63; !((k >> bit) & 1); bit--);
+    for (bit--; bit >= 0; bit--) {
+        if ((k >> bit) & 1) {
+            ecm_add(e, x1, z1, x0, z0, x, z, x0, z0);
+            ecm_double(e, x1, z1, x1, z1);
+        }
+        else {
+            ecm_add(e, x0, z0, x1, z1, x, z, x1, z1);
+            ecm_double(e, x0, z0, x0, z0);
+        }
+    }
+    memcpy(x, x0, len * sizeof(HALF));
+    memcpy(z, z0, len * sizeof(HALF));
+}
+
+/* runs stages 1 and 2 on one curve */
+static void
+ecm_curve(ECMJOB * job, ECMCURVE * c, HALF * scratch)
+{
+    ECMARITH arith, *e = &arith;
+    LEN len = job->len;
+    HALF *x, *z, *lad, *xs, *zs, *xm, *zm, *xp, *zp, *xn, *zn, *acc, *ud;
+    uint64_t k, q, p;
+    long i, kcur, kq, delta, half = ECM_WINDOW / 2;
+    char used[ECM_WINDOW / 2];
+
+    e->n = job->n;
+    e->len = len;
+    e->ninv = job->ninv;
+    e->a24 = c->a24;
+    e->t = scratch;
+    e->u = e->t + len + 2;
+    e->v = e->u + len;
+    e->w = e->v + len;
+    x = e->w + len;
+    z = x + len;
+    lad = z + len;
+    xs = lad + 4 * len;
+    zs = xs + len;
+    xm = zs + len;
+    zm = xm + len;
+    xp = zm + len;
+    zp = xp + len;
+    xn = zp + len;
+    zn = xn + len;
+    acc = zn + len;
+    ud = acc + len;             /* ECM_WINDOW * len HALFs, (2i + 1) P for i < half */
+
+    /* stage 1: multiply by every prime power up to b1, several at a time */
+    memcpy(x, c->x, len * sizeof(HALF));
+    memcpy(z, c->z, len * sizeof(HALF));
+    k = 1;
+    for (i = 0; i < job->nprimes && job->primes[i] <= job->b1; i++) {
+        p = job->primes[i];
+        for (q = p; q <= job->b1 / p; q *= p);
+        if (k > UINT64_MAX / q) {
+            ecm_ladder(e, k, x, z, lad);
+            k = 1;
+            if (job->cancel) {
+                return;
+            }
+        }
+        k *= q;
+    }
+    ecm_ladder(e, k, x, z, lad);
+    memcpy(c->g1, z, len * sizeof(HALF));
+
+    /* stage 2: for each prime q in (b1, b2], with m the nearest multiple of
+     * s = 2 * ECM_WINDOW and q = m +- d, m P = +-d P if the order of P mod a
+     * prime factor divides q.  m P and d P have the same x coordinate then,
+     * so the factor divides xm zd - xd zm. */
+    memcpy(ud, x, len * sizeof(HALF));
+    memcpy(ud + len, z, len * sizeof(HALF));
+    ecm_double(e, x, z, xs, zs);
+    ecm_add(e, xs, zs, x, z, x, z, ud + 2 * len, ud + 3 * len);
+    for (i = 2; i < half; i++) {
+        ecm_add(e, ud + 2 * (i - 1) * len, ud + (2 * i - 1) * len, xs, zs,
+                ud + 2 * (i - 2) * len, ud + (2 * i - 3) * len, ud + 2 * i * len,
+                ud + (2 * i + 1) * len);
+    }
+    for (i = 0; i < job->nprimes && job->primes[i] <= job->b1; i++);
+    memcpy(acc, z, len * sizeof(HALF));
+    kcur = (job->b1 + ECM_WINDOW) / (2 * ECM_WINDOW);
+    if (kcur < 2) {
+        kcur = 2;
+    }
+    memcpy(xp, x, len * sizeof(HALF));
+    memcpy(zp, z, len * sizeof(HALF));
+    ecm_ladder(e, (uint64_t) (kcur - 1) * 2 * ECM_WINDOW, xp, zp, lad);
+    memcpy(xm, x, len * sizeof(HALF));
+    memcpy(zm, z, len * sizeof(HALF));
+    ecm_ladder(e, (uint64_t) kcur * 2 * ECM_WINDOW, xm, zm, lad);
+    memcpy(xs, x, len * sizeof(HALF));
+    memcpy(zs, z, len * sizeof(HALF));
+    ecm_ladder(e, 2 * ECM_WINDOW, xs, zs, lad);
+    memset(used, 0, sizeof(used));
+    for (; i < job->nprimes; i++) {
+        q = job->primes[i];
+        kq = (long) ((q + ECM_WINDOW) / (2 * ECM_WINDOW));
+        if (kq < kcur) {
+            continue;
+        }
+        while (kcur < kq) {
+            ecm_add(e, xm, zm, xs, zs, xp, zp, xn, zn);
+            memcpy(xp, xm, len * sizeof(HALF));
+            memcpy(zp, zm, len * sizeof(HALF));
+            memcpy(xm, xn, len * sizeof(HALF));
+            memcpy(zm, zn, len * sizeof(HALF));
+            kcur++;
+            memset(used, 0, sizeof(used));
+        }
+        delta = (long) q - kq * 2 * ECM_WINDOW;
+        if (delta < 0) {
+            delta = -delta;
+        }
+        if (used[delta / 2]) {
+            continue;
+        }
+        used[delta / 2] = 1;
+        emul(e, xm, ud + (delta - 1) * len + len, e->u);
+        emul(e, ud + (delta - 1) * len, zm, e->v);
+        mod_sub(e->u, e->v, e->n, len, e->u);
+        emul(e, acc, e->u, acc);
+        if ((i & 1023) == 0 && job->cancel) {
+            return;
+        }
+    }
+    memcpy(c->g2, acc, len * sizeof(HALF));
+}
+
+static void *
+ecm_piece(void *arg)
+{
+    ECMPIECE *pp = (ECMPIECE *) arg;
+    long i;
+
+    for (i = pp->first; i < pp->last && !pp->job->cancel; i++) {
+        ecm_curve(pp->job, &pp->job->curves[i], pp->scratch);
+    }
+    return NULL;
+}
+
+static void *
+ecm_run(void *arg)
+{
+    ECMJOB *job = (ECMJOB *) arg;
+
+    parallel_run(ecm_piece, job->args, job->npieces);
+    return NULL;
+}
+
+/* runs the curves in job without the GVL, for rb_protect() */
+static VALUE
+ecm_run_protected(VALUE arg)
+{
+    ECMJOB *job = (ECMJOB *) arg;
+
+    call_without_gvl(ecm_run, job, &job->cancel);
+    return Qnil;
+}
+
+/* sets up the curve with parameter sigma.  returns 0 if all is well, 1 and
+ * sets *res if a factor of n turned up, or -1 if the curve is degenerate. */
+static int
+ecm_setup(ZVALUE n, long sigma, ECMCURVE * c, ZVALUE * res)
+{
+    ZVALUE u, v, x, z, t1, t2, t3, num, den, g;
+    NUMBER *qden, *qn, *qinv;
+    int result = 0;
+
+    /* u = sigma^2 - 5, v = 4 sigma, x = u^3, z = v^3 */
+    itoz(sigma, &t1);
+    zsquare(t1, &t2);
+    zfree(t1);
+    itoz(5L, &t3);
+    zsub(t2, t3, &t1);
+    zfree(t2);
+    zfree(t3);
+    zmod(t1, n, &u, 0);
+    zfree(t1);
+    itoz(4 * sigma, &t1);
+    zmod(t1, n, &v, 0);
+    zfree(t1);
+    zsquare(u, &t1);
+    zmul(t1, u, &t2);
+    zfree(t1);
+    zmod(t2, n, &x, 0);
+    zfree(t2);
+    zsquare(v, &t1);
+    zmul(t1, v, &t2);
+    zfree(t1);
+    zmod(t2, n, &z, 0);
+    zfree(t2);
+
+    /* (A + 2) / 4 = (v - u)^3 (3 u + v) / (16 u^3 v) */
+    zsub(v, u, &t1);
+    zsquare(t1, &t2);
+    zmul(t2, t1, &t3);
+    zfree(t1);
+    zfree(t2);
+    zmuli(u, 3L, &t1);
+    zadd(t1, v, &t2);
+    zfree(t1);
+    zmul(t3, t2, &t1);
+    zfree(t2);
+    zfree(t3);
+    zmod(t1, n, &num, 0);
+    zfree(t1);
+    zmul(x, v, &t1);
+    zshift(t1, 4L, &t2);
+    zfree(t1);
+    zmod(t2, n, &den, 0);
+    zfree(t2);
+
+    zgcd(den, n, &g);
+    if (!zisone(g)) {
+        if (zcmp(g, n) != 0 && !ziszero(den)) {
+            *res = g;
+            result = 1;
+        }
+        else {
+            zfree(g);
+            result = -1;
+        }
+    }
+    else {
+        zfree(g);
+        qden = qalloc();
+        qden->num = den;
+        qn = qalloc();
+        zcopy(n, &qn->num);
+        qinv = qminv(qden, qn);
+        zmul(num, qinv->num, &t1);
+        zmod(t1, n, &t2, 0);
+        zfree(t1);
+        qfree(qinv);
+        qfree(qn);
+        qfree(qden);
+        to_mont(x, n, c->x);
+        to_mont(z, n, c->z);
+        to_mont(t2, n, c->a24);
+        zfree(t2);
+    }
+    if (result != 0) {
+        zfree(den);
+    }
+    zfree(num);
+    zfree(u);
+    zfree(v);
+    zfree(x);
+    zfree(z);
+    return result;
+}
+
+/* sets *res to the gcd of a (len HALFs) and n, returning TRUE if it is a
+ * proper factor */
+static BOOL
+ecm_gcd(HALF * a, ZVALUE n, ZVALUE * res)
+{
+    ZVALUE g;
+
+    zgcd(limb_view(a, n.len), n, &g);
+    if (zisone(g) || zcmp(g, n) == 0) {
+        zfree(g);
+        return FALSE;
+    }
+    *res = g;
+    return TRUE;
+}
+
+/* runs up to ncurves curves with stage 1 limit b1 and stage 2 limit
+ * ECM_B2_MULT b1 (at most ECM_MAX_B2), returning TRUE and setting *res if a
+ * proper factor of n is found */
+static BOOL
+ecm(FACTORIZE * fz, ZVALUE n, uint32_t b1, long ncurves, ZVALUE * res)
+{
+    ECMJOB job;
+    HALF *curve_mem;
+    LEN len = n.len;
+    uint64_t b2;
+    long i, done, per, round;
+    int r;
+    BOOL found = FALSE;
+
+    job.n = n.v;
+    job.len = len;
+    job.ninv = mont_ninv(n.v);
+    job.b1 = b1;
+    b2 = (uint64_t) b1 * ECM_B2_MULT;
+    job.b2 = b2 < ECM_MAX_B2 ? (uint32_t) b2 : ECM_MAX_B2;
+    if (job.b2 < b1) {
+        job.b2 = b1;
+    }
+    job.primes = prime_sieve(job.b2, &job.nprimes);
+    job.npieces = calc_threads > 0 ? (int) calc_threads : 1;
+    job.pieces = ALLOC_N(ECMPIECE, job.npieces);
+    job.args = ALLOC_N(void *, job.npieces);
+    for (i = 0; i < job.npieces; i++) {
+        job.pieces[i].job = &job;
+        job.pieces[i].scratch = ALLOC_N(HALF, ECM_SCRATCH(len));
+        job.args[i] = &job.pieces[i];
+    }
+
+    /* each round runs a couple of curves per thread */
+    round = 2 * job.npieces;
+    job.curves = ALLOC_N(ECMCURVE, round);
+    curve_mem = ALLOC_N(HALF, 5 * len * round);
+    for (i = 0; i < round; i++) {
+        job.curves[i].x = curve_mem + 5 * len * i;
+        job.curves[i].z = job.curves[i].x + len;
+        job.curves[i].a24 = job.curves[i].z + len;
+        job.curves[i].g1 = job.curves[i].a24 + len;
+        job.curves[i].g2 = job.curves[i].g1 + len;
+    }
+
+    for (done = 0; !found && done < ncurves && !out_of_time(fz); done += round) {
+        job.ncurves = 0;
+        while (job.ncurves < round && !found) {
+            r = ecm_setup(n, 6 + (long) (rb_genrand_int32() >> 2), &job.curves[job.ncurves],
+                          res);
+            if (r == 1) {
+                found = TRUE;
+            }
+            else if (r == 0) {
+                job.ncurves++;
+            }
+        }
+        if (found) {
+            break;
+        }
+        per = (job.ncurves + job.npieces - 1) / job.npieces;
+        for (i = 0; i < job.npieces; i++) {
+            job.pieces[i].first = i * per < job.ncurves ? i * per : job.ncurves;
+            job.pieces[i].last = (i + 1) * per < job.ncurves ? (i + 1) * per : job.ncurves;
+        }
+        rb_protect(ecm_run_protected, (VALUE) & job, &fz->state);
+        if (fz->state) {
+            /* interrupted; the curves weren't finished */
+            fz->expired = TRUE;
+            break;
+        }
+        for (i = 0; i < job.ncurves && !found; i++) {
+            found = ecm_gcd(job.curves[i].g2, n, res) || ecm_gcd(job.curves[i].g1, n, res);
+        }
+    }
+
+    for (i = 0; i < job.npieces; i++) {
+        xfree(job.pieces[i].scratch);
+    }
+    xfree(job.pieces);
+    xfree(job.args);
+    xfree(job.curves);
+    xfree(curve_mem);
+    xfree(job.primes);
+    return found;
+}
+
+/*
+ * self initializing quadratic sieve.
+ *
+ * With a multiplier k chosen by the Knuth-Schroeppel function, polynomials
+ * g(x) = ((A x + B)^2 - k n) / A are sieved over -M <= x < M by the factor
+ * base of primes p with (k n / p) != -1.  A is a product of factor base
+ * primes, so each A gives 2^(s-1) values of B, switched cheaply in Gray code
+ * order.  Values with a cofactor below a large prime bound are kept, and
+ * pairs with the same large prime are combined.  Once there are more
+ * relations than primes, Gaussian elimination over GF(2) finds sets whose
+ * product is a square, and each gives a chance of gcd(X - Y, n) being a
+ * proper factor.
+ */
+
+typedef struct {
+    int digits;
+    long nfb;                   /* factor base size */
+    long m;                     /* half width of the sieve interval */
+    long lpmult;                /* large prime bound is this times the largest prime */
+} SIQSPARAMS;
+
+static const SIQSPARAMS siqs_params[] = {
+    {20, 100, 4096, 20},
+    {25, 150, 8192, 30},
+    {30, 250, 8192, 40},
+    {35, 400, 16384, 50},
+    {40, 600, 16384, 60},
+    {45, 1000, 32768, 70},
+    {50, 1500, 32768, 80},
+    {55, 2200, 32768, 90},
+    {60, 3000, 49152, 100},
+    {65, 4000, 49152, 110},
+    {70, 5500, 65536, 120},
+    {75, 7000, 81920, 120},
+    {80, 9000, 98304, 128},
+    {85, 11000, 114688, 128},
+    {90, 13500, 131072, 128},
+    {95, 16500, 147456, 128},
+    {100, 20000, 163840, 128}
+};
+
+typedef struct {
+    ZVALUE x;                   /* A x + B */
+    uint32_t *f;                /* factor base indexes of A g(x)'s factors, with repeats */
+    long nf;
+    uint32_t large;             /* large prime, or 1 */
+} RELATION;
+
+/* a row of the matrix is one full relation, or two partial relations with
+ * the same large prime.  rel[1] is -1 for a full relation. */
+typedef struct {
+    long rel[2];
+} SIQSROW;
+
+typedef struct {
+    ZVALUE n;
+    ZVALUE kn;
+    long k;
+    long m;
+    uint32_t large_bound;
+
+    /* factor base: index 0 is -1 and index 1 is 2 */
+    uint32_t *fb;
+    uint32_t *sqrtkn;           /* sqrt(k n) mod p */
+    unsigned char *logp;
+    long nfb;
+    long first_sieved;          /* smaller primes aren't sieved */
+
+    /* current polynomial */
+    ZVALUE a;
+    ZVALUE b;
+    ZVALUE *bj;                 /* B = sum of +-bj */
+    int *bsign;
+    long *aidx;                 /* factor base indexes of the factors of A */
+    long s;
+    char *ina;                  /* flags factor base primes dividing A */
+    uint32_t *root1;            /* sieve offsets of the roots mod p */
+    uint32_t *root2;
+    uint32_t *next1;            /* sieve positions, while sieving by blocks */
+    uint32_t *next2;
+    uint32_t *bainv;            /* 2 bj / A mod p, s rows of nfb */
+    uint64_t *used_a;           /* signatures of the A values used so far */
+    long nused_a;
+    long size_used_a;
+    unsigned char *sieve;
+    unsigned char sieve_init;   /* 128 - threshold, so candidates get the top bit set */
+
+    /* relations: full ones, and partial ones with a large prime */
+    RELATION *rels;
+    long nrels;
+    long size_rels;
+    SIQSROW *rows;
+    long nrows;
+    long size_rows;
+    uint32_t *lp_keys;          /* hash table of large primes -> first partial */
+    long *lp_vals;
+    long lp_size;
+    long lp_count;
+} SIQS;
+
+/* chooses the multiplier k with the Knuth-Schroeppel function */
+static long
+siqs_multiplier(ZVALUE n)
+{
+    static const long ks[] = { 1, 3, 5, 7, 11, 13, 15, 17, 19, 21, 23, 29, 31, 33, 35, 37,
+        39, 41, 43, 47
+    };
+    const uint32_t *small_primes;
+    long small_count, i, j, nmod8, best = 1, kn8;
+    uint64_t p, knp;
+    double score, best_score = -1e30;
+
+    small_primes = small_prime_table(&small_count);
+    nmod8 = zmodi(n, 8L);
+    for (i = 0; i < (long) (sizeof(ks) / sizeof(ks[0])); i++) {
+        score = -0.5 * log((double) ks[i]);
+        kn8 = (nmod8 * ks[i]) % 8;
+        if (kn8 == 1) {
+            score += 2 * M_LN2;
+        }
+        else if (kn8 == 5) {
+            score += M_LN2;
+        }
+        else {
+            score += 0.5 * M_LN2;
+        }
+        for (j = 1; j < small_count; j++) {
+            p = small_primes[j];
+            if (ks[i] % p == 0) {
+                score += log((double) p) / p;
+            }
+            else {
+                knp = (uint64_t) zmodi(n, (long) p) * ks[i] % p;
+                if (powmod32(knp, (p - 1) / 2, p) == 1) {
+                    score += 2 * log((double) p) / (p - 1);
+                }
+            }
+        }
+        if (score > best_score) {
+            best_score = score;
+            best = ks[i];
+        }
+    }
+    return best;
+}
+
+/* builds the factor base.  returns TRUE and sets *res if a prime in it
+ * divides n. */
+static BOOL
+siqs_factor_base(SIQS * s, long nfb, ZVALUE * res)
+{
+    uint32_t *primes;
+    long limit, nprimes, i;
+    uint32_t p, r;
+
+    s->fb = ALLOC_N(uint32_t, nfb);
+    s->sqrtkn = ALLOC_N(uint32_t, nfb);
+    s->logp = ALLOC_N(unsigned char, nfb);
+    s->fb[0] = 1;
+    s->sqrtkn[0] = 0;
+    s->fb[1] = 2;
+    s->sqrtkn[1] = 1;
+    s->nfb = 2;
+    limit = (long) (3 * nfb * log(2.0 * nfb + 10)) + 1000;
+    for (;;) {
+        primes = prime_sieve(limit, &nprimes);
+        for (i = 1; i < nprimes && s->nfb < nfb; i++) {
+            p = primes[i];
+            r = (uint32_t) zmodi(s->kn, p);
+            if (r == 0) {
+                if (s->k % p != 0) {
+                    xfree(primes);
+                    utoz((FULL) p, res);
+                    return TRUE;
+                }
+            }
+            else if (powmod32(r, (p - 1) / 2, p) != 1) {
+                continue;
+            }
+            s->fb[s->nfb] = p;
+            s->sqrtkn[s->nfb] = sqrtmod32(r, p);
+            s->nfb++;
+        }
+        xfree(primes);
+        if (s->nfb == nfb) {
+            break;
+        }
+        limit *= 2;
+    }
+    for (s->first_sieved = 2; s->first_sieved < nfb - 1 && s->fb[s->first_sieved] < 30;
+         s->first_sieved++);
+    return FALSE;
+}
+
+static uint64_t
+xorshift64(uint64_t * state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/* index of the factor base prime closest to 2^bits, in [lo, hi] */
+static long
+siqs_nearest(SIQS * s, double bits, long lo, long hi)
+{
+    double target = pow(2.0, bits);
+    long first = lo, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (s->fb[mid] < target) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    if (lo > first && target - s->fb[lo - 1] < s->fb[lo] - target) {
+        lo--;
+    }
+    return lo;
+}
+
+/* chooses a new A close to sqrt(2 k n) / M, made of s factor base primes,
+ * and computes the first B and the roots.  returns FALSE if no unused A can
+ * be found. */
+static BOOL
+siqs_new_a(SIQS * s, uint64_t * rng)
+{
+    ZVALUE t1, t2, aj;
+    double target, prefer, bits, remaining;
+    long lo, hi, mid, span, i, j, tries, idx;
+    uint64_t sig;
+    uint32_t p, gamma, amodp, bmodp, ainv, t, mmodp;
+    BOOL ok;
+
+    target = (zhighbit(s->kn) + 2) / 2.0 - log((double) s->m) / M_LN2;
+    lo = s->first_sieved + 1;
+    hi = s->nfb - 1;
+
+    /* prefer primes of about 2000, or smaller for small factor bases */
+    prefer = log(s->fb[s->nfb / 2] < 2000 ? (double) s->fb[s->nfb / 2] : 2000.0) / M_LN2;
+    s->s = (long) (target / prefer + 0.5);
+    if (s->s < 2) {
+        s->s = 2;
+    }
+    if (s->s > SIQS_MAX_A) {
+        s->s = SIQS_MAX_A;
+    }
+    bits = target / s->s;
+    mid = siqs_nearest(s, bits, lo, hi);
+    span = s->nfb / 8 > 8 ? s->nfb / 8 : 8;
+
+    for (tries = 0; tries < 1000; tries++) {
+        ok = TRUE;
+        remaining = target;
+        for (i = 0; i < s->s - 1 && ok; i++) {
+            do {
+                idx = mid - span + (long) (xorshift64(rng) % (uint64_t) (2 * span + 1));
+                if (idx < lo) {
+                    idx = lo;
+                }
+                if (idx > hi) {
+                    idx = hi;
+                }
+                for (j = 0; j < i && s->aidx[j] != idx; j++);
+            } while (j < i);
+            s->aidx[i] = idx;
+            remaining -= log((double) s->fb[idx]) / M_LN2;
+        }
+        idx = siqs_nearest(s, remaining, lo, hi);
+        for (j = 0; j < i && s->aidx[j] != idx; j++);
+        if (j < i || s->sqrtkn[idx] == 0) {
+            continue;
+        }
+        s->aidx[i] = idx;
+        for (j = 0; j < s->s; j++) {
+            if (s->sqrtkn[s->aidx[j]] == 0) {
+                ok = FALSE;
+            }
+        }
+        if (!ok) {
+            continue;
+        }
+
+        /* the signature doesn't depend on the order of the primes */
+        sig = 0;
+        for (j = 0; j < s->s; j++) {
+            sig += ((uint64_t) s->aidx[j] * 0x9e3779b97f4a7c15ULL) ^ (uint64_t) s->aidx[j];
+        }
+        for (j = 0; j < s->nused_a && s->used_a[j] != sig; j++);
+        if (j < s->nused_a) {
+            continue;
+        }
+        if (s->nused_a == s->size_used_a) {
+            s->size_used_a *= 2;
+            REALLOC_N(s->used_a, uint64_t, s->size_used_a);
+        }
+        s->used_a[s->nused_a++] = sig;
+        break;
+    }
+    if (tries == 1000) {
+        return FALSE;
+    }
+
+    /* A, then bj = (A / q) ((sqrt(kn) / (A / q)) mod q), with the smaller
+     * choice of sign, for each prime q of A */
+    zfree(s->a);
+    itoz(1L, &s->a);
+    memset(s->ina, 0, s->nfb);
+    for (j = 0; j < s->s; j++) {
+        zmuli(s->a, (long) s->fb[s->aidx[j]], &t1);
+        zfree(s->a);
+        s->a = t1;
+        s->ina[s->aidx[j]] = 1;
+    }
+    zfree(s->b);
+    itoz(0L, &s->b);
+    for (j = 0; j < s->s; j++) {
+        p = s->fb[s->aidx[j]];
+        zdivi(s->a, (long) p, &aj);
+        gamma = (uint32_t) ((uint64_t) s->sqrtkn[s->aidx[j]] * invmod32(zmodi(aj, p), p) % p);
+        if (gamma > p / 2) {
+            gamma = p - gamma;
+        }
+        zfree(s->bj[j]);
+        zmuli(aj, (long) gamma, &s->bj[j]);
+        zfree(aj);
+        zadd(s->b, s->bj[j], &t2);
+        zfree(s->b);
+        s->b = t2;
+        s->bsign[j] = 1;
+    }
+
+    /* roots ((+-sqrt(kn) - B) / A mod p) + M, and 2 bj / A mod p */
+    for (i = 1; i < s->nfb; i++) {
+        p = s->fb[i];
+        if (s->ina[i] || i < s->first_sieved) {
+            continue;
+        }
+        amodp = (uint32_t) zmodi(s->a, p);
+        ainv = invmod32(amodp, p);
+        bmodp = (uint32_t) zmodi(s->b, p);
+        mmodp = (uint32_t) (s->m % p);
+        t = (uint32_t) ((uint64_t) ainv * ((s->sqrtkn[i] + p - bmodp) % p) % p);
+        s->root1[i] = (t + mmodp) % p;
+        t = (uint32_t) ((uint64_t) ainv * ((2 * (uint64_t) p - s->sqrtkn[i] - bmodp) % p) % p);
+        s->root2[i] = (t + mmodp) % p;
+        for (j = 0; j < s->s; j++) {
+            s->bainv[j * s->nfb + i] =
+                (uint32_t) (2 * (uint64_t) zmodi(s->bj[j], p) * ainv % p);
+        }
+    }
+    return TRUE;
+}
+
+/* switches to the next B for the current A: polynomial number idx, for
+ * 1 <= idx < 2^(s-1), flips the sign of bj where j is the lowest set bit of idx */
+static void
+siqs_next_b(SIQS * s, long idx)
+{
+    ZVALUE t1, t2;
+    long i, j;
+    uint32_t p, d, *row;
+
+    for (j = 0; !((idx >> j) & 1); j++);
+    zshift(s->bj[j], 1L, &t1);
+    if (s->bsign[j] > 0) {
+        zsub(s->b, t1, &t2);
+    }
+    else {
+        zadd(s->b, t1, &t2);
+    }
+    zfree(t1);
+    zfree(s->b);
+    s->b = t2;
+    row = s->bainv + j * s->nfb;
+    for (i = s->first_sieved; i < s->nfb; i++) {
+        if (s->ina[i]) {
+            continue;
+        }
+        p = s->fb[i];
+        d = s->bsign[j] > 0 ? row[i] : p - row[i];
+        s->root1[i] += d;
+        if (s->root1[i] >= p) {
+            s->root1[i] -= p;
+        }
+        s->root2[i] += d;
+        if (s->root2[i] >= p) {
+            s->root2[i] -= p;
+        }
+    }
+    s->bsign[j] = -s->bsign[j];
+}
+
+/* adds log p at the roots of g(x) mod p.  primes below SIQS_BLOCK are
+ * sieved a block at a time, so the block stays in the cache. */
+static void
+siqs_sieve(SIQS * s)
+{
+    unsigned char *sieve = s->sieve, lp;
+    long i, start, end, len = 2 * s->m, small_end;
+    uint32_t p, pos;
+
+    memset(sieve, s->sieve_init, len);
+    for (small_end = s->first_sieved; small_end < s->nfb && s->fb[small_end] < SIQS_BLOCK;
+         small_end++) {
+        s->next1[small_end] = s->root1[small_end];
+        s->next2[small_end] = s->root2[small_end];
+    }
+    for (start = 0; start < len; start = end) {
+        end = start + SIQS_BLOCK < len ? start + SIQS_BLOCK : len;
+        for (i = s->first_sieved; i < small_end; i++) {
+            if (s->ina[i]) {
+                continue;
+            }
+            p = s->fb[i];
+            lp = s->logp[i];
+            for (pos = s->next1[i]; pos < end; pos += p) {
+                sieve[pos] += lp;
+            }
+            s->next1[i] = pos;
+            if (s->root2[i] != s->root1[i]) {
+                for (pos = s->next2[i]; pos < end; pos += p) {
+                    sieve[pos] += lp;
+                }
+                s->next2[i] = pos;
+            }
+        }
+    }
+    for (i = small_end; i < s->nfb; i++) {
+        if (s->ina[i]) {
+            continue;
+        }
+        p = s->fb[i];
+        lp = s->logp[i];
+        for (pos = s->root1[i]; pos < len; pos += p) {
+            sieve[pos] += lp;
+        }
+        if (s->root2[i] != s->root1[i]) {
+            for (pos = s->root2[i]; pos < len; pos += p) {
+                sieve[pos] += lp;
+            }
+        }
+    }
+}
+
+/* returns the position of the large prime in the hash table */
+static long
+siqs_lp_slot(SIQS * s, uint32_t large)
+{
+    long h = (long) ((large * 0x9e3779b1U) & (s->lp_size - 1));
+
+    while (s->lp_keys[h] && s->lp_keys[h] != large) {
+        h = (h + 1) & (s->lp_size - 1);
+    }
+    return h;
+}
+
+static void
+siqs_add_row(SIQS * s, long r1, long r2)
+{
+    if (s->nrows == s->size_rows) {
+        s->size_rows *= 2;
+        REALLOC_N(s->rows, SIQSROW, s->size_rows);
+    }
+    s->rows[s->nrows].rel[0] = r1;
+    s->rows[s->nrows].rel[1] = r2;
+    s->nrows++;
+}
+
+/* stores a relation, combining partials with the same large prime */
+static void
+siqs_add_relation(SIQS * s, ZVALUE x, uint32_t * f, long nf, uint32_t large)
+{
+    long slot, i, old_size;
+    uint32_t *old_keys;
+    long *old_vals;
+
+    if (s->nrels == s->size_rels) {
+        s->size_rels *= 2;
+        REALLOC_N(s->rels, RELATION, s->size_rels);
+    }
+    s->rels[s->nrels].x = x;
+    s->rels[s->nrels].f = ALLOC_N(uint32_t, nf);
+    memcpy(s->rels[s->nrels].f, f, nf * sizeof(uint32_t));
+    s->rels[s->nrels].nf = nf;
+    s->rels[s->nrels].large = large;
+    if (large == 1) {
+        siqs_add_row(s, s->nrels, -1);
+    }
+    else {
+        slot = siqs_lp_slot(s, large);
+        if (s->lp_keys[slot]) {
+            siqs_add_row(s, s->lp_vals[slot], s->nrels);
+        }
+        else {
+            s->lp_keys[slot] = large;
+            s->lp_vals[slot] = s->nrels;
+            if (++s->lp_count * 2 > s->lp_size) {
+                old_keys = s->lp_keys;
+                old_vals = s->lp_vals;
+                old_size = s->lp_size;
+                s->lp_size *= 2;
+                s->lp_keys = ZALLOC_N(uint32_t, s->lp_size);
+                s->lp_vals = ALLOC_N(long, s->lp_size);
+                for (i = 0; i < old_size; i++) {
+                    if (old_keys[i]) {
+                        slot = siqs_lp_slot(s, old_keys[i]);
+                        s->lp_keys[slot] = old_keys[i];
+                        s->lp_vals[slot] = old_vals[i];
+                    }
+                }
+                xfree(old_keys);
+                xfree(old_vals);
+            }
+        }
+    }
+    s->nrels++;
+}
+
+/* trial divides g(x) at sieve position pos, keeping it if it is smooth
+ * apart from at most one large prime */
+static void
+siqs_check(SIQS * s, long pos, uint32_t * f)
+{
+    ZVALUE x, g, t1, t2;
+    long nf = 0, i, e, xval = pos - s->m;
+    uint32_t p, r;
+    FULL rest;
+
+    zmuli(s->a, xval, &t1);
+    zadd(t1, s->b, &x);
+    zfree(t1);
+    zsquare(x, &t1);
+    zsub(t1, s->kn, &t2);
+    zfree(t1);
+    zequo(t2, s->a, &g);
+    zfree(t2);
+
+    for (i = 0; i < s->s; i++) {
+        f[nf++] = (uint32_t) s->aidx[i];
+    }
+    if (ziszero(g)) {
+        zfree(g);
+        zfree(x);
+        return;
+    }
+    if (zisneg(g)) {
+        f[nf++] = 0;
+        g.sign = 0;
+    }
+    e = zlowbit(g);
+    if (e > 0) {
+        zshift(g, -e, &t1);
+        zfree(g);
+        g = t1;
+        while (e-- > 0) {
+            f[nf++] = 1;
+        }
+    }
+    for (i = 2; i < s->nfb && !zisone(g); i++) {
+        p = s->fb[i];
+        if (i >= s->first_sieved && !s->ina[i]) {
+            r = (uint32_t) (pos % p);
+            if (r != s->root1[i] && r != s->root2[i]) {
+                continue;
+            }
+        }
+        else if (zmodi(g, p) != 0) {
+            continue;
+        }
+        while (zdivi(g, (long) p, &t1) == 0) {
+            zfree(g);
+            g = t1;
+            f[nf++] = (uint32_t) i;
+        }
+        zfree(t1);
+    }
+    if (zge32b(g)) {
+        zfree(g);
+        zfree(x);
+        return;
+    }
+    rest = ztou(g);
+    zfree(g);
+    if (rest == 1 || rest < s->large_bound) {
+        siqs_add_relation(s, x, f, nf, (uint32_t) rest);
+    }
+    else {
+        zfree(x);
+    }
+}
+
+/* checks the sieve positions which reached the threshold */
+static void
+siqs_scan(SIQS * s, uint32_t * f)
+{
+    uint64_t word;
+    long i, j;
+
+    for (i = 0; i < 2 * s->m; i += 8) {
+        memcpy(&word, s->sieve + i, sizeof(word));
+        if (word & 0x8080808080808080ULL) {
+            for (j = i; j < i + 8; j++) {
+                if (s->sieve[j] & 0x80) {
+                    siqs_check(s, j, f);
+                }
+            }
+        }
+    }
+}
+
+/* looks for a factor using the set of rows flagged in deps.  returns TRUE
+ * and sets *res if gcd(X - Y, n) is a proper factor. */
+static BOOL
+siqs_try_dependency(SIQS * s, const uint64_t * deps, long *exps, ZVALUE * res)
+{
+    ZVALUE x, y, t1, t2, zp, ze;
+    RELATION *rel;
+    long i, j, k;
+    BOOL found = FALSE;
+
+    memset(exps, 0, s->nfb * sizeof(long));
+    itoz(1L, &x);
+    itoz(1L, &y);
+    for (i = 0; i < s->nrows; i++) {
+        if (!((deps[i / 64] >> (i % 64)) & 1)) {
+            continue;
+        }
+        for (k = 0; k < 2 && s->rows[i].rel[k] >= 0; k++) {
+            rel = &s->rels[s->rows[i].rel[k]];
+            zmul(x, rel->x, &t1);
+            zfree(x);
+            zmod(t1, s->n, &x, 0);
+            zfree(t1);
+            for (j = 0; j < rel->nf; j++) {
+                exps[rel->f[j]]++;
+            }
+        }
+        if (s->rows[i].rel[1] >= 0) {
+            zmuli(y, (long) s->rels[s->rows[i].rel[0]].large, &t1);
+            zfree(y);
+            zmod(t1, s->n, &y, 0);
+            zfree(t1);
+        }
+    }
+    for (j = 1; j < s->nfb; j++) {
+        if (exps[j] > 0) {
+            utoz((FULL) s->fb[j], &zp);
+            itoz(exps[j] / 2, &ze);
+            zpowermod(zp, ze, s->n, &t1);
+            zfree(zp);
+            zfree(ze);
+            zmul(y, t1, &t2);
+            zfree(t1);
+            zfree(y);
+            zmod(t2, s->n, &y, 0);
+            zfree(t2);
+        }
+    }
+    zsub(x, y, &t1);
+    zgcd(t1, s->n, &t2);
+    zfree(t1);
+    if (!zisone(t2) && zcmp(t2, s->n) != 0) {
+        *res = t2;
+        found = TRUE;
+    }
+    else {
+        zfree(t2);
+    }
+    zfree(x);
+    zfree(y);
+    return found;
+}
+
+/* Gaussian elimination over GF(2) on the exponent vectors of the rows, then
+ * tries each dependency found */
+static BOOL
+siqs_solve(SIQS * s, ZVALUE * res)
+{
+    uint64_t *mat, *hist, *row, *hrow, *prow, *phrow;
+    long words = (s->nfb + 63) / 64, hwords = (s->nrows + 63) / 64;
+    long i, j, col, piv, *exps;
+    char *pivot;
+    RELATION *rel;
+    BOOL found = FALSE;
+
+    mat = ZALLOC_N(uint64_t, s->nrows * words);
+    hist = ZALLOC_N(uint64_t, s->nrows * hwords);
+    pivot = ZALLOC_N(char, s->nrows);
+    for (i = 0; i < s->nrows; i++) {
+        row = mat + i * words;
+        for (j = 0; j < 2 && s->rows[i].rel[j] >= 0; j++) {
+            rel = &s->rels[s->rows[i].rel[j]];
+            for (col = 0; col < rel->nf; col++) {
+                row[rel->f[col] / 64] ^= (uint64_t) 1 << (rel->f[col] % 64);
+            }
+        }
+        hist[i * hwords + i / 64] = (uint64_t) 1 << (i % 64);
+    }
+    for (col = 0; col < s->nfb; col++) {
+        for (piv = 0; piv < s->nrows; piv++) {
+            if (!pivot[piv] && ((mat[piv * words + col / 64] >> (col % 64)) & 1)) {
+                break;
+            }
+        }
+        if (piv == s->nrows) {
+            continue;
+        }
+        pivot[piv] = 1;
+        prow = mat + piv * words;
+        phrow = hist + piv * hwords;
+        for (i = 0; i < s->nrows; i++) {
+            row = mat + i * words;
+            if (i != piv && ((row[col / 64] >> (col % 64)) & 1)) {
+                for (j = col / 64; j < words; j++) {
+                    row[j] ^= prow[j];
+                }
+                hrow = hist + i * hwords;
+                for (j = 0; j < hwords; j++) {
+                    hrow[j] ^= phrow[j];
+                }
+            }
+        }
+    }
+    exps = ALLOC_N(long, s->nfb);
+    for (i = 0; i < s->nrows && !found; i++) {
+        if (!pivot[i]) {
+            found = siqs_try_dependency(s, hist + i * hwords, exps, res);
+        }
+    }
+    xfree(exps);
+    xfree(mat);
+    xfree(hist);
+    xfree(pivot);
+    return found;
+}
+
+static void
+siqs_free(SIQS * s)
+{
+    long i;
+
+    for (i = 0; i < s->nrels; i++) {
+        zfree(s->rels[i].x);
+        xfree(s->rels[i].f);
+    }
+    for (i = 0; i < SIQS_MAX_A; i++) {
+        zfree(s->bj[i]);
+    }
+    xfree(s->rels);
+    xfree(s->rows);
+    xfree(s->lp_keys);
+    xfree(s->lp_vals);
+    xfree(s->used_a);
+    if (s->fb) {
+        xfree(s->fb);
+        xfree(s->sqrtkn);
+        xfree(s->logp);
+    }
+    if (s->root1) {
+        xfree(s->root1);
+        xfree(s->root2);
+        xfree(s->next1);
+        xfree(s->next2);
+        xfree(s->ina);
+        xfree(s->bainv);
+        xfree(s->sieve);
+    }
+    xfree(s->bj);
+    xfree(s->bsign);
+    xfree(s->aidx);
+    zfree(s->a);
+    zfree(s->b);
+    zfree(s->kn);
+}
+
+/* returns TRUE and sets *res to a proper factor of n (odd, composite, not a
+ * perfect power and without factors below 2^16), or FALSE if the budget
+ * ran out */
+static BOOL
+siqs(FACTORIZE * fz, ZVALUE n, ZVALUE * res)
+{
+    SIQS s;
+    const SIQSPARAMS *par;
+    uint32_t *f;
+    uint64_t rng;
+    long digits, i, idx, npolys, needed;
+    double bits, scale;
+    BOOL found = FALSE;
+
+    memset(&s, 0, sizeof(s));
+    s.n = n;
+    s.k = siqs_multiplier(n);
+    zmuli(n, s.k, &s.kn);
+    itoz(0L, &s.a);
+    itoz(0L, &s.b);
+    s.bj = ALLOC_N(ZVALUE, SIQS_MAX_A);
+    for (i = 0; i < SIQS_MAX_A; i++) {
+        itoz(0L, &s.bj[i]);
+    }
+    s.bsign = ALLOC_N(int, SIQS_MAX_A);
+    s.aidx = ALLOC_N(long, SIQS_MAX_A);
+    s.size_used_a = 64;
+    s.used_a = ALLOC_N(uint64_t, s.size_used_a);
+    s.size_rels = 1024;
+    s.rels = ALLOC_N(RELATION, s.size_rels);
+    s.size_rows = 1024;
+    s.rows = ALLOC_N(SIQSROW, s.size_rows);
+    s.lp_size = 1024;
+    s.lp_keys = ZALLOC_N(uint32_t, s.lp_size);
+    s.lp_vals = ALLOC_N(long, s.lp_size);
+
+    digits = (long) ((zhighbit(s.kn) + 1) * 0.30103);
+    par = &siqs_params[0];
+    for (i = 0; i < (long) (sizeof(siqs_params) / sizeof(siqs_params[0])); i++) {
+        par = &siqs_params[i];
+        if (digits <= par->digits) {
+            break;
+        }
+    }
+    if (siqs_factor_base(&s, par->nfb, res)) {
+        siqs_free(&s);
+        return TRUE;
+    }
+    s.m = par->m;
+    s.large_bound = s.fb[s.nfb - 1] * (uint32_t) par->lpmult;
+    s.root1 = ALLOC_N(uint32_t, s.nfb);
+    s.root2 = ALLOC_N(uint32_t, s.nfb);
+    s.next1 = ALLOC_N(uint32_t, s.nfb);
+    s.next2 = ALLOC_N(uint32_t, s.nfb);
+    s.ina = ALLOC_N(char, s.nfb);
+    s.bainv = ALLOC_N(uint32_t, SIQS_MAX_A * s.nfb);
+    s.sieve = ALLOC_N(unsigned char, 2 * s.m);
+    f = ALLOC_N(uint32_t, 64 + SIQS_MAX_A + zhighbit(s.kn));
+
+    /* g(x) is at most about M sqrt(k n / 2), and typically much smaller.
+     * allow for that, the large prime and the small primes which aren't
+     * sieved.  logs are scaled down if need be, to keep the sieve values in
+     * a byte. */
+    bits = log((double) s.m) / M_LN2 + zhighbit(s.kn) / 2.0 - 0.5;
+    bits -= log((double) s.large_bound) / M_LN2 + 10;
+    scale = bits > 120 ? 120 / bits : 1;
+    s.sieve_init = (unsigned char) (128 - (bits > 20 ? bits : 20) * scale);
+    for (i = 0; i < s.nfb; i++) {
+        s.logp[i] = (unsigned char) (log((double) s.fb[i]) / M_LN2 * scale + 0.5);
+    }
+
+    rng = ((uint64_t) rb_genrand_int32() << 32) | rb_genrand_int32() | 1;
+    needed = s.nfb + SIQS_EXTRA;
+    while (!found) {
+        while (s.nrows < needed) {
+            if (out_of_time(fz) || !siqs_new_a(&s, &rng)) {
+                break;
+            }
+            npolys = 1L << (s.s - 1);
+            for (idx = 0; idx < npolys; idx++) {
+                if (idx > 0) {
+                    siqs_next_b(&s, idx);
+                }
+                siqs_sieve(&s);
+                siqs_scan(&s, f);
+            }
+        }
+        if (s.nrows < needed) {
+            break;
+        }
+        found = siqs_solve(&s, res);
+        needed = s.nrows + SIQS_EXTRA / 4;
+    }
+    xfree(f);
+    siqs_free(&s);
+    return found;
+}
+
+/*
+ * driver
+ */
+
+/* ECM levels: b1 and number of curves expected to find factors of up to
+ * 15, 20, 25, 30, 35 and 40 digits */
+static const struct {
+    uint32_t b1;
+    long curves;
+} ecm_levels[] = {
+    {2000, 25},
+    {11000, 90},
+    {50000, 300},
+    {250000, 700},
+    {1000000, 1800},
+    {3000000, 5100}
+};
+
+#define ECM_LEVELS ((long) (sizeof(ecm_levels) / sizeof(ecm_levels[0])))
+
+/* returns TRUE and sets *res to a proper factor of n, which is odd,
+ * composite, not a perfect power and has no factors below 2^16 */
+static BOOL
+find_factor(FACTORIZE * fz, ZVALUE n, ZVALUE * res)
+{
+    long digits, levels, i, c;
+    uint32_t b1;
+
+    digits = (long) ((zhighbit(n) + 1) * 0.30103) + 1;
+
+    /* rho is the quickest for small factors, and fast enough for anything
+     * up to 2^64 */
+    if (digits <= 20) {
+        for (c = 1; !out_of_time(fz); c += 2) {
+            if (rho(fz, n, c, 0, res)) {
+                return TRUE;
+            }
+        }
+        return FALSE;
+    }
+    if (rho(fz, n, 1L, RHO_SHORT, res)) {
+        return TRUE;
+    }
+
+    /* ECM until the sieve would be quicker than the next level */
+    if (digits <= 35) {
+        levels = 0;
+    }
+    else if (digits <= 65) {
+        levels = 1;
+    }
+    else if (digits <= 80) {
+        levels = 2;
+    }
+    else if (digits <= 95) {
+        levels = 3;
+    }
+    else if (digits <= SIQS_MAX_DIGITS) {
+        levels = 4;
+    }
+    else {
+        levels = ECM_LEVELS;
+    }
+    for (i = 0; i < levels && !out_of_time(fz); i++) {
+        if (ecm(fz, n, ecm_levels[i].b1, ecm_levels[i].curves, res)) {
+            return TRUE;
+        }
+    }
+    if (digits <= SIQS_MAX_DIGITS) {
+        return !out_of_time(fz) && siqs(fz, n, res);
+    }
+
+    /* too big for the sieve: ECM with ever larger bounds */
+    for (b1 = 2 * ecm_levels[ECM_LEVELS - 1].b1;
+         !out_of_time(fz) && b1 <= ECM_MAX_B2 / 4; b1 *= 2) {
+        if (ecm(fz, n, b1, 4000, res)) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* splits n (with exponent e), which has no factors below 2^16, into primes */
+static void
+factorize_cofactor(FACTORIZE * fz, ZVALUE n, long e)
+{
+    ZVALUE root, d, q;
+    long k;
+
+    if (zbpsw(n)) {
+        add_factor(fz, n, e);
+        return;
+    }
+    k = zperfect_power(n, &root);
+    if (k > 0) {
+        zfree(n);
+        factorize_cofactor(fz, root, e * k);
+        return;
+    }
+    if (fz->expired || !find_factor(fz, n, &d)) {
+        /* out of time: return the composite as it is */
+        add_factor(fz, n, e);
+        return;
+    }
+    zequo(n, d, &q);
+    zfree(n);
+    factorize_cofactor(fz, d, e);
+    factorize_cofactor(fz, q, e);
+}
+
+static int
+compare_factors(const void *a, const void *b)
+{
+    return zrel(((const FACTOR *) a)->z, ((const FACTOR *) b)->z);
+}
+
+/* factorizes abs(n), for n != 0.  sets *factors and *exps to arrays of the
+ * distinct factors (in increasing order) and their exponents, allocated with
+ * ALLOC_N, and returns how many there are.
+ *
+ * if seconds > 0, it limits the time spent; any composite factors which
+ * haven't been split by then are included in the result. */
+long
+zfactorize(ZVALUE n, double seconds, ZVALUE ** factors, long **exps)
+{
+    FACTORIZE fz;
+    ZVALUE m, q;
+    uint32_t *primes;
+    long nprimes, i, j, e;
+
+    memset(&fz, 0, sizeof(fz));
+    if (seconds > 0) {
+        fz.deadline = now_seconds() + seconds;
+    }
+    zcopy(n, &m);
+    m.sign = 0;
+
+    /* trial division */
+    primes = prime_sieve(TRIAL_LIMIT, &nprimes);
+    for (i = 0; i < nprimes && !zisone(m); i++) {
+        if (!zge64b(m) && (FULL) primes[i] * primes[i] > ztou(m)) {
+            break;
+        }
+        for (e = 0; zdivi(m, (long) primes[i], &q) == 0; e++) {
+            zfree(m);
+            m = q;
+        }
+        zfree(q);
+        if (e > 0) {
+            utoz((FULL) primes[i], &q);
+            add_factor(&fz, q, e);
+        }
+    }
+    xfree(primes);
+    if (!zisone(m)) {
+        factorize_cofactor(&fz, m, 1L);
+    }
+    else {
+        zfree(m);
+    }
+    if (fz.state) {
+        /* everything else is freed; raise the interrupt's exception */
+        for (i = 0; i < fz.count; i++) {
+            zfree(fz.factors[i].z);
+        }
+        xfree(fz.factors);
+        rb_jump_tag(fz.state);
+    }
+
+    /* sort, and merge any repeated factors */
+    qsort(fz.factors, fz.count, sizeof(FACTOR), compare_factors);
+    *factors = ALLOC_N(ZVALUE, fz.count > 0 ? fz.count : 1);
+    *exps = ALLOC_N(long, fz.count > 0 ? fz.count : 1);
+    for (i = 0, j = 0; i < fz.count; i++) {
+        if (j > 0 && zcmp((*factors)[j - 1], fz.factors[i].z) == 0) {
+            (*exps)[j - 1] += fz.factors[i].e;
+            zfree(fz.factors[i].z);
+        }
+        else {
+            (*factors)[j] = fz.factors[i].z;
+            (*exps)[j] = fz.factors[i].e;
+            j++;
+        }
+    }
+    xfree(fz.factors);
+    return j;
+}
@@ -0,0 +1,222 @@
+#include "calc.h"
+
+/* Fibonacci and Lucas numbers.
+ *
+ * Single values use the fast doubling identities
+ *
+ *   F(2k)   = F(k) * (2 * F(k+1) - F(k))
+ *   F(2k+1) = F(k)^2 + F(k+1)^2
+ *
+ * which need a couple of multiplications per bit of the index, and work
+ * just as well modulo some number (where the index can be arbitrarily
+ * large).  Calc.fib_each adds successive numbers in place in two buffers.
+ */
+
+/* reduce *z modulo mod (if mod is not NULL), in place */
+static void
+zreduce(ZVALUE * z, ZVALUE * mod)
+{
+    ZVALUE tmp;
+
+    if (mod) {
+        zmod(*z, *mod, &tmp, 0);
+        zfree(*z);
+        *z = tmp;
+    }
+}
+
+/* sets f and g to F(abs(n)) and F(abs(n) + 1), modulo mod if it isn't NULL */
+static void
+zfib_pair(ZVALUE n, ZVALUE * mod, ZVALUE * f, ZVALUE * g)
+{
+    ZVALUE c, d, tmp, tmp2;
+    long bit;
+    int set;
+
+    itoz(0L, f);
+    itoz(1L, g);
+    if (ziszero(n)) {
+        return;
+    }
+    for (bit = zhighbit(n); bit >= 0; bit--) {
+        /* c = F(2k) = f * (2g - f) */
+        zshift(*g, 1L, &tmp);
+        zsub(tmp, *f, &tmp2);
+        zfree(tmp);
+        zmul_fast(*f, tmp2, &c);
+        zfree(tmp2);
+        zreduce(&c, mod);
+
+        /* d = F(2k+1) = f^2 + g^2 */
+        zsquare_fast(*f, &tmp);
+        zsquare_fast(*g, &tmp2);
+        zadd(tmp, tmp2, &d);
+        zfree(tmp);
+        zfree(tmp2);
+        zreduce(&d, mod);
+
+        zfree(*f);
+        zfree(*g);
+        set = (n.v[bit / BASEB] >> (bit % BASEB)) & 1;
+        if (set) {
+            *f = d;
+            zadd(c, d, g);
+            zfree(c);
+            zreduce(g, mod);
+        }
+        else {
+            *f = c;
+            *g = d;
+        }
+    }
+}
+
+/* returns F(q) if lucas is FALSE or L(q) if it is TRUE, modulo m if m is
+ * not NULL.  q must be an integer and m a positive integer. */
+static NUMBER *
+qfib_lucas(NUMBER * q, NUMBER * m, BOOL lucas)
+{
+    NUMBER *r;
+    ZVALUE *mod, f, g, tmp;
+    BOOL negate;
+
+    mod = m ? &m->num : NULL;
+    zfib_pair(q->num, mod, &f, &g);
+    r = qalloc();
+    if (lucas) {
+        /* L(n) = 2 * F(n+1) - F(n); L(-n) = (-1)^n * L(n) */
+        zshift(g, 1L, &tmp);
+        zsub(tmp, f, &r->num);
+        zfree(tmp);
+        zfree(f);
+        negate = qisneg(q) && zisodd(q->num);
+    }
+    else {
+        /* F(-n) = (-1)^(n+1) * F(n) */
+        r->num = f;
+        negate = qisneg(q) && !zisodd(q->num);
+    }
+    zfree(g);
+    if (negate && !ziszero(r->num)) {
+        r->num.sign = !r->num.sign;
+    }
+    zreduce(&r->num, mod);
+    return r;
+}
+
+/* F(q), modulo m if it isn't NULL */
+NUMBER *
+qfib_fast(NUMBER * q, NUMBER * m)
+{
+    return qfib_lucas(q, m, FALSE);
+}
+
+/* L(q), modulo m if it isn't NULL */
+NUMBER *
+qlucas_fast(NUMBER * q, NUMBER * m)
+{
+    return qfib_lucas(q, m, TRUE);
+}
+
+/* state for Calc.fib_each: a and b hold consecutive fibonacci numbers, each
+ * in len HALFs (a has leading zeros if it is shorter) */
+typedef struct {
+    HALF *a;
+    HALF *b;
+    LEN len;
+    LEN cap;
+    NUMBER *limit;
+} FIBSEQ;
+
+static VALUE
+fib_each_loop(VALUE arg)
+{
+    FIBSEQ *fs = (FIBSEQ *) arg;
+    NUMBER view, *q;
+    HALF *tmp;
+    FULL carry;
+    LEN i;
+
+    view.den = _one_;
+    view.links = 1;
+    for (;;) {
+        view.num.v = fs->a;
+        view.num.len = fs->len;
+        view.num.sign = 0;
+        ztrim(&view.num);
+        if (fs->limit && qrel(&view, fs->limit) >= 0) {
+            return Qnil;
+        }
+        q = qalloc();
+        zcopy(view.num, &q->num);
+        rb_yield(wrap_number(q));
+
+        /* a += b, then swap so a < b again */
+        carry = 0;
+        for (i = 0; i < fs->len; i++) {
+            carry += (FULL) fs->a[i] + fs->b[i];
+            fs->a[i] = (HALF) carry;
+            carry >>= BASEB;
+        }
+        if (carry) {
+            if (fs->len == fs->cap) {
+                fs->cap *= 2;
+                REALLOC_N(fs->a, HALF, fs->cap);
+                REALLOC_N(fs->b, HALF, fs->cap);
+            }
+            fs->a[fs->len] = (HALF) carry;
+            fs->b[fs->len] = 0;
+            fs->len++;
+        }
+        tmp = fs->a;
+        fs->a = fs->b;
+        fs->b = tmp;
+    }
+}
+
+static VALUE
+fib_each_free(VALUE arg)
+{
+    FIBSEQ *fs = (FIBSEQ *) arg;
+
+    xfree(fs->a);
+    xfree(fs->b);
+    if (fs->limit) {
+        qfree(fs->limit);
+    }
+    return Qnil;
+}
+
+/* Iterates over the fibonacci numbers
+ *
+ * Yields F(0), F(1), F(2), ... in turn, stopping before the first one which
+ * is not less than limit (or never if limit is nil).  Each number is
+ * calculated by adding the previous two in place, so the only allocation
+ * per step is for the yielded value.
+ *
+ * @param limit [Numeric,nil]
+ * @return [nil,Enumerator] nil, or an Enumerator if no block is given
+ * @yield [Calc::Q]
+ * @example
+ *  Calc.fib_each(6).to_a #=> [Calc::Q(0), Calc::Q(1), Calc::Q(1), Calc::Q(2), Calc::Q(3), Calc::Q(5)]
+ *  Calc.fib_each.lazy.select(&:prime?).first(4) #=> [Calc::Q(2), Calc::Q(3), Calc::Q(5), Calc::Q(13)]
+ */
+VALUE
+calc_fib_each(int argc, VALUE * argv, VALUE klass)
+{
+    FIBSEQ fs;
+    VALUE limit;
+    setup_math_error();
+
+    RETURN_ENUMERATOR(klass, argc, argv);
+    rb_scan_args(argc, argv, "01", &limit);
+    fs.limit = NIL_P(limit) ? NULL : value_to_number(limit, 0);
+    fs.cap = 16;
+    fs.len = 1;
+    fs.a = ALLOC_N(HALF, fs.cap);
+    fs.b = ALLOC_N(HALF, fs.cap);
+    fs.a[0] = 0;
+    fs.b[0] = 1;
+    rb_ensure(fib_each_loop, (VALUE) & fs, fib_each_free, (VALUE) & fs);
+    return Qnil;
+}
@@ -0,0 +1,810 @@
+#include "calc.h"
+
+/* Document-class: Calc::Fixed
+ *
+ * Fixed point decimal number.
+ *
+ * Calc::Q keeps numbers in lowest terms, so every sum or product finds a gcd
+ * even when all the denominators are powers of ten, as with amounts of
+ * money.  A Calc::Fixed is an integer and a scale (a number of decimal
+ * places), and its value is the integer divided by 10^scale.  Addition,
+ * subtraction and comparison are integer operations once the operand with
+ * fewer places has been multiplied up, and no gcd is ever calculated.
+ *
+ * Results of +, -, * and / have the larger of the two scales.  + and - are
+ * exact; * and / are rounded as per Calc.config(:round) (by default to
+ * nearest, with ties to even).  Integer operands are treated as having a
+ * scale of 0, so multiplying or dividing by an integer keeps the scale.  Any
+ * other numbers (Calc::Q, Rational, Float) are combined with the value of
+ * the Calc::Fixed as a Calc::Q, giving a Calc::Q result.
+ *
+ * @example
+ *  price = Calc::Fixed("19.99")
+ *  price * 3                     #=> Calc::Fixed(59.97)
+ *  price * Calc::Fixed("0.0825") #=> Calc::Fixed(1.6492)
+ *  Calc::Fixed("10.00") / 3      #=> Calc::Fixed(3.33)
+ */
+VALUE cFixed;
+
+static ID id_add;
+static ID id_divide;
+static ID id_multiply;
+static ID id_spaceship;
+static ID id_subtract;
+static ID id_to_f;
+static ID id_to_i;
+
+typedef struct {
+    ZVALUE num;                 /* value * 10^scale */
+    long scale;                 /* decimal places */
+} FIXED;
+
+/* powers of ten which fit in a long */
+#define MAX_LONG_TENPOW 18
+static const long long_tenpow[MAX_LONG_TENPOW + 1] = {
+    1L, 10L, 100L, 1000L, 10000L, 100000L, 1000000L, 10000000L, 100000000L,
+    1000000000L, 10000000000L, 100000000000L, 1000000000000L, 10000000000000L,
+    100000000000000L, 1000000000000000L, 10000000000000000L, 100000000000000000L,
+    1000000000000000000L
+};
+
+static void
+cfixed_free(void *p)
+{
+    FIXED *f = (FIXED *) p;
+
+    if (f) {
+        zfree(f->num);
+        xfree(f);
+    }
+}
+
+const rb_data_type_t calc_fixed_type = {
+    "Calc::Fixed",
+    {0, cfixed_free, 0},
+    0, 0
+#ifdef RUBY_TYPED_FREE_IMMEDIATELY
+        , RUBY_TYPED_FREE_IMMEDIATELY
+#endif
+};
+
+#define CALC_FIXED_P(v) (rb_typeddata_is_kind_of((v), &calc_fixed_type))
+
+static VALUE
+cfixed_alloc(VALUE klass)
+{
+    return TypedData_Wrap_Struct(klass, &calc_fixed_type, 0);
+}
+
+static FIXED *
+get_fixed(VALUE self)
+{
+    FIXED *f = rb_check_typeddata(self, &calc_fixed_type);
+
+    if (!f) {
+        rb_raise(rb_eArgError, "uninitialized Calc::Fixed");
+    }
+    return f;
+}
+
+/* wrap num and scale in a new Calc::Fixed.  takes ownership of num. */
+static VALUE
+wrap_fixed(ZVALUE num, long scale)
+{
+    VALUE result;
+    FIXED *f;
+
+    result = cfixed_alloc(cFixed);
+    f = ALLOC(FIXED);
+    f->num = num;
+    f->scale = scale;
+    DATA_PTR(result) = f;
+    return result;
+}
+
+static void
+tenpow(long n, ZVALUE * res)
+{
+    if (n <= MAX_LONG_TENPOW) {
+        itoz(long_tenpow[n], res);
+    }
+    else {
+        ztenpow(n, res);
+    }
+}
+
+/* sets *res to z * 10^n.  returns TRUE if *res was allocated, or FALSE if n
+ * is 0 and *res is z itself. */
+static BOOL
+scale_up(ZVALUE z, long n, ZVALUE * res)
+{
+    ZVALUE t;
+
+    if (n == 0) {
+        *res = z;
+        return FALSE;
+    }
+    if (n <= MAX_LONG_TENPOW) {
+        zmuli(z, long_tenpow[n], res);
+    }
+    else {
+        ztenpow(n, &t);
+        zmul_fast(z, t, res);
+        zfree(t);
+    }
+    return TRUE;
+}
+
+/* sets *res to z scaled from one number of places to another, rounding as
+ * per rnd if places are lost.  *res is always allocated. */
+static void
+rescale(ZVALUE z, long from, long to, long rnd, ZVALUE * res)
+{
+    ZVALUE t;
+
+    if (to < from) {
+        tenpow(from - to, &t);
+        zquo(z, t, res, rnd);
+        zfree(t);
+    }
+    else if (!scale_up(z, to - from, res)) {
+        zcopy(z, res);
+    }
+}
+
+/* number of decimal places needed for 1/den, or -1 if it doesn't have a
+ * finite decimal expansion */
+static long
+decimal_places(ZVALUE den)
+{
+    ZVALUE t, q;
+    long twos, fives = 0;
+    BOOL ok;
+
+    twos = zlowbit(den);
+    zshift(den, -twos, &t);
+    while (!zisunit(t)) {
+        if (zdivi(t, 5, &q) != 0) {
+            zfree(q);
+            break;
+        }
+        zfree(t);
+        t = q;
+        fives++;
+    }
+    ok = zisunit(t);
+    zfree(t);
+    if (!ok) {
+        return -1;
+    }
+    return (twos > fives) ? twos : fives;
+}
+
+/* parses a plain decimal string ("-123.45").  returns FALSE for anything
+ * else, which is left for libcalc's parser. */
+static BOOL
+parse_decimal(VALUE str, ZVALUE * res, long *scale)
+{
+    const char *s, *p;
+    long i, len, chunk, digits = 0, places = -1;
+    ZVALUE acc, t, u;
+    BOOL neg = FALSE;
+
+    s = StringValueCStr(str);
+    while (*s == ' ') {
+        s++;
+    }
+    if (*s == '-' || *s == '+') {
+        neg = (*s == '-');
+        s++;
+    }
+    for (p = s; *p; p++) {
+        if (*p == '.' && places < 0) {
+            places = 0;
+        }
+        else if (*p >= '0' && *p <= '9') {
+            digits++;
+            if (places >= 0) {
+                places++;
+            }
+        }
+        else {
+            break;
+        }
+    }
+    len = p - s;
+    while (*p == ' ') {
+        p++;
+    }
+    if (*p || digits == 0) {
+        return FALSE;
+    }
+    /* accumulate up to 18 digits at a time */
+    itoz(0, &acc);
+    chunk = 0;
+    i = 0;
+    for (p = s; p < s + len; p++) {
+        if (*p == '.') {
+            continue;
+        }
+        chunk = chunk * 10 + (*p - '0');
+        if (++i == MAX_LONG_TENPOW || p == s + len - 1) {
+            zmuli(acc, long_tenpow[i], &t);
+            itoz(chunk, &u);
+            zfree(acc);
+            zadd(t, u, &acc);
+            zfree(t);
+            zfree(u);
+            chunk = 0;
+            i = 0;
+        }
+    }
+    if (i > 0) {
+        /* string ended with "." */
+        zmuli(acc, long_tenpow[i], &t);
+        itoz(chunk, &u);
+        zfree(acc);
+        zadd(t, u, &acc);
+        zfree(t);
+        zfree(u);
+    }
+    if (neg && !ziszero(acc)) {
+        acc.sign = 1;
+    }
+    *res = acc;
+    *scale = (places < 0) ? 0 : places;
+    return TRUE;
+}
+
+/* converts a ruby value to a fixed point integer with the given scale, or if
+ * scale is negative, with as many places as the value needs.  the scale used
+ * is returned. */
+static long
+value_to_fixed(VALUE v, long scale, ZVALUE * res)
+{
+    FIXED *f;
+    NUMBER *q;
+    ZVALUE t;
+    long places;
+    BOOL alloced;
+
+    if (CALC_FIXED_P(v)) {
+        f = get_fixed(v);
+        if (scale < 0) {
+            scale = f->scale;
+        }
+        rescale(f->num, f->scale, scale, conf->round, res);
+        return scale;
+    }
+    if (RB_TYPE_P(v, T_STRING) && parse_decimal(v, &t, &places)) {
+        if (scale < 0) {
+            *res = t;
+            return places;
+        }
+        rescale(t, places, scale, conf->round, res);
+        zfree(t);
+        return scale;
+    }
+    q = value_to_number(v, 1);
+    if (scale < 0) {
+        scale = qisint(q) ? 0 : decimal_places(q->den);
+        if (scale < 0) {
+            qfree(q);
+            rb_raise(e_MathError, "number isn't a finite decimal; a scale is required");
+        }
+    }
+    if (qisint(q)) {
+        rescale(q->num, 0, scale, conf->round, res);
+    }
+    else {
+        alloced = scale_up(q->num, scale, &t);
+        zquo(t, q->den, res, conf->round);
+        if (alloced) {
+            zfree(t);
+        }
+    }
+    qfree(q);
+    return scale;
+}
+
+/* if other is a Calc::Fixed or an Integer, sets *num and *scale and returns
+ * TRUE.  *num must be freed if *alloced is set. */
+static BOOL
+fixed_operand(VALUE other, ZVALUE * num, long *scale, BOOL * alloced)
+{
+    FIXED *f;
+    NUMBER *q;
+
+    if (CALC_FIXED_P(other)) {
+        f = get_fixed(other);
+        *num = f->num;
+        *scale = f->scale;
+        *alloced = FALSE;
+        return TRUE;
+    }
+    if (FIXNUM_P(other)) {
+        itoz(FIX2LONG(other), num);
+    }
+    else if (RB_TYPE_P(other, T_BIGNUM)) {
+        q = value_to_number(other, 0);
+        zcopy(q->num, num);
+        qfree(q);
+    }
+    else {
+        return FALSE;
+    }
+    *scale = 0;
+    *alloced = TRUE;
+    return TRUE;
+}
+
+/* Creates a new fixed point number
+ *
+ * Without a scale, a string keeps the number of places it was written
+ * with, an integer has scale 0, and other numbers have as many places as
+ * they need (a Calc::MathError is raised if that is infinite, eg 1/3).
+ * With a scale, the value is rounded as per Calc.config(:round) if it has
+ * more places.
+ *
+ * Plain decimal strings ("-123.45") are converted directly to the scaled
+ * integer; other strings are parsed as for Calc::Q.
+ *
+ * @param value [Numeric,Calc::Fixed,String]
+ * @param scale [Integer] (optional) number of decimal places
+ * @raise [ArgumentError] if scale is negative
+ * @raise [Calc::MathError] if value needs a scale and doesn't have a finite
+ *  decimal expansion
+ * @example
+ *  Calc::Fixed.new("1.50")        #=> Calc::Fixed(1.50)
+ *  Calc::Fixed.new(Calc::Q(1, 8)) #=> Calc::Fixed(0.125)
+ *  Calc::Fixed.new("2/3", 4)      #=> Calc::Fixed(0.6667)
+ */
+static VALUE
+cfixed_initialize(int argc, VALUE * argv, VALUE self)
+{
+    FIXED *f;
+    VALUE value, scale;
+    ZVALUE num;
+    long s = -1;
+    setup_math_error();
+
+    if (rb_scan_args(argc, argv, "11", &value, &scale) == 2 && !NIL_P(scale)) {
+        s = value_to_long(scale);
+        if (s < 0) {
+            rb_raise(rb_eArgError, "negative scale for Calc::Fixed");
+        }
+    }
+    s = value_to_fixed(value, s, &num);
+    if (DATA_PTR(self)) {
+        cfixed_free(DATA_PTR(self));
+    }
+    f = ALLOC(FIXED);
+    f->num = num;
+    f->scale = s;
+    DATA_PTR(self) = f;
+    return self;
+}
+
+static VALUE
+cfixed_initialize_copy(VALUE obj, VALUE orig)
+{
+    FIXED *forig, *fobj;
+
+    if (obj == orig) {
+        return obj;
+    }
+    forig = get_fixed(orig);
+    fobj = ALLOC(FIXED);
+    zcopy(forig->num, &fobj->num);
+    fobj->scale = forig->scale;
+    DATA_PTR(obj) = fobj;
+    return obj;
+}
+
+/* Converts to a Calc::Q
+ *
+ * @return [Calc::Q]
+ * @example
+ *  Calc::Fixed("1.50").to_q #=> Calc::Q(1.5)
+ */
+static VALUE
+cfixed_to_q(VALUE self)
+{
+    FIXED *f;
+    NUMBER *q;
+    ZVALUE den, g;
+    setup_math_error();
+
+    f = get_fixed(self);
+    q = qalloc();
+    if (f->scale == 0) {
+        zcopy(f->num, &q->num);
+        return wrap_number(q);
+    }
+    tenpow(f->scale, &den);
+    zgcd(f->num, den, &g);
+    if (zisunit(g)) {
+        zcopy(f->num, &q->num);
+        q->den = den;
+    }
+    else {
+        zequo(f->num, g, &q->num);
+        zequo(den, g, &q->den);
+        zfree(den);
+    }
+    zfree(g);
+    return wrap_number(q);
+}
+
+/* + and -, or * and / when mul is set.  the result has the larger scale. */
+static VALUE
+arith(VALUE self, VALUE other, ID func)
+{
+    FIXED *f;
+    ZVALUE zother, za, zb, t, zresult;
+    long sother, s, rnd;
+    BOOL alloced, fa, fb;
+    setup_math_error();
+
+    f = get_fixed(self);
+    if (!fixed_operand(other, &zother, &sother, &alloced)) {
+        return rb_funcall(cfixed_to_q(self), func, 1, other);
+    }
+    s = (f->scale > sother) ? f->scale : sother;
+    rnd = conf->round;
+    if (func == id_add || func == id_subtract) {
+        fa = scale_up(f->num, s - f->scale, &za);
+        fb = scale_up(zother, s - sother, &zb);
+        if (func == id_add) {
+            zadd(za, zb, &zresult);
+        }
+        else {
+            zsub(za, zb, &zresult);
+        }
+        if (fa) {
+            zfree(za);
+        }
+        if (fb) {
+            zfree(zb);
+        }
+    }
+    else if (func == id_multiply) {
+        /* the product has f->scale + sother places */
+        zmul_fast(f->num, zother, &t);
+        rescale(t, f->scale + sother, s, rnd, &zresult);
+        zfree(t);
+    }
+    else {
+        if (ziszero(zother)) {
+            if (alloced) {
+                zfree(zother);
+            }
+            rb_raise(rb_eZeroDivError, "division by zero");
+        }
+        /* (a / 10^sa) / (b / 10^sb) * 10^s = a * 10^(s + sb - sa) / b */
+        fa = scale_up(f->num, s + sother - f->scale, &za);
+        zquo(za, zother, &zresult, rnd);
+        if (fa) {
+            zfree(za);
+        }
+    }
+    if (alloced) {
+        zfree(zother);
+    }
+    return wrap_fixed(zresult, s);
+}
+
+/* Adds a number
+ *
+ * @param y [Calc::Fixed,Integer,Numeric]
+ * @return [Calc::Fixed,Calc::Q]
+ * @example
+ *  Calc::Fixed("1.5") + Calc::Fixed("0.25") #=> Calc::Fixed(1.75)
+ */
+static VALUE
+cfixed_add(VALUE self, VALUE other)
+{
+    return arith(self, other, id_add);
+}
+
+/* Subtracts a number
+ *
+ * @param y [Calc::Fixed,Integer,Numeric]
+ * @return [Calc::Fixed,Calc::Q]
+ * @example
+ *  Calc::Fixed("1.5") - 2 #=> Calc::Fixed(-0.5)
+ */
+static VALUE
+cfixed_subtract(VALUE self, VALUE other)
+{
+    return arith(self, other, id_subtract);
+}
+
+/* Multiplies by a number, rounding to the larger scale
+ *
+ * @param y [Calc::Fixed,Integer,Numeric]
+ * @return [Calc::Fixed,Calc::Q]
+ * @example
+ *  Calc::Fixed("1.25") * Calc::Fixed("1.5") #=> Calc::Fixed(1.88)
+ */
+static VALUE
+cfixed_multiply(VALUE self, VALUE other)
+{
+    return arith(self, other, id_multiply);
+}
+
+/* Divides by a number, rounding to the larger scale
+ *
+ * @param y [Calc::Fixed,Integer,Numeric]
+ * @return [Calc::Fixed,Calc::Q]
+ * @raise [ZeroDivisionError] if y is zero
+ * @example
+ *  Calc::Fixed("1.00") / 3 #=> Calc::Fixed(0.33)
+ */
+static VALUE
+cfixed_divide(VALUE self, VALUE other)
+{
+    return arith(self, other, id_divide);
+}
+
+static VALUE
+cfixed_uminus(VALUE self)
+{
+    FIXED *f;
+    ZVALUE num;
+    setup_math_error();
+
+    f = get_fixed(self);
+    zcopy(f->num, &num);
+    if (!ziszero(num)) {
+        num.sign = !num.sign;
+    }
+    return wrap_fixed(num, f->scale);
+}
+
+/* Absolute value
+ *
+ * @return [Calc::Fixed]
+ * @example
+ *  Calc::Fixed("-1.5").abs #=> Calc::Fixed(1.5)
+ */
+static VALUE
+cfixed_abs(VALUE self)
+{
+    FIXED *f;
+    ZVALUE num;
+    setup_math_error();
+
+    f = get_fixed(self);
+    zcopy(f->num, &num);
+    num.sign = 0;
+    return wrap_fixed(num, f->scale);
+}
+
+/* Comparison - Returns -1, 0, +1 or nil
+ *
+ * Numbers with different scales are equal if their values are equal.
+ *
+ * @param other [Calc::Fixed,Numeric]
+ * @return [Integer,nil]
+ * @example
+ *  Calc::Fixed("1.50") <=> Calc::Fixed("1.5") #=> 0
+ *  Calc::Fixed("1.5") <=> 2                   #=> -1
+ */
+static VALUE
+cfixed_spaceship(VALUE self, VALUE other)
+{
+    FIXED *f;
+    ZVALUE zother, za, zb;
+    long sother, s;
+    BOOL alloced, fa, fb;
+    int result;
+    setup_math_error();
+
+    f = get_fixed(self);
+    if (!fixed_operand(other, &zother, &sother, &alloced)) {
+        if (!RB_TYPE_P(other, T_FLOAT) && !RB_TYPE_P(other, T_RATIONAL) && !CALC_Q_P(other)) {
+            return Qnil;
+        }
+        return rb_funcall(cfixed_to_q(self), id_spaceship, 1, other);
+    }
+    s = (f->scale > sother) ? f->scale : sother;
+    fa = scale_up(f->num, s - f->scale, &za);
+    fb = scale_up(zother, s - sother, &zb);
+    result = zrel(za, zb);
+    if (fa) {
+        zfree(za);
+    }
+    if (fb) {
+        zfree(zb);
+    }
+    if (alloced) {
+        zfree(zother);
+    }
+    return INT2FIX(result);
+}
+
+/* Converts a number for arithmetic with a Calc::Fixed
+ *
+ * Integers become Calc::Fixed; other numbers give a pair of Calc::Q.
+ *
+ * @param other [Numeric]
+ * @return [Array]
+ */
+static VALUE
+cfixed_coerce(VALUE self, VALUE other)
+{
+    ZVALUE num;
+    long scale;
+    BOOL alloced;
+    setup_math_error();
+
+    if (fixed_operand(other, &num, &scale, &alloced)) {
+        if (!alloced) {
+            zcopy(num, &num);
+        }
+        return rb_assoc_new(wrap_fixed(num, scale), self);
+    }
+    return rb_assoc_new(wrap_number(value_to_number(other, 0)), cfixed_to_q(self));
+}
+
+/* Rounds to a number of decimal places
+ *
+ * Returns a Calc::Fixed with the given scale.  The rounding mode defaults
+ * to Calc.config(:round).  A scale larger than the current one adds zeros.
+ *
+ * @param places [Integer] (default 0)
+ * @param rnd [Integer] rounding mode (default Calc.config(:round))
+ * @return [Calc::Fixed]
+ * @raise [ArgumentError] if places is negative
+ * @example
+ *  Calc::Fixed("2.345").round(2)    #=> Calc::Fixed(2.34)
+ *  Calc::Fixed("2.345").round(2, 1) #=> Calc::Fixed(2.35)
+ *  Calc::Fixed("2.3").round(3)      #=> Calc::Fixed(2.300)
+ */
+static VALUE
+cfixed_round(int argc, VALUE * argv, VALUE self)
+{
+    FIXED *f;
+    VALUE places, rnd;
+    ZVALUE num;
+    long n, p, r;
+    setup_math_error();
+
+    f = get_fixed(self);
+    n = rb_scan_args(argc, argv, "02", &places, &rnd);
+    p = (n >= 1) ? value_to_long(places) : 0;
+    r = (n == 2) ? value_to_long(rnd) : conf->round;
+    if (p < 0) {
+        rb_raise(rb_eArgError, "negative scale for Calc::Fixed");
+    }
+    rescale(f->num, f->scale, p, r, &num);
+    return wrap_fixed(num, p);
+}
+
+/* Returns the number of decimal places
+ *
+ * @return [Integer]
+ * @example
+ *  Calc::Fixed("1.50").scale #=> 2
+ */
+static VALUE
+cfixed_scale(VALUE self)
+{
+    return LONG2NUM(get_fixed(self)->scale);
+}
+
+static VALUE
+cfixed_to_f(VALUE self)
+{
+    return rb_funcall(cfixed_to_q(self), id_to_f, 0);
+}
+
+/* Converts to an Integer, as Calc::Q#to_i
+ *
+ * @return [Integer]
+ */
+static VALUE
+cfixed_to_i(VALUE self)
+{
+    return rb_funcall(cfixed_to_q(self), id_to_i, 0);
+}
+
+/* Returns a string with exactly scale decimal places
+ *
+ * @return [String]
+ * @example
+ *  Calc::Fixed("-0.05").to_s #=> "-0.05"
+ *  Calc::Fixed(12, 2).to_s   #=> "12.00"
+ */
+static VALUE
+cfixed_to_s(VALUE self)
+{
+    FIXED *f;
+    VALUE result;
+    char *s, *digits;
+    long len, pad;
+    setup_math_error();
+
+    f = get_fixed(self);
+    math_divertio();
+    zprintval(f->num, 0, 0);
+    s = math_getdivertedio();
+    digits = (*s == '-') ? s + 1 : s;
+    len = (long) strlen(digits);
+    result = rb_str_buf_new(len + f->scale + 3);
+    if (zisneg(f->num)) {
+        rb_str_cat2(result, "-");
+    }
+    pad = f->scale + 1 - len;
+    if (pad > 0) {
+        /* leading zeros: "0.0" ... */
+        rb_str_cat2(result, "0");
+        if (f->scale > 0) {
+            rb_str_cat2(result, ".");
+        }
+        for (pad--; pad > 0; pad--) {
+            rb_str_cat2(result, "0");
+        }
+        rb_str_cat2(result, digits);
+    }
+    else {
+        rb_str_cat(result, digits, len - f->scale);
+        if (f->scale > 0) {
+            rb_str_cat2(result, ".");
+            rb_str_cat2(result, digits + len - f->scale);
+        }
+    }
+    free(s);
+    return result;
+}
+
+static VALUE
+cfixed_inspect(VALUE self)
+{
+    return rb_sprintf("Calc::Fixed(%" PRIsVALUE ")", cfixed_to_s(self));
+}
+
+/* Returns true if the number is zero
+ *
+ * @return [Boolean]
+ */
+static VALUE
+cfixed_zerop(VALUE self)
+{
+    return ziszero(get_fixed(self)->num) ? Qtrue : Qfalse;
+}
+
+void
+define_calc_fixed(VALUE m)
+{
+    cFixed = rb_define_class_under(m, "Fixed", rb_cObject);
+    rb_include_module(cFixed, rb_mComparable);
+    rb_define_alloc_func(cFixed, cfixed_alloc);
+    rb_define_method(cFixed, "initialize", cfixed_initialize, -1);
+    rb_define_method(cFixed, "initialize_copy", cfixed_initialize_copy, 1);
+    rb_define_method(cFixed, "*", cfixed_multiply, 1);
+    rb_define_method(cFixed, "+", cfixed_add, 1);
+    rb_define_method(cFixed, "-", cfixed_subtract, 1);
+    rb_define_method(cFixed, "-@", cfixed_uminus, 0);
+    rb_define_method(cFixed, "/", cfixed_divide, 1);
+    rb_define_method(cFixed, "<=>", cfixed_spaceship, 1);
+    rb_define_method(cFixed, "abs", cfixed_abs, 0);
+    rb_define_method(cFixed, "coerce", cfixed_coerce, 1);
+    rb_define_method(cFixed, "inspect", cfixed_inspect, 0);
+    rb_define_method(cFixed, "round", cfixed_round, -1);
+    rb_define_method(cFixed, "scale", cfixed_scale, 0);
+    rb_define_method(cFixed, "to_f", cfixed_to_f, 0);
+    rb_define_method(cFixed, "to_i", cfixed_to_i, 0);
+    rb_define_method(cFixed, "to_q", cfixed_to_q, 0);
+    rb_define_method(cFixed, "to_s", cfixed_to_s, 0);
+    rb_define_method(cFixed, "zero?", cfixed_zerop, 0);
+
+    id_add = rb_intern("+");
+    id_divide = rb_intern("/");
+    id_multiply = rb_intern("*");
+    id_spaceship = rb_intern("<=>");
+    id_subtract = rb_intern("-");
+    id_to_f = rb_intern("to_f");
+    id_to_i = rb_intern("to_i");
+}
@@ -0,0 +1,391 @@
+#include "calc.h"
+
+/* Memo of transcendental function results.
+ *
+ * Programs which call sin, exp, ln, sqrt etc on the same arguments at the
+ * same epsilon over and over can have the results remembered instead of
+ * summing the series again each time.  An entry is found by hashing the
+ * function, its argument, epsilon and anything else the result depends on
+ * (the rounding mode Calc.config(:appr), or R for sqrt).  The argument and
+ * epsilon are then compared exactly, so a hash collision can't return the
+ * wrong result, and the least recently used entry is dropped when there
+ * would be more than Calc.config(:memo) of them.  The default limit of 0
+ * disables the memo.
+ *
+ * libcalc is only called while holding the GVL, and nothing here calls back
+ * into ruby between finding an entry and updating the lists, so ruby threads
+ * can't see the memo half updated.
+ */
+
+/* most buckets allocated for the hash table, however big the limit is */
+#define MEMO_MAX_BUCKETS (1L << 20)
+
+/* FNV-1a */
+#define MEMO_HASH_BASIS 2166136261UL
+#define MEMO_HASH_PRIME 16777619UL
+#define MEMO_HASH(h, x) (((h) ^ (unsigned long) (x)) * MEMO_HASH_PRIME)
+
+typedef void (*MEMOFUNC) (void);
+
+typedef struct memo_entry {
+    MEMOFUNC func;              /* libcalc function which made the result */
+    long extra;                 /* R for sqrt, otherwise conf->appr */
+    unsigned long hash;
+    NUMBER *qarg;               /* real argument, or NULL */
+    COMPLEX *carg;              /* complex argument, or NULL */
+    NUMBER *epsilon;
+    NUMBER *qresult;            /* result from a real function */
+    COMPLEX *cresult;           /* result from a complex function */
+    struct memo_entry *chain;   /* next entry in the same bucket */
+    struct memo_entry *newer;   /* least recently used list */
+    struct memo_entry *older;
+} MEMO;
+
+long memo_limit = 0;
+
+static MEMO **buckets = NULL;
+static long nbuckets = 0;
+static long nentries = 0;
+static long hits = 0;
+static long misses = 0;
+static MEMO *newest = NULL;
+static MEMO *oldest = NULL;
+
+static unsigned long
+hash_z(unsigned long h, ZVALUE z)
+{
+    LEN i;
+
+    h = MEMO_HASH(h, z.sign);
+    for (i = 0; i < z.len; i++) {
+        h = MEMO_HASH(h, z.v[i]);
+    }
+    return h;
+}
+
+static unsigned long
+hash_q(unsigned long h, NUMBER * q)
+{
+    return hash_z(hash_z(h, q->num), q->den);
+}
+
+static unsigned long
+memo_hash(MEMOFUNC func, long extra, NUMBER * qarg, COMPLEX * carg, NUMBER * epsilon)
+{
+    unsigned long h;
+
+    h = MEMO_HASH(MEMO_HASH_BASIS, (uintptr_t) func);
+    h = MEMO_HASH(h, extra);
+    if (qarg) {
+        h = hash_q(h, qarg);
+    }
+    else {
+        h = hash_q(hash_q(h, carg->real), carg->imag);
+    }
+    return hash_q(h, epsilon);
+}
+
+/* bucket count for a limit: a power of 2 at least the limit, so chains stay
+ * short when the memo is full */
+static long
+memo_bucket_count(long limit)
+{
+    long n = 1;
+
+    while (n < limit && n < MEMO_MAX_BUCKETS) {
+        n <<= 1;
+    }
+    return n;
+}
+
+static void
+lru_unlink(MEMO * m)
+{
+    if (m->newer) {
+        m->newer->older = m->older;
+    }
+    else {
+        newest = m->older;
+    }
+    if (m->older) {
+        m->older->newer = m->newer;
+    }
+    else {
+        oldest = m->newer;
+    }
+}
+
+static void
+lru_push(MEMO * m)
+{
+    m->newer = NULL;
+    m->older = newest;
+    if (newest) {
+        newest->newer = m;
+    }
+    else {
+        oldest = m;
+    }
+    newest = m;
+}
+
+static void
+memo_evict(MEMO * m)
+{
+    MEMO **pp;
+
+    for (pp = &buckets[m->hash & (nbuckets - 1)]; *pp != m; pp = &(*pp)->chain);
+    *pp = m->chain;
+    lru_unlink(m);
+    nentries--;
+    if (m->qarg) {
+        qfree(m->qarg);
+    }
+    if (m->carg) {
+        comfree(m->carg);
+    }
+    qfree(m->epsilon);
+    if (m->qresult) {
+        qfree(m->qresult);
+    }
+    if (m->cresult) {
+        comfree(m->cresult);
+    }
+    xfree(m);
+}
+
+/* returns the entry matching the key (and makes it the most recently used)
+ * or NULL */
+static MEMO *
+memo_find(unsigned long hash, MEMOFUNC func, long extra, NUMBER * qarg, COMPLEX * carg,
+          NUMBER * epsilon)
+{
+    MEMO *m;
+
+    if (buckets) {
+        for (m = buckets[hash & (nbuckets - 1)]; m; m = m->chain) {
+            if (m->hash != hash || m->func != func || m->extra != extra) {
+                continue;
+            }
+            if (qarg ? (!m->qarg || qcmp(m->qarg, qarg))
+                : (!m->carg || c_cmp(m->carg, carg))) {
+                continue;
+            }
+            if (m->epsilon != epsilon && qcmp(m->epsilon, epsilon)) {
+                continue;
+            }
+            hits++;
+            lru_unlink(m);
+            lru_push(m);
+            return m;
+        }
+    }
+    misses++;
+    return NULL;
+}
+
+/* adds an entry for the key, dropping the least recently used entries if the
+ * memo is full.  results are linked, not copied; a complex argument is
+ * copied since callers may pass one on the stack. */
+static void
+memo_store(unsigned long hash, MEMOFUNC func, long extra, NUMBER * qarg, COMPLEX * carg,
+           NUMBER * epsilon, NUMBER * qresult, COMPLEX * cresult)
+{
+    MEMO *m;
+
+    if (!buckets) {
+        nbuckets = memo_bucket_count(memo_limit);
+        buckets = ZALLOC_N(MEMO *, nbuckets);
+    }
+    while (nentries >= memo_limit) {
+        memo_evict(oldest);
+    }
+    m = ALLOC(MEMO);
+    m->func = func;
+    m->extra = extra;
+    m->hash = hash;
+    m->qarg = qarg ? qlink(qarg) : NULL;
+    m->carg = carg ? qqtoc(carg->real, carg->imag) : NULL;
+    m->epsilon = qlink(epsilon);
+    m->qresult = qresult ? qlink(qresult) : NULL;
+    m->cresult = cresult ? clink(cresult) : NULL;
+    m->chain = buckets[hash & (nbuckets - 1)];
+    buckets[hash & (nbuckets - 1)] = m;
+    lru_push(m);
+    nentries++;
+}
+
+/* versions of calling libcalc functions which use the memo if enabled */
+
+NUMBER *
+memo_qfunc(NUMBER * (*f) (NUMBER *, NUMBER *), NUMBER * q, NUMBER * epsilon)
+{
+    MEMO *m;
+    NUMBER *result;
+    unsigned long hash;
+
+    if (memo_limit <= 0) {
+        return (*f) (q, epsilon);
+    }
+    hash = memo_hash((MEMOFUNC) f, conf->appr, q, NULL, epsilon);
+    m = memo_find(hash, (MEMOFUNC) f, conf->appr, q, NULL, epsilon);
+    if (m) {
+        return qlink(m->qresult);
+    }
+    result = (*f) (q, epsilon);
+    if (result) {
+        memo_store(hash, (MEMOFUNC) f, conf->appr, q, NULL, epsilon, result, NULL);
+    }
+    return result;
+}
+
+COMPLEX *
+memo_cfunc(COMPLEX * (*f) (COMPLEX *, NUMBER *), COMPLEX * c, NUMBER * epsilon)
+{
+    MEMO *m;
+    COMPLEX *result;
+    unsigned long hash;
+
+    if (memo_limit <= 0) {
+        return (*f) (c, epsilon);
+    }
+    hash = memo_hash((MEMOFUNC) f, conf->appr, NULL, c, epsilon);
+    m = memo_find(hash, (MEMOFUNC) f, conf->appr, NULL, c, epsilon);
+    if (m) {
+        return clink(m->cresult);
+    }
+    result = (*f) (c, epsilon);
+    if (result) {
+        memo_store(hash, (MEMOFUNC) f, conf->appr, NULL, c, epsilon, NULL, result);
+    }
+    return result;
+}
+
+NUMBER *
+memo_qsqrt(NUMBER * q, NUMBER * epsilon, long R)
+{
+    MEMO *m;
+    NUMBER *result;
+    unsigned long hash;
+
+    if (memo_limit <= 0) {
+        return qsqrt(q, epsilon, R);
+    }
+    hash = memo_hash((MEMOFUNC) qsqrt, R, q, NULL, epsilon);
+    m = memo_find(hash, (MEMOFUNC) qsqrt, R, q, NULL, epsilon);
+    if (m) {
+        return qlink(m->qresult);
+    }
+    result = qsqrt(q, epsilon, R);
+    if (result) {
+        memo_store(hash, (MEMOFUNC) qsqrt, R, q, NULL, epsilon, result, NULL);
+    }
+    return result;
+}
+
+COMPLEX *
+memo_csqrt(COMPLEX * c, NUMBER * epsilon, long R)
+{
+    MEMO *m;
+    COMPLEX *result;
+    unsigned long hash;
+
+    if (memo_limit <= 0) {
+        return c_sqrt(c, epsilon, R);
+    }
+    hash = memo_hash((MEMOFUNC) c_sqrt, R, NULL, c, epsilon);
+    m = memo_find(hash, (MEMOFUNC) c_sqrt, R, NULL, c, epsilon);
+    if (m) {
+        return clink(m->cresult);
+    }
+    result = c_sqrt(c, epsilon, R);
+    if (result) {
+        memo_store(hash, (MEMOFUNC) c_sqrt, R, NULL, c, epsilon, NULL, result);
+    }
+    return result;
+}
+
+static void
+memo_clear(void)
+{
+    while (oldest) {
+        memo_evict(oldest);
+    }
+    if (buckets) {
+        xfree(buckets);
+        buckets = NULL;
+        nbuckets = 0;
+    }
+}
+
+/* sets the memo limit, dropping the least recently used entries if there are
+ * more than that.  the hash table is sized for the new limit. */
+void
+memo_set_limit(long limit)
+{
+    MEMO **old_buckets, *m;
+
+    memo_limit = limit;
+    if (limit <= 0) {
+        memo_clear();
+        return;
+    }
+    while (nentries > limit) {
+        memo_evict(oldest);
+    }
+    if (buckets && memo_bucket_count(limit) != nbuckets) {
+        old_buckets = buckets;
+        nbuckets = memo_bucket_count(limit);
+        buckets = ZALLOC_N(MEMO *, nbuckets);
+        xfree(old_buckets);
+        for (m = oldest; m; m = m->newer) {
+            m->chain = buckets[m->hash & (nbuckets - 1)];
+            buckets[m->hash & (nbuckets - 1)] = m;
+        }
+    }
+}
+
+/* Empties the transcendental function memo
+ *
+ * All remembered results are freed and the hit and miss counts in
+ * Calc.memo_stats are reset.  The limit set by Calc.config(:memo) is
+ * unchanged.
+ *
+ * @return [nil]
+ * @example
+ *  Calc.clear_memo #=> nil
+ */
+VALUE
+calc_clear_memo(VALUE klass)
+{
+    memo_clear();
+    hits = 0;
+    misses = 0;
+    return Qnil;
+}
+
+/* Returns statistics about the transcendental function memo
+ *
+ * The result is a hash with the number of remembered results (entries), the
+ * number of calls which found a result (hits) or had to calculate it
+ * (misses), and the maximum number of entries set by Calc.config(:memo).
+ * Nothing is counted while the memo is disabled.
+ *
+ * @return [Hash]
+ * @example
+ *  Calc.config(:memo, 1000)
+ *  2.times { Calc::Q(2).sin }
+ *  Calc.memo_stats #=> {:entries=>1, :hits=>1, :misses=>1, :limit=>1000}
+ */
+VALUE
+calc_memo_stats(VALUE klass)
+{
+    VALUE result;
+
+    result = rb_hash_new();
+    rb_hash_aset(result, ID2SYM(rb_intern("entries")), LONG2NUM(nentries));
+    rb_hash_aset(result, ID2SYM(rb_intern("hits")), LONG2NUM(hits));
+    rb_hash_aset(result, ID2SYM(rb_intern("misses")), LONG2NUM(misses));
+    rb_hash_aset(result, ID2SYM(rb_intern("limit")), LONG2NUM(memo_limit));
+    return result;
+}
@@ -0,0 +1,565 @@
+#include "calc.h"
+
+/* Document-class: Calc::ModContext
+ *
+ * Modular arithmetic with a fixed modulus.
+ *
+ * Calc::Q#pmod, Calc::Q#minv and friends take the modulus as an argument,
+ * so any setup for reducing by it is repeated on every call.  A ModContext
+ * does that setup once: a Barrett reciprocal for reducing products, and for
+ * odd moduli a libcalc REDC (Montgomery) context used for exponentiation.
+ *
+ * Arguments can be any integers and all results are Calc::Q objects, with
+ * the canonical residue chosen by Calc.config(:mod) just like Calc::Q#pmod.
+ *
+ * @example
+ *  m = Calc::ModContext.new(1000003)
+ *  m.pow(2, 1000)        #=> Calc::Q(510646)
+ *  m.pow_many([2, 3], 5) #=> [Calc::Q(32), Calc::Q(243)]
+ */
+VALUE cModContext;
+
+typedef struct {
+    NUMBER *qmod;               /* modulus as given */
+    ZVALUE mod;                 /* abs(modulus) */
+    ZVALUE mu;                  /* floor(2^(2*k) / mod) */
+    long k;                     /* mod < 2^k */
+    REDC *redc;                 /* NULL if mod is even */
+} MODCTX;
+
+static void
+cmod_free(void *p)
+{
+    MODCTX *ctx = (MODCTX *) p;
+
+    if (ctx) {
+        qfree(ctx->qmod);
+        zfree(ctx->mod);
+        zfree(ctx->mu);
+        if (ctx->redc) {
+            zredcfree(ctx->redc);
+        }
+        xfree(ctx);
+    }
+}
+
+const rb_data_type_t calc_modcontext_type = {
+    "Calc::ModContext",
+    {0, cmod_free, 0},
+    0, 0
+#ifdef RUBY_TYPED_FREE_IMMEDIATELY
+        , RUBY_TYPED_FREE_IMMEDIATELY
+#endif
+};
+
+static VALUE
+cmod_alloc(VALUE klass)
+{
+    return TypedData_Wrap_Struct(klass, &calc_modcontext_type, 0);
+}
+
+static MODCTX *
+get_ctx(VALUE self)
+{
+    MODCTX *ctx = rb_check_typeddata(self, &calc_modcontext_type);
+
+    if (!ctx) {
+        rb_raise(rb_eArgError, "uninitialized Calc::ModContext");
+    }
+    return ctx;
+}
+
+/* convert a ruby value to an integer residue in [0, mod) */
+static void
+value_to_residue(MODCTX * ctx, VALUE v, ZVALUE * res)
+{
+    NUMBER *q;
+
+    q = value_to_number(v, 0);
+    if (qisfrac(q)) {
+        qfree(q);
+        rb_raise(e_MathError, "non-integer argument for Calc::ModContext");
+    }
+    zmod(q->num, ctx->mod, res, 0);
+    qfree(q);
+}
+
+/* wrap a residue in [0, mod) as the canonical residue chosen by config
+ * "mod".  frees r. */
+static VALUE
+wrap_residue(MODCTX * ctx, ZVALUE r)
+{
+    NUMBER *q;
+
+    q = qalloc();
+    zmod(r, ctx->qmod->num, &q->num, conf->mod);
+    zfree(r);
+    return wrap_number(q);
+}
+
+/* Barrett reduction of 0 <= x < mod^2 */
+static void
+barrett_reduce(MODCTX * ctx, ZVALUE x, ZVALUE * res)
+{
+    ZVALUE q, t, r;
+
+    zshift(x, 1 - ctx->k, &t);
+    zmul(t, ctx->mu, &q);
+    zfree(t);
+    zshift(q, -1 - ctx->k, &t);
+    zfree(q);
+    zmul(t, ctx->mod, &q);
+    zfree(t);
+    zsub(x, q, &r);
+    zfree(q);
+    while (zrel(r, ctx->mod) >= 0) {
+        zsub(r, ctx->mod, &t);
+        zfree(r);
+        r = t;
+    }
+    *res = r;
+}
+
+/* multiply two residues.  for odd moduli during exponentiation, they are in
+ * REDC form. */
+static void
+ctx_mul(MODCTX * ctx, int redc, ZVALUE a, ZVALUE b, ZVALUE * res)
+{
+    ZVALUE t;
+
+    if (redc) {
+        zredcmul(ctx->redc, a, b, res);
+    }
+    else {
+        zmul(a, b, &t);
+        barrett_reduce(ctx, t, res);
+        zfree(t);
+    }
+}
+
+static void
+ctx_square(MODCTX * ctx, int redc, ZVALUE a, ZVALUE * res)
+{
+    ZVALUE t;
+
+    if (redc) {
+        zredcsquare(ctx->redc, a, res);
+    }
+    else {
+        zsquare(a, &t);
+        barrett_reduce(ctx, t, res);
+        zfree(t);
+    }
+}
+
+/* a sliding window exponent: the exponent is processed as a sequence of
+ * windows, each of which squares the accumulator some number of times and
+ * then multiplies it by an odd power of the base from a table. */
+typedef struct {
+    long width;                 /* window size in bits */
+    long count;                 /* number of windows */
+    long *squarings;            /* squarings before each window's multiply */
+    long *index;                /* table index: odd power (2 * index + 1) */
+    long trailing;              /* squarings after the last window */
+} WINDOWS;
+
+#define zbit(z, i) (((z).v[(i) / BASEB] >> ((i) % BASEB)) & 1)
+
+static void
+windows_recode(ZVALUE e, WINDOWS * w)
+{
+    long bits, i, j, k, val, pending = 0;
+
+    bits = ziszero(e) ? 1 : zhighbit(e) + 1;
+    w->width = 1 + (bits > 8) + (bits > 24) + (bits > 80) + (bits > 240) + (bits > 672);
+    w->squarings = ALLOC_N(long, bits);
+    w->index = ALLOC_N(long, bits);
+    w->count = 0;
+    i = bits - 1;
+    while (i >= 0) {
+        if (!zbit(e, i)) {
+            pending++;
+            i--;
+            continue;
+        }
+        /* longest window of at most width bits starting at i and ending in
+         * a set bit */
+        j = (i - w->width + 1 > 0) ? i - w->width + 1 : 0;
+        while (!zbit(e, j)) {
+            j++;
+        }
+        val = 0;
+        for (k = i; k >= j; k--) {
+            val = (val << 1) | zbit(e, k);
+        }
+        w->squarings[w->count] = pending + (i - j + 1);
+        w->index[w->count] = val >> 1;
+        w->count++;
+        pending = 0;
+        i = j - 1;
+    }
+    w->trailing = pending;
+}
+
+static void
+windows_free(WINDOWS * w)
+{
+    xfree(w->squarings);
+    xfree(w->index);
+}
+
+/* base^e mod m for a residue base using precomputed windows.  frees base. */
+static void
+ctx_pow(MODCTX * ctx, ZVALUE base, WINDOWS * w, ZVALUE * res)
+{
+    ZVALUE *table, b2, acc, t;
+    long i, j, size;
+    int redc;
+
+    redc = (ctx->redc != NULL);
+    if (redc) {
+        zredcencode(ctx->redc, base, &t);
+        zfree(base);
+        base = t;
+    }
+
+    /* odd powers base^1, base^3, ... base^(2^width - 1) */
+    size = 1L << (w->width - 1);
+    table = ALLOC_N(ZVALUE, size);
+    table[0] = base;
+    if (size > 1) {
+        ctx_square(ctx, redc, base, &b2);
+        for (i = 1; i < size; i++) {
+            ctx_mul(ctx, redc, table[i - 1], b2, &table[i]);
+        }
+        zfree(b2);
+    }
+
+    /* the first window needs no squarings, the accumulator being 1 */
+    zcopy(table[w->index[0]], &acc);
+    for (i = 1; i < w->count; i++) {
+        for (j = 0; j < w->squarings[i]; j++) {
+            ctx_square(ctx, redc, acc, &t);
+            zfree(acc);
+            acc = t;
+        }
+        ctx_mul(ctx, redc, acc, table[w->index[i]], &t);
+        zfree(acc);
+        acc = t;
+    }
+    for (j = 0; j < w->trailing; j++) {
+        ctx_square(ctx, redc, acc, &t);
+        zfree(acc);
+        acc = t;
+    }
+    for (i = 0; i < size; i++) {
+        zfree(table[i]);
+    }
+    xfree(table);
+
+    if (redc) {
+        zredcdecode(ctx->redc, acc, res);
+        zfree(acc);
+    }
+    else {
+        *res = acc;
+    }
+}
+
+/* ZVALUE exponent from a ruby value.  the absolute value is returned and
+ * neg is set if it was negative. */
+static void
+value_to_exponent(MODCTX * ctx, VALUE v, ZVALUE * e, int *neg)
+{
+    NUMBER *q;
+
+    q = value_to_number(v, 0);
+    if (qisfrac(q)) {
+        qfree(q);
+        rb_raise(e_MathError, "non-integer exponent for Calc::ModContext#pow");
+    }
+    zcopy(q->num, e);
+    qfree(q);
+    *neg = e->sign;
+    e->sign = 0;
+}
+
+/* inverse of residue a.  frees a.  returns FALSE if there isn't one. */
+static BOOL
+ctx_inverse(MODCTX * ctx, ZVALUE a, ZVALUE * res)
+{
+    NUMBER *qa, *qinv;
+    BOOL ok;
+
+    qa = qalloc();
+    qa->num = a;
+    qinv = qminv(qa, ctx->qmod);
+    qfree(qa);
+    ok = !qiszero(qinv) || zisunit(ctx->mod);
+    zmod(qinv->num, ctx->mod, res, 0);
+    qfree(qinv);
+    return ok;
+}
+
+/* base^e for a residue base; frees base.  returns FALSE if e is negative
+ * and base has no inverse. */
+static BOOL
+ctx_power(MODCTX * ctx, ZVALUE base, ZVALUE e, WINDOWS * w, int neg, ZVALUE * res)
+{
+    ZVALUE t;
+
+    if (neg) {
+        if (!ctx_inverse(ctx, base, &t)) {
+            zfree(t);
+            return FALSE;
+        }
+        base = t;
+    }
+    if (ziszero(e)) {
+        zfree(base);
+        zmod(_one_, ctx->mod, res, 0);
+    }
+    else {
+        ctx_pow(ctx, base, w, res);
+    }
+    return TRUE;
+}
+
+/* Creates a new modular arithmetic context
+ *
+ * @param m [Integer] the modulus
+ * @raise [Calc::MathError] if m is zero or not an integer
+ * @example
+ *  Calc::ModContext.new(101)
+ */
+static VALUE
+cmod_initialize(VALUE self, VALUE m)
+{
+    MODCTX *ctx;
+    NUMBER *q;
+    ZVALUE t;
+    setup_math_error();
+
+    q = value_to_number(m, 0);
+    if (qisfrac(q) || qiszero(q)) {
+        qfree(q);
+        rb_raise(e_MathError, "modulus for Calc::ModContext must be a non-zero integer");
+    }
+    if (DATA_PTR(self)) {
+        cmod_free(DATA_PTR(self));
+        DATA_PTR(self) = 0;
+    }
+    ctx = ALLOC(MODCTX);
+    ctx->qmod = q;
+    zcopy(q->num, &ctx->mod);
+    ctx->mod.sign = 0;
+    ctx->k = zhighbit(ctx->mod) + 1;
+    zbitvalue(2 * ctx->k, &t);
+    zquo(t, ctx->mod, &ctx->mu, 0);
+    zfree(t);
+    ctx->redc = (zisodd(ctx->mod) && !zisunit(ctx->mod)) ? zredcalloc(ctx->mod) : NULL;
+    DATA_PTR(self) = ctx;
+    return self;
+}
+
+/* Inverse modulo the context's modulus
+ *
+ * Returns the same value as Calc::Q#minv: zero if a has no inverse.
+ *
+ * @param a [Integer]
+ * @return [Calc::Q]
+ * @raise [Calc::MathError] if a is not an integer
+ * @example
+ *  Calc::ModContext.new(10).inv(3) #=> Calc::Q(7)
+ */
+static VALUE
+cmod_inv(VALUE self, VALUE a)
+{
+    MODCTX *ctx;
+    NUMBER *qa, *qresult;
+    setup_math_error();
+
+    ctx = get_ctx(self);
+    qa = value_to_number(a, 0);
+    if (qisfrac(qa)) {
+        qfree(qa);
+        rb_raise(e_MathError, "non-integer argument for Calc::ModContext");
+    }
+    qresult = qminv(qa, ctx->qmod);
+    qfree(qa);
+    return wrap_number(qresult);
+}
+
+/* Returns true if a and b are congruent modulo the context's modulus
+ *
+ * @param a [Integer]
+ * @param b [Integer]
+ * @return [Boolean]
+ * @example
+ *  Calc::ModContext.new(7).meq?(5, 33) #=> true
+ */
+static VALUE
+cmod_meqp(VALUE self, VALUE a, VALUE b)
+{
+    MODCTX *ctx;
+    ZVALUE za, zb;
+    VALUE result;
+    setup_math_error();
+
+    ctx = get_ctx(self);
+    /* check b first so a bad one doesn't leak a */
+    value_to_residue(ctx, b, &zb);
+    zfree(zb);
+    value_to_residue(ctx, a, &za);
+    value_to_residue(ctx, b, &zb);
+    result = zcmp(za, zb) ? Qfalse : Qtrue;
+    zfree(za);
+    zfree(zb);
+    return result;
+}
+
+/* Returns the modulus
+ *
+ * @return [Calc::Q]
+ * @example
+ *  Calc::ModContext.new(101).modulus #=> Calc::Q(101)
+ */
+static VALUE
+cmod_modulus(VALUE self)
+{
+    return wrap_number(qlink(get_ctx(self)->qmod));
+}
+
+/* Product modulo the context's modulus
+ *
+ * @param a [Integer]
+ * @param b [Integer]
+ * @return [Calc::Q]
+ * @raise [Calc::MathError] if a or b are not integers
+ * @example
+ *  Calc::ModContext.new(10).mul(7, 9) #=> Calc::Q(3)
+ */
+static VALUE
+cmod_mul(VALUE self, VALUE a, VALUE b)
+{
+    MODCTX *ctx;
+    ZVALUE za, zb, zresult;
+    setup_math_error();
+
+    ctx = get_ctx(self);
+    /* check b first so a bad one doesn't leak a */
+    value_to_residue(ctx, b, &zb);
+    zfree(zb);
+    value_to_residue(ctx, a, &za);
+    value_to_residue(ctx, b, &zb);
+    ctx_mul(ctx, 0, za, zb, &zresult);
+    zfree(za);
+    zfree(zb);
+    return wrap_residue(ctx, zresult);
+}
+
+/* Power modulo the context's modulus
+ *
+ * Uses sliding window exponentiation, with Montgomery multiplication for odd
+ * moduli and Barrett reduction for even ones.  The result is the same as
+ * Calc::Q#pmod.  A negative exponent raises the inverse of the base to the
+ * corresponding positive power.
+ *
+ * @param base [Integer]
+ * @param exp [Integer]
+ * @return [Calc::Q]
+ * @raise [Calc::MathError] if base or exp are not integers, or exp is
+ *  negative and base has no inverse
+ * @example
+ *  Calc::ModContext.new(10).pow(2, 3)  #=> Calc::Q(8)
+ *  Calc::ModContext.new(10).pow(3, -1) #=> Calc::Q(7)
+ */
+static VALUE
+cmod_pow(VALUE self, VALUE base, VALUE exp)
+{
+    MODCTX *ctx;
+    WINDOWS w;
+    ZVALUE zbase, zexp, zresult;
+    BOOL ok;
+    int neg;
+    setup_math_error();
+
+    ctx = get_ctx(self);
+    /* check everything first so nothing is leaked by a bad argument */
+    value_to_residue(ctx, base, &zbase);
+    zfree(zbase);
+    value_to_exponent(ctx, exp, &zexp, &neg);
+    value_to_residue(ctx, base, &zbase);
+    windows_recode(zexp, &w);
+    ok = ctx_power(ctx, zbase, zexp, &w, neg, &zresult);
+    windows_free(&w);
+    zfree(zexp);
+    if (!ok) {
+        rb_raise(e_MathError, "base has no inverse for negative exponent");
+    }
+    return wrap_residue(ctx, zresult);
+}
+
+/* Raises many bases to the same power
+ *
+ * Equivalent to bases.map { |b| pow(b, exp) }, but the exponent is only
+ * recoded into windows once.
+ *
+ * @param bases [Array<Integer>]
+ * @param exp [Integer]
+ * @return [Array<Calc::Q>]
+ * @raise [Calc::MathError] if any base or exp are not integers
+ * @example
+ *  Calc::ModContext.new(10).pow_many([2, 3, 4], 2) #=> [Calc::Q(4), Calc::Q(9), Calc::Q(6)]
+ */
+static VALUE
+cmod_pow_many(VALUE self, VALUE bases, VALUE exp)
+{
+    MODCTX *ctx;
+    WINDOWS w;
+    ZVALUE zbase, zexp, zresult;
+    VALUE result;
+    long i;
+    BOOL ok;
+    int neg;
+    setup_math_error();
+
+    ctx = get_ctx(self);
+    Check_Type(bases, T_ARRAY);
+    /* check everything first so nothing is leaked by a bad argument */
+    for (i = 0; i < RARRAY_LEN(bases); i++) {
+        value_to_residue(ctx, RARRAY_AREF(bases, i), &zbase);
+        zfree(zbase);
+    }
+    value_to_exponent(ctx, exp, &zexp, &neg);
+    windows_recode(zexp, &w);
+    result = rb_ary_new2(RARRAY_LEN(bases));
+    ok = TRUE;
+    for (i = 0; ok && i < RARRAY_LEN(bases); i++) {
+        value_to_residue(ctx, RARRAY_AREF(bases, i), &zbase);
+        ok = ctx_power(ctx, zbase, zexp, &w, neg, &zresult);
+        if (ok) {
+            rb_ary_push(result, wrap_residue(ctx, zresult));
+        }
+    }
+    windows_free(&w);
+    zfree(zexp);
+    if (!ok) {
+        rb_raise(e_MathError, "base has no inverse for negative exponent");
+    }
+    return result;
+}
+
+void
+define_calc_modcontext(VALUE m)
+{
+    cModContext = rb_define_class_under(m, "ModContext", rb_cObject);
+    rb_define_alloc_func(cModContext, cmod_alloc);
+    rb_define_method(cModContext, "initialize", cmod_initialize, 1);
+    rb_define_method(cModContext, "inv", cmod_inv, 1);
+    rb_define_method(cModContext, "meq?", cmod_meqp, 2);
+    rb_define_method(cModContext, "modulus", cmod_modulus, 0);
+    rb_define_method(cModContext, "mul", cmod_mul, 2);
+    rb_define_method(cModContext, "pow", cmod_pow, 2);
+    rb_define_method(cModContext, "pow_many", cmod_pow_many, 2);
+}
@@ -0,0 +1,160 @@
+#include "calc.h"
+
+/* Montgomery multiplication on plain arrays of HALFs.
+ *
+ * libcalc's REDC functions can't be used without the GVL (see parallel.c),
+ * so code which runs modular arithmetic on other threads, ie Calc.ptest_many
+ * and the ECM stage of Calc::Q#factorize, uses these instead.  Numbers are
+ * little endian arrays of len HALFs, all reduced modulo an odd n of the same
+ * length.  None of these functions allocate memory.
+ */
+
+/* compares a and b, returning -1, 0 or 1 */
+int
+limb_cmp(const HALF * a, const HALF * b, LEN len)
+{
+    while (len-- > 0) {
+        if (a[len] != b[len]) {
+            return a[len] < b[len] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/* a += b, returning the carry */
+HALF
+limb_add(HALF * a, const HALF * b, LEN len)
+{
+    FULL carry = 0;
+    LEN i;
+
+    for (i = 0; i < len; i++) {
+        carry += (FULL) a[i] + b[i];
+        a[i] = (HALF) carry;
+        carry >>= BASEB;
+    }
+    return (HALF) carry;
+}
+
+/* a -= b, returning the borrow */
+HALF
+limb_sub(HALF * a, const HALF * b, LEN len)
+{
+    FULL borrow = 0, d;
+    LEN i;
+
+    for (i = 0; i < len; i++) {
+        d = (FULL) a[i] - b[i] - borrow;
+        a[i] = (HALF) d;
+        borrow = (d >> BASEB) & 1;
+    }
+    return (HALF) borrow;
+}
+
+/* a = 2a mod n, for a < n */
+void
+mod_double(HALF * a, const HALF * n, LEN len)
+{
+    HALF top = a[len - 1] >> (BASEB - 1);
+    LEN i;
+
+    for (i = len - 1; i > 0; i--) {
+        a[i] = (a[i] << 1) | (a[i - 1] >> (BASEB - 1));
+    }
+    a[0] <<= 1;
+    if (top || limb_cmp(a, n, len) >= 0) {
+        limb_sub(a, n, len);
+    }
+}
+
+/* r = a + b mod n, for a, b < n.  r may be a or b. */
+void
+mod_add(const HALF * a, const HALF * b, const HALF * n, LEN len, HALF * r)
+{
+    HALF carry;
+
+    if (r != a) {
+        memmove(r, a, len * sizeof(HALF));
+    }
+    carry = limb_add(r, b == r ? a : b, len);
+    if (carry || limb_cmp(r, n, len) >= 0) {
+        limb_sub(r, n, len);
+    }
+}
+
+/* r = a - b mod n, for a, b < n.  r may be a but not b. */
+void
+mod_sub(const HALF * a, const HALF * b, const HALF * n, LEN len, HALF * r)
+{
+    if (r != a) {
+        memmove(r, a, len * sizeof(HALF));
+    }
+    if (limb_sub(r, b, len)) {
+        limb_add(r, n, len);
+    }
+}
+
+/* returns -1/n mod 2^BASEB, for odd n, by Newton's iteration */
+HALF
+mont_ninv(const HALF * n)
+{
+    HALF ninv = n[0];
+    int i;
+
+    for (i = 0; i < 5; i++) {
+        ninv *= 2 - n[0] * ninv;
+    }
+    return -ninv;
+}
+
+/* one = R mod n, where R = 2^(BASEB * len), ie 1 in Montgomery form */
+void
+mont_one(HALF * one, const HALF * n, LEN len)
+{
+    long i;
+
+    memset(one, 0, len * sizeof(HALF));
+    one[0] = 1;
+    for (i = 0; i < (long) len * BASEB; i++) {
+        mod_double(one, n, len);
+    }
+}
+
+/* r = a * b / R mod n, where R = 2^(BASEB * len) and ninv = -1/n mod
+ * 2^BASEB.  t is scratch space of len + 2 HALFs; r may be a or b. */
+void
+mont_mul(const HALF * a, const HALF * b, const HALF * n, LEN len, HALF ninv, HALF * t,
+         HALF * r)
+{
+    FULL c;
+    HALF m;
+    LEN i, j;
+
+    memset(t, 0, (len + 2) * sizeof(HALF));
+    for (i = 0; i < len; i++) {
+        c = 0;
+        for (j = 0; j < len; j++) {
+            c += (FULL) a[j] * b[i] + t[j];
+            t[j] = (HALF) c;
+            c >>= BASEB;
+        }
+        c += t[len];
+        t[len] = (HALF) c;
+        t[len + 1] = (HALF) (c >> BASEB);
+
+        m = t[0] * ninv;
+        c = ((FULL) m * n[0] + t[0]) >> BASEB;
+        for (j = 1; j < len; j++) {
+            c += (FULL) m * n[j] + t[j];
+            t[j - 1] = (HALF) c;
+            c >>= BASEB;
+        }
+        c += t[len];
+        t[len - 1] = (HALF) c;
+        t[len] = t[len + 1] + (HALF) (c >> BASEB);
+    }
+    if (t[len] || limb_cmp(t, n, len) >= 0) {
+        limb_sub(t, n, len);
+    }
+    memcpy(r, t, len * sizeof(HALF));
+}
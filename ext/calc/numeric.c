@@ -30,19 +30,19 @@ log_function(int argc, VALUE * argv, VALUE self, NUMBER * (fq) (NUMBER *, NUMBER
         qself = DATA_PTR(self);
         if (!qisneg(qself) && !qiszero(qself)) {
             result = cq_new();
-            DATA_PTR(result) = (*fq) (qself, qepsilon ? qepsilon : conf->epsilon);
+            DATA_PTR(result) = memo_qfunc(fq, qself, qepsilon ? qepsilon : conf->epsilon);
         }
         else {
             cself = comalloc();
             qfree(cself->real);
             cself->real = qlink(qself);
-            result = wrap_complex((*fc) (cself, qepsilon ? qepsilon : conf->epsilon));
+            result = wrap_complex(memo_cfunc(fc, cself, qepsilon ? qepsilon : conf->epsilon));
             comfree(cself);
         }
     }
     else if (CALC_C_P(self)) {
         cself = DATA_PTR(self);
-        result = wrap_complex((*fc) (cself, qepsilon ? qepsilon : conf->epsilon));
+        result = wrap_complex(memo_cfunc(fc, cself, qepsilon ? qepsilon : conf->epsilon));
     }
     else {
         rb_raise(e_MathError, "log_function called with invalid receiver");
@@ -192,6 +192,29 @@ cn_cmp(VALUE self, VALUE other)
     return result;
 }
 
+/* product of (c - i) for lo <= i < hi, as a balanced product tree */
+static COMPLEX *
+c_falling_product(COMPLEX * c, long lo, long hi)
+{
+    COMPLEX *left, *right, *res;
+    NUMBER *q;
+    long mid;
+
+    if (hi - lo == 1) {
+        q = itoq(-lo);
+        res = c_addq(c, q);
+        qfree(q);
+        return res;
+    }
+    mid = lo + (hi - lo) / 2;
+    left = c_falling_product(c, lo, mid);
+    right = c_falling_product(c, mid, hi);
+    res = c_mul(left, right);
+    comfree(left);
+    comfree(right);
+    return res;
+}
+
 /* combinatorial number
  *
  * Returns the number of combinations in which `other` things may be chosen
@@ -210,8 +233,8 @@ static VALUE
 cn_comb(VALUE self, VALUE other)
 {
     VALUE result;
-    NUMBER *qother, *qresult, *qdiv, *qtmp;
-    COMPLEX *cresult, *ctmp1, *ctmp2;
+    NUMBER *qother, *qresult, *qtmp;
+    COMPLEX *cresult, *ctmp;
     long n;
     setup_math_error();
 
@@ -237,7 +260,7 @@ cn_comb(VALUE self, VALUE other)
         return self;
     }
     else if (CALC_Q_P(self)) {
-        qresult = qcomb(DATA_PTR(self), qother);
+        qresult = qcomb_fast(DATA_PTR(self), qother);
         qfree(qother);
         if (qresult == NULL) {
             rb_raise(e_MathError, "argument too large for comb");
@@ -246,36 +269,22 @@ cn_comb(VALUE self, VALUE other)
         DATA_PTR(result) = qresult;
         return result;
     }
-    /* if here, self is a Calc::C and qother is integer > 1.  algorithm based
-     * on calc's func.c, but only for COMPLEX*. */
+    /* if here, self is a Calc::C and qother is integer > 1.  the product of
+     * self - i for i in 0...other is divided by other! */
     if (zge24b(qother->num)) {
         qfree(qother);
         rb_raise(e_MathError, "argument too large for comb");
     }
     n = qtoi(qother);
-    cresult = clink((COMPLEX *) DATA_PTR(self));
-    ctmp1 = c_addq((COMPLEX *) DATA_PTR(self), &_qnegone_);
-    qdiv = qlink(&_qtwo_);
-    n--;
-    for (;;) {
-        ctmp2 = c_mul(cresult, ctmp1);
-        comfree(cresult);
-        cresult = c_divq(ctmp2, qdiv);
-        comfree(ctmp2);
-        if (--n == 0 || ciszero(cresult)) {
-            comfree(ctmp1);
-            qfree(qdiv);
-            result = cc_new();
-            DATA_PTR(result) = cresult;
-            return result;
-        }
-        ctmp2 = c_addq(ctmp1, &_qnegone_);
-        comfree(ctmp1);
-        ctmp1 = ctmp2;
-        qtmp = qinc(qdiv);
-        qfree(qdiv);
-        qdiv = qtmp;
-    }
+    ctmp = c_falling_product((COMPLEX *) DATA_PTR(self), 0, n);
+    qtmp = qfact_fast(qother);
+    qfree(qother);
+    cresult = c_divq(ctmp, qtmp);
+    comfree(ctmp);
+    qfree(qtmp);
+    result = cc_new();
+    DATA_PTR(result) = cresult;
+    return result;
 }
 
 /* floor of logarithm to specified integer base
@@ -335,7 +344,7 @@ cn_ilog(VALUE self, VALUE base)
 static VALUE
 cn_ln(int argc, VALUE * argv, VALUE self)
 {
-    return log_function(argc, argv, self, &qln, &c_ln);
+    return log_function(argc, argv, self, &qln_cached, &c_ln);
 }
 
 /* Base 10 logarithm
@@ -581,7 +590,7 @@ cn_sqrt(int argc, VALUE * argv, VALUE self)
     if (CALC_Q_P(self) && !qisneg((NUMBER *) DATA_PTR(self))) {
         /* non-negative rational */
         result = cq_new();
-        DATA_PTR(result) = qsqrt(DATA_PTR(self), qepsilon, R);
+        DATA_PTR(result) = memo_qsqrt(DATA_PTR(self), qepsilon, R);
     }
     else {
         if (CALC_Q_P(self)) {
@@ -589,12 +598,12 @@ cn_sqrt(int argc, VALUE * argv, VALUE self)
             qtmp = qneg(DATA_PTR(self));
             cresult = comalloc();
             qfree(cresult->imag);
-            cresult->imag = qsqrt(qtmp, qepsilon, R);
+            cresult->imag = memo_qsqrt(qtmp, qepsilon, R);
             qfree(qtmp);
         }
         else {
             /* complex */
-            cresult = c_sqrt(DATA_PTR(self), qepsilon, R);
+            cresult = memo_csqrt(DATA_PTR(self), qepsilon, R);
         }
         result = wrap_complex(cresult);
     }
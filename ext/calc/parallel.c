@@ -0,0 +1,85 @@
+#include "calc.h"
+#ifdef HAVE_RUBY_THREAD_H
+#include "ruby/thread.h"
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+/* Running long calculations without the GVL, optionally on several threads.
+ *
+ * libcalc is not thread safe (it has static scratch buffers and reports
+ * errors by longjmp), and the ruby API can't be used without the GVL, so only
+ * plain C code working on memory allocated beforehand may run this way.
+ *
+ * The number of threads is set by Calc.config(:threads).  Without pthreads
+ * the pieces of work run one after another.
+ */
+
+long calc_threads = 1;
+
+/* runs fn(args[i]) for 0 <= i < n, each on its own thread if there is more
+ * than one.  callers split their work into at most calc_threads pieces. */
+void
+parallel_run(void *(*fn) (void *), void **args, int n)
+{
+#ifdef HAVE_PTHREAD_H
+    pthread_t *tids;
+    int *started, i;
+
+    if (n > 1) {
+        tids = malloc(n * sizeof(pthread_t));
+        started = calloc(n, sizeof(int));
+        if (tids && started) {
+            for (i = 1; i < n; i++) {
+                started[i] = (pthread_create(&tids[i], NULL, fn, args[i]) == 0);
+            }
+            (*fn) (args[0]);
+            for (i = 1; i < n; i++) {
+                if (started[i]) {
+                    pthread_join(tids[i], NULL);
+                }
+                else {
+                    (*fn) (args[i]);
+                }
+            }
+            free(tids);
+            free(started);
+            return;
+        }
+        free(tids);
+        free(started);
+    }
+#endif
+    for (; n > 0; n--, args++) {
+        (*fn) (*args);
+    }
+}
+
+#ifdef HAVE_RUBY_THREAD_H
+static void
+set_cancel(void *cancel)
+{
+    *(volatile int *) cancel = 1;
+}
+#endif
+
+/* calls fn(data) without the GVL, so other ruby threads can run meanwhile.
+ *
+ * if the ruby thread is interrupted, *cancel is set; fn should check it
+ * regularly and return early if it is set.  a pending exception (eg
+ * Interrupt) is then raised, otherwise fn is called again from the start. */
+void
+call_without_gvl(void *(*fn) (void *), void *data, volatile int *cancel)
+{
+#ifdef HAVE_RUBY_THREAD_H
+    do {
+        *cancel = 0;
+        rb_thread_call_without_gvl(fn, data, set_cancel, (void *) cancel);
+        rb_thread_check_ints();
+    } while (*cancel);
+#else
+    *cancel = 0;
+    (*fn) (data);
+#endif
+}
@@ -0,0 +1,440 @@
+#include <math.h>
+#include "calc.h"
+
+/* Prime counting function for arguments beyond libcalc's 2^32 limit.
+ *
+ * Uses the Lagarias-Miller-Odlyzko version of the Meissel-Lehmer method.
+ * With y a little more than x^(1/3), a = pi(y) and z = x / y:
+ *
+ *   pi(x) = phi(x, a) + a - 1 - P2(x, a)
+ *
+ * where phi(x, a) counts the integers <= x with no prime factor <= p_a, and
+ * P2 counts those with exactly two such prime factors.  phi(x, a) is split
+ * into the "ordinary leaves" S1, a simple sum over n <= y, and the "special
+ * leaves" S2, which need phi(x / n, b) for many x / n < z.  Those are
+ * counted by sieving [1, z) in segments and removing the multiples of each
+ * prime in turn, with a binary indexed tree to count what remains below any
+ * point of the segment.  P2 needs pi(x / p) for the primes y < p <= sqrt(x),
+ * also found by sieving up to z.
+ *
+ * Both sieves are split into Calc.config(:threads) pieces.  Each piece of
+ * the S2 sieve counts phi from the start of its piece; the counts are
+ * combined afterwards using the number of leaves that used each phi(., b).
+ *
+ * All memory is allocated before the calculation starts, which then runs
+ * without the GVL.
+ */
+
+/* largest supported argument is 2^PIX_MAX_BITS - 1; this keeps the sums
+ * well within 64 bits */
+#define PIX_MAX_BITS 56
+
+typedef struct pixpiece PIXPIECE;
+
+typedef struct {
+    int64_t x;
+    int64_t y;
+    int64_t z;
+    int64_t a;                  /* pi(y) */
+    int64_t sqrtx;
+    int64_t pisqrtx;            /* pi(sqrt(x)) */
+    const uint32_t *primes;     /* primes <= sqrt(x); primes[0] is 2 */
+    const int32_t *lpf;         /* least prime factor of 2..y */
+    const signed char *mu;      /* moebius function of 1..y */
+    PIXPIECE *pieces;           /* one per thread */
+    int npieces;
+    volatile int cancel;
+    int64_t result;
+} PIX;
+
+struct pixpiece {
+    PIX *px;
+    int64_t low;                /* this piece of the sieve is [low, high) */
+    int64_t high;
+    int64_t sum;                /* contribution, assuming counts start at 0 */
+    int64_t count;              /* P2: primes in [low, high) */
+    int64_t leaves;             /* P2: number of x / p in [low, high) */
+    int64_t *phi;               /* S2: numbers left in [low, high) after sieving by b primes */
+    int64_t *musum;             /* S2: sum of -mu(m) for leaves using phi[b] */
+    int64_t *next;              /* S2: next multiple of each prime to cross off */
+    unsigned char *sieve;
+    int32_t *tree;
+    int64_t segment;            /* segment size */
+};
+
+#define PRIME(px, b) ((int64_t) (px)->primes[(b) - 1])
+
+static int64_t
+isqrt64(int64_t x)
+{
+    int64_t r = (int64_t) sqrt((double) x);
+
+    while (r * r > x) {
+        r--;
+    }
+    while ((r + 1) * (r + 1) <= x) {
+        r++;
+    }
+    return r;
+}
+
+static int64_t
+icbrt64(int64_t x)
+{
+    int64_t r = (int64_t) cbrt((double) x);
+
+    while (r * r * r > x) {
+        r--;
+    }
+    while ((r + 1) * (r + 1) * (r + 1) <= x) {
+        r++;
+    }
+    return r;
+}
+
+/* binary indexed tree over the sieve segment, counting unsieved numbers */
+
+static void
+tree_init(int32_t * tree, const unsigned char *sieve, int64_t n)
+{
+    int64_t i, j;
+
+    for (i = 1; i <= n; i++) {
+        tree[i] = sieve[i - 1];
+    }
+    for (i = 1; i <= n; i++) {
+        j = i + (i & -i);
+        if (j <= n) {
+            tree[j] += tree[i];
+        }
+    }
+}
+
+static void
+tree_remove(int32_t * tree, int64_t n, int64_t pos)
+{
+    for (pos++; pos <= n; pos += pos & -pos) {
+        tree[pos]--;
+    }
+}
+
+/* number of unsieved numbers at positions 0..pos */
+static int64_t
+tree_count(const int32_t * tree, int64_t pos)
+{
+    int64_t sum = 0;
+
+    for (pos++; pos > 0; pos -= pos & -pos) {
+        sum += tree[pos];
+    }
+    return sum;
+}
+
+/* S2 for one piece of [1, z) */
+static void *
+s2_piece(void *arg)
+{
+    PIXPIECE *pp = (PIXPIECE *) arg;
+    PIX *px = pp->px;
+    int64_t low, high, n, b, p, k, m, min_m, max_m;
+
+    pp->sum = 0;
+    for (b = 1; b <= px->a; b++) {
+        p = PRIME(px, b);
+        pp->next[b] = ((pp->low + p - 1) / p) * p;
+        pp->phi[b] = 0;
+        pp->musum[b] = 0;
+    }
+    for (low = pp->low; low < pp->high; low += pp->segment) {
+        if (px->cancel) {
+            return NULL;
+        }
+        high = low + pp->segment < pp->high ? low + pp->segment : pp->high;
+        n = high - low;
+        memset(pp->sieve, 1, n);
+        tree_init(pp->tree, pp->sieve, n);
+        for (b = 1; b < px->a; b++) {
+            /* leaves x / (p * m) in [low, high) with y < p * m, m <= y and
+             * lpf(m) > p */
+            p = PRIME(px, b);
+            min_m = px->x / (p * high);
+            if (min_m < px->y / p) {
+                min_m = px->y / p;
+            }
+            max_m = px->x / (p * low);
+            if (max_m > px->y) {
+                max_m = px->y;
+            }
+            if (p >= max_m) {
+                break;
+            }
+            for (m = max_m; m > min_m; m--) {
+                if (px->mu[m] != 0 && p < px->lpf[m]) {
+                    pp->sum -= px->mu[m] * (pp->phi[b] + tree_count(pp->tree,
+                                                                    px->x / (p * m) - low));
+                    pp->musum[b] -= px->mu[m];
+                }
+            }
+            pp->phi[b] += tree_count(pp->tree, n - 1);
+
+            /* remove multiples of p */
+            for (k = pp->next[b]; k < high; k += p) {
+                if (pp->sieve[k - low]) {
+                    pp->sieve[k - low] = 0;
+                    tree_remove(pp->tree, n, k - low);
+                }
+            }
+            pp->next[b] = k;
+        }
+    }
+    return NULL;
+}
+
+/* P2 for one piece of (sqrt(x), z] */
+static void *
+p2_piece(void *arg)
+{
+    PIXPIECE *pp = (PIXPIECE *) arg;
+    PIX *px = pp->px;
+    int64_t low, high, i, k, p, b, v, pos;
+
+    pp->sum = pp->count = pp->leaves = 0;
+
+    /* the largest b with x / p_b >= low; x / p_b increases as b decreases */
+    b = px->pisqrtx;
+    while (b > px->a && px->x / PRIME(px, b) < pp->low) {
+        b--;
+    }
+    for (low = pp->low; low < pp->high; low += pp->segment) {
+        if (px->cancel) {
+            return NULL;
+        }
+        high = low + pp->segment < pp->high ? low + pp->segment : pp->high;
+        memset(pp->sieve, 1, high - low);
+        for (i = 1; i <= px->pisqrtx; i++) {
+            p = PRIME(px, i);
+            if (p * p >= high) {
+                break;
+            }
+            k = ((low + p - 1) / p) * p;
+            if (k < p * p) {
+                k = p * p;
+            }
+            for (; k < high; k += p) {
+                pp->sieve[k - low] = 0;
+            }
+        }
+        pos = low;
+        while (b > px->a && (v = px->x / PRIME(px, b)) < high) {
+            for (; pos <= v; pos++) {
+                pp->count += pp->sieve[pos - low];
+            }
+            pp->sum += pp->count;
+            pp->leaves++;
+            b--;
+        }
+        for (; pos < high; pos++) {
+            pp->count += pp->sieve[pos - low];
+        }
+    }
+    return NULL;
+}
+
+/* splits [low, high) into px->npieces pieces and runs fn on each */
+static void
+run_pieces(PIX * px, void *(*fn) (void *), int64_t low, int64_t high)
+{
+    PIXPIECE *pp = px->pieces;
+    void **args;
+    int64_t size;
+    int i;
+
+    args = malloc(px->npieces * sizeof(void *));
+    if (!args) {
+        px->npieces = 1;
+    }
+    size = (high - low + px->npieces - 1) / px->npieces;
+    for (i = 0; i < px->npieces; i++) {
+        pp[i].px = px;
+        pp[i].low = low + i * size < high ? low + i * size : high;
+        pp[i].high = pp[i].low + size < high ? pp[i].low + size : high;
+    }
+    if (args) {
+        for (i = 0; i < px->npieces; i++) {
+            args[i] = &pp[i];
+        }
+        parallel_run(fn, args, px->npieces);
+        free(args);
+    }
+    else {
+        (*fn) (pp);
+    }
+}
+
+static void *
+pix_calculate(void *arg)
+{
+    PIX *px = (PIX *) arg;
+    PIXPIECE *pp = px->pieces;
+    int64_t s1, s2, p2, *phi, n, b;
+    int i;
+
+    /* ordinary leaves */
+    s1 = 0;
+    for (n = 1; n <= px->y; n++) {
+        s1 += px->mu[n] * (px->x / n);
+    }
+
+    /* special leaves; pieces after the first add their leaves' share of
+     * the counts from the pieces before them */
+    run_pieces(px, s2_piece, 1, px->z + 1);
+    if (px->cancel) {
+        return NULL;
+    }
+    phi = pp[0].phi;
+    s2 = pp[0].sum;
+    for (i = 1; i < px->npieces; i++) {
+        s2 += pp[i].sum;
+        for (b = 1; b < px->a; b++) {
+            s2 += pp[i].musum[b] * phi[b];
+            phi[b] += pp[i].phi[b];
+        }
+    }
+
+    /* P2 = sum of pi(x / p_b) - b + 1 for a < b <= pi(sqrt(x)).  x / p_b is
+     * at least sqrt(x), so count primes from there. */
+    run_pieces(px, p2_piece, px->sqrtx, px->z + 1);
+    if (px->cancel) {
+        return NULL;
+    }
+    p2 = 0;
+    n = px->pisqrtx;
+    if (PRIME(px, n) == px->sqrtx) {
+        n--;
+    }
+    for (i = 0; i < px->npieces; i++) {
+        p2 += pp[i].sum + pp[i].leaves * n;
+        n += pp[i].count;
+    }
+    p2 -= (px->a + px->pisqrtx - 1) * (px->pisqrtx - px->a) / 2;
+
+    px->result = s1 + s2 + px->a - 1 - p2;
+    return NULL;
+}
+
+/* alpha = y / x^(1/3), balancing the S2 sieve (which shrinks as y grows)
+ * against the number of special leaves (which grows with y) */
+static double
+pix_alpha(int64_t x)
+{
+    double l = log((double) x);
+    double alpha = l * l / 300.0;
+
+    return alpha < 1.0 ? 1.0 : alpha;
+}
+
+static VALUE
+pix_run(VALUE arg)
+{
+    PIX *px = (PIX *) arg;
+    PIXPIECE *pp;
+    int i;
+
+    for (i = 0; i < px->npieces; i++) {
+        pp = &px->pieces[i];
+        pp->sieve = ALLOC_N(unsigned char, pp->segment);
+        pp->tree = ALLOC_N(int32_t, pp->segment + 1);
+        pp->phi = ALLOC_N(int64_t, px->a + 1);
+        pp->musum = ALLOC_N(int64_t, px->a + 1);
+        pp->next = ALLOC_N(int64_t, px->a + 1);
+    }
+    call_without_gvl(pix_calculate, px, &px->cancel);
+    return Qnil;
+}
+
+/* frees everything pix_large() allocated, including when the calculation
+ * is interrupted */
+static VALUE
+pix_free(VALUE arg)
+{
+    PIX *px = (PIX *) arg;
+    int i;
+
+    for (i = 0; i < px->npieces; i++) {
+        xfree(px->pieces[i].sieve);
+        xfree(px->pieces[i].tree);
+        xfree(px->pieces[i].phi);
+        xfree(px->pieces[i].musum);
+        xfree(px->pieces[i].next);
+    }
+    xfree(px->pieces);
+    xfree((void *) px->lpf);
+    xfree((void *) px->mu);
+    xfree((void *) px->primes);
+    return Qnil;
+}
+
+/* returns pi(x) for 2^32 <= x < 2^PIX_MAX_BITS, or -1 if x is too large */
+int64_t
+pix_large(int64_t x)
+{
+    PIX px;
+    uint32_t *primes;
+    int32_t *lpf;
+    signed char *mu;
+    long count;
+    int64_t i, j, p, segment;
+
+    if (x < 0 || (x >> PIX_MAX_BITS) != 0) {
+        return -1;
+    }
+    px.x = x;
+    px.sqrtx = isqrt64(x);
+    px.y = (int64_t) (pix_alpha(x) * icbrt64(x));
+    if (px.y > px.sqrtx) {
+        px.y = px.sqrtx;
+    }
+    px.z = x / px.y;
+
+    primes = prime_sieve(px.sqrtx, &count);
+    px.primes = primes;
+    px.pisqrtx = count;
+    for (px.a = 0; px.a < count && primes[px.a] <= px.y; px.a++);
+
+    /* least prime factor and moebius function up to y */
+    lpf = ALLOC_N(int32_t, px.y + 1);
+    mu = ALLOC_N(signed char, px.y + 1);
+    for (i = 0; i <= px.y; i++) {
+        lpf[i] = INT32_MAX;
+        mu[i] = 1;
+    }
+    for (i = 0; i < px.a; i++) {
+        p = primes[i];
+        for (j = p; j <= px.y; j += p) {
+            if (lpf[j] == INT32_MAX) {
+                lpf[j] = (int32_t) p;
+            }
+            mu[j] = -mu[j];
+        }
+        for (j = p * p; j <= px.y; j += p * p) {
+            mu[j] = 0;
+        }
+    }
+    px.lpf = lpf;
+    px.mu = mu;
+
+    px.npieces = calc_threads > 0 ? (int) calc_threads : 1;
+    segment = 1;
+    while (segment * segment < px.z) {
+        segment <<= 1;
+    }
+    if (segment < 1024) {
+        segment = 1024;
+    }
+    px.pieces = ZALLOC_N(PIXPIECE, px.npieces);
+    for (i = 0; i < px.npieces; i++) {
+        px.pieces[i].segment = segment;
+    }
+    rb_ensure(pix_run, (VALUE) & px, pix_free, (VALUE) & px);
+    return px.result;
+}
@@ -0,0 +1,173 @@
+#include "calc.h"
+
+/* Document-class: Calc::Polynomial
+ *
+ * Polynomial with Calc::Q coefficients.
+ *
+ * Most of the class is implemented in ruby (lib/calc/polynomial.rb); the
+ * extension provides Kronecker substitution, which turns a polynomial
+ * product into a single large integer multiplication.
+ */
+VALUE cPolynomial;
+
+/* number of bits needed for the largest absolute value of any integer in ary.
+ * raises an error if any element isn't an integer. */
+static long
+max_coefficient_bits(VALUE ary)
+{
+    NUMBER *q;
+    long i, bits, max = 0;
+
+    for (i = 0; i < RARRAY_LEN(ary); i++) {
+        q = value_to_number(RARRAY_AREF(ary, i), 0);
+        if (qisfrac(q)) {
+            qfree(q);
+            rb_raise(e_MathError, "non-integer coefficient for kronecker_mul");
+        }
+        bits = qiszero(q) ? 0 : zhighbit(q->num) + 1;
+        qfree(q);
+        if (bits > max) {
+            max = bits;
+        }
+    }
+    return max;
+}
+
+/* evaluate the integer polynomial in ary at 2^(BASEB*w).  each coefficient
+ * fits in w HALFs, so positive and negative coefficients can be copied
+ * straight into the limbs of two integers which are then subtracted. */
+static void
+kronecker_pack(VALUE ary, long w, ZVALUE * res)
+{
+    ZVALUE pos, neg;
+    NUMBER *q;
+    LEN len;
+    long i;
+
+    len = (LEN) (RARRAY_LEN(ary) * w);
+    pos.v = alloc(len);
+    neg.v = alloc(len);
+    memset(pos.v, 0, len * sizeof(HALF));
+    memset(neg.v, 0, len * sizeof(HALF));
+    pos.len = neg.len = len;
+    pos.sign = neg.sign = 0;
+    for (i = 0; i < RARRAY_LEN(ary); i++) {
+        q = value_to_number(RARRAY_AREF(ary, i), 0);
+        if (!qiszero(q)) {
+            memcpy((qisneg(q) ? neg.v : pos.v) + i * w, q->num.v, q->num.len * sizeof(HALF));
+        }
+        qfree(q);
+    }
+    ztrim(&pos);
+    ztrim(&neg);
+    zsub(pos, neg, res);
+    zfree(pos);
+    zfree(neg);
+}
+
+/* split z back into count signed coefficients of w HALFs each.  a chunk with
+ * its top bit set represents a negative coefficient, which borrows one from
+ * the next chunk. */
+static VALUE
+kronecker_unpack(ZVALUE z, long count, long w)
+{
+    VALUE result;
+    ZVALUE chunk, tmp, half, full;
+    NUMBER *q;
+    long i, offset, n;
+    int borrow = 0;
+
+    result = rb_ary_new2(count);
+    zbitvalue(BASEB * w - 1, &half);
+    zbitvalue(BASEB * w, &full);
+    for (i = 0; i < count; i++) {
+        offset = i * w;
+        n = (z.len > offset) ? z.len - offset : 0;
+        if (n > w) {
+            n = w;
+        }
+        chunk.v = alloc((LEN) w);
+        memset(chunk.v, 0, w * sizeof(HALF));
+        if (n > 0) {
+            memcpy(chunk.v, z.v + offset, n * sizeof(HALF));
+        }
+        chunk.len = (LEN) w;
+        chunk.sign = 0;
+        ztrim(&chunk);
+        if (borrow) {
+            zadd(chunk, _one_, &tmp);
+            zfree(chunk);
+            chunk = tmp;
+        }
+        borrow = (zrel(chunk, half) >= 0);
+        if (borrow) {
+            zsub(chunk, full, &tmp);
+            zfree(chunk);
+            chunk = tmp;
+        }
+        if (z.sign && !ziszero(chunk)) {
+            chunk.sign = !chunk.sign;
+        }
+        q = qalloc();
+        q->num = chunk;
+        rb_ary_push(result, wrap_number(q));
+    }
+    zfree(half);
+    zfree(full);
+    return result;
+}
+
+/* Multiplies two integer polynomials using Kronecker substitution
+ *
+ * Both arguments are arrays of integer coefficients, lowest degree first.
+ * Each polynomial is evaluated at a power of two large enough that the
+ * coefficients of the product can't overlap, the two resulting integers are
+ * multiplied, and the product's coefficients are read back out of the
+ * result.
+ *
+ * @param a [Array<Integer,Calc::Q>]
+ * @param b [Array<Integer,Calc::Q>]
+ * @return [Array<Calc::Q>]
+ * @raise [Calc::MathError] if any coefficient is not an integer
+ * @example
+ *  Calc::Polynomial.kronecker_mul([1, 1], [-1, 1]) #=> [Calc::Q(-1), Calc::Q(0), Calc::Q(1)]
+ */
+static VALUE
+cpoly_kronecker_mul(VALUE klass, VALUE a, VALUE b)
+{
+    VALUE result;
+    ZVALUE za, zb, zresult;
+    long bits, w, la, lb;
+    setup_math_error();
+
+    Check_Type(a, T_ARRAY);
+    Check_Type(b, T_ARRAY);
+    la = RARRAY_LEN(a);
+    lb = RARRAY_LEN(b);
+    if (la == 0 || lb == 0) {
+        return rb_ary_new();
+    }
+    /* each product coefficient is a sum of min(la, lb) products; w is then
+     * chosen with at least one spare bit for the sign */
+    bits = max_coefficient_bits(a) + max_coefficient_bits(b) + 1;
+    for (w = (la < lb) ? la : lb; w > 1; w >>= 1) {
+        bits++;
+    }
+    w = bits / BASEB + 1;
+
+    kronecker_pack(a, w, &za);
+    kronecker_pack(b, w, &zb);
+    zmul_fast(za, zb, &zresult);
+    zfree(za);
+    zfree(zb);
+    result = kronecker_unpack(zresult, la + lb - 1, w);
+    zfree(zresult);
+    return result;
+}
+
+void
+define_calc_polynomial(VALUE m)
+{
+    cPolynomial = rb_define_class_under(m, "Polynomial", rb_cObject);
+    rb_define_singleton_method(cPolynomial, "kronecker_mul", cpoly_kronecker_mul, 2);
+}
@@ -0,0 +1,325 @@
+#include <math.h>
+#include "calc.h"
+
+/* Tables of small primes, for functions which work with every prime up to
+ * some limit (factorial.c, pix.c) or trial divide (bpsw.c, ptest.c), and
+ * Calc.each_prime.
+ */
+
+/* small_prime_table() has the primes below this */
+#define SMALL_PRIME_LIMIT 1000
+
+/* returns an array of the primes <= n in increasing order, setting *count to
+ * its length.  n must be less than 2^32.  the caller frees it with xfree. */
+uint32_t *
+prime_sieve(long n, long *count)
+{
+    unsigned char *composite;
+    uint32_t *primes;
+    long i, j, half, found, max;
+
+    *count = 0;
+    if (n < 2) {
+        return ALLOC_N(uint32_t, 1);
+    }
+
+    /* composite[i] is set if 2i+1 is composite */
+    half = (n - 1) / 2 + 1;
+    composite = ALLOC_N(unsigned char, half);
+    memset(composite, 0, half);
+    for (i = 1; (2 * i + 1) * (2 * i + 1) <= n; i++) {
+        if (!composite[i]) {
+            for (j = (2 * i + 1) * (2 * i + 1) / 2; j < half; j += 2 * i + 1) {
+                composite[j] = 1;
+            }
+        }
+    }
+
+    /* pi(n) < 1.26 n / ln(n) for n > 1 */
+    max = (long) (1.26 * n / log((double) n)) + 2;
+    primes = ALLOC_N(uint32_t, max);
+    primes[0] = 2;
+    found = 1;
+    for (i = 1; i < half; i++) {
+        if (!composite[i]) {
+            primes[found++] = (uint32_t) (2 * i + 1);
+        }
+    }
+    xfree(composite);
+    *count = found;
+    return primes;
+}
+
+/* returns the primes below SMALL_PRIME_LIMIT (starting with 2), setting
+ * *count to how many there are.  the table is shared and must not be freed. */
+const uint32_t *
+small_prime_table(long *count)
+{
+    static uint32_t *primes = NULL;
+    static long found = 0;
+
+    if (primes == NULL) {
+        primes = prime_sieve(SMALL_PRIME_LIMIT, &found);
+    }
+    *count = found;
+    return primes;
+}
+
+
+/* Calc.each_prime sieves odd numbers in segments of SIEVE_SEGMENT bytes (one
+ * per odd number, to fit in L1 cache).  Multiples of 3, 5, 7, 11 and 13 are
+ * removed by copying from a repeating pattern, so only larger primes are
+ * crossed off one at a time.  With Calc.config(:threads) > 1, that many
+ * consecutive segments are sieved at once without the GVL, then their primes
+ * are yielded in order. */
+#define SIEVE_SEGMENT 32768
+#define SIEVE_WHEEL 15015       /* 3 * 5 * 7 * 11 * 13 */
+#define SIEVE_FIRST 17          /* smallest prime not in the pattern */
+#define SIEVE_MAX_BITS 56       /* keeps the sieving primes below 2^28 */
+
+typedef struct primeiter PRIMEITER;
+
+typedef struct {
+    PRIMEITER *it;
+    uint64_t low;               /* odd; byte i of sieve is for low + 2i */
+    long len;                   /* bytes used, 0 if past the end */
+    unsigned char *sieve;
+} SEGMENT;
+
+struct primeiter {
+    uint64_t from;
+    uint64_t to;
+    uint64_t next;              /* start of the next round of segments */
+    uint32_t *primes;           /* sieving primes, <= sqrt(to) */
+    long nprimes;
+    unsigned char *wheel;       /* pattern for odd numbers from 1 */
+    SEGMENT *segments;
+    void **args;                /* pointers to segments for parallel_run */
+    int nsegments;
+    long segment;               /* bytes per segment */
+    long batch;                 /* yield arrays of this many primes if > 0 */
+    VALUE ary;
+    volatile int cancel;
+};
+
+static void *
+sieve_segment(void *arg)
+{
+    SEGMENT *seg = (SEGMENT *) arg;
+    PRIMEITER *it = seg->it;
+    uint64_t high, p, i;
+    long j;
+
+    if (seg->len == 0 || it->cancel) {
+        return NULL;
+    }
+    memcpy(seg->sieve, it->wheel + (seg->low / 2) % SIEVE_WHEEL, seg->len);
+    high = seg->low + 2 * (uint64_t) (seg->len - 1);
+    for (j = 0; j < it->nprimes; j++) {
+        p = it->primes[j];
+        if (p < SIEVE_FIRST) {
+            continue;
+        }
+        if (p * p > high) {
+            break;
+        }
+        /* first odd multiple of p which is at least p^2 and low */
+        i = p * p;
+        if (i < seg->low) {
+            i = ((seg->low + p - 1) / p) * p;
+            if (i % 2 == 0) {
+                i += p;
+            }
+        }
+        for (i = (i - seg->low) / 2; i < (uint64_t) seg->len; i += p) {
+            seg->sieve[i] = 0;
+        }
+    }
+    return NULL;
+}
+
+static void *
+sieve_round(void *arg)
+{
+    PRIMEITER *it = (PRIMEITER *) arg;
+
+    parallel_run(sieve_segment, it->args, it->nsegments);
+    return NULL;
+}
+
+static void
+yield_prime(PRIMEITER * it, uint64_t p)
+{
+    VALUE q = wrap_number(utoq((FULL) p));
+
+    if (it->batch > 0) {
+        rb_ary_push(it->ary, q);
+        if (RARRAY_LEN(it->ary) >= it->batch) {
+            rb_yield(it->ary);
+            it->ary = rb_ary_new_capa(it->batch);
+        }
+    }
+    else {
+        rb_yield(q);
+    }
+}
+
+static VALUE
+each_prime_loop(VALUE arg)
+{
+    static const uint64_t small[] = { 2, 3, 5, 7, 11, 13 };
+    PRIMEITER *it = (PRIMEITER *) arg;
+    SEGMENT *seg;
+    uint64_t low;
+    long i;
+    int s;
+
+    for (i = 0; i < 6; i++) {
+        if (small[i] >= it->from && small[i] <= it->to) {
+            yield_prime(it, small[i]);
+        }
+    }
+    while (it->next <= it->to) {
+        low = it->next;
+        for (s = 0; s < it->nsegments; s++) {
+            seg = &it->segments[s];
+            seg->low = low;
+            seg->len = 0;
+            if (low <= it->to) {
+                seg->len = (long) ((it->to - low) / 2 + 1);
+                if (seg->len > it->segment) {
+                    seg->len = it->segment;
+                }
+                low += 2 * (uint64_t) seg->len;
+            }
+        }
+        it->next = low;
+        call_without_gvl(sieve_round, it, &it->cancel);
+        for (s = 0; s < it->nsegments; s++) {
+            seg = &it->segments[s];
+            for (i = 0; i < seg->len; i++) {
+                if (seg->sieve[i]) {
+                    yield_prime(it, seg->low + 2 * (uint64_t) i);
+                }
+            }
+        }
+    }
+    if (it->batch > 0 && RARRAY_LEN(it->ary) > 0) {
+        rb_yield(it->ary);
+    }
+    return Qnil;
+}
+
+static VALUE
+each_prime_free(VALUE arg)
+{
+    PRIMEITER *it = (PRIMEITER *) arg;
+    int s;
+
+    for (s = 0; s < it->nsegments; s++) {
+        xfree(it->segments[s].sieve);
+    }
+    xfree(it->segments);
+    xfree(it->args);
+    xfree(it->wheel);
+    xfree(it->primes);
+    return Qnil;
+}
+
+/* Iterates over the primes in a range
+ *
+ * Yields each prime p with from <= p <= to in increasing order, or arrays of
+ * up to batch primes if batch is given.  The primes are found with a
+ * segmented sieve, so this is much faster than calling nextprime
+ * repeatedly.  Calc.config(:threads) segments are sieved in parallel.
+ *
+ * @param from [Integer]
+ * @param to [Integer] must be less than 2**56
+ * @param batch [Integer,nil]
+ * @return [nil,Enumerator] nil, or an Enumerator if no block is given
+ * @yield [Calc::Q,Array<Calc::Q>]
+ * @raise [Calc::MathError] if from or to is not an integer, to is too large,
+ *   or batch is not positive
+ * @example
+ *  Calc.each_prime(10, 30).to_a #=> [Calc::Q(11), Calc::Q(13), Calc::Q(17), Calc::Q(19), Calc::Q(23), Calc::Q(29)]
+ *  Calc.each_prime(2**40, 2**40 + 1000).count #=> 36
+ *  Calc.each_prime(1, 30, 4) { |a| p a.map(&:to_i) }
+ *  # [2, 3, 5, 7]
+ *  # [11, 13, 17, 19]
+ *  # [23, 29]
+ */
+VALUE
+calc_each_prime(int argc, VALUE * argv, VALUE klass)
+{
+    PRIMEITER it;
+    NUMBER *qfrom, *qto;
+    VALUE from, to, batch;
+    uint64_t root, low;
+    long i, v;
+    int s;
+    setup_math_error();
+
+    RETURN_ENUMERATOR(klass, argc, argv);
+    rb_scan_args(argc, argv, "21", &from, &to, &batch);
+    it.batch = NIL_P(batch) ? 0 : NUM2LONG(batch);
+    if (!NIL_P(batch) && it.batch < 1) {
+        rb_raise(e_MathError, "batch size for each_prime must be positive");
+    }
+    qfrom = value_to_number(from, 0);
+    qto = value_to_number(to, 0);
+    if (qisfrac(qfrom) || qisfrac(qto)) {
+        qfree(qfrom);
+        qfree(qto);
+        rb_raise(e_MathError, "non-integer value for each_prime");
+    }
+    if (!qisneg(qto) && zhighbit(qto->num) >= SIEVE_MAX_BITS) {
+        qfree(qfrom);
+        qfree(qto);
+        rb_raise(e_MathError, "each_prime limit is >= 2^56");
+    }
+    if (qisneg(qto) || (!qisneg(qfrom) && qrel(qfrom, qto) > 0)) {
+        qfree(qfrom);
+        qfree(qto);
+        return Qnil;
+    }
+    it.from = qisneg(qfrom) ? 0 : ztou(qfrom->num);
+    it.to = ztou(qto->num);
+    qfree(qfrom);
+    qfree(qto);
+
+    low = it.from < SIEVE_FIRST ? SIEVE_FIRST : it.from;
+    it.next = low | 1;
+    root = (uint64_t) sqrt((double) it.to);
+    while (root * root > it.to) {
+        root--;
+    }
+    while ((root + 1) * (root + 1) <= it.to) {
+        root++;
+    }
+    it.primes = prime_sieve((long) root, &it.nprimes);
+
+    /* with lots of sieving primes, finding the first multiple of each in a
+     * segment costs more than the sieving; use larger segments then */
+    it.segment = SIEVE_SEGMENT;
+    while (it.segment < it.nprimes / 4 && it.next < it.to
+           && (uint64_t) it.segment < (it.to - it.next) / 2) {
+        it.segment *= 2;
+    }
+    it.wheel = ALLOC_N(unsigned char, SIEVE_WHEEL + it.segment);
+    for (i = 0; i < SIEVE_WHEEL + it.segment; i++) {
+        v = (2 * i + 1) % SIEVE_WHEEL;
+        it.wheel[i] = (v % 3 != 0 && v % 5 != 0 && v % 7 != 0 && v % 11 != 0 && v % 13 != 0);
+    }
+    it.nsegments = calc_threads > 0 ? (int) calc_threads : 1;
+    it.segments = ALLOC_N(SEGMENT, it.nsegments);
+    it.args = ALLOC_N(void *, it.nsegments);
+    for (s = 0; s < it.nsegments; s++) {
+        it.segments[s].it = &it;
+        it.segments[s].sieve = ALLOC_N(unsigned char, it.segment);
+        it.args[s] = &it.segments[s];
+    }
+    it.ary = it.batch > 0 ? rb_ary_new_capa(it.batch) : Qnil;
+
+    rb_ensure(each_prime_loop, (VALUE) & it, each_prime_free, (VALUE) & it);
+    return Qnil;
+}
@@ -0,0 +1,382 @@
+#include "calc.h"
+
+/* Calc.ptest_many: ptest? for many candidates at once.
+ *
+ * With the GVL held, each candidate is converted once, values below 2^32
+ * are decided by libcalc's table, and the rest are trial divided by the
+ * shared table of small primes.  The survivors get their Miller-Rabin tests
+ * without the GVL, split across Calc.config(:threads) threads.  As libcalc
+ * isn't thread safe, that part uses its own Montgomery multiplication on
+ * copies of the candidates' HALF arrays (see mont.c).
+ */
+
+typedef struct {
+    HALF *n;                    /* abs(candidate), odd and > 2^32 */
+    LEN len;
+    long index;                 /* position in the candidates array */
+    uint64_t seed;              /* for random bases */
+    BOOL result;
+} PTCAND;
+
+typedef struct ptestjob PTESTJOB;
+
+typedef struct {
+    PTESTJOB *job;
+    long first;                 /* candidates [first, last) */
+    long last;
+    HALF *scratch;
+} PTPIECE;
+
+struct ptestjob {
+    VALUE candidates;           /* the array given to ptest_many */
+    BOOL *passed;               /* result for each of candidates */
+    PTCAND *cands;              /* candidates not decided with the GVL */
+    long ncands;
+    long count;                 /* number of bases */
+    long skip;                  /* 0: random, 1: primes, else consecutive from skip */
+    uint32_t *bases;            /* primes below 2^16, if skip is 1 */
+    long nbases;
+    PTPIECE *pieces;
+    void **args;
+    int npieces;
+    volatile int cancel;
+};
+
+/* TRUE if a < 2 */
+static BOOL
+limb_small(const HALF * a, LEN len)
+{
+    while (--len > 0) {
+        if (a[len]) {
+            return FALSE;
+        }
+    }
+    return a[0] < 2;
+}
+
+static uint64_t
+xorshift(uint64_t * state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/* sets base to the k'th base for candidate c, a number in [2, n - 2] */
+static void
+choose_base(PTESTJOB * job, PTCAND * c, long k, HALF * base, HALF * nm2)
+{
+    long bits;
+    LEN i;
+
+    memset(base, 0, c->len * sizeof(HALF));
+    if (job->skip == 1) {
+        base[0] = job->bases[k];
+    }
+    else if (job->skip > 1) {
+        base[0] = (HALF) (job->skip + k);
+    }
+    else {
+        /* random, retrying until it is in range */
+        for (bits = BASEB - 1; !((c->n[c->len - 1] >> bits) & 1); bits--);
+        do {
+            for (i = 0; i < c->len; i++) {
+                base[i] = (HALF) xorshift(&c->seed);
+            }
+            base[c->len - 1] &= (bits == BASEB - 1) ? (HALF) - 1 : ((HALF) 1 << (bits + 1)) - 1;
+        } while (limb_cmp(base, nm2, c->len) > 0 || limb_small(base, c->len));
+    }
+}
+
+/* count strong probable prime tests on one candidate */
+static BOOL
+ptest_candidate(PTESTJOB * job, PTCAND * c, HALF * scratch)
+{
+    LEN len = c->len, i;
+    HALF *t, *d, *one, *mone, *nm2, *base, *x, ninv;
+    long s, r, k, bit;
+    BOOL pass;
+
+    t = scratch;
+    d = t + len + 2;
+    one = d + len;
+    mone = one + len;
+    nm2 = mone + len;
+    base = nm2 + len;
+    x = base + len;
+
+    ninv = mont_ninv(c->n);
+
+    /* n - 1 = d * 2^s with d odd */
+    memcpy(d, c->n, len * sizeof(HALF));
+    d[0]--;
+    for (s = 0; !((d[s / BASEB] >> (s % BASEB)) & 1); s++);
+    for (bit = 0; bit < len * BASEB - s; bit++) {
+        k = bit + s;
+        if ((d[k / BASEB] >> (k % BASEB)) & 1) {
+            d[bit / BASEB] |= (HALF) 1 << (bit % BASEB);
+        }
+        else {
+            d[bit / BASEB] &= ~((HALF) 1 << (bit % BASEB));
+        }
+    }
+    for (; bit < len * BASEB; bit++) {
+        d[bit / BASEB] &= ~((HALF) 1 << (bit % BASEB));
+    }
+
+    /* R mod n, and -R mod n */
+    mont_one(one, c->n, len);
+    memcpy(mone, c->n, len * sizeof(HALF));
+    limb_sub(mone, one, len);
+    memcpy(nm2, c->n, len * sizeof(HALF));
+    memset(x, 0, len * sizeof(HALF));
+    x[0] = 2;
+    limb_sub(nm2, x, len);
+
+    for (k = 0; k < job->count; k++) {
+        if (job->cancel) {
+            return FALSE;
+        }
+        choose_base(job, c, k, base, nm2);
+        for (i = 0; i < len * BASEB; i++) {
+            mod_double(base, c->n, len);
+        }
+
+        /* x = base^d */
+        memcpy(x, one, len * sizeof(HALF));
+        for (bit = len * BASEB - 1; bit >= 0 && !((d[bit / BASEB] >> (bit % BASEB)) & 1);
+             bit--);
+        for (; bit >= 0; bit--) {
+            mont_mul(x, x, c->n, len, ninv, t, x);
+            if ((d[bit / BASEB] >> (bit % BASEB)) & 1) {
+                mont_mul(x, base, c->n, len, ninv, t, x);
+            }
+        }
+
+        pass = (limb_cmp(x, one, len) == 0 || limb_cmp(x, mone, len) == 0);
+        for (r = 1; !pass && r < s; r++) {
+            mont_mul(x, x, c->n, len, ninv, t, x);
+            if (limb_cmp(x, mone, len) == 0) {
+                pass = TRUE;
+            }
+            else if (limb_cmp(x, one, len) == 0) {
+                break;
+            }
+        }
+        if (!pass) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static void *
+ptest_piece(void *arg)
+{
+    PTPIECE *pp = (PTPIECE *) arg;
+    long i;
+
+    for (i = pp->first; i < pp->last; i++) {
+        pp->job->cands[i].result = ptest_candidate(pp->job, &pp->job->cands[i], pp->scratch);
+    }
+    return NULL;
+}
+
+static void *
+ptest_run(void *arg)
+{
+    PTESTJOB *job = (PTESTJOB *) arg;
+
+    parallel_run(ptest_piece, job->args, job->npieces);
+    return NULL;
+}
+
+/* converts a count or skip keyword argument, which must be a small integer */
+static long
+ptest_option(VALUE v, long dflt, const char *name)
+{
+    NUMBER *q;
+    long result;
+
+    if (v == Qundef) {
+        return dflt;
+    }
+    q = value_to_number(v, 0);
+    if (qisfrac(q) || zge31b(q->num)) {
+        qfree(q);
+        rb_raise(e_MathError, "%s for ptest_many must be an integer < 2^31", name);
+    }
+    result = qtoi(q);
+    qfree(q);
+    return result;
+}
+
+/* does the work of calc_ptest_many() once the arguments are checked.  all
+ * allocations are in job so ptest_many_free() can release them. */
+static VALUE
+ptest_many_run(VALUE arg)
+{
+    PTESTJOB *job = (PTESTJOB *) arg;
+    NUMBER *q;
+    const uint32_t *small_primes;
+    LEN maxlen;
+    long i, j, ncands, small_count, per;
+    uint64_t seed;
+    FLAG small;
+    VALUE result;
+
+    /* decide what we can with the GVL, keeping the rest for later */
+    ncands = RARRAY_LEN(job->candidates);
+    small_primes = small_prime_table(&small_count);
+    job->passed = ALLOC_N(BOOL, ncands);
+    job->cands = ALLOC_N(PTCAND, ncands);
+    seed = ((uint64_t) rb_genrand_int32() << 32) | rb_genrand_int32() | 1;
+    maxlen = 1;
+    for (i = 0; i < ncands; i++) {
+        q = value_to_number(rb_ary_entry(job->candidates, i), 0);
+        job->passed[i] = FALSE;
+        if (qisint(q)) {
+            small = zisprime(q->num);
+            if (small >= 0) {
+                job->passed[i] = small;
+            }
+            else {
+                for (j = 0; j < small_count && zmodi(q->num, small_primes[j]) != 0; j++);
+                if (j == small_count) {
+                    job->cands[job->ncands].len = q->num.len;
+                    job->cands[job->ncands].n = ALLOC_N(HALF, q->num.len);
+                    memcpy(job->cands[job->ncands].n, q->num.v, q->num.len * sizeof(HALF));
+                    job->cands[job->ncands].index = i;
+                    job->cands[job->ncands].seed = seed + 0x9e3779b97f4a7c15ULL * i;
+                    if (q->num.len > maxlen) {
+                        maxlen = q->num.len;
+                    }
+                    job->ncands++;
+                }
+            }
+        }
+        qfree(q);
+    }
+
+    if (job->skip == 1) {
+        job->bases = prime_sieve(65535, &job->nbases);
+        if (job->count > job->nbases) {
+            job->count = job->nbases;
+        }
+    }
+    job->npieces = calc_threads > 0 ? (int) calc_threads : 1;
+    if (job->npieces > job->ncands) {
+        job->npieces = job->ncands > 0 ? (int) job->ncands : 1;
+    }
+    job->pieces = ZALLOC_N(PTPIECE, job->npieces);
+    job->args = ALLOC_N(void *, job->npieces);
+    per = (job->ncands + job->npieces - 1) / job->npieces;
+    for (i = 0; i < job->npieces; i++) {
+        job->pieces[i].job = job;
+        job->pieces[i].first = i * per < job->ncands ? i * per : job->ncands;
+        job->pieces[i].last = (i + 1) * per < job->ncands ? (i + 1) * per : job->ncands;
+        job->pieces[i].scratch = ALLOC_N(HALF, 7 * maxlen + 2);
+        job->args[i] = &job->pieces[i];
+    }
+
+    if (job->ncands > 0) {
+        call_without_gvl(ptest_run, job, &job->cancel);
+    }
+    for (i = 0; i < job->ncands; i++) {
+        job->passed[job->cands[i].index] = job->cands[i].result;
+    }
+
+    result = rb_ary_new();
+    for (i = 0; i < ncands; i++) {
+        if (job->passed[i]) {
+            rb_ary_push(result, LONG2FIX(i));
+        }
+    }
+    return result;
+}
+
+/* frees everything ptest_many_run() allocated, including when it raises or
+ * is interrupted */
+static VALUE
+ptest_many_free(VALUE arg)
+{
+    PTESTJOB *job = (PTESTJOB *) arg;
+    long i;
+
+    for (i = 0; i < job->ncands; i++) {
+        xfree(job->cands[i].n);
+    }
+    if (job->pieces) {
+        for (i = 0; i < job->npieces; i++) {
+            xfree(job->pieces[i].scratch);
+        }
+    }
+    xfree(job->pieces);
+    xfree(job->args);
+    xfree(job->cands);
+    xfree(job->passed);
+    xfree(job->bases);
+    return Qnil;
+}
+
+/* Probabilistic primality test of many numbers
+ *
+ * Equivalent to candidates.each_index.select { |i| candidates[i].ptest?(count, skip) },
+ * but much faster for large numbers of candidates: each is trial divided by
+ * the primes below 1000, then the Miller-Rabin tests of those which remain
+ * run without the GVL, split across Calc.config(:threads) threads.
+ *
+ * skip selects the bases as for Calc::Q#ptest?, except that it must be less
+ * than 2**31.
+ *
+ * @param candidates [Array<Integer,Calc::Q>]
+ * @param count [Integer] number of bases to test (default 1)
+ * @param skip [Integer] 0 for random bases, 1 for successive primes, or the
+ *  first of consecutive integers (default 1)
+ * @return [Array<Integer>] indexes of the candidates which are probably prime
+ * @raise [Calc::MathError] if count or skip isn't a small integer
+ * @example
+ *  Calc.ptest_many([2**61 - 1, 2**61 + 1, 2**89 - 1], count: 10) #=> [0, 2]
+ * @see Calc::Q#ptest?
+ */
+VALUE
+calc_ptest_many(int argc, VALUE * argv, VALUE klass)
+{
+    static ID keywords[2];
+    PTESTJOB job;
+    VALUE candidates, opts, values[2];
+    long i;
+    setup_math_error();
+
+    rb_scan_args(argc, argv, "1:", &candidates, &opts);
+    if (!keywords[0]) {
+        keywords[0] = rb_intern("count");
+        keywords[1] = rb_intern("skip");
+    }
+    values[0] = values[1] = Qundef;
+    if (!NIL_P(opts)) {
+        rb_get_kwargs(opts, keywords, 0, 2, values);
+    }
+    job.count = ptest_option(values[0], 1, "count");
+    job.skip = ptest_option(values[1], 1, "skip");
+    if (job.count < 0) {
+        job.count = -job.count;
+    }
+    candidates = rb_Array(candidates);
+
+    /* check everything first so nothing is leaked by a bad candidate */
+    for (i = 0; i < RARRAY_LEN(candidates); i++) {
+        qfree(value_to_number(rb_ary_entry(candidates, i), 0));
+    }
+    job.candidates = candidates;
+    job.passed = NULL;
+    job.cands = NULL;
+    job.ncands = 0;
+    job.bases = NULL;
+    job.nbases = 0;
+    job.pieces = NULL;
+    job.args = NULL;
+    job.npieces = 0;
+    return rb_ensure(ptest_many_run, (VALUE) & job, ptest_many_free, (VALUE) & job);
+}
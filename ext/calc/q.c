@@ -195,7 +195,10 @@ trans_function(int argc, VALUE * argv, VALUE self, NUMBER * (*f) (NUMBER *, NUMB
     else {
         qepsilon = value_to_number(epsilon, 1);
     }
-    qresult = (*f) (DATA_PTR(self), qepsilon ? qepsilon : conf->epsilon);
+    qresult = qtrans_double(f, DATA_PTR(self), qepsilon ? qepsilon : conf->epsilon);
+    if (!qresult) {
+        qresult = memo_qfunc(f, DATA_PTR(self), qepsilon ? qepsilon : conf->epsilon);
+    }
     if (qresult) {
         result = wrap_number(qresult);
     }
@@ -204,7 +207,7 @@ trans_function(int argc, VALUE * argv, VALUE self, NUMBER * (*f) (NUMBER *, NUMB
         cself = comalloc();
         qfree(cself->real);
         cself->real = qlink((NUMBER *) DATA_PTR(self));
-        cresult = (*fcomplex) (cself, qepsilon ? qepsilon : conf->epsilon);
+        cresult = memo_cfunc(fcomplex, cself, qepsilon ? qepsilon : conf->epsilon);
         comfree(cself);
         if (cresult) {
             result = wrap_complex(cresult);
@@ -361,7 +364,7 @@ cq_and(VALUE x, VALUE y)
 static VALUE
 cq_multiply(VALUE x, VALUE y)
 {
-    return numeric_op(x, y, &qmul, &qmuli, id_multiply);
+    return numeric_op(x, y, &qmul_fast, &qmuli, id_multiply);
 }
 
 /* Performs addition.
@@ -951,6 +954,7 @@ cq_cfappr(int argc, VALUE * argv, VALUE self)
  *   355/113
  *   22/7
  *   3
+ * @see #convergents
  */
 static VALUE
 cq_cfsim(int argc, VALUE * argv, VALUE self)
@@ -1193,7 +1197,7 @@ cq_evenp(VALUE self)
 static VALUE
 cq_exp(int argc, VALUE * argv, VALUE self)
 {
-    return trans_function(argc, argv, self, &qexp, NULL);
+    return trans_function(argc, argv, self, &qexp_cached, NULL);
 }
 
 /* Returns the factorial of a number.
@@ -1208,7 +1212,7 @@ static VALUE
 cq_fact(VALUE self)
 {
     setup_math_error();
-    return wrap_number(qfact(DATA_PTR(self)));
+    return wrap_number(qfact_fast(DATA_PTR(self)));
 }
 
 /* Smallest prime factor not exceeding specified limit
@@ -1264,6 +1268,69 @@ cq_factor(int argc, VALUE * argv, VALUE self)
     return wrap_number(qfactor);
 }
 
+/* Complete factorization into primes
+ *
+ * Returns the prime factors of self and their exponents, in increasing
+ * order, like Prime.prime_division.  If self is negative the first pair is
+ * [-1, 1].
+ *
+ * Methods are tried in increasing order of cost: trial division, Pollard's
+ * rho, the elliptic curve method (running Calc.config(:threads) curves at
+ * once) and for factors of up to 100 digits, the self initializing quadratic
+ * sieve.  Factors above 2^32 are BPSW probable primes (see #prime?).
+ *
+ * Numbers with two large prime factors can take a very long time.  If effort
+ * is given, it limits the time spent to about that many seconds; any factors
+ * which couldn't be split by then are included as they are, so test them
+ * with #prime? if that matters.
+ *
+ * @param effort [Numeric] (optional) time limit in seconds
+ * @return [Array<Array>] pairs of [Calc::Q prime, Integer exponent]
+ * @raise [Calc::MathError] if self is zero or not an integer
+ * @example
+ *  Calc::Q(360).factorize #=> [[Calc::Q(2), 3], [Calc::Q(3), 2], [Calc::Q(5), 1]]
+ *  (Calc::Q(2)**128 + 1).factorize
+ *  #=> [[Calc::Q(59649589127497217), 1], [Calc::Q(5704689200685129054721), 1]]
+ */
+static VALUE
+cq_factorize(int argc, VALUE * argv, VALUE self)
+{
+    VALUE effort, result;
+    NUMBER *qself, *qfactor;
+    ZVALUE *factors;
+    long *exps, count, i;
+    double seconds = 0;
+    setup_math_error();
+
+    if (rb_scan_args(argc, argv, "01", &effort) > 0 && !NIL_P(effort)) {
+        seconds = NUM2DBL(rb_funcall(effort, rb_intern("to_f"), 0));
+        if (seconds <= 0) {
+            rb_raise(e_MathError, "effort for factorize must be positive");
+        }
+    }
+    qself = DATA_PTR(self);
+    if (qisfrac(qself)) {
+        rb_raise(e_MathError, "non-integer for factorize");
+    }
+    if (qiszero(qself)) {
+        rb_raise(e_MathError, "zero for factorize");
+    }
+
+    count = zfactorize(qself->num, seconds, &factors, &exps);
+    result = rb_ary_new2(count + 1);
+    if (qisneg(qself)) {
+        rb_ary_push(result, rb_assoc_new(wrap_number(itoq(-1L)), INT2FIX(1)));
+    }
+    for (i = 0; i < count; i++) {
+        qfactor = qalloc();
+        qfactor->num = factors[i];
+        rb_ary_push(result, rb_assoc_new(wrap_number(qfactor), LONG2NUM(exps[i])));
+    }
+    xfree(factors);
+    xfree(exps);
+    return result;
+}
+
 /* Count number of times an integer divides self.
  *
  * Returns the greatest non-negative n for which y^n is a divisor of self.
@@ -1338,19 +1405,56 @@ cq_frem(VALUE self, VALUE y)
     return result;
 }
 
+/* checks arguments for fib and lucas, returning the modulus (or NULL) */
+static NUMBER *
+fib_modulus(int argc, VALUE * argv, VALUE self, const char *name)
+{
+    VALUE mod;
+    NUMBER *qmod;
+
+    if (rb_scan_args(argc, argv, "01", &mod) == 0) {
+        if (zge31b(((NUMBER *) DATA_PTR(self))->num)) {
+            rb_raise(e_MathError, "argument too large for %s", name);
+        }
+        return NULL;
+    }
+    qmod = value_to_number(mod, 0);
+    if (qisfrac(qmod) || qisneg(qmod) || qiszero(qmod)) {
+        qfree(qmod);
+        rb_raise(e_MathError, "modulus for %s must be a positive integer", name);
+    }
+    return qmod;
+}
+
 /* Returns the Fibonacci number with index self.
  *
+ * If a modulus is given, returns the Fibonacci number modulo m without
+ * calculating the whole number, so self can be arbitrarily large.
+ *
+ * @param m [Integer] (optional) modulus
  * @return [Calc::Q]
  * @raise [Calc::MathError] if self is not an integer
- * @raise [Calc::MathError] if abs(self) >= 2^31
+ * @raise [Calc::MathError] if m is not a positive integer
+ * @raise [Calc::MathError] if abs(self) >= 2^31 and there is no modulus
  * @example
- *  Calc::Q(10).fib #=> Calc::Q(55)
+ *  Calc::Q(10).fib                  #=> Calc::Q(55)
+ *  Calc::Q(10).power(100).fib(1000) #=> Calc::Q(875)
  */
 static VALUE
-cq_fib(VALUE self)
+cq_fib(int argc, VALUE * argv, VALUE self)
 {
+    NUMBER *qmod, *qresult;
     setup_math_error();
-    return wrap_number(qfib(DATA_PTR(self)));
+
+    if (qisfrac((NUMBER *) DATA_PTR(self))) {
+        rb_raise(e_MathError, "non-integer argument for fib");
+    }
+    qmod = fib_modulus(argc, argv, self, "fib");
+    qresult = qfib_fast(DATA_PTR(self), qmod);
+    if (qmod) {
+        qfree(qmod);
+    }
+    return wrap_number(qresult);
 }
 
 /* Greatest common divisor
@@ -1602,7 +1706,7 @@ static VALUE
 cq_lcmfact(VALUE self)
 {
     setup_math_error();
-    return wrap_number(qlcmfact(DATA_PTR(self)));
+    return wrap_number(qlcmfact_fast(DATA_PTR(self)));
 }
 
 /* Smallest prime factor in first specified number of primes
@@ -1689,6 +1793,38 @@ cq_ltol(int argc, VALUE * argv, VALUE self)
     return wrap_number(qresult);
 }
 
+/* Returns the Lucas number with index self.
+ *
+ * Lucas numbers follow the same recurrence as the Fibonacci numbers, but
+ * start with 2, 1.  If a modulus is given, returns the Lucas number modulo m
+ * without calculating the whole number.
+ *
+ * @param m [Integer] (optional) modulus
+ * @return [Calc::Q]
+ * @raise [Calc::MathError] if self is not an integer
+ * @raise [Calc::MathError] if m is not a positive integer
+ * @raise [Calc::MathError] if abs(self) >= 2^31 and there is no modulus
+ * @example
+ *  Calc::Q(10).lucas #=> Calc::Q(123)
+ *  Calc::Q(-5).lucas #=> Calc::Q(-11)
+ */
+static VALUE
+cq_lucas(int argc, VALUE * argv, VALUE self)
+{
+    NUMBER *qmod, *qresult;
+    setup_math_error();
+
+    if (qisfrac((NUMBER *) DATA_PTR(self))) {
+        rb_raise(e_MathError, "non-integer argument for lucas");
+    }
+    qmod = fib_modulus(argc, argv, self, "lucas");
+    qresult = qlucas_fast(DATA_PTR(self), qmod);
+    if (qmod) {
+        qfree(qmod);
+    }
+    return wrap_number(qresult);
+}
+
 /* test for equality modulo a specific number
  *
  * Returns true if self is congruent to y modulo md.
@@ -1857,22 +1993,24 @@ extern NUMBER _nxtprime_;
 
 /* Next prime number
  *
- * If self is >= 2**32, raises an exception.  Otherwise returns the next prime
- * number.
+ * Returns the smallest prime greater than self.  Below 2**32 libcalc's
+ * table of primes is used; above that, candidates without small factors
+ * are checked with a Baillie-PSW test (see Calc::Q#prime?).
  *
  * @return [Calc::Q]
- * @raise [Calc::MathError] if self is >= 2**32
+ * @raise [Calc::MathError] if self is not an integer
  * @example
  *  Calc::Q(2).nextprime         #=> Calc::Q(3)
  *  Calc::Q(10).nextprime        #=> Calc::Q(11)
  *  Calc::Q(100).nextprime       #=> Calc::Q(101)
  *  Calc::Q("1e6").nextprime     #=> Calc::Q(1000003)
  *  Calc::Q(2**32 - 1).nextprime #=> Calc::Q(4294967311)
+ *  Calc::Q(2**64).nextprime     #=> Calc::Q(18446744073709551629)
  */
 static VALUE
 cq_nextprime(VALUE self)
 {
-    NUMBER *qself;
+    NUMBER *qself, *qresult;
     FULL next_prime;
     setup_math_error();
 
@@ -1886,7 +2024,9 @@ cq_nextprime(VALUE self)
         return wrap_number(qlink(&_nxtprime_));
     }
     else if (next_prime == 1) {
-        rb_raise(e_MathError, "nextprime arg is >= 2^32");
+        qresult = qalloc();
+        zbpsw_step(qself->num, 1, &qresult->num);
+        return wrap_number(qresult);
     }
     return wrap_number(utoq(next_prime));
 }
@@ -1951,7 +2091,7 @@ cq_perm(VALUE self, VALUE other)
     setup_math_error();
 
     qother = value_to_number(other, 0);
-    qresult = qperm(DATA_PTR(self), qother);
+    qresult = qperm_fast(DATA_PTR(self), qother);
     qfree(qother);
     return wrap_number(qresult);
 }
@@ -1969,23 +2109,29 @@ static VALUE
 cq_pfact(VALUE self)
 {
     setup_math_error();
-    return wrap_number(qpfact(DATA_PTR(self)));
+    return wrap_number(qpfact_fast(DATA_PTR(self)));
 }
 
 /* Number of primes not exceeded specified number
+ *
+ * Values below 2**32 are looked up by libcalc.  Larger ones are calculated
+ * with the Meissel-Lehmer method (see ext/calc/pix.c), which takes a few
+ * seconds for 10**13 and is split across Calc.config(:threads) threads.
  *
  * @return [Calc::Q]
- * @raise [Calc::MathError] if self is >= 2**32
+ * @raise [Calc::MathError] if self is >= 2**56
  * @example
- *  Calc::Q(10).pix    #=> Calc::Q(4)
- *  Calc::Q(100).pix   #=> Calc::Q(25)
- *  Calc::Q(10**9).pix #=> Calc::Q(50847534)
+ *  Calc::Q(10).pix     #=> Calc::Q(4)
+ *  Calc::Q(100).pix    #=> Calc::Q(25)
+ *  Calc::Q(10**9).pix  #=> Calc::Q(50847534)
+ *  Calc::Q(10**12).pix #=> Calc::Q(37607912018)
  */
 static VALUE
 cq_pix(VALUE self)
 {
     NUMBER *qself;
     long value;
+    int64_t x, large;
     setup_math_error();
 
     qself = DATA_PTR(self);
@@ -1996,7 +2142,17 @@ cq_pix(VALUE self)
     if (value >= 0) {
         return wrap_number(utoq(value));
     }
-    rb_raise(e_MathError, "pix arg is >= 2^32");
+    if (!qisneg(qself) && zhighbit(qself->num) < 56) {
+        x = qself->num.v[0];
+        if (qself->num.len > 1) {
+            x |= (int64_t) qself->num.v[1] << BASEB;
+        }
+        large = pix_large(x);
+        if (large >= 0) {
+            return wrap_number(value_to_number(LL2NUM(large), 0));
+        }
+    }
+    rb_raise(e_MathError, "pix arg is >= 2^56");
 }
 
 /* Number of decimal (or other) places in fractional part
@@ -2120,7 +2276,7 @@ cq_power(int argc, VALUE * argv, VALUE self)
 {
     /* ref: powervalue() in calc value.c.  handle cases NUM,NUM and NUM,COM */
     VALUE arg, epsilon, result;
-    NUMBER *qself, *qarg, *qepsilon;
+    NUMBER *qself, *qarg, *qepsilon, *qresult;
     COMPLEX *cself, *carg;
     setup_math_error();
 
@@ -2149,8 +2305,12 @@ cq_power(int argc, VALUE * argv, VALUE self)
     }
     else {
         qarg = value_to_number(arg, 1);
-        result = wrap_number(qpower(qself, qarg, qepsilon ? qepsilon : conf->epsilon));
-        qfree(qarg)
+        qresult = qpowi_fast(qself, qarg);
+        if (!qresult) {
+            qresult = qpower(qself, qarg, qepsilon ? qepsilon : conf->epsilon);
+        }
+        result = wrap_number(qresult);
+        qfree(qarg);
     }
     if (qepsilon) {
         qfree(qepsilon);
@@ -2186,22 +2346,23 @@ cq_prevcand(int argc, VALUE * argv, VALUE self)
 
 /* Previous prime number
  *
- * If self <= 2, returns nil.  If self is >= 2**32, raises an exception.
- * Otherwise returns the previous prime number.
+ * If self <= 2, returns nil.  Otherwise returns the largest prime less than
+ * self, found as for Calc::Q#nextprime.
  *
  * @return [Calc::Q]
- * @raise [Calc::MathError] if self is >= 2**32
+ * @raise [Calc::MathError] if self is not an integer
  * @example
  *  Calc::Q(2).prevprime         #=> nil
  *  Calc::Q(10).prevprime        #=> Calc::Q(7)
  *  Calc::Q(100).prevprime       #=> Calc::Q(97)
  *  Calc::Q("1e6").prevprime     #=> Calc::Q(999983)
  *  Calc::Q(2**32 - 1).prevprime #=> Calc::Q(4294967291)
+ *  Calc::Q(2**64).prevprime     #=> Calc::Q(18446744073709551557)
  */
 static VALUE
 cq_prevprime(VALUE self)
 {
-    NUMBER *qself;
+    NUMBER *qself, *qresult;
     FULL prev_prime;
     setup_math_error();
 
@@ -2214,21 +2375,29 @@ cq_prevprime(VALUE self)
         return Qnil;
     }
     else if (prev_prime == 1) {
-        rb_raise(e_MathError, "prevprime arg is >= 2^32");
+        qresult = qalloc();
+        zbpsw_step(qself->num, -1, &qresult->num);
+        return wrap_number(qresult);
     }
     return wrap_number(utoq(prev_prime));
 }
 
-/* Small integer prime test
+/* Prime test
  *
  * Returns true if self is prime, false if it is not prime.
- * This function can't be used for odd numbers > 2^32.
+ *
+ * Values below 2**32 are checked exactly by libcalc.  Larger values are
+ * trial divided by the primes below 1000, then given a Baillie-PSW test: a
+ * strong probable prime test to base 2 and a strong Lucas probable prime
+ * test.  This is exact below 2**64, and no larger composite which passes it
+ * is known.
  *
  * @return [Boolean]
- * @raise [Calc::MathError] if self is odd and > 2^32.
+ * @raise [Calc::MathError] if self is not an integer
  * @example
  *  Calc::Q(2**31 - 9).prime? #=> false
  *  Calc::Q(2**31 - 1).prime? #=> true
+ *  Calc::Q(2**89 - 1).prime? #=> true
  * @see Calc::Q#isprime
  */
 static VALUE
@@ -2241,14 +2410,7 @@ cq_primep(VALUE self)
     if (qisfrac(qself)) {
         rb_raise(e_MathError, "non-integral for prime?");
     }
-    switch (zisprime(qself->num)) {
-    case 0:
-        return Qfalse;
-    case 1:
-        return Qtrue;
-    default:
-        rb_raise(e_MathError, "prime? argument is an odd value > 2^32");
-    }
+    return zbpsw(qself->num) ? Qtrue : Qfalse;
 }
 
 /* Probabilistic test of primality
@@ -2679,6 +2841,8 @@ define_calc_q(VALUE m)
     rb_define_method(cQ, "catalan", cq_catalan, 0);
     rb_define_method(cQ, "cfappr", cq_cfappr, -1);
     rb_define_method(cQ, "cfsim", cq_cfsim, -1);
+    rb_define_method(cQ, "continued_fraction", cq_continued_fraction, 0);
+    rb_define_method(cQ, "convergents", cq_convergents, -1);
     rb_define_method(cQ, "cos", cq_cos, -1);
     rb_define_method(cQ, "cosh", cq_cosh, -1);
     rb_define_method(cQ, "cot", cq_cot, -1);
@@ -2693,10 +2857,11 @@ define_calc_q(VALUE m)
     rb_define_method(cQ, "exp", cq_exp, -1);
     rb_define_method(cQ, "fact", cq_fact, 0);
     rb_define_method(cQ, "factor", cq_factor, -1);
+    rb_define_method(cQ, "factorize", cq_factorize, -1);
     rb_define_method(cQ, "fcnt", cq_fcnt, 1);
     rb_define_method(cQ, "frac", cq_frac, 0);
     rb_define_method(cQ, "frem", cq_frem, 1);
-    rb_define_method(cQ, "fib", cq_fib, 0);
+    rb_define_method(cQ, "fib", cq_fib, -1);
     rb_define_method(cQ, "gcd", cq_gcd, -1);
     rb_define_method(cQ, "gcdrem", cq_gcdrem, 1);
     rb_define_method(cQ, "highbit", cq_highbit, 0);
@@ -2712,6 +2877,7 @@ define_calc_q(VALUE m)
     rb_define_method(cQ, "lfactor", cq_lfactor, 1);
     rb_define_method(cQ, "lowbit", cq_lowbit, 0);
     rb_define_method(cQ, "ltol", cq_ltol, -1);
+    rb_define_method(cQ, "lucas", cq_lucas, -1);
     rb_define_method(cQ, "meq?", cq_meqp, 2);
     rb_define_method(cQ, "minv", cq_minv, 1);
     rb_define_method(cQ, "mod", cq_mod, -1);
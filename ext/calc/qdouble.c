@@ -0,0 +1,125 @@
+#include <float.h>
+#include <math.h>
+#include "calc.h"
+
+/* Double precision fast path for sin and cos at coarse epsilons.
+ *
+ * qsin and qcos return the multiple of epsilon nearest to the result of
+ * qsincos, which they ask for n + 2 bits where 2^-n <= epsilon, so it is
+ * within epsilon/4 of the true value (hence the documented error of less
+ * than .75 epsilon).  When epsilon is no finer than
+ * Calc.config(:double_epsilon), the C library's double result and a bound on
+ * its error can usually tell which multiple that is: if the double is within
+ * epsilon/5 of a multiple of epsilon after allowing for the error, the true
+ * value is too, libcalc's approximation is within epsilon/2 of it and libcalc
+ * returns the same multiple.  Otherwise (and for arguments which don't fit in
+ * a double, results near zero etc) libcalc is called as before, so results
+ * are the same either way.
+ *
+ * exp and ln aren't done this way: qexp only keeps the error of its
+ * approximation below 2^(n-1), which can be epsilon/2, so no margin shows
+ * which multiple libcalc rounds to.
+ *
+ * The error bound assumes the C library's sin and cos are accurate to a few
+ * ulp, as glibc, musl and the BSD libms are.
+ */
+
+/* assumed error of the C library functions, in ulp */
+#define DOUBLE_LIBM_ULPS 4
+
+/* how close (in multiples of epsilon) a result must be to a multiple of
+ * epsilon, including its error, to be used */
+#define DOUBLE_MARGIN 0.2
+
+static NUMBER *double_epsilon = NULL;
+
+/* Calc.config(:double_epsilon), default 1e-12 */
+NUMBER *
+double_epsilon_value(void)
+{
+    NUMBER *q;
+
+    if (!double_epsilon) {
+        q = utoq((FULL) 1000000 * 1000000);
+        double_epsilon = qinv(q);
+        qfree(q);
+    }
+    return double_epsilon;
+}
+
+/* sets Calc.config(:double_epsilon), taking ownership of q */
+void
+double_epsilon_set(NUMBER * q)
+{
+    if (qisneg(q)) {
+        qfree(q);
+        rb_raise(e_MathError, "Negative value for double_epsilon");
+    }
+    qfree(double_epsilon_value());
+    double_epsilon = q;
+}
+
+/* sets *d to q correctly rounded, if its numerator and denominator both fit
+ * in the significand of a double.  returns 0 if not. */
+static int
+number_to_double(NUMBER * q, double *d)
+{
+    if (zhighbit(q->num) >= DBL_MANT_DIG || zhighbit(q->den) >= DBL_MANT_DIG) {
+        return 0;
+    }
+    *d = (double) ztou(q->num) / (double) ztou(q->den);
+    if (qisneg(q)) {
+        *d = -*d;
+    }
+    return 1;
+}
+
+/* returns f(q) rounded to a multiple of epsilon as libcalc would, for f qsin
+ * or qcos, or NULL if f is anything else or the double result can't be shown
+ * to give the same answer */
+NUMBER *
+qtrans_double(NUMBER * (*f) (NUMBER *, NUMBER *), NUMBER * q, NUMBER * epsilon)
+{
+    NUMBER *qn, *result;
+    double x, e, y, err, t, n;
+
+    if (qiszero(q) || conf->appr != 24 || qiszero(double_epsilon_value())
+        || qrel(epsilon, double_epsilon) < 0 || qrel(epsilon, &_qone_) >= 0
+        || !number_to_double(q, &x) || !number_to_double(epsilon, &e)) {
+        return NULL;
+    }
+
+    /* err starts as the effect of rounding q to x (relative error at most
+     * DBL_EPSILON/2) on the result */
+    if (f == &qsin) {
+        y = sin(x);
+        err = fabs(x) * DBL_EPSILON / 2;
+    }
+    else if (f == &qcos) {
+        y = cos(x);
+        err = fabs(x) * DBL_EPSILON / 2;
+    }
+    else {
+        return NULL;
+    }
+    err += fabs(y) * DOUBLE_LIBM_ULPS * DBL_EPSILON;
+
+    /* in multiples of epsilon, allowing for the rounding of epsilon, the
+     * division and the calculation of err itself */
+    t = y / e;
+    err = 2 * (err / e + fabs(t) * 4 * DBL_EPSILON);
+    n = floor(t + 0.5);
+    if (fabs(t) < 2 || fabs(t) >= ldexp(1.0, DBL_MANT_DIG - 1)
+        || fabs(t - n) + err > DOUBLE_MARGIN) {
+        return NULL;
+    }
+    qn = utoq((FULL) fabs(n));
+    if (n < 0) {
+        result = qneg(qn);
+        qfree(qn);
+        qn = result;
+    }
+    result = qmul(qn, epsilon);
+    qfree(qn);
+    return result;
+}
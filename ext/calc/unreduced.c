@@ -0,0 +1,564 @@
+#include "calc.h"
+
+/* Document-class: Calc::Unreduced
+ *
+ * Rational number which is not kept in lowest terms.
+ *
+ * Every Calc::Q operation reduces its result with a gcd, which in long sums
+ * and products can cost more than the arithmetic.  A Calc::Unreduced skips
+ * that: + - * / just multiply out the numerators and denominators (except
+ * that adding a fraction whose denominator divides this one's, eg a term
+ * with a small denominator to a long sum, keeps the same denominator).  The
+ * fraction is reduced when the denominator grows past Calc.config(:unreduced)
+ * bits, and after that whenever it doubles in size since the last reduction,
+ * so the numbers can't grow without limit (a threshold of 0 reduces every
+ * result, like Calc::Q).  Converting to a Calc::Q or a string always gives
+ * the reduced value.
+ *
+ * Comparisons cross multiply instead of reducing.  Integers, Calc::Q,
+ * Rational and Float operands give a Calc::Unreduced result; anything else
+ * is combined with the value as a Calc::Q.
+ *
+ * @example
+ *  x = (1..100).reduce(Calc::Unreduced(0)) { |s, k| s + Calc::Q(1, k) }
+ *  x.to_q == (1..100).reduce(Calc::Q(0)) { |s, k| s + Calc::Q(1, k) } #=> true
+ */
+VALUE cUnreduced;
+
+long unreduced_threshold = UNREDUCED_THRESHOLD_DEFAULT;
+
+static ID id_add;
+static ID id_divide;
+static ID id_multiply;
+static ID id_spaceship;
+static ID id_subtract;
+static ID id_to_f;
+static ID id_to_s;
+
+typedef struct {
+    ZVALUE num;
+    ZVALUE den;                 /* always positive */
+    long limit;                 /* reduce when den has this many bits */
+} UNREDUCED;
+
+static void
+cunred_free(void *p)
+{
+    UNREDUCED *u = (UNREDUCED *) p;
+
+    if (u) {
+        zfree(u->num);
+        zfree(u->den);
+        xfree(u);
+    }
+}
+
+const rb_data_type_t calc_unreduced_type = {
+    "Calc::Unreduced",
+    {0, cunred_free, 0},
+    0, 0
+#ifdef RUBY_TYPED_FREE_IMMEDIATELY
+        , RUBY_TYPED_FREE_IMMEDIATELY
+#endif
+};
+
+#define CALC_UNREDUCED_P(v) (rb_typeddata_is_kind_of((v), &calc_unreduced_type))
+
+static VALUE
+cunred_alloc(VALUE klass)
+{
+    return TypedData_Wrap_Struct(klass, &calc_unreduced_type, 0);
+}
+
+static UNREDUCED *
+get_unreduced(VALUE self)
+{
+    UNREDUCED *u = rb_check_typeddata(self, &calc_unreduced_type);
+
+    if (!u) {
+        rb_raise(rb_eArgError, "uninitialized Calc::Unreduced");
+    }
+    return u;
+}
+
+/* limit for a fraction just reduced to lowest terms */
+static long
+next_limit(ZVALUE den)
+{
+    long bits = 2 * (zhighbit(den) + 1);
+
+    return (bits > unreduced_threshold) ? bits : unreduced_threshold;
+}
+
+/* reduce u to lowest terms if its denominator has grown past its limit (or
+ * always, if the threshold is 0) */
+static void
+maybe_reduce(UNREDUCED * u)
+{
+    ZVALUE g, t;
+
+    if (unreduced_threshold > 0 && zhighbit(u->den) < u->limit) {
+        return;
+    }
+    zgcd(u->num, u->den, &g);
+    if (!zisunit(g)) {
+        zequo(u->num, g, &t);
+        zfree(u->num);
+        u->num = t;
+        zequo(u->den, g, &t);
+        zfree(u->den);
+        u->den = t;
+    }
+    zfree(g);
+    u->limit = next_limit(u->den);
+}
+
+/* wrap num / den (den > 0) in a new Calc::Unreduced, reducing it if it is
+ * past limit.  takes ownership of num and den. */
+static VALUE
+wrap_unreduced(ZVALUE num, ZVALUE den, long limit)
+{
+    VALUE result;
+    UNREDUCED *u;
+
+    result = cunred_alloc(cUnreduced);
+    u = ALLOC(UNREDUCED);
+    u->num = num;
+    u->den = den;
+    u->limit = limit;
+    DATA_PTR(result) = u;
+    maybe_reduce(u);
+    return result;
+}
+
+/* if other is a Calc::Unreduced or can be converted to Calc::Q, sets *num,
+ * *den and *limit and returns TRUE.  *num and *den must be freed if
+ * *alloced is set. */
+static BOOL
+unreduced_operand(VALUE other, ZVALUE * num, ZVALUE * den, long *limit, BOOL * alloced)
+{
+    UNREDUCED *u;
+    NUMBER *q;
+
+    if (CALC_UNREDUCED_P(other)) {
+        u = get_unreduced(other);
+        *num = u->num;
+        *den = u->den;
+        *limit = u->limit;
+        *alloced = FALSE;
+        return TRUE;
+    }
+    if (FIXNUM_P(other)) {
+        itoz(FIX2LONG(other), num);
+        itoz(1, den);
+    }
+    else if (RB_TYPE_P(other, T_BIGNUM) || RB_TYPE_P(other, T_RATIONAL)
+             || RB_TYPE_P(other, T_FLOAT) || CALC_Q_P(other)) {
+        q = value_to_number(other, 0);
+        zcopy(q->num, num);
+        zcopy(q->den, den);
+        qfree(q);
+    }
+    else {
+        return FALSE;
+    }
+    *limit = next_limit(*den);
+    *alloced = TRUE;
+    return TRUE;
+}
+
+/* Creates a new unreduced rational number
+ *
+ * @param num [Numeric,Calc::Q,String]
+ * @param den [Numeric,Calc::Q,String] (optional)
+ * @raise [ZeroDivisionError] if the denominator is zero
+ * @example
+ *  Calc::Unreduced.new(1, 3) #=> Calc::Unreduced(0.33333333333333333333)
+ */
+static VALUE
+cunred_initialize(int argc, VALUE * argv, VALUE self)
+{
+    UNREDUCED *u;
+    NUMBER *qnum, *qden, *q;
+    VALUE num, den;
+    setup_math_error();
+
+    if (rb_scan_args(argc, argv, "11", &num, &den) == 1) {
+        q = value_to_number(num, 1);
+    }
+    else {
+        qden = value_to_number(den, 1);
+        if (qiszero(qden)) {
+            qfree(qden);
+            rb_raise(rb_eZeroDivError, "division by zero");
+        }
+        qnum = value_to_number(num, 1);
+        q = qqdiv(qnum, qden);
+        qfree(qden);
+        qfree(qnum);
+    }
+    if (DATA_PTR(self)) {
+        cunred_free(DATA_PTR(self));
+    }
+    u = ALLOC(UNREDUCED);
+    zcopy(q->num, &u->num);
+    zcopy(q->den, &u->den);
+    u->limit = next_limit(u->den);
+    qfree(q);
+    DATA_PTR(self) = u;
+    return self;
+}
+
+static VALUE
+cunred_initialize_copy(VALUE obj, VALUE orig)
+{
+    UNREDUCED *uorig, *uobj;
+
+    if (obj == orig) {
+        return obj;
+    }
+    uorig = get_unreduced(orig);
+    uobj = ALLOC(UNREDUCED);
+    zcopy(uorig->num, &uobj->num);
+    zcopy(uorig->den, &uobj->den);
+    uobj->limit = uorig->limit;
+    DATA_PTR(obj) = uobj;
+    return obj;
+}
+
+/* Converts to a Calc::Q, reducing to lowest terms
+ *
+ * @return [Calc::Q]
+ * @example
+ *  (Calc::Unreduced(1, 6) + Calc::Q(1, 3)).to_q #=> Calc::Q(0.5)
+ */
+static VALUE
+cunred_to_q(VALUE self)
+{
+    UNREDUCED *u;
+    NUMBER *q;
+    ZVALUE g;
+    setup_math_error();
+
+    u = get_unreduced(self);
+    q = qalloc();
+    zgcd(u->num, u->den, &g);
+    if (zisunit(g)) {
+        zcopy(u->num, &q->num);
+        zcopy(u->den, &q->den);
+    }
+    else {
+        zequo(u->num, g, &q->num);
+        zequo(u->den, g, &q->den);
+    }
+    zfree(g);
+    return wrap_number(q);
+}
+
+static VALUE
+arith(VALUE self, VALUE other, ID func)
+{
+    UNREDUCED *u;
+    ZVALUE n2, d2, num, den, t1, t2, q;
+    long limit;
+    BOOL alloced;
+    setup_math_error();
+
+    u = get_unreduced(self);
+    if (!unreduced_operand(other, &n2, &d2, &limit, &alloced)) {
+        return rb_funcall(cunred_to_q(self), func, 1, other);
+    }
+    if (u->limit > limit) {
+        limit = u->limit;
+    }
+    if (func == id_add || func == id_subtract) {
+        if (zcmp(u->den, d2) == 0) {
+            t1 = u->num;
+            t2 = n2;
+            zcopy(u->den, &den);
+        }
+        else if (zisunit(d2)) {
+            t1 = u->num;
+            zmul_fast(n2, u->den, &t2);
+            zcopy(u->den, &den);
+        }
+        else if (zisunit(u->den)) {
+            zmul_fast(u->num, d2, &t1);
+            t2 = n2;
+            zcopy(d2, &den);
+        }
+        else if (!zgtmaxlong(d2) && zdivi(u->den, ztoi(d2), &q) == 0) {
+            /* a small denominator which divides ours, as in most terms of a
+             * long sum of fractions with small denominators */
+            t1 = u->num;
+            zmul_fast(n2, q, &t2);
+            zfree(q);
+            zcopy(u->den, &den);
+        }
+        else {
+            if (!zgtmaxlong(d2)) {
+                zfree(q);
+            }
+            zmul_fast(u->num, d2, &t1);
+            zmul_fast(n2, u->den, &t2);
+            zmul_fast(u->den, d2, &den);
+        }
+        if (func == id_add) {
+            zadd(t1, t2, &num);
+        }
+        else {
+            zsub(t1, t2, &num);
+        }
+        if (t1.v != u->num.v) {
+            zfree(t1);
+        }
+        if (t2.v != n2.v) {
+            zfree(t2);
+        }
+    }
+    else if (func == id_multiply) {
+        zmul_fast(u->num, n2, &num);
+        zmul_fast(u->den, d2, &den);
+    }
+    else {
+        if (ziszero(n2)) {
+            if (alloced) {
+                zfree(n2);
+                zfree(d2);
+            }
+            rb_raise(rb_eZeroDivError, "division by zero");
+        }
+        zmul_fast(u->num, d2, &num);
+        zmul_fast(u->den, n2, &den);
+        if (zisneg(den)) {
+            den.sign = 0;
+            if (!ziszero(num)) {
+                num.sign = !num.sign;
+            }
+        }
+    }
+    if (alloced) {
+        zfree(n2);
+        zfree(d2);
+    }
+    return wrap_unreduced(num, den, limit);
+}
+
+/* Adds a number, without reducing the result
+ *
+ * @param y [Calc::Unreduced,Numeric]
+ * @return [Calc::Unreduced]
+ */
+static VALUE
+cunred_add(VALUE self, VALUE other)
+{
+    return arith(self, other, id_add);
+}
+
+/* Subtracts a number, without reducing the result
+ *
+ * @param y [Calc::Unreduced,Numeric]
+ * @return [Calc::Unreduced]
+ */
+static VALUE
+cunred_subtract(VALUE self, VALUE other)
+{
+    return arith(self, other, id_subtract);
+}
+
+/* Multiplies by a number, without reducing the result
+ *
+ * @param y [Calc::Unreduced,Numeric]
+ * @return [Calc::Unreduced]
+ */
+static VALUE
+cunred_multiply(VALUE self, VALUE other)
+{
+    return arith(self, other, id_multiply);
+}
+
+/* Divides by a number, without reducing the result
+ *
+ * @param y [Calc::Unreduced,Numeric]
+ * @return [Calc::Unreduced]
+ * @raise [ZeroDivisionError] if y is zero
+ */
+static VALUE
+cunred_divide(VALUE self, VALUE other)
+{
+    return arith(self, other, id_divide);
+}
+
+static VALUE
+cunred_uminus(VALUE self)
+{
+    UNREDUCED *u;
+    ZVALUE num, den;
+    setup_math_error();
+
+    u = get_unreduced(self);
+    zcopy(u->num, &num);
+    zcopy(u->den, &den);
+    if (!ziszero(num)) {
+        num.sign = !num.sign;
+    }
+    return wrap_unreduced(num, den, u->limit);
+}
+
+/* Comparison - Returns -1, 0, +1 or nil
+ *
+ * Compares by cross multiplying, so neither side is reduced.
+ *
+ * @param other [Calc::Unreduced,Numeric]
+ * @return [Integer,nil]
+ * @example
+ *  Calc::Unreduced(2, 4) <=> Calc::Q(1, 2) #=> 0
+ */
+static VALUE
+cunred_spaceship(VALUE self, VALUE other)
+{
+    UNREDUCED *u;
+    ZVALUE n2, d2, t1, t2;
+    long limit;
+    BOOL alloced;
+    int result;
+    setup_math_error();
+
+    u = get_unreduced(self);
+    if (!unreduced_operand(other, &n2, &d2, &limit, &alloced)) {
+        return Qnil;
+    }
+    zmul_fast(u->num, d2, &t1);
+    zmul_fast(n2, u->den, &t2);
+    result = zrel(t1, t2);
+    zfree(t1);
+    zfree(t2);
+    if (alloced) {
+        zfree(n2);
+        zfree(d2);
+    }
+    return INT2FIX(result);
+}
+
+/* Converts a number for arithmetic with a Calc::Unreduced
+ *
+ * @param other [Numeric]
+ * @return [Array<Calc::Unreduced>]
+ */
+static VALUE
+cunred_coerce(VALUE self, VALUE other)
+{
+    ZVALUE num, den;
+    long limit;
+    BOOL alloced;
+    setup_math_error();
+
+    if (!unreduced_operand(other, &num, &den, &limit, &alloced)) {
+        rb_raise(rb_eTypeError, "%" PRIsVALUE " can't be coerced into Calc::Unreduced",
+                 rb_obj_class(other));
+    }
+    if (!alloced) {
+        zcopy(num, &num);
+        zcopy(den, &den);
+    }
+    return rb_assoc_new(wrap_unreduced(num, den, limit), self);
+}
+
+/* Returns the denominator, which may not be in lowest terms
+ *
+ * @return [Calc::Q]
+ * @example
+ *  (Calc::Unreduced(1, 2) * Calc::Q(2, 3)).den #=> Calc::Q(6)
+ */
+static VALUE
+cunred_den(VALUE self)
+{
+    NUMBER *q;
+    setup_math_error();
+
+    q = qalloc();
+    zcopy(get_unreduced(self)->den, &q->num);
+    return wrap_number(q);
+}
+
+/* Returns the numerator, which may not be in lowest terms
+ *
+ * @return [Calc::Q]
+ * @example
+ *  (Calc::Unreduced(1, 2) * Calc::Q(2, 3)).num #=> Calc::Q(2)
+ */
+static VALUE
+cunred_num(VALUE self)
+{
+    NUMBER *q;
+    setup_math_error();
+
+    q = qalloc();
+    zcopy(get_unreduced(self)->num, &q->num);
+    return wrap_number(q);
+}
+
+static VALUE
+cunred_to_f(VALUE self)
+{
+    return rb_funcall(cunred_to_q(self), id_to_f, 0);
+}
+
+/* Converts to a string, as Calc::Q#to_s
+ *
+ * @param mode [String,Symbol,Integer] (optional) output mode, see [Calc::Config]
+ * @return [String]
+ */
+static VALUE
+cunred_to_s(int argc, VALUE * argv, VALUE self)
+{
+    return rb_funcall2(cunred_to_q(self), id_to_s, argc, argv);
+}
+
+static VALUE
+cunred_inspect(VALUE self)
+{
+    return rb_sprintf("Calc::Unreduced(%" PRIsVALUE ")", cunred_to_s(0, NULL, self));
+}
+
+/* Returns true if the number is zero
+ *
+ * @return [Boolean]
+ */
+static VALUE
+cunred_zerop(VALUE self)
+{
+    return ziszero(get_unreduced(self)->num) ? Qtrue : Qfalse;
+}
+
+void
+define_calc_unreduced(VALUE m)
+{
+    cUnreduced = rb_define_class_under(m, "Unreduced", rb_cObject);
+    rb_include_module(cUnreduced, rb_mComparable);
+    rb_define_alloc_func(cUnreduced, cunred_alloc);
+    rb_define_method(cUnreduced, "initialize", cunred_initialize, -1);
+    rb_define_method(cUnreduced, "initialize_copy", cunred_initialize_copy, 1);
+    rb_define_method(cUnreduced, "*", cunred_multiply, 1);
+    rb_define_method(cUnreduced, "+", cunred_add, 1);
+    rb_define_method(cUnreduced, "-", cunred_subtract, 1);
+    rb_define_method(cUnreduced, "-@", cunred_uminus, 0);
+    rb_define_method(cUnreduced, "/", cunred_divide, 1);
+    rb_define_method(cUnreduced, "<=>", cunred_spaceship, 1);
+    rb_define_method(cUnreduced, "coerce", cunred_coerce, 1);
+    rb_define_method(cUnreduced, "den", cunred_den, 0);
+    rb_define_method(cUnreduced, "inspect", cunred_inspect, 0);
+    rb_define_method(cUnreduced, "num", cunred_num, 0);
+    rb_define_method(cUnreduced, "to_f", cunred_to_f, 0);
+    rb_define_method(cUnreduced, "to_q", cunred_to_q, 0);
+    rb_define_method(cUnreduced, "to_s", cunred_to_s, -1);
+    rb_define_method(cUnreduced, "zero?", cunred_zerop, 0);
+
+    id_add = rb_intern("+");
+    id_divide = rb_intern("/");
+    id_multiply = rb_intern("*");
+    id_spaceship = rb_intern("<=>");
+    id_subtract = rb_intern("-");
+    id_to_f = rb_intern("to_f");
+    id_to_s = rb_intern("to_s");
+}
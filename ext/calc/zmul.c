@@ -0,0 +1,506 @@
+#include "calc.h"
+
+/* Multiplication of very large integers by number theoretic transform.
+ *
+ * libcalc multiplies with schoolbook and Karatsuba methods, which become the
+ * bottleneck when both operands have many thousands of HALFs.  Above
+ * ntt_threshold, products are instead calculated as a convolution of the
+ * HALFs of each operand, modulo three primes of the form k * 2^m + 1 (which
+ * have 2^m-th roots of unity, so the convolution can be done by NTT).  Each
+ * coefficient of the convolution is less than the product of the primes, so
+ * it is recovered exactly by the chinese remainder theorem and the
+ * coefficients are then carried into the result.
+ *
+ * Division is reduced to multiplication too: zmod_fast finds a reciprocal by
+ * Newton's iteration and reduces by Barrett's method.
+ *
+ * Arithmetic modulo each prime uses Montgomery multiplication.  The CRT step
+ * needs 128 bit integers; without them (HAVE_TYPE___INT128 is set by
+ * extconf.rb) the *_fast functions just call the libcalc ones.
+ */
+
+#define NTT_P1 998244353U       /* 119 * 2^23 + 1 */
+#define NTT_P2 167772161U       /* 5 * 2^25 + 1 */
+#define NTT_P3 469762049U       /* 7 * 2^26 + 1 */
+#define NTT_G 3                 /* primitive root modulo all three primes */
+
+/* largest transform size supported by all three primes */
+#define NTT_MAXLEN (1L << 23)
+
+/* every coefficient of the convolution is at most min(len1, len2) *
+ * (BASE - 1)^2, which must be less than P1 * P2 * P3 (about 2^86) */
+#define NTT_MAXSHORT (1L << 21)
+
+/* both operands must have at least this many HALFs before NTT is used */
+#define NTT_THRESHOLD_DEFAULT 8192
+
+long ntt_threshold = NTT_THRESHOLD_DEFAULT;
+
+#ifdef HAVE_TYPE___INT128
+
+typedef unsigned __int128 ntt_u128;
+
+typedef struct {
+    uint32_t p;                 /* the prime */
+    uint32_t pinv;              /* -1/p mod 2^32 */
+    uint32_t r2;                /* 2^64 mod p */
+} NTTPRIME;
+
+static uint32_t
+mont_reduce(const NTTPRIME * np, uint64_t t)
+{
+    uint32_t m = (uint32_t) t * np->pinv;
+    uint32_t r = (uint32_t) ((t + (uint64_t) m * np->p) >> 32);
+
+    return r >= np->p ? r - np->p : r;
+}
+
+#define mont_mul(np, a, b) mont_reduce((np), (uint64_t) (a) * (b))
+
+static uint32_t
+powmod32(uint32_t b, uint64_t e, uint32_t p)
+{
+    uint64_t r = 1, x = b % p;
+
+    while (e) {
+        if (e & 1) {
+            r = r * x % p;
+        }
+        x = x * x % p;
+        e >>= 1;
+    }
+    return (uint32_t) r;
+}
+
+static void
+ntt_prime_init(NTTPRIME * np, uint32_t p)
+{
+    uint32_t inv = p;
+    int i;
+
+    /* newton iteration for 1/p mod 2^32 */
+    for (i = 0; i < 5; i++) {
+        inv *= 2 - p * inv;
+    }
+    np->p = p;
+    np->pinv = -inv;
+    np->r2 = (uint32_t) (((ntt_u128) 1 << 64) % p);
+}
+
+/* in-place transform of a (length n, a power of 2) modulo np->p.  values are
+ * in [0, p) and in normal (not Montgomery) form; the twiddle factors in tw
+ * are in Montgomery form so a Montgomery multiply by one is an ordinary
+ * modular multiply. */
+static void
+ntt(const NTTPRIME * np, uint32_t * a, long n, int inverse, uint32_t * tw)
+{
+    const uint32_t p = np->p;
+    uint32_t w, wlen, u, v, t;
+    long i, j, k, len, half;
+
+    for (i = 1, j = 0; i < n; i++) {
+        for (k = n >> 1; j & k; k >>= 1) {
+            j ^= k;
+        }
+        j ^= k;
+        if (i < j) {
+            t = a[i];
+            a[i] = a[j];
+            a[j] = t;
+        }
+    }
+    for (len = 2; len <= n; len <<= 1) {
+        half = len >> 1;
+        wlen = powmod32(NTT_G, (p - 1) / len, p);
+        if (inverse) {
+            wlen = powmod32(wlen, p - 2, p);
+        }
+        wlen = mont_mul(np, wlen, np->r2);      /* to Montgomery form */
+        w = mont_reduce(np, np->r2);    /* 1 in Montgomery form */
+        for (j = 0; j < half; j++) {
+            tw[j] = w;
+            w = mont_mul(np, w, wlen);
+        }
+        for (i = 0; i < n; i += len) {
+            for (j = 0; j < half; j++) {
+                u = a[i + j];
+                v = mont_mul(np, a[i + j + half], tw[j]);
+                t = u + v;
+                a[i + j] = t >= p ? t - p : t;
+                a[i + j + half] = u >= v ? u - v : u + p - v;
+            }
+        }
+    }
+}
+
+/* cyclic convolution of z1 and z2 modulo one prime, into out (length n).
+ * if z2 is NULL, z1 is squared.  fb is scratch space of length n, tw of
+ * length n / 2. */
+static void
+ntt_convolve(const NTTPRIME * np, ZVALUE z1, ZVALUE * z2, long n, uint32_t * out,
+             uint32_t * fb, uint32_t * tw)
+{
+    uint32_t scale;
+    long i;
+
+    for (i = 0; i < n; i++) {
+        out[i] = (i < z1.len) ? z1.v[i] % np->p : 0;
+    }
+    ntt(np, out, n, 0, tw);
+    if (z2) {
+        for (i = 0; i < n; i++) {
+            fb[i] = (i < z2->len) ? z2->v[i] % np->p : 0;
+        }
+        ntt(np, fb, n, 0, tw);
+        for (i = 0; i < n; i++) {
+            out[i] = mont_mul(np, out[i], fb[i]);
+        }
+    }
+    else {
+        for (i = 0; i < n; i++) {
+            out[i] = mont_mul(np, out[i], out[i]);
+        }
+    }
+    ntt(np, out, n, 1, tw);
+    /* the pointwise products carry a factor of 2^-32 from Montgomery
+     * multiplication; remove it and divide by n in one step: multiply by
+     * (2^64 / n) in Montgomery form */
+    scale = mont_mul(np, powmod32(n % np->p, np->p - 2, np->p), np->r2);
+    scale = mont_mul(np, scale, np->r2);
+    for (i = 0; i < n; i++) {
+        out[i] = mont_mul(np, out[i], scale);
+    }
+}
+
+/* one of the three convolutions of zmul_ntt, so they can run in parallel */
+typedef struct {
+    NTTPRIME np;
+    ZVALUE z1;
+    ZVALUE *z2;
+    long n;
+    uint32_t *out;
+    uint32_t *fb;
+    uint32_t *tw;
+} NTTCONV;
+
+static void *
+ntt_convolve_run(void *arg)
+{
+    NTTCONV *c = (NTTCONV *) arg;
+
+    ntt_convolve(&c->np, c->z1, c->z2, c->n, c->out, c->fb, c->tw);
+    return NULL;
+}
+
+/* returns FALSE (without touching res) if the operands are too large for the
+ * transform sizes supported by the primes.  with more than one thread (see
+ * Calc.config(:threads)) the three convolutions run at the same time, each
+ * with its own scratch space. */
+static BOOL
+zmul_ntt(ZVALUE z1, ZVALUE * z2, ZVALUE * res)
+{
+    static const uint32_t primes[3] = { NTT_P1, NTT_P2, NTT_P3 };
+    NTTCONV conv[3];
+    void *args[3];
+    uint32_t *r1, *r2, *r3, inv1, inv12, x2, x3;
+    ntt_u128 carry;
+    uint64_t p12;
+    long i, n, len2, outlen;
+    int parallel;
+
+    len2 = z2 ? z2->len : z1.len;
+    outlen = z1.len + len2;
+    if ((z1.len < len2 ? z1.len : len2) > NTT_MAXSHORT || outlen - 1 > NTT_MAXLEN) {
+        return FALSE;
+    }
+    n = 1;
+    while (n < outlen - 1) {
+        n <<= 1;
+    }
+
+    parallel = (calc_threads > 1);
+    for (i = 0; i < 3; i++) {
+        ntt_prime_init(&conv[i].np, primes[i]);
+        conv[i].z1 = z1;
+        conv[i].z2 = z2;
+        conv[i].n = n;
+        conv[i].out = ALLOC_N(uint32_t, n);
+        if (i == 0 || parallel) {
+            conv[i].fb = z2 ? ALLOC_N(uint32_t, n) : NULL;
+            conv[i].tw = ALLOC_N(uint32_t, n / 2 + 1);
+        }
+        else {
+            conv[i].fb = conv[0].fb;
+            conv[i].tw = conv[0].tw;
+        }
+        args[i] = &conv[i];
+    }
+    if (parallel) {
+        parallel_run(ntt_convolve_run, args, 3);
+    }
+    else {
+        for (i = 0; i < 3; i++) {
+            ntt_convolve_run(args[i]);
+        }
+    }
+    for (i = 0; i < (parallel ? 3 : 1); i++) {
+        xfree(conv[i].tw);
+        if (conv[i].fb) {
+            xfree(conv[i].fb);
+        }
+    }
+    r1 = conv[0].out;
+    r2 = conv[1].out;
+    r3 = conv[2].out;
+
+    /* garner's algorithm, then carry into HALFs */
+    inv1 = powmod32(NTT_P1 % NTT_P2, NTT_P2 - 2, NTT_P2);
+    p12 = (uint64_t) NTT_P1 *NTT_P2;
+    inv12 = powmod32((uint32_t) (p12 % NTT_P3), NTT_P3 - 2, NTT_P3);
+    res->v = alloc((LEN) outlen);
+    res->len = (LEN) outlen;
+    res->sign = (z1.sign != (z2 ? z2->sign : z1.sign));
+    carry = 0;
+    for (i = 0; i < outlen; i++) {
+        if (i < outlen - 1) {
+            x2 = (uint32_t) (((uint64_t) r2[i] + NTT_P2 - r1[i] % NTT_P2) * inv1 % NTT_P2);
+            x3 = (uint32_t) ((r3[i] + NTT_P3 - (r1[i] + (uint64_t) NTT_P1 * x2) % NTT_P3)
+                             * (uint64_t) inv12 % NTT_P3);
+            carry += r1[i] + (ntt_u128) NTT_P1 *x2 + (ntt_u128) p12 *x3;
+        }
+        res->v[i] = (HALF) carry;
+        carry >>= BASEB;
+    }
+    xfree(r1);
+    xfree(r2);
+    xfree(r3);
+    ztrim(res);
+    if (ziszero(*res)) {
+        res->sign = 0;
+    }
+    return TRUE;
+}
+
+#else
+
+#define zmul_ntt(z1, z2, res) FALSE
+
+#endif                          /* HAVE_TYPE___INT128 */
+
+/* z1 * z2, using NTT if both are large enough */
+void
+zmul_fast(ZVALUE z1, ZVALUE z2, ZVALUE * res)
+{
+    if (z1.len >= ntt_threshold && z2.len >= ntt_threshold && zmul_ntt(z1, &z2, res)) {
+        return;
+    }
+    zmul(z1, z2, res);
+}
+
+/* z^2, using NTT if z is large enough */
+void
+zsquare_fast(ZVALUE z, ZVALUE * res)
+{
+    if (z.len >= ntt_threshold && zmul_ntt(z, NULL, res)) {
+        res->sign = 0;
+        return;
+    }
+    zsquare(z, res);
+}
+
+#ifdef HAVE_TYPE___INT128
+
+/* an approximation to 2^e / m, for m > 0 and e at least the bit length of
+ * m, off by at most a few units.  each Newton step doubles the precision of
+ * the one before, and uses only as many leading bits of m as it needs, so
+ * the whole costs a few multiplications of the size of the result. */
+static void
+zrecip(ZVALUE m, long e, ZVALUE * res)
+{
+    ZVALUE mt, y, t, d;
+    long k, p, h, sh, et, big;
+
+    k = zhighbit(m) + 1;
+    p = e - k + 1;              /* bits in the result */
+    sh = k - p - 32;
+    if (sh > 0) {
+        zshift(m, -sh, &mt);
+    }
+    else {
+        sh = 0;
+        zcopy(m, &mt);
+    }
+    et = e - sh;
+    k -= sh;
+    if (p <= 256 || p <= ntt_threshold * BASEB) {
+        zbitvalue(et, &t);
+        zquo(t, mt, res, 0);
+        zfree(t);
+        zfree(mt);
+        return;
+    }
+
+    /* y is about 2^big / mt to h bits, so mt * y = 2^big - d with d about
+     * 2^(big - h), and 2^et / mt = 2^(et - big) * y / (1 - d / 2^big) which
+     * is y * 2^(et - big) + y * d * 2^(et - 2 big) to about 2h bits */
+    h = p / 2 + 32;
+    big = k - 1 + h;
+    zrecip(mt, big, &y);
+    zmul_fast(mt, y, &t);
+    zfree(mt);
+    zbitvalue(big, &mt);
+    zsub(mt, t, &d);
+    zfree(mt);
+    zfree(t);
+    zmul_fast(y, d, &t);
+    zfree(d);
+    zshift(t, et - 2 * big, &d);
+    zfree(t);
+    zshift(y, et - big, &t);
+    zfree(y);
+    zadd(t, d, res);
+    zfree(t);
+    zfree(d);
+}
+
+#endif                          /* HAVE_TYPE___INT128 */
+
+/* z mod m for z >= 0 and m > 0.  when the quotient and m are both large
+ * enough for NTT, by Barrett reduction with a reciprocal from zrecip,
+ * instead of libcalc's long division which is quadratic. */
+void
+zmod_fast(ZVALUE z, ZVALUE m, ZVALUE * res)
+{
+#ifdef HAVE_TYPE___INT128
+    ZVALUE x, q, t, r;
+    long s;
+
+    if (m.len < ntt_threshold || z.len < m.len + ntt_threshold) {
+        zmod(z, m, res, 0);
+        return;
+    }
+    s = zhighbit(z) + 1;
+    zrecip(m, s, &x);
+    zmul_fast(z, x, &t);
+    zfree(x);
+    zshift(t, -s, &q);
+    zfree(t);
+    zmul_fast(q, m, &t);
+    zfree(q);
+    zsub(z, t, &r);
+    zfree(t);
+    while (zisneg(r)) {
+        zadd(r, m, &t);
+        zfree(r);
+        r = t;
+    }
+    while (zrel(r, m) >= 0) {
+        zsub(r, m, &t);
+        zfree(r);
+        r = t;
+    }
+    *res = r;
+#else
+    zmod(z, m, res, 0);
+#endif
+}
+
+/* q1 * q2 for rationals, using zmul_fast.  like libcalc's qmul, common
+ * factors of each numerator and the other denominator are removed first so
+ * the result needs no further reduction. */
+NUMBER *
+qmul_fast(NUMBER * q1, NUMBER * q2)
+{
+    NUMBER *r;
+    ZVALUE n1, n2, d1, d2, g1, g2;
+
+    if (q1->num.len < ntt_threshold || q2->num.len < ntt_threshold) {
+        return qmul(q1, q2);
+    }
+    r = qalloc();
+    if (qisint(q1) && qisint(q2)) {
+        zmul_fast(q1->num, q2->num, &r->num);
+        return r;
+    }
+    zgcd(q1->num, q2->den, &g1);
+    zgcd(q2->num, q1->den, &g2);
+    zequo(q1->num, g1, &n1);
+    zequo(q2->den, g1, &d2);
+    zequo(q2->num, g2, &n2);
+    zequo(q1->den, g2, &d1);
+    zfree(g1);
+    zfree(g2);
+    zmul_fast(n1, n2, &r->num);
+    zmul_fast(d1, d2, &r->den);
+    zfree(n1);
+    zfree(n2);
+    zfree(d1);
+    zfree(d2);
+    return r;
+}
+
+/* integer power of a rational by repeated squaring with zsquare_fast and
+ * zmul_fast.  numerator and denominator are coprime so their powers are too,
+ * and they are raised separately. */
+static void
+zpowi_fast(ZVALUE z, long e, ZVALUE * res)
+{
+    ZVALUE acc, base, t;
+    int have = 0;
+
+    zcopy(z, &base);
+    while (e > 0) {
+        if (e & 1) {
+            if (have) {
+                zmul_fast(acc, base, &t);
+                zfree(acc);
+                acc = t;
+            }
+            else {
+                zcopy(base, &acc);
+                have = 1;
+            }
+        }
+        e >>= 1;
+        if (e > 0) {
+            zsquare_fast(base, &t);
+            zfree(base);
+            base = t;
+        }
+    }
+    zfree(base);
+    *res = acc;
+}
+
+/* q^e for an integer e, or NULL if the result isn't large enough to benefit
+ * from NTT (the caller should use qpower) */
+NUMBER *
+qpowi_fast(NUMBER * q, NUMBER * e)
+{
+    NUMBER *r, *t;
+    long n, len;
+
+    if (qisfrac(e) || qiszero(q) || zge31b(e->num)) {
+        return NULL;
+    }
+    n = ztoi(e->num);
+    if (n < 0) {
+        n = -n;
+    }
+    /* the last squaring is the biggest; skip unless it would use NTT */
+    len = (q->num.len > q->den.len) ? q->num.len : q->den.len;
+    if (n < 2 || len * (n / 2) < ntt_threshold) {
+        return NULL;
+    }
+    r = qalloc();
+    zpowi_fast(q->num, n, &r->num);
+    if (qisfrac(q)) {
+        zpowi_fast(q->den, n, &r->den);
+    }
+    if (qisneg(e)) {
+        t = qinv(r);
+        qfree(r);
+        r = t;
+    }
+    return r;
+}
@@ -3,6 +3,9 @@ require "calc/calc"
 require "calc/numeric"
 require "calc/q"
 require "calc/c"
+require "calc/polynomial"
+require "calc/real"
+require "calc/interval"
 
 module Calc
   # builtins implemented as instance methods on Calc::Q or Calc::C
@@ -51,6 +54,14 @@ module Calc
     C.new(*args)
   end
 
+  def self.Fixed(*args) # rubocop:disable Style/MethodName
+    Fixed.new(*args)
+  end
+
+  def self.Unreduced(*args) # rubocop:disable Style/MethodName
+    Unreduced.new(*args)
+  end
+
   # Average (arithmetic mean)
   #
   # Any number of numeric arguments can be provided.  Returns the sum of all
@@ -200,16 +211,15 @@ module Calc
     args.flatten.map { |t| to_calc_x(t) }.compact.inject(:+)
   end
 
- 
+  # Prints the Fibonacci numbers less than n
+  #
+  # @param n [Numeric]
+  # @return [nil]
+  # @see Calc.fib_each
+  # @example
+  #  Calc.fiblist(10) # prints [0, 1, 1, 2, 3, 5, 8]
   def self.fiblist(n)
-    x, y = 0, 1
-    list = Array.new
-    while x < n
-      list << x 
-      x, y = y, x + y
-     
-    end
-    print "#{list}\n"
+    print "#{ fib_each(n).map(&:to_i) }\n"
   end
 
   # returns a Calc::Q or Calc::C object, converting if necessary
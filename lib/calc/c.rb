@@ -75,50 +75,6 @@ module Calc
     end
     alias conjugate conj
 
-    # Trigonometric cotangent
-    #
-    # @param eps [Calc::Q] (optional) calculation accuracy
-    # @return [Calc::C]
-    # @example
-    #  Calc::C(2,3).cot #=> Calc::C(~-0.00373971037633695666-~0.99675779656935831046i)
-    def cot(*args)
-      # see f_cot() in func.c
-      cos(*args) / sin(*args)
-    end
-
-    # Hyperbolic cotangent
-    #
-    # @param eps [Calc::Q] (optional) calculation accuracy
-    # @return [Calc::C]
-    # @example
-    #  Calc::C(2,3).coth #=> Calc::C(~1.03574663776499539611+~0.01060478347033710175i)
-    def coth(*args)
-      # see f_coth() in func.c
-      cosh(*args) / sinh(*args)
-    end
-
-    # Trigonometric cosecant
-    #
-    # @param eps [Calc::Q] (optional) calculation accuracy
-    # @return [Calc::C]
-    # @example
-    #  Calc::C(2,3).csc #=> Calc::C(~0.09047320975320743981+~0.04120098628857412646i)
-    def csc(*args)
-      # see f_csc() in func.c
-      sin(*args).inverse
-    end
-
-    # Hyperbolic cosecant
-    #
-    # @param eps [Calc::Q] (optional) calculation accuracy
-    # @return [Calc::C]
-    # @example
-    #  Calc::C(2,3).csch #=> Calc::C(~-0.27254866146294019951-~0.04030057885689152187i)
-    def csch(*args)
-      # see f_csch() in func.c
-      sinh(*args).inverse
-    end
-
     # Denominator of a complex number
     #
     # The denominator is the lowest common denominator of the real and
@@ -246,50 +202,6 @@ module Calc
       end
     end
 
-    # Trigonometric secant
-    #
-    # @param eps [Calc::Q] (optional) calculation accuracy
-    # @return [Calc::C]
-    # @example
-    #  Calc::C(2,3).sec #=> Calc::C(~-0.04167496441114427005+~0.09061113719623759653i)
-    def sec(*args)
-      # see f_sec() in func.c
-      cos(*args).inverse
-    end
-
-    # Hyperbolic secant
-    #
-    # @param eps [Calc::Q] (optional) calculation accuracy
-    # @return [Calc::C]
-    # @example
-    #  Calc::C(2,3).sech #=> Calc::C(~-0.26351297515838930964-~0.03621163655876852087i)
-    def sech(*args)
-      # see f_sech() in func.c
-      cosh(*args).inverse
-    end
-
-    # Trigonometric tangent
-    #
-    # @param eps [Calc::Q] (optional) calculation accuracy
-    # @return [Calc::C]
-    # @example
-    #  Calc::C(1,2).tan #=> Calc::C(~-0.00376402564150424829+~1.00323862735360980145i)
-    def tan(*args)
-      # see f_tan() in func.c
-      sin(*args) / cos(*args)
-    end
-
-    # Hyperbolic tangent
-    #
-    # @param eps [Calc::Q] (optional) calculation accuracy
-    # @return [Calc::C]
-    # @example
-    #  Calc::C(1,2).tanh #=> Calc::C(~0.96538587902213312428-~0.00988437503832249372i)
-    def tanh(*args)
-      # see f_tanh() in func.c
-      sinh(*args) / cosh(*args)
-    end
-
     # Converts a Calc::C object into a ruby Complex object
     #
     # @return [Complex]
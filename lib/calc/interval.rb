@@ -0,0 +1,260 @@
+module Calc
+  # Closed interval with rational endpoints, for certified bounds
+  #
+  # Arithmetic on intervals gives an interval containing every possible
+  # result, so a calculation done with intervals bounds its own error: if the
+  # answer is narrow enough, it is correct, and there is no need to repeat
+  # the calculation at a much smaller epsilon to check it.
+  #
+  # +, -, *, / and integer powers are exact (the endpoints are rationals).
+  # The transcendental methods take an epsilon like their Calc::Q
+  # equivalents, whose results are within epsilon of the true value; the
+  # bounds are widened by epsilon and rounded outwards to multiples of it
+  # with Calc::Q#appr, so they stay short as well as correct.
+  #
+  # @example
+  #  x = Calc::Interval(1, 2)
+  #  x * x - x          #=> Calc::Interval(-1, 3)
+  #  Calc::Interval(2).sqrt("1e-5") #=> Calc::Interval(1.4142, 1.41422)
+  #  y = Calc::Interval.refine("1e-50") { |eps| Calc::Interval(2).ln(eps).exp(eps) }
+  #  y.include?(2) #=> true
+  class Interval
+    attr_reader :lo, :hi
+
+    # Creates an interval
+    #
+    # @param lo [Numeric,String] lower bound
+    # @param hi [Numeric,String] upper bound (default: same as lo)
+    # @raise [ArgumentError] if lo > hi
+    # @example
+    #  Calc::Interval.new(1, 2) #=> Calc::Interval(1, 2)
+    def initialize(lo, hi = lo)
+      @lo = Calc::Q(lo)
+      @hi = Calc::Q(hi)
+      raise ArgumentError, "lower bound of interval is above upper bound" if @lo > @hi
+    end
+
+    # Returns x as an interval
+    #
+    # @param x [Calc::Interval,Numeric,String]
+    # @return [Calc::Interval]
+    def self.convert(x)
+      x.is_a?(Interval) ? x : new(x)
+    end
+
+    # An interval containing pi
+    #
+    # @param eps [Numeric] (default: Calc.config(:epsilon))
+    # @return [Calc::Interval]
+    def self.pi(eps = nil)
+      eps = epsilon(eps)
+      around(Calc.pi(eps), eps)
+    end
+
+    # Repeats a calculation with smaller epsilons until it is narrow enough
+    #
+    # The block is called with an epsilon, starting from eps, and must
+    # return an Interval.  While its width is more than width, the block is
+    # called again with a smaller epsilon (about twice as many digits each
+    # time), so the work done is not much more than at the first epsilon
+    # which would have been enough.
+    #
+    # @param width [Numeric] maximum width of the result
+    # @param eps [Numeric] first epsilon (default: Calc.config(:epsilon))
+    # @return [Calc::Interval]
+    # @yield [Calc::Q] epsilon
+    # @raise [Calc::MathError] if the interval can't be made narrow enough
+    # @example
+    #  r = Calc::Interval.refine("1e-40") { |eps| (Calc::Interval(3).sqrt(eps) - 1).ln(eps) }
+    #  r.width <= Calc::Q("1e-40") #=> true
+    def self.refine(width, eps = nil)
+      width = Calc::Q(width)
+      eps = epsilon(eps)
+      loop do
+        result = yield(eps)
+        return result if result.width <= width
+        if eps.ilog2 < -Real::MAX_BITS
+          raise Calc::MathError, "interval is still too wide at epsilon 2^-#{ Real::MAX_BITS }"
+        end
+        eps = eps < REFINE_FACTOR ? eps * eps : eps * REFINE_FACTOR
+      end
+    end
+
+    # smallest step used by refine
+    REFINE_FACTOR = Calc::Q(1, 2**32)
+
+    def self.epsilon(eps)
+      eps = Calc::Q(eps || Calc.config(:epsilon))
+      raise Calc::MathError, "epsilon for Calc::Interval must be positive" unless eps > 0
+      eps
+    end
+    private_class_method :epsilon
+
+    # [x - eps, x + eps], rounded outwards to multiples of eps
+    def self.around(x, eps)
+      new((x - eps).appr(eps, 0), (x + eps).appr(-eps, 0))
+    end
+    private_class_method :around
+
+    def width
+      @hi - @lo
+    end
+
+    # Midpoint
+    #
+    # @return [Calc::Q]
+    def mid
+      (@lo + @hi) / 2
+    end
+
+    # Returns true if x is in the interval
+    #
+    # @param x [Numeric,Calc::Interval]
+    def include?(x)
+      x = Interval.convert(x)
+      @lo <= x.lo && x.hi <= @hi
+    end
+
+    def ==(other)
+      other.is_a?(Interval) && @lo == other.lo && @hi == other.hi
+    end
+    alias eql? ==
+
+    def hash
+      [@lo, @hi].hash
+    end
+
+    def +(other)
+      other = Interval.convert(other)
+      Interval.new(@lo + other.lo, @hi + other.hi)
+    end
+
+    def -(other)
+      other = Interval.convert(other)
+      Interval.new(@lo - other.hi, @hi - other.lo)
+    end
+
+    def -@
+      Interval.new(-@hi, -@lo)
+    end
+
+    def *(other)
+      other = Interval.convert(other)
+      products = [@lo * other.lo, @lo * other.hi, @hi * other.lo, @hi * other.hi]
+      Interval.new(products.min, products.max)
+    end
+
+    # @raise [ZeroDivisionError] if other contains zero
+    def /(other)
+      self * Interval.convert(other).inverse
+    end
+
+    # @raise [ZeroDivisionError] if self contains zero
+    def inverse
+      raise ZeroDivisionError, "interval contains zero" if @lo <= 0 && @hi >= 0
+      Interval.new(@hi.inverse, @lo.inverse)
+    end
+
+    def abs
+      return self if @lo >= 0
+      return -self if @hi <= 0
+      Interval.new(0, [-@lo, @hi].max)
+    end
+
+    # Raises self to an integer power
+    #
+    # @param n [Integer]
+    # @return [Calc::Interval]
+    # @raise [ZeroDivisionError] for a negative power of an interval
+    #  containing zero
+    def **(other)
+      n = Calc::Q(other)
+      raise ArgumentError, "power of an interval must be an integer" unless n.int?
+      return (self**-n).inverse if n < 0
+      a = abs
+      return Interval.new(a.lo**n, a.hi**n) if n.even?
+      Interval.new(@lo**n, @hi**n)
+    end
+
+    # @param eps [Numeric] (default: Calc.config(:epsilon))
+    def exp(eps = nil)
+      eps = Interval.__send__(:epsilon, eps)
+      r = join(@lo.exp(eps), @hi.exp(eps), eps)
+      r.lo < 0 ? Interval.new(0, r.hi) : r
+    end
+
+    # @param eps [Numeric] (default: Calc.config(:epsilon))
+    # @raise [Calc::MathError] unless the interval is positive
+    def ln(eps = nil)
+      eps = Interval.__send__(:epsilon, eps)
+      raise Calc::MathError, "logarithm of interval which isn't positive" unless @lo > 0
+      join(@lo.ln(eps), @hi.ln(eps), eps)
+    end
+
+    # @param eps [Numeric] (default: Calc.config(:epsilon))
+    # @raise [Calc::MathError] if the interval has negative values
+    def sqrt(eps = nil)
+      eps = Interval.__send__(:epsilon, eps)
+      raise Calc::MathError, "square root of interval with negative values" if @lo < 0
+      r = join(@lo.sqrt(eps), @hi.sqrt(eps), eps)
+      r.lo < 0 ? Interval.new(0, r.hi) : r
+    end
+
+    # @param eps [Numeric] (default: Calc.config(:epsilon))
+    def sin(eps = nil)
+      periodic(:sin, 1, eps)
+    end
+
+    # @param eps [Numeric] (default: Calc.config(:epsilon))
+    def cos(eps = nil)
+      periodic(:cos, 0, eps)
+    end
+
+    def coerce(other)
+      [Interval.convert(other), self]
+    end
+
+    def to_s
+      "[#{ @lo }, #{ @hi }]"
+    end
+
+    def inspect
+      @lo == @hi ? "Calc::Interval(#{ @lo })" : "Calc::Interval(#{ @lo }, #{ @hi })"
+    end
+
+    private
+
+    # interval from approximations (within eps) of the values at each end of
+    # a monotonic function
+    def join(a, b, eps)
+      a, b = b, a if a > b
+      Interval.new((a - eps).appr(eps, 0), (b + eps).appr(-eps, 0))
+    end
+
+    # sin or cos.  the maximum is at (4k + max_at) * pi/2 and the minimum
+    # two quarter turns later.
+    def periodic(f, max_at, eps)
+      eps = Interval.__send__(:epsilon, eps)
+      pi = Interval.pi(eps)
+      return Interval.new(-1, 1) if width >= pi.lo * 2
+      r = join(@lo.__send__(f, eps), @hi.__send__(f, eps), eps)
+      lo = turning_point?(max_at + 2, pi) ? -1 : [r.lo, -1].max
+      hi = turning_point?(max_at, pi) ? 1 : [r.hi, 1].min
+      Interval.new(lo, hi)
+    end
+
+    # can self contain (4k + m) * pi/2 for some integer k, pi being anywhere
+    # in the interval pi?
+    def turning_point?(m, pi)
+      k = ((mid * 2 / pi.mid - m) / 4).floor
+      (k - 1..k + 1).any? do |j|
+        ends = [pi.lo * (4 * j + m) / 2, pi.hi * (4 * j + m) / 2]
+        ends.min <= @hi && ends.max >= @lo
+      end
+    end
+  end
+
+  def self.Interval(lo, hi = lo) # rubocop:disable Style/MethodName
+    Interval.new(lo, hi)
+  end
+end
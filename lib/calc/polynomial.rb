@@ -0,0 +1,416 @@
+module Calc
+  # Polynomial in one variable with Calc::Q coefficients
+  #
+  # Coefficients are stored lowest degree first, the same order as the array
+  # form of Calc.poly.  Polynomials are immutable; arithmetic returns new
+  # objects.
+  #
+  # Products are calculated with Kronecker substitution, so a product of two
+  # large polynomials costs one large integer multiplication.  Long division
+  # uses Newton iteration on the reversed divisor, and evaluation at many
+  # points (or interpolation through many points) uses a subproduct tree,
+  # which is much faster than evaluating at each point separately once there
+  # are more than a handful of points.
+  #
+  # @example
+  #  p = Calc::Polynomial.new([-1, 0, 1]) #=> Calc::Polynomial(x^2 - 1)
+  #  p.call(3)                            #=> Calc::Q(8)
+  #  p.evaluate_many([1, 2, 3])           #=> [Calc::Q(0), Calc::Q(3), Calc::Q(8)]
+  class Polynomial
+    # products where both factors have at least this many terms use Kronecker
+    # substitution; smaller ones are multiplied term by term
+    KRONECKER_THRESHOLD = 8
+
+    # quotients with at least this many terms are calculated with Newton
+    # iteration; smaller ones with schoolbook long division
+    NEWTON_THRESHOLD = 32
+
+    # evaluate_many uses a subproduct tree for at least this many points
+    TREE_THRESHOLD = 16
+
+    # Creates a new polynomial
+    #
+    # @param coeffs [Array] coefficients, lowest degree first
+    # @example
+    #  Calc::Polynomial.new([1, 2, 3]) #=> Calc::Polynomial(3*x^2 + 2*x + 1)
+    def initialize(coeffs = [])
+      coeffs = coeffs.coefficients if coeffs.is_a?(Polynomial)
+      @coeffs = coeffs.map { |c| Calc::Q(c) }
+      @coeffs.pop while @coeffs.any? && @coeffs.last.zero?
+      @coeffs.freeze
+    end
+
+    # Creates a polynomial from its coefficients, lowest degree first
+    #
+    # @example
+    #  Calc::Polynomial[1, 2, 3] #=> Calc::Polynomial(3*x^2 + 2*x + 1)
+    def self.[](*coeffs)
+      new(coeffs)
+    end
+
+    # Returns the monic polynomial with the given roots
+    #
+    # @param roots [Array<Numeric>]
+    # @return [Calc::Polynomial]
+    # @example
+    #  Calc::Polynomial.from_roots([1, -1]) #=> Calc::Polynomial(x^2 - 1)
+    def self.from_roots(roots)
+      return new([1]) if roots.empty?
+      subproduct_tree(roots.map { |x| Calc::Q(x) }).last.first
+    end
+
+    # Returns the polynomial of least degree passing through the given points
+    #
+    # Uses a subproduct tree to calculate the Lagrange interpolating
+    # polynomial in quasi-linear time.
+    #
+    # @param xs [Array<Numeric>] distinct x coordinates
+    # @param ys [Array<Numeric>] y coordinates
+    # @return [Calc::Polynomial]
+    # @raise [ArgumentError] if xs and ys are different sizes
+    # @raise [Calc::MathError] if any x coordinates are repeated
+    # @example
+    #  Calc::Polynomial.interpolate([0, 1, 2], [1, 2, 5]) #=> Calc::Polynomial(x^2 + 1)
+    def self.interpolate(xs, ys)
+      raise ArgumentError, "xs and ys must be the same size" unless xs.size == ys.size
+      return new if xs.empty?
+      xs = xs.map { |x| Calc::Q(x) }
+      if xs.sort.each_cons(2).any? { |a, b| a == b }
+        raise MathError, "Repeated x coordinate for interpolate"
+      end
+      tree = subproduct_tree(xs)
+      weights = tree.last.first.derivative.__send__(:evaluate_tree, tree)
+      level = ys.zip(weights).map { |y, w| new([Calc::Q(y) / w]) }
+      tree[0..-2].each do |ms|
+        level = level.each_slice(2).each_with_index.map do |(a, b), j|
+          b ? a * ms[2 * j + 1] + b * ms[2 * j] : a
+        end
+      end
+      level.first
+    end
+
+    # levels of the tree of products of (x - p) for each p in points, from the
+    # leaves up.  node i of a level is the product of nodes 2i and 2i+1 of the
+    # level below.
+    def self.subproduct_tree(points)
+      level = points.map { |x| new([-x, 1]) }
+      tree = [level]
+      while level.size > 1
+        level = level.each_slice(2).map { |a, b| b ? a * b : a }
+        tree << level
+      end
+      tree
+    end
+    private_class_method :subproduct_tree
+
+    # Returns the coefficient of x^i
+    #
+    # @param i [Integer]
+    # @return [Calc::Q]
+    # @example
+    #  Calc::Polynomial[1, 2, 3][1] #=> Calc::Q(2)
+    def [](i)
+      (i >= 0 && @coeffs[i]) || Q::ZERO
+    end
+
+    # Returns an array of coefficients, lowest degree first
+    #
+    # @return [Array<Calc::Q>]
+    def coefficients
+      @coeffs.dup
+    end
+    alias to_a coefficients
+
+    # Returns the degree of the polynomial (-1 for the zero polynomial)
+    #
+    # @return [Integer]
+    # @example
+    #  Calc::Polynomial[1, 2, 3].degree #=> 2
+    def degree
+      @coeffs.size - 1
+    end
+
+    # Returns the coefficient of the highest power of x
+    #
+    # @return [Calc::Q]
+    def leading
+      @coeffs.last || Q::ZERO
+    end
+
+    # Returns true if this is the zero polynomial
+    def zero?
+      @coeffs.empty?
+    end
+
+    # Returns self divided by its leading coefficient
+    #
+    # @return [Calc::Polynomial]
+    # @example
+    #  Calc::Polynomial[2, 4].monic #=> Calc::Polynomial(x + 1/2)
+    def monic
+      return self if zero? || leading == 1
+      self * leading.inverse
+    end
+
+    def ==(other)
+      other.is_a?(Polynomial) && @coeffs == other.coefficients
+    end
+    alias eql? ==
+
+    def hash
+      @coeffs.map(&:to_s).hash
+    end
+
+    def coerce(other)
+      [Polynomial.new([other]), self]
+    end
+
+    def -@
+      Polynomial.new(@coeffs.map(&:-@))
+    end
+
+    def +(other)
+      other = to_polynomial(other)
+      a = other.coefficients
+      size = [@coeffs.size, a.size].max
+      Polynomial.new(Array.new(size) { |i| self[i] + (a[i] || Q::ZERO) })
+    end
+
+    def -(other)
+      self + -to_polynomial(other)
+    end
+
+    # Multiplication
+    #
+    # If other is a polynomial and both factors are large, the product is
+    # calculated with Kronecker substitution: coefficients are scaled to
+    # integers, packed into a single large integer per polynomial, and one
+    # integer multiplication gives all the coefficients of the product.
+    #
+    # @param other [Calc::Polynomial,Numeric]
+    # @return [Calc::Polynomial]
+    # @example
+    #  Calc::Polynomial[1, 1] * Calc::Polynomial[-1, 1] #=> Calc::Polynomial(x^2 - 1)
+    def *(other)
+      unless other.is_a?(Polynomial)
+        other = Calc::Q(other)
+        return Polynomial.new(@coeffs.map { |c| c * other })
+      end
+      b = other.coefficients
+      return Polynomial.new if zero? || b.empty?
+      if [@coeffs.size, b.size].min < KRONECKER_THRESHOLD
+        product = Array.new(@coeffs.size + b.size - 1, Q::ZERO)
+        @coeffs.each_with_index do |x, i|
+          next if x.zero?
+          b.each_with_index { |y, j| product[i + j] += x * y }
+        end
+        Polynomial.new(product)
+      else
+        ia, da = integral(@coeffs)
+        ib, db = integral(b)
+        d = da * db
+        Polynomial.new(Polynomial.kronecker_mul(ia, ib).map { |c| c / d })
+      end
+    end
+
+    # Raises to a non-negative integer power
+    #
+    # @param n [Integer]
+    # @return [Calc::Polynomial]
+    # @raise [ArgumentError] if n is negative or not an integer
+    def **(other)
+      n = other.to_i
+      raise ArgumentError, "Polynomial power must be a non-negative integer" if n < 0 || n != other
+      result = Polynomial.new([1])
+      base = self
+      while n > 0
+        result *= base if n.odd?
+        n >>= 1
+        base *= base if n > 0
+      end
+      result
+    end
+
+    # Polynomial division with remainder
+    #
+    # Returns [q, r] such that self == q * other + r and r has lower degree
+    # than other.  Long quotients are calculated by Newton iteration on the
+    # reversed divisor, which costs a few multiplications rather than one
+    # step per term.
+    #
+    # @param other [Calc::Polynomial,Numeric]
+    # @return [Array<Calc::Polynomial>]
+    # @raise [Calc::MathError] if other is zero
+    # @example
+    #  Calc::Polynomial[-1, 0, 1].divmod(Calc::Polynomial[1, 1])
+    #  #=> [Calc::Polynomial(x - 1), Calc::Polynomial(0)]
+    def divmod(other)
+      other = to_polynomial(other)
+      raise MathError, "Division by zero" if other.zero?
+      n = degree
+      m = other.degree
+      return [Polynomial.new, self] if n < m
+      return [self * other.leading.inverse, Polynomial.new] if m.zero?
+      q = if n - m + 1 < NEWTON_THRESHOLD
+            long_divide(other)
+          else
+            newton_divide(other)
+          end
+      [q, self - q * other]
+    end
+
+    def /(other)
+      divmod(other).first
+    end
+
+    def %(other)
+      divmod(other).last
+    end
+    alias modulo %
+
+    # Greatest common divisor
+    #
+    # The result is monic (or zero if both polynomials are zero).
+    #
+    # @param other [Calc::Polynomial]
+    # @return [Calc::Polynomial]
+    # @example
+    #  Calc::Polynomial[-1, 0, 1].gcd(Calc::Polynomial[1, 2, 1]) #=> Calc::Polynomial(x + 1)
+    def gcd(other)
+      a = self
+      b = to_polynomial(other)
+      a, b = b.monic, a % b until b.zero?
+      a.monic
+    end
+
+    # Returns the derivative
+    #
+    # @return [Calc::Polynomial]
+    # @example
+    #  Calc::Polynomial[1, 2, 3].derivative #=> Calc::Polynomial(6*x + 2)
+    def derivative
+      Polynomial.new(@coeffs.each_with_index.drop(1).map { |c, i| c * i })
+    end
+
+    # Evaluates the polynomial at x using Horner's method
+    #
+    # @param x [Numeric]
+    # @return [Calc::Q,Calc::C]
+    # @example
+    #  Calc::Polynomial[1, 2, 3].call(2) #=> Calc::Q(17)
+    def call(x)
+      x = x.is_a?(Calc::C) || x.is_a?(Complex) ? Calc::C(x) : Calc::Q(x)
+      @coeffs.reverse.inject(Q::ZERO) { |acc, c| acc * x + c }
+    end
+    alias evaluate call
+
+    # Evaluates the polynomial at many points
+    #
+    # With enough points, builds a subproduct tree of the points and reduces
+    # self modulo each level in turn, which is quasi-linear in the number of
+    # points rather than quadratic.
+    #
+    # @param points [Array<Numeric>] real values
+    # @return [Array<Calc::Q>]
+    # @example
+    #  Calc::Polynomial[1, 2, 3].evaluate_many([0, 1, 2]) #=> [Calc::Q(1), Calc::Q(6), Calc::Q(17)]
+    def evaluate_many(points)
+      points = points.map { |x| Calc::Q(x) }
+      return points.map { |x| call(x) } if points.size < TREE_THRESHOLD
+      evaluate_tree(Polynomial.__send__(:subproduct_tree, points))
+    end
+
+    def to_s
+      return "0" if zero?
+      terms = []
+      @coeffs.each_with_index.reverse_each do |c, i|
+        next if c.zero?
+        a = c.abs
+        term = if i.zero?
+                 a.to_s
+               else
+                 power = i == 1 ? "x" : "x^#{ i }"
+                 a == 1 ? power : "#{ a }*#{ power }"
+               end
+        if terms.empty?
+          terms << (c < 0 ? "-#{ term }" : term)
+        else
+          terms << (c < 0 ? "- " : "+ ") + term
+        end
+      end
+      terms.join(" ")
+    end
+
+    def inspect
+      "Calc::Polynomial(#{ self })"
+    end
+
+    private
+
+    def to_polynomial(x)
+      x.is_a?(Polynomial) ? x : Polynomial.new([x])
+    end
+
+    # returns [integer coefficients, common denominator]
+    def integral(coeffs)
+      d = coeffs.map(&:den).inject { |a, b| a.lcm(b) }
+      [d == 1 ? coeffs : coeffs.map { |c| c * d }, d]
+    end
+
+    # first n coefficients
+    def truncate(n)
+      Polynomial.new(@coeffs.first(n))
+    end
+
+    # power series inverse of self modulo x^n.  each step doubles the number
+    # of correct terms: g' = g * (2 - f * g).
+    def inverse_series(n)
+      g = Polynomial.new([self[0].inverse])
+      k = 1
+      while k < n
+        k = [2 * k, n].min
+        e = -(truncate(k) * g).truncate(k) + 2
+        g = (g * e).truncate(k)
+      end
+      g
+    end
+
+    def long_divide(other)
+      n = degree
+      m = other.degree
+      b = other.coefficients
+      r = @coeffs.dup
+      lead = other.leading.inverse
+      q = Array.new(n - m + 1, Q::ZERO)
+      (n - m).downto(0) do |i|
+        c = r[i + m] * lead
+        q[i] = c
+        next if c.zero?
+        b.each_with_index { |bc, j| r[i + j] -= c * bc }
+      end
+      Polynomial.new(q)
+    end
+
+    # with rev(p) = x^deg(p) * p(1/x), rev(q) = rev(self) / rev(other) as a
+    # power series, modulo x^(deg(q) + 1).
+    def newton_divide(other)
+      k = degree - other.degree + 1
+      ra = Polynomial.new(@coeffs.reverse).truncate(k)
+      rb = Polynomial.new(other.coefficients.reverse)
+      rq = (ra * rb.inverse_series(k)).truncate(k)
+      Polynomial.new(Array.new(k) { |i| rq[k - 1 - i] })
+    end
+
+    # values of self at the leaves of a subproduct tree, by reducing self
+    # modulo each node from the root down
+    def evaluate_tree(tree)
+      rems = [self % tree.last.first]
+      (tree.size - 2).downto(0) do |lv|
+        rems = tree[lv].each_with_index.map { |m, i| rems[i / 2] % m }
+      end
+      rems.map { |r| r[0] }
+    end
+
+    protected :inverse_series, :truncate
+  end
+end
@@ -278,11 +278,11 @@ module Calc
       odd? ? ONE : ZERO
     end
 
-    # Returns 1 if self is prime, 0 if it is not prime.  This function can't
-    # be used for odd numbers > 2^32.
+    # Returns 1 if self is prime, 0 if it is not prime.  Values > 2^32 are
+    # checked with a Baillie-PSW test; see {#prime?}.
     #
     # @return [Calc::Q]
-    # @raise [Calc::MathError] if self is odd and > 2^32
+    # @raise [Calc::MathError] if self is not an integer
     # @example
     #  Calc::Q(2**31 - 9).isprime #=> Calc::Q(0)
     #  Calc::Q(2**31 - 1).isprime #=> Calc::Q(1)
@@ -0,0 +1,288 @@
+module Calc
+  # Exact real number, evaluated lazily to whatever accuracy is asked for
+  #
+  # Transcendental methods on Calc::Q take an epsilon up front, and in a
+  # chain of them the error of each step is magnified by the next, so the
+  # epsilons have to be chosen pessimistically.  A Calc::Real instead records
+  # the operations, and when a value is wanted works out how accurate each
+  # intermediate result has to be for the final one to be within the
+  # requested accuracy.  Each node only does as much work as its parent
+  # needs.
+  #
+  # Values are calculated by the same functions as Calc::Q (Calc::Q#exp,
+  # Calc::Q#ln, etc) with the epsilon chosen automatically.  Every node keeps
+  # the best approximation it has calculated, so asking for the same or less
+  # accuracy again costs nothing, and when more is needed it grows by at
+  # least half again, so refining a value step by step doesn't keep paying
+  # for the whole calculation.
+  #
+  # Comparing two reals exactly is undecidable in general, so there are no
+  # comparison methods; compare approximations instead.  Operations which
+  # need to know that a value is not zero (division, ln) give up with a
+  # Calc::MathError once it is known to be within 2^-MAX_BITS of zero.
+  #
+  # @example
+  #  x = Calc::Real(2).sqrt.ln * Calc::Real.pi
+  #  x.to_q(Calc::Q("1e-30")) #=> Calc::Q(1.088793045151801065250344449119)
+  #  x.to_s(50)              #=> "1.08879304515180106525034444911880697366929185018464"
+  class Real
+    # operations needing a non-zero value give up after this many bits
+    MAX_BITS = 10_000
+
+    # rounding mode for final results: to nearest, half to even
+    NEAREST = 24
+
+    # Creates an exact real from a rational number
+    #
+    # @param x [Numeric,String] anything accepted by Calc::Q.new
+    # @example
+    #  Calc::Real.new("1/3")
+    def initialize(x)
+      @op = :exact
+      @value = Calc::Q(x)
+    end
+
+    # pi
+    #
+    # @return [Calc::Real]
+    def self.pi
+      node(:pi)
+    end
+
+    # e, the base of natural logarithms
+    #
+    # @return [Calc::Real]
+    def self.e
+      node(:e)
+    end
+
+    def self.node(op, *args)
+      r = allocate
+      r.instance_variable_set(:@op, op)
+      r.instance_variable_set(:@args, args)
+      r
+    end
+    private_class_method :node
+
+    # Returns x as a Calc::Real
+    #
+    # @param x [Calc::Real,Numeric,String]
+    # @return [Calc::Real]
+    def self.convert(x)
+      x.is_a?(Real) ? x : new(x)
+    end
+
+    def +(other)
+      Real.__send__(:node, :add, self, Real.convert(other))
+    end
+
+    def -(other)
+      self + -Real.convert(other)
+    end
+
+    def -@
+      Real.__send__(:node, :neg, self)
+    end
+
+    def *(other)
+      Real.__send__(:node, :mul, self, Real.convert(other))
+    end
+
+    def /(other)
+      self * Real.convert(other).inverse
+    end
+
+    # Raises self to a power
+    #
+    # An integer power is calculated by repeated multiplication; any other
+    # power as exp(other * ln(self)), so self must be positive.
+    #
+    # @param other [Integer,Calc::Real,Numeric]
+    # @return [Calc::Real]
+    # @raise [Calc::MathError] for a non-integer power of a non-positive number
+    def **(other)
+      if other.is_a?(Integer) || (!other.is_a?(Real) && Calc::Q(other).int?)
+        n = other.to_i
+        return Real.new(1) if n.zero?
+        return Real.__send__(:node, :pow, self, n) if n > 0
+        Real.__send__(:node, :pow, self, -n).inverse
+      else
+        (Real.convert(other) * ln).exp
+      end
+    end
+
+    def inverse
+      Real.__send__(:node, :inv, self)
+    end
+
+    def exp
+      Real.__send__(:node, :exp, self)
+    end
+
+    # @raise [Calc::MathError] (when evaluated) if self is not positive
+    def ln
+      Real.__send__(:node, :ln, self)
+    end
+
+    # @raise [Calc::MathError] (when evaluated) if self is negative
+    def sqrt
+      Real.__send__(:node, :sqrt, self)
+    end
+
+    def sin
+      Real.__send__(:node, :sin, self)
+    end
+
+    def cos
+      Real.__send__(:node, :cos, self)
+    end
+
+    def tan
+      sin / cos
+    end
+
+    def atan
+      Real.__send__(:node, :atan, self)
+    end
+
+    def coerce(other)
+      [Real.convert(other), self]
+    end
+
+    # Returns a rational approximation within 2^-bits
+    #
+    # @param bits [Integer]
+    # @return [Calc::Q]
+    # @example
+    #  Calc::Real.pi.approximate(10) #=> Calc::Q(3.1416015625)
+    def approximate(bits)
+      return @value if @op == :exact
+      bits = 0 if bits < 0
+      if @bits.nil? || @bits < bits
+        bits = [bits, @bits + @bits / 2].max if @bits
+        @approx = compute(bits)
+        @bits = bits
+      end
+      @approx
+    end
+
+    # Returns the nearest multiple of eps (or one of the two nearest)
+    #
+    # @param eps [Numeric] (default: Calc.config(:epsilon))
+    # @return [Calc::Q]
+    # @raise [Calc::MathError] if eps is not positive
+    # @example
+    #  Calc::Real(2).sqrt.to_q("1e-10") #=> Calc::Q(1.4142135624)
+    def to_q(eps = nil)
+      eps = Calc::Q(eps || Calc.config(:epsilon))
+      raise Calc::MathError, "epsilon for to_q must be positive" unless eps > 0
+      approximate(2 - eps.ilog2.to_i).appr(eps, NEAREST)
+    end
+
+    def to_f
+      approximate(60).to_f
+    end
+
+    # Returns a decimal string with the given number of digits after the
+    # point
+    #
+    # The last digit may be one out when the value is very close to half way
+    # between two decimals.
+    #
+    # @param digits [Integer]
+    # @return [String]
+    def to_s(digits = 20)
+      n = (to_q(Calc::Q(1, 10**digits)) * 10**digits).to_i
+      s = n.abs.to_s.rjust(digits + 1, "0")
+      s.insert(-digits - 1, ".") if digits > 0
+      n < 0 ? "-" + s : s
+    end
+
+    def inspect
+      "Calc::Real(#{ to_s })"
+    end
+
+    private
+
+    # 2^-bits as a Calc::Q
+    def epsilon(bits)
+      Calc::Q(1, 1 << bits)
+    end
+
+    # smallest k with |self| < 2^k (not always the smallest, but close)
+    def upper_log2
+      @upper_log2 ||= (approximate(0).abs + 1).ilog2.to_i + 1
+    end
+
+    # largest k with |self| >= 2^k (or close to it), or nil if self is
+    # within 2^-limit of zero
+    def lower_log2(limit = MAX_BITS)
+      return @lower_log2 if @lower_log2
+      bits = 8
+      loop do
+        x = approximate(bits).abs - epsilon(bits)
+        return @lower_log2 = x.ilog2.to_i if x > 0
+        return nil if bits >= limit
+        bits = [bits * 2, limit].min
+      end
+    end
+
+    def nonzero_lower_log2
+      lower_log2 || raise(Calc::MathError, "value is too close to zero")
+    end
+
+    # a value within 2^-bits.  each case chooses the accuracy needed from its
+    # arguments so that their errors plus its own add up to less than that.
+    def compute(bits)
+      a, b = @args
+      case @op
+      when :pi
+        Calc.pi(epsilon(bits + 1))
+      when :e
+        Calc::Q::ONE.exp(epsilon(bits + 1))
+      when :neg
+        -a.approximate(bits)
+      when :add
+        (a.approximate(bits + 2) + b.approximate(bits + 2)).bround(bits + 2)
+      when :mul
+        x = a.approximate(bits + b.__send__(:upper_log2) + 3)
+        y = b.approximate(bits + a.__send__(:upper_log2) + 3)
+        (x * y).bround(bits + 2)
+      when :pow
+        # |x'^n - x^n| <= n * max(|x|, |x'|)^(n-1) * |x' - x|
+        extra = (a.__send__(:upper_log2) + 1) * (b - 1) + b.bit_length
+        a.approximate(bits + 2 + extra).power(b).bround(bits + 2)
+      when :inv
+        lb = a.__send__(:nonzero_lower_log2)
+        x = a.approximate([bits + 2 - 2 * lb, 1 - lb].max)
+        x.inverse.bround(bits + 2)
+      when :exp
+        # x and x' are less than u, and exp(u) < 2^(1.45u) if u > 0
+        u = a.approximate(0) + 2
+        extra = u > 0 ? (u * Calc::Q(145, 100)).ceil.to_i : 0
+        a.approximate(bits + 2 + extra).exp(epsilon(bits + 2))
+      when :ln
+        lb = a.__send__(:nonzero_lower_log2)
+        x = a.approximate(bits + 3 - lb)
+        raise Calc::MathError, "logarithm of non-positive number" if x <= 0
+        x.ln(epsilon(bits + 2))
+      when :sqrt
+        # |sqrt(x') - sqrt(x)| <= |x' - x| / sqrt(x).  if x might be zero,
+        # sqrt is only Holder continuous and x is needed to twice the bits.
+        lb = a.__send__(:lower_log2, 2 * bits + 4)
+        x = a.approximate(lb ? [bits + 2 - lb / 2, 1 - lb].max : 2 * bits + 4)
+        if x < 0
+          raise Calc::MathError, "square root of negative number" if lb
+          x = Calc::Q::ZERO
+        end
+        x.sqrt(epsilon(bits + 2))
+      when :sin, :cos, :atan
+        a.approximate(bits + 2).__send__(@op, epsilon(bits + 2))
+      end
+    end
+  end
+
+  def self.Real(x) # rubocop:disable Style/MethodName
+    Real.convert(x)
+  end
+end
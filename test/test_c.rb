@@ -277,6 +277,20 @@ class TestC < MiniTest::Test
     assert_complex_parts [0.96538587902213312428, -0.00988437503832249372], Calc::C(2, 3).tanh
   end
 
+  def test_trig_ratio_rounding
+    # results are rounded once, so they are exact multiples of epsilon
+    c = Calc::C(2, 3)
+    assert_equal Calc::C("-0.00373971037633695666", "-0.99675779656935831046"), c.cot
+    assert_equal Calc::C("-0.27254866146294019951", "-0.04030057885689152188"), c.csch
+    assert_equal Calc::C("-0.0038", "1.0032"), c.tan("1e-4")
+    assert_equal c.tan("1e-30").inverse.round(25), c.cot("1e-25")
+    # sin and cos are huge here, but their ratio isn't
+    assert_equal Calc::C(0, 1), Calc::C(1, 200).tan
+    assert_equal Calc::C(1), Calc::C(200, 1).tanh
+    assert_raises(Calc::MathError) { Calc::C(0, 0).csc }
+    assert_raises(Calc::MathError) { Calc::C(0, 0).coth }
+  end
+
   def test_agd
     assert_complex_parts [0.22751065843194319695, 1.422911462459226797], Calc::C(1, 2).agd
     assert_equal 0, Calc::C(0, 0).agd
@@ -380,6 +394,8 @@ class TestC < MiniTest::Test
 
   def test_comb
     assert_complex_parts [Calc::Q("49/2"), Calc::Q("-329/6")], Calc::C(0, 7).comb(3)
+    expected = (0...40).map { |i| Complex(1 - i, 2) }.inject(:*) / (1..40).inject(:*)
+    assert_complex_parts [expected.real, expected.imag], Calc::C(1, 2).comb(40)
   end
 
   def test_conj
@@ -1,4 +1,5 @@
 require "minitest_helper"
+require "tmpdir"
 
 class TestCalc < Minitest::Test
   DEBUG = ENV.fetch("DEBUG_DELEGATIONS", false)
@@ -16,6 +17,148 @@ class TestCalc < Minitest::Test
     assert_equal Rational(314159, 100000), pi
   end
 
+  def test_constant_cache
+    pi100 = Calc::Q("3.14159265358979323846264338327950288419716939937510" \
+                    "5820974944592307816406286208998628034825342117068")
+    Calc.pi("1e-100")
+    before = Calc.constant_cache_stats[:pi]
+    assert_operator before[:bits], :>=, 333
+    assert_equal pi100, Calc.pi("1e-99")
+    assert_equal Rational(314159, 100000), Calc.pi("1e-5")
+    after = Calc.constant_cache_stats[:pi]
+    assert_equal before[:hits] + 2, after[:hits]
+    assert_equal before[:misses], after[:misses]
+
+    e = Calc::Q(1).exp("1e-30")
+    assert_equal Calc::Q("2.718281828459045235360287471353"), e
+    assert_equal e, Calc::Q(1).exp("1e-30")
+    assert_operator Calc.constant_cache_stats[:e][:hits], :>=, 1
+    assert_equal Calc::Q("0.693147180559945309417232121458"), Calc::Q(2).ln("1e-30")
+    assert_equal Calc::Q("2.302585092994045684017991454684"), Calc::Q(10).ln("1e-30")
+
+    # exp and ln round cached values in the appr mode, like libcalc
+    with_config(:appr, 0) do
+      assert_equal Calc::Q("2.7182"), Calc::Q(1).exp("1e-4")
+      assert_equal Calc::Q("2.3025"), Calc::Q(10).ln("1e-4")
+    end
+    with_config(:appr, 1) do
+      assert_equal Calc::Q("0.6932"), Calc::Q(2).ln("1e-4")
+    end
+
+    stats = Calc.constant_cache_stats
+    assert_equal %i[pi e ln2 ln10].map { |c| stats[c][:bytes] }.inject(:+), stats[:bytes]
+    assert_equal Calc.config(:constant_cache), stats[:limit]
+  end
+
+  def test_constant_cache_limit
+    orig = Calc.config(:constant_cache, 0)
+    assert_equal 0, Calc.constant_cache_stats[:bytes]
+    misses = Calc.constant_cache_stats[:pi][:misses]
+    Calc.pi("1e-50")
+    Calc.pi("1e-50")
+    assert_equal misses + 2, Calc.constant_cache_stats[:pi][:misses]
+    assert_equal 0, Calc.constant_cache_stats[:bytes]
+  ensure
+    Calc.config(:constant_cache, orig)
+  end
+
+  def test_memo
+    Calc.clear_memo
+    calls = -> { [Calc::Q(2).sin, Calc::Q(-2).ln, Calc::Q(2).sqrt, Calc::C(1, 2).exp] }
+    expected = calls.call
+    assert_equal({ entries: 0, hits: 0, misses: 0, limit: 0 }, Calc.memo_stats)
+    with_config(:memo, 100) do
+      assert_equal expected, calls.call
+      assert_equal expected, calls.call
+      assert_equal({ entries: 4, hits: 4, misses: 4, limit: 100 }, Calc.memo_stats)
+
+      # epsilon is part of the key; equal values match however given
+      assert_equal Calc::Q(2).sin(Calc::Q("1e-30")), Calc::Q(2).sin("1e-30")
+      assert_equal 5, Calc.memo_stats[:misses]
+      assert_equal 5, Calc.memo_stats[:hits]
+      assert_equal expected[0], Calc::Q(2).sin(Calc.config(:epsilon) * 1)
+      assert_equal 6, Calc.memo_stats[:hits]
+
+      # real functions with complex results use the complex memo
+      assert_equal Calc::Q(2).acos, Calc::Q(2).acos
+      assert_instance_of Calc::C, Calc::Q(2).acos
+
+      # libcalc rounds exp and ln in the appr mode, so that is part of the key
+      assert_equal Calc::Q("2.7183"), Calc::Q(1).exp("1e-4")
+      assert_equal Calc::Q("0.6931"), Calc::Q(2).ln("1e-4")
+      with_config(:appr, 0) do
+        assert_equal Calc::Q("2.7182"), Calc::Q(1).exp("1e-4")
+      end
+      with_config(:appr, 1) do
+        assert_equal Calc::Q("0.6932"), Calc::Q(2).ln("1e-4")
+      end
+      assert_equal Calc::Q("2.7183"), Calc::Q(1).exp("1e-4")
+      assert_equal Calc::Q("0.6931"), Calc::Q(2).ln("1e-4")
+
+      assert_nil Calc.clear_memo
+      assert_equal({ entries: 0, hits: 0, misses: 0, limit: 100 }, Calc.memo_stats)
+    end
+    assert_equal 0, Calc.memo_stats[:entries]
+  end
+
+  def test_memo_limit
+    Calc.clear_memo
+    expected = (0..4).map { |i| Calc::Q(i).exp }
+    with_config(:memo, 3) do
+      (1..3).each { |i| Calc::Q(i).exp }
+      Calc::Q(1).exp
+      Calc::Q(4).exp # drops exp(2), the least recently used
+      assert_equal 3, Calc.memo_stats[:entries]
+      hits = Calc.memo_stats[:hits]
+      [1, 3, 4].each { |i| assert_equal expected[i], Calc::Q(i).exp }
+      assert_equal hits + 3, Calc.memo_stats[:hits]
+      misses = Calc.memo_stats[:misses]
+      Calc::Q(2).exp
+      assert_equal misses + 1, Calc.memo_stats[:misses]
+      Calc.config(:memo, 1)
+      assert_equal 1, Calc.memo_stats[:entries]
+    end
+    assert_raises(Calc::MathError) { Calc.config(:memo, -1) }
+    assert_raises(Calc::MathError) { Calc.config(:memo, 1.5) }
+  end
+
+  def test_batch_gcd
+    assert_equal [11, 7, 91, 143], Calc.batch_gcd([33, 35, 91, 143])
+    assert_instance_of Calc::Q, Calc.batch_gcd([6, 10]).first
+    assert_equal [], Calc.batch_gcd([])
+    assert_equal [1], Calc.batch_gcd([15])
+    assert_equal [3, 1, 3], Calc.batch_gcd([-6, 5, Calc::Q(9)])
+    primes = (1..30).map { |i| (Calc::Q(2)**100 * i).nextprime }
+    moduli = (0...25).map { |i| primes[i] * primes[(i * 7 + 3) % 30] }
+    expected = moduli.each_index.map do |i|
+      moduli[i].gcd(moduli.each_with_index.reject { |_, j| j == i }.map(&:first).inject(:*))
+    end
+    assert_equal expected, Calc.batch_gcd(moduli)
+    with_config(:ntt, 0) do
+      with_config(:threads, 3) do
+        assert_equal expected, Calc.batch_gcd(moduli)
+      end
+    end
+    Dir.mktmpdir do |dir|
+      assert_equal expected, Calc.batch_gcd(moduli, tmpdir: dir)
+      assert_empty Dir.glob(File.join(dir, "*"))
+    end
+    assert_raises(Calc::MathError) { Calc.batch_gcd([6, 0]) }
+    assert_raises(Calc::MathError) { Calc.batch_gcd([6, Calc::Q(1, 2)]) }
+  end
+
+  def test_binary_splitting
+    # at this precision the constants are calculated by binary splitting;
+    # compare them to values libcalc calculates in other ways
+    eps = Calc::Q("1e-1000")
+    close = ->(a, b) { assert_operator (a - b).abs, :<=, eps }
+    close.call Calc::Q(1).atan("1e-1010") * 4, Calc.pi(eps)
+    close.call Calc::Q("1/2").exp("1e-1010")**2, Calc::Q(1).exp(eps)
+    close.call Calc::Q(4).ln("1e-1010") / 2, Calc::Q(2).ln(eps)
+    close.call Calc::Q(100).ln("1e-1010") / 2, Calc::Q(10).ln(eps)
+    assert_operator Calc.constant_cache_stats[:pi][:bits], :>=, 3322
+  end
+
   def test_polar
     assert_rational_and_equal 2, Calc.polar(2, 0)
     assert_complex_parts [-0.41615, 0.9093], Calc.polar(1, 2, "1e-5")
@@ -45,6 +188,53 @@ class TestCalc < Minitest::Test
     assert_nil Calc.freeeuler
   end
 
+  def test_crt
+    assert_rational_and_equal 23, Calc.crt([2, 3, 2], [3, 5, 7])
+    assert_rational_and_equal 0, Calc.crt([], [])
+    assert_rational_and_equal 2, Calc.crt([5], [3])
+    assert_rational_and_equal 35, Calc.crt([-1, Calc::Q(-1)], [-4, 9])
+    moduli = (1..40).map { |i| (Calc::Q(2)**64 * i).nextprime }
+    residues = moduli.map { |m| (m * 7 / 11).floor }
+    x = Calc.crt(residues, moduli)
+    assert x >= 0 && x < moduli.inject(:*)
+    residues.zip(moduli).each { |r, m| assert_equal r, x % m }
+    with_config(:ntt, 0) do
+      assert_equal x, Calc.crt(residues, moduli)
+    end
+    assert_raises(Calc::MathError) { Calc.crt([1, 2], [6, 4]) }
+    assert_raises(Calc::MathError) { Calc.crt([1, 2], [3, 0]) }
+    assert_raises(Calc::MathError) { Calc.crt([Calc::Q(1, 2), 1], [3, 5]) }
+    assert_raises(ArgumentError) { Calc.crt([1], [2, 3]) }
+  end
+
+  def test_each_prime
+    assert_equal [11, 13, 17, 19, 23, 29], Calc.each_prime(10, 30).to_a
+    assert_instance_of Calc::Q, Calc.each_prime(1, 10).first
+    assert_equal [2, 3, 5, 7, 11, 13, 17, 19], Calc.each_prime(-5, 20).to_a
+    assert_equal [], Calc.each_prime(30, 10).to_a
+    assert_equal [17], Calc.each_prime(17, 17).to_a
+    assert_equal 78498, Calc.each_prime(0, 10**6).count
+    assert_equal 36, Calc.each_prime(2**40, 2**40 + 1000).count
+    assert_equal [[2, 3, 5, 7], [11, 13, 17, 19], [23, 29]], Calc.each_prime(1, 30, 4).to_a
+    with_config(:threads, 3) do
+      assert_equal 78498, Calc.each_prime(0, 10**6).count
+      assert_equal Calc::Q(10**6).nextprime, Calc.each_prime(10**6, 2 * 10**6).first
+    end
+    assert_raises(Calc::MathError) { Calc.each_prime(0, 2**56) {} }
+    assert_raises(Calc::MathError) { Calc.each_prime(0.5, 10) {} }
+    assert_raises(Calc::MathError) { Calc.each_prime(0, 10, 0) {} }
+  end
+
+  def test_fib_each
+    assert_equal [0, 1, 1, 2, 3, 5, 8], Calc.fib_each(10).to_a
+    assert_instance_of Calc::Q, Calc.fib_each(10).first
+    assert_equal [0, 1, 1, 2, 3, 5, 8], Calc.fib_each(Calc::Q("8.5")).to_a
+    assert_equal [], Calc.fib_each(0).to_a
+    assert_equal (0..300).map { |n| Calc::Q(n).fib }, Calc.fib_each.first(301)
+    assert_equal [2, 3, 5, 13], Calc.fib_each.lazy.select(&:prime?).first(4)
+    assert_output("[0, 1, 1, 2, 3, 5, 8]\n") { Calc.fiblist(10) }
+  end
+
   def test_hmean
     assert_nil Calc.hmean
     assert_rational_and_equal 1, Calc.hmean(1)
@@ -108,6 +298,46 @@ class TestCalc < Minitest::Test
     assert_rational_and_equal 204, Calc.ssq(1, 2, [3, 4, [5, 6]], [], 7, 8)
   end
 
+  def test_ptest_many
+    assert_equal [0, 2], Calc.ptest_many([2**61 - 1, 2**61 + 1, 2**89 - 1], count: 10)
+    assert_equal [], Calc.ptest_many([])
+    candidates = [-7, 0, 1, 2, 15, Calc::Q(1, 2), 4294967311, 2**64 + 1, 2**64 + 13, -(2**127 - 1)]
+    expected = candidates.each_index.select { |i| Calc::Q(candidates[i]).ptest?(20) }
+    assert_equal expected, Calc.ptest_many(candidates, count: 20)
+    assert_equal [0, 3, 6, 8, 9], Calc.ptest_many(candidates, count: 10, skip: 0)
+    # strong pseudoprime to the first 11 prime bases
+    spsp = 3825123056546413051
+    assert_equal [0], Calc.ptest_many([spsp], count: 11)
+    assert_equal [], Calc.ptest_many([spsp], count: 12)
+    assert_equal [0], Calc.ptest_many([spsp], count: 1, skip: 31)
+    assert_equal [], Calc.ptest_many([spsp], count: 1, skip: 37)
+    big = (1..60).map { |i| Calc::Q(2)**64 + i }
+    with_config(:threads, 3) do
+      assert_equal big.each_index.select { |i| big[i].prime? }, Calc.ptest_many(big, count: 5)
+    end
+    assert_raises(Calc::MathError) { Calc.ptest_many([3], count: 0.5) }
+  end
+
+  def test_rational_reconstruct
+    p = 1000003
+    assert_rational_and_equal Calc::Q(2, 3), Calc.rational_reconstruct(333335, p)
+    assert_equal [Calc::Q(2, 3), Calc::Q(1, 2)], Calc.rational_reconstruct([333335, 500002], p)
+    assert_rational_and_equal 5, Calc.rational_reconstruct(5, p)
+    assert_rational_and_equal(-1, Calc.rational_reconstruct(p - 1, p))
+    assert_rational_and_equal 0, Calc.rational_reconstruct(0, 7)
+    m = Calc::Q(2)**20_000 + 1
+    [Calc::Q(-(3**6000), 7**3000 + 2), Calc::Q(5**4000, 3**5000), Calc::Q(1, 3**6000)].each do |q|
+      a = (q.num * q.den.minv(m)).mod(m)
+      assert_rational_and_equal q, Calc.rational_reconstruct(a, m)
+      with_config(:ntt, 0) do
+        assert_rational_and_equal q, Calc.rational_reconstruct(a, m)
+      end
+    end
+    assert_raises(Calc::MathError) { Calc.rational_reconstruct(12355, p) }
+    assert_raises(Calc::MathError) { Calc.rational_reconstruct(3, 1) }
+    assert_raises(Calc::MathError) { Calc.rational_reconstruct(Calc::Q(1, 2), p) }
+  end
+
   def test_sum
     assert_nil Calc.sum
     assert_rational_and_equal 2, Calc.sum(2)
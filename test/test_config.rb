@@ -47,6 +47,41 @@ class TestConfig < Minitest::Test
     assert_raises(Calc::MathError) { Calc.config(:display, -1) }
   end
 
+  def test_double_epsilon
+    r = Random.new(49)
+    args = Array.new(100) { Calc::Q(r.rand(-100_000..100_000), r.rand(1..1000)) }
+    epsilons = %w[1e-12 3e-10 1e-8 0.001].map { |e| Calc::Q(e) }
+    results = lambda do
+      args.product(epsilons).map do |x, eps|
+        [x.sin(eps), x.cos(eps), (x / 100).exp(eps), (x.abs + 1).ln(eps)]
+      end
+    end
+    expected = results.call
+    with_config(:double_epsilon, Calc::Q("1e-12"), 0) do
+      assert_equal expected, results.call
+    end
+    assert_raises(Calc::MathError) { Calc.config(:double_epsilon, -1) }
+  end
+
+  def test_double_epsilon_margin
+    # results about epsilon/5 either side of a multiple of epsilon, where a
+    # double result is most likely to round differently to libcalc
+    r = Random.new(4949)
+    near = ->(max) { (r.rand(2..max) + r.rand(0.15..0.25) * (r.rand(2) * 2 - 1)) * 1e-9 }
+    args = {
+      sin: Array.new(50) { Math.asin(near.call(900_000_000)) },
+      cos: Array.new(50) { Math.acos(near.call(900_000_000)) },
+      exp: Array.new(50) { Math.log(near.call(20_000_000_000)) },
+      ln: Array.new(50) { Math.exp(near.call(20_000_000_000)) }
+    }
+    eps = Calc::Q("1e-9")
+    results = -> { args.map { |f, xs| xs.map { |x| Calc::Q(x).__send__(f, eps) } } }
+    expected = results.call
+    with_config(:double_epsilon, Calc::Q("1e-12"), 0) do
+      assert_equal expected, results.call
+    end
+  end
+
   def test_epsilon
     assert_equal Calc::Q("3.14159265358979323846"), Calc.pi
     with_config(:epsilon, Calc::Q("1e-20"), Calc::Q("1e-3")) do
@@ -100,6 +135,19 @@ class TestConfig < Minitest::Test
     assert_raises(Calc::MathError) { Calc.config(:quomod, -1) }
   end
 
+  def test_ntt
+    x = Calc::Q(3)**200_000
+    y = Calc::Q(7)**150_000 + 1
+    expected = x * y
+    with_config(:ntt, 8192, 0) do
+      assert_rational_and_equal expected, x * y
+      assert_rational_and_equal expected * expected, (x * y)**2
+      assert_rational_and_equal(-expected, -x * y)
+      assert_rational_and_equal Calc::Q(2, 3)**50_000, Calc::Q(2)**50_000 / Calc::Q(3)**50_000
+    end
+    assert_raises(Calc::MathError) { Calc.config(:ntt, -1) }
+  end
+
   def test_round
     assert_rational_and_equal Calc::Q("3.14159"), Calc.pi.round(5)
     with_config(:round, 24, 1) do
@@ -117,4 +165,12 @@ class TestConfig < Minitest::Test
     assert_raises(Calc::MathError) { Calc.config(:sqrt, 0.5) }
     assert_raises(Calc::MathError) { Calc.config(:sqrt, -1) }
   end
+
+  def test_threads
+    with_config(:threads, 1, 3) do
+      assert_rational_and_equal 455052511, Calc::Q(10**10).pix
+    end
+    assert_raises(Calc::MathError) { Calc.config(:threads, 0) }
+    assert_raises(Calc::MathError) { Calc.config(:threads, 1.5) }
+  end
 end
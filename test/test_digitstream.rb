@@ -0,0 +1,75 @@
+require "minitest_helper"
+
+class TestDigitStream < Minitest::Test
+  PI = "14159265358979323846264338327950288419716939937510" \
+       "58209749445923078164062862089986280348253421170679".freeze
+  E = "71828182845904523536028747135266249775724709369995" \
+      "95749669676277240766303535475945713821785251664274".freeze
+
+  def test_class_exists
+    refute_nil Calc::DigitStream
+  end
+
+  def test_pi
+    s = Calc.digits_of(:pi, chunk: 10)
+    assert_instance_of Calc::DigitStream, s
+    assert_equal "3", s.next
+    assert_equal PI[0, 10], s.next
+    assert_equal PI[10, 10], s.next
+    assert_equal 20, s.position
+    [1, 7, 100].each do |chunk|
+      digits = Calc.digits_of(:pi, chunk: chunk).first(100 / chunk + 1)
+      assert_equal "3", digits.shift
+      assert_equal PI[0, 100 / chunk * chunk], digits.join
+    end
+    assert_equal %w(3 243f6a88 85a308d3), Calc.digits_of(:pi, base: 16, chunk: 8).first(3)
+  end
+
+  def test_e
+    assert_equal %w(2 71828 18284), Calc.digits_of(:e, chunk: 5).first(3)
+    assert_equal E, Calc.digits_of(:e, chunk: 50).first(3).drop(1).join
+    assert_equal %w(2 b7e15162 8aed2a6a), Calc.digits_of(:e, base: 16, chunk: 8).first(3)
+  end
+
+  def test_sqrt
+    assert_equal %w(1 41421356 23730950), Calc.digits_of(:sqrt, 2, chunk: 8).first(3)
+    assert_equal %w(1 01101010), Calc.digits_of(:sqrt, 2, base: 2, chunk: 8).first(2)
+    assert_equal %w(0 57735 02691), Calc.digits_of(:sqrt, Calc::Q(1, 3), chunk: 5).first(3)
+    assert_equal %w(12 00000), Calc.digits_of(:sqrt, 144, chunk: 5).first(2)
+    assert_equal %w(0 000 000), Calc.digits_of(:sqrt, 0, chunk: 3).first(3)
+    x = Calc::Q(10**40 + 7, 3**21)
+    digits = Calc.digits_of(:sqrt, x, chunk: 30).first(5).join
+    assert_equal (x * 10**240).floor.isqrt.to_i.to_s, digits
+  end
+
+  def test_resume
+    s = Calc.digits_of(:e, chunk: 5)
+    assert_equal %w(2 71828), s.first(2)
+    assert_equal %w(18284 59045), s.first(2)
+    assert_equal 15, s.position
+    assert_equal 10, s.base
+    assert_equal 5, s.chunk
+  end
+
+  def test_dup
+    s = Calc.digits_of(:pi, chunk: 20)
+    3.times { s.next }
+    t = s.dup
+    assert_equal s.first(3), t.first(3)
+    assert_equal 100, t.position
+    u = Calc.digits_of(:sqrt, 3, chunk: 20)
+    u.next
+    v = u.dup
+    assert_equal u.next, v.next
+  end
+
+  def test_errors
+    assert_raises(ArgumentError) { Calc.digits_of(:tau) }
+    assert_raises(ArgumentError) { Calc.digits_of(:sqrt) }
+    assert_raises(ArgumentError) { Calc.digits_of(:pi, 2) }
+    assert_raises(ArgumentError) { Calc.digits_of(:pi, base: 1) }
+    assert_raises(ArgumentError) { Calc.digits_of(:pi, base: 37) }
+    assert_raises(ArgumentError) { Calc.digits_of(:pi, chunk: 0) }
+    assert_raises(Calc::MathError) { Calc.digits_of(:sqrt, -2) }
+  end
+end
@@ -0,0 +1,127 @@
+require "minitest_helper"
+
+class TestExpression < Minitest::Test
+  def test_class_exists
+    refute_nil Calc::Expression
+  end
+
+  def test_call
+    f = Calc.compile("a*x^2 + b*sqrt(y) - c/x", vars: %i[a b c x y])
+    assert_instance_of Calc::Expression, f
+    assert_equal %i[a b c x y], f.vars
+    assert_rational_and_equal Calc::Q(85, 4), f.call(a: 1, b: 2, c: 3, x: 4, y: 9)
+    assert_rational_and_equal Calc::Q(85, 4), f.call(1, 2, 3, 4, 9)
+    strings = { "a" => 1, "b" => 2, "c" => 3, "x" => 4, "y" => 9 }
+    assert_rational_and_equal Calc::Q(85, 4), f.call(strings)
+    assert_rational_and_equal Calc::Q(85, 4), f[1, 2, 3, 4, Rational(9)]
+    assert_rational_and_equal Calc::Q(-1, 4), f.call(0, 0, Calc::Q(1, 2), 2, "0.25")
+    assert_equal "a*x^2 + b*sqrt(y) - c/x", f.to_s
+    assert_equal "Calc::Expression(a*x^2 + b*sqrt(y) - c/x)", f.inspect
+    g = f.dup
+    assert_equal f.vars, g.vars
+    assert_equal f.call(1, 2, 3, 4, 9), g.call(1, 2, 3, 4, 9)
+    assert_equal Calc::Expression.new("x + 1").vars, Calc.compile("x + 1").vars
+  end
+
+  def test_vars
+    assert_equal %i[y x], Calc.compile("y * sin(x) + y").vars
+    assert_equal [], Calc.compile("2 * pi").vars
+    assert_equal %i[pi], Calc.compile("2 * pi", vars: [:pi]).vars
+    assert_rational_and_equal Calc::Q(6), Calc.compile("2 * pi", vars: [:pi]).call(3)
+    assert_equal %i[x unused], Calc.compile("x", vars: ["x", :unused]).vars
+  end
+
+  def test_precedence
+    {
+      "-2^2" => -4, "2^-1" => Rational(1, 2), "2^3^2" => 512, "2**3" => 8, "1 - 2 - 3" => -4,
+      "12/3/2" => 2, "2*3+4*5" => 26, "(2+3)*4" => 20, "--3" => 3, "+3" => 3, "1.5e1" => 15,
+      ".5" => Rational(1, 2), "2*-3" => -6, " 1 +2* 3 " => 7, "2^10/2^8" => 4, "(1/3)^-2" => 9
+    }.each do |source, expected|
+      assert_rational_and_equal Calc::Q(expected), Calc.compile(source).call
+    end
+  end
+
+  def test_constants_folded_with_variables
+    f = Calc.compile("(1 + 2) * x^2 - -3 + x*(4/2) - 2^x")
+    [-3, 0, 1, 7].each do |x|
+      x = Calc::Q(x)
+      assert_equal x**2 * 3 + 3 + x * 2 - Calc::Q(2)**x, f.call(x)
+    end
+  end
+
+  def test_matches_q
+    eps = Calc::Q("1e-30")
+    f = Calc.compile("exp(x)/3 + ln(y) * sin(x) - cos(y)^2 + atan(x/y) + sqrt(y)", eps: eps)
+    [[1, 2], [Calc::Q(-7, 3), Calc::Q("0.25")], ["1.5", 10]].each do |x, y|
+      x = Calc::Q(x)
+      y = Calc::Q(y)
+      expected = x.exp(eps) / 3 + y.ln(eps) * x.sin(eps) - y.cos(eps)**2 + (x / y).atan(eps) +
+                 y.sqrt(eps)
+      assert_equal expected, f.call(x: x, y: y)
+    end
+    g = Calc.compile("log(x) + tan(x) - sinh(x) * cosh(x) + tanh(x) + abs(x)", eps: eps)
+    x = Calc::Q(3, 2)
+    expected = x.log(eps) + x.tan(eps) - x.sinh(eps) * x.cosh(eps) + x.tanh(eps) + x.abs
+    assert_equal expected, g.call(x)
+  end
+
+  def test_epsilon
+    f = Calc.compile("sqrt(x)")
+    with_config(:epsilon, Calc::Q("1e-5")) do
+      assert_equal Calc::Q(2).sqrt(Calc::Q("1e-5")), f.call(2)
+    end
+    assert_equal Calc::Q(2).sqrt(Calc::Q("1e-40")), Calc.compile("sqrt(x)", eps: "1e-40").call(2)
+    assert_equal Calc.pi(Calc::Q("1e-30")), Calc.compile("pi", eps: "1e-30").call
+    assert_raises(Calc::MathError) { Calc.compile("x", eps: 0) }
+  end
+
+  def test_complex
+    f = Calc.compile("x^2 + 1")
+    assert_rational_and_equal Calc::Q(0), f.call(x: Complex(0, 1))
+    assert_rational_and_equal Calc::Q(0), f.call(x: Calc::C(0, 1))
+    assert_equal Calc::C(-2, 4), f.call(Calc::C(1, 2))
+    g = Calc.compile("sqrt(x)")
+    assert_instance_of Calc::C, g.call(-4)
+    assert_equal Calc::C(0, 2), g.call(-4)
+    assert_equal Calc::C(1, 2), Calc.compile("1 + 2i").call
+    assert_rational_and_equal Calc::Q(-1), Calc.compile("(2i)^2 / 4").call
+    assert_rational_and_equal Calc::Q(5), Calc.compile("abs(3 + 4i)").call
+    assert_rational_and_equal Calc::Q(-1), Calc.compile("sqrt(x) * sqrt(x)").call(-1)
+    assert_equal Calc::Q(-1).ln, Calc.compile("ln(x)").call(-1)
+  end
+
+  def test_call_many
+    f = Calc.compile("1/x + y")
+    assert_equal [Calc::Q(3, 2), Calc::Q(1, 4)], f.call_many([{ x: 2, y: 1 }, [4, 0]])
+    assert_equal [Calc::Q(1), Calc::Q(4), Calc::Q(9)], Calc.compile("x*x").call_many(1..3)
+    assert_equal [], f.call_many([])
+    assert_raises(ArgumentError) { f.call_many([[1, 2, 3]]) }
+    r = Random.new(47)
+    g = Calc.compile("(x - y)^3 / (x^2 + 1) + y")
+    bindings = Array.new(200) { [Calc::Q(r.rand(-100..100), r.rand(1..20)), r.rand(-50..50)] }
+    expected = bindings.map { |x, y| (x - y)**3 / (x**2 + 1) + y }
+    assert_equal expected, g.call_many(bindings)
+  end
+
+  def test_errors
+    ["2 +", "(1", "1)", "foo(1)", "2x", "1 2", "sqrt 2", "", "1 + $", "(" * 2000 + "1" + ")" * 2000,
+     (["x"] * 2000).join("^"), "-" * 2000 + "1"]
+      .each do |source|
+      assert_raises(ArgumentError) { Calc.compile(source) }
+    end
+    e = assert_raises(ArgumentError) { Calc.compile("1 + * 2") }
+    assert_match(/position 4/, e.message)
+    assert_raises(ArgumentError) { Calc.compile("x + y", vars: [:x]) }
+    assert_raises(ArgumentError) { Calc.compile("x", vars: %i[x x]) }
+    assert_raises(ArgumentError) { Calc.compile("x", bogus: 1) }
+    f = Calc.compile("x / y")
+    assert_raises(ArgumentError) { f.call(x: 1) }
+    assert_raises(ArgumentError) { f.call(x: 1, y: 2, z: 3) }
+    assert_raises(ArgumentError) { f.call(1) }
+    assert_raises(ArgumentError) { f.call(1, nil) }
+    assert_raises(Calc::MathError) { f.call(1, 0) }
+    assert_raises(Calc::MathError) { Calc.compile("1/0") }
+    # still usable after an error part way through
+    assert_rational_and_equal Calc::Q(1, 2), f.call(1, 2)
+  end
+end
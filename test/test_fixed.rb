@@ -0,0 +1,109 @@
+require "minitest_helper"
+
+class TestFixed < Minitest::Test
+  def test_class_exists
+    refute_nil Calc::Fixed
+  end
+
+  def test_initialization
+    x = Calc::Fixed("1.50")
+    assert_instance_of Calc::Fixed, x
+    assert_equal 2, x.scale
+    assert_equal "1.50", x.to_s
+    assert_equal "Calc::Fixed(1.50)", x.inspect
+    assert_equal "-0.05", Calc::Fixed(" -0.05 ").to_s
+    assert_equal "12", Calc::Fixed(12).to_s
+    assert_equal "12.00", Calc::Fixed(12, 2).to_s
+    assert_equal "0.125", Calc::Fixed(Calc::Q(1, 8)).to_s
+    assert_equal "0.5", Calc::Fixed(0.5).to_s
+    assert_equal "0.6667", Calc::Fixed("2/3", 4).to_s
+    assert_equal "0.001", Calc::Fixed("1e-3").to_s
+    assert_equal "3", Calc::Fixed("3.", nil).to_s
+    assert_equal "2", Calc::Fixed("1.5", 0).to_s
+    assert_equal "2.46", Calc::Fixed(Calc::Fixed("2.455"), 2).to_s
+    assert_equal "123456789012345678901234567890.1234567890123456789",
+                 Calc::Fixed("123456789012345678901234567890.1234567890123456789").to_s
+    assert_raises(Calc::MathError) { Calc::Fixed(Calc::Q(1, 3)) }
+    assert_raises(ArgumentError) { Calc::Fixed(1, -1) }
+    assert_raises(ArgumentError) { Calc::Fixed(nil) }
+  end
+
+  def test_conversion
+    x = Calc::Fixed("-12.50")
+    assert_rational_and_equal Calc::Q(-25, 2), x.to_q
+    assert_equal(-12, x.to_i)
+    assert_equal(-12.5, x.to_f)
+    assert_rational_and_equal Calc::Q(7), Calc::Fixed(7).to_q
+    y = x.dup
+    assert_equal x, y
+    assert_equal "-12.50", y.to_s
+  end
+
+  def test_add_subtract
+    assert_equal "1.75", (Calc::Fixed("1.5") + Calc::Fixed("0.25")).to_s
+    assert_equal "-0.5", (Calc::Fixed("1.5") - 2).to_s
+    assert_equal "3.5", (2 + Calc::Fixed("1.5")).to_s
+    assert_equal "0.50", (2 - Calc::Fixed("1.50")).to_s
+    assert_equal "0.00", (Calc::Fixed("0.10") + Calc::Fixed("-0.10")).to_s
+    assert_equal "-1.5", (-Calc::Fixed("1.5")).to_s
+    assert_equal "1.5", Calc::Fixed("-1.5").abs.to_s
+    assert_rational_and_equal Calc::Q(11, 6), Calc::Fixed("1.5") + Calc::Q(1, 3)
+    assert_rational_and_equal Calc::Q(11, 6), Calc::Q(1, 3) + Calc::Fixed("1.5")
+  end
+
+  def test_multiply_divide
+    assert_equal "59.97", (Calc::Fixed("19.99") * 3).to_s
+    assert_equal "1.6492", (Calc::Fixed("19.99") * Calc::Fixed("0.0825")).to_s
+    assert_equal "1.88", (Calc::Fixed("1.25") * Calc::Fixed("1.5")).to_s
+    assert_equal "3.33", (Calc::Fixed("10.00") / 3).to_s
+    assert_equal "0.67", (Calc::Fixed("2.00") / 3).to_s
+    assert_equal "-0.67", (Calc::Fixed("-2.00") / 3).to_s
+    assert_equal "2.50", (Calc::Fixed("1.00") / Calc::Fixed("0.4")).to_s
+    assert_equal "0.25", (1 / Calc::Fixed("4.00")).to_s
+    assert_rational_and_equal Calc::Q(1, 2), Calc::Fixed("1.5") / Calc::Q(3)
+    assert_raises(ZeroDivisionError) { Calc::Fixed("1.5") / 0 }
+    assert_raises(ZeroDivisionError) { Calc::Fixed("1.5") / Calc::Fixed("0.00") }
+  end
+
+  def test_round
+    assert_equal "2.34", Calc::Fixed("2.345").round(2).to_s
+    assert_equal "2.36", Calc::Fixed("2.355").round(2).to_s
+    assert_equal "2.35", Calc::Fixed("2.345").round(2, 1).to_s
+    assert_equal "2.300", Calc::Fixed("2.3").round(3).to_s
+    assert_equal "2", Calc::Fixed("2.3").round.to_s
+    assert_raises(ArgumentError) { Calc::Fixed("2.3").round(-1) }
+    with_config(:round, 0) do
+      assert_equal "-0.34", (Calc::Fixed("-1.00") / 3).to_s
+      assert_equal "0.33", (Calc::Fixed("1.00") / 3).to_s
+      assert_equal "1.87", (Calc::Fixed("1.25") * Calc::Fixed("1.5")).to_s
+    end
+  end
+
+  def test_comparison
+    assert_equal Calc::Fixed("1.5"), Calc::Fixed("1.50")
+    assert_equal 0, Calc::Fixed("1.50") <=> Calc::Fixed("1.5")
+    assert_equal(-1, Calc::Fixed("1.5") <=> 2)
+    assert_equal 1, Calc::Fixed("1.5") <=> Calc::Q(4, 3)
+    assert_nil Calc::Fixed("1.5") <=> "cat"
+    assert Calc::Fixed("-0.01") < 0
+    assert Calc::Fixed("0.00").zero?
+    refute Calc::Fixed("0.01").zero?
+    values = %w[3.1 -2 0.05 1.000].map { |s| Calc::Fixed(s) }
+    assert_equal %w[-2 0.05 1.000 3.1], values.sort.map(&:to_s)
+  end
+
+  def test_matches_q
+    r = Random.new(42)
+    200.times do
+      a = Calc::Fixed(Calc::Q(r.rand(-10**30..10**30), 10**r.rand(0..25)), r.rand(0..25))
+      b = Calc::Fixed(Calc::Q(r.rand(-10**20..10**20), 10**r.rand(0..25)), r.rand(0..25))
+      s = [a.scale, b.scale].max
+      assert_equal a.to_q + b.to_q, (a + b).to_q
+      assert_equal a.to_q - b.to_q, (a - b).to_q
+      assert_equal((a.to_q * b.to_q).round(s), (a * b).to_q)
+      assert_equal((a.to_q / b.to_q).round(s), (a / b).to_q) unless b.zero?
+      assert_equal a.to_q <=> b.to_q, a <=> b
+      assert_equal a, Calc::Fixed(a.to_s)
+    end
+  end
+end
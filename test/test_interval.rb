@@ -0,0 +1,138 @@
+require "minitest_helper"
+
+class TestInterval < Minitest::Test
+  def test_class_exists
+    refute_nil Calc::Interval
+  end
+
+  def test_initialize
+    x = Calc::Interval(1, "5/2")
+    assert_instance_of Calc::Interval, x
+    assert_rational_and_equal Calc::Q(1), x.lo
+    assert_rational_and_equal Calc::Q(5, 2), x.hi
+    assert_rational_and_equal Calc::Q(3, 2), x.width
+    assert_rational_and_equal Calc::Q(7, 4), x.mid
+    assert_equal Calc::Interval.new(3, 3), Calc::Interval(3)
+    assert_raises(ArgumentError) { Calc::Interval(2, 1) }
+    assert_equal "Calc::Interval(1, 2.5)", x.inspect
+    assert_equal "Calc::Interval(3)", Calc::Interval(3).inspect
+    assert_equal "[1, 2.5]", x.to_s
+  end
+
+  def test_include
+    x = Calc::Interval(1, 2)
+    assert x.include?(1)
+    assert x.include?(Calc::Q(3, 2))
+    assert x.include?(Calc::Interval(1, 2))
+    refute x.include?(Calc::Q(1, 2))
+    refute x.include?(Calc::Interval(0, 2))
+  end
+
+  def test_arithmetic
+    x = Calc::Interval(1, 2)
+    y = Calc::Interval(-3, 1)
+    assert_equal Calc::Interval(-1, 3), x * x - x
+    assert_equal Calc::Interval(-2, 3), x + y
+    assert_equal Calc::Interval(0, 5), x - y
+    assert_equal Calc::Interval(-6, 2), x * y
+    assert_equal Calc::Interval(-1, 3), -y
+    assert_equal Calc::Interval(Calc::Q(1, 2), 1), x.inverse
+    assert_equal Calc::Interval(-6, 2), y / Calc::Interval(Calc::Q(1, 2), 1)
+    assert_equal Calc::Interval(2, 3), x + 1
+    assert_equal Calc::Interval(2, 3), 1 + x
+    assert_equal Calc::Interval(0, 3), y.abs
+    assert_raises(ZeroDivisionError) { x / y }
+    assert_raises(ZeroDivisionError) { Calc::Interval(0, 1).inverse }
+  end
+
+  def test_power
+    assert_equal Calc::Interval(0, 9), Calc::Interval(-3, 1)**2
+    assert_equal Calc::Interval(1, 9), Calc::Interval(-3, -1)**2
+    assert_equal Calc::Interval(-27, 1), Calc::Interval(-3, 1)**3
+    assert_equal Calc::Interval(1), Calc::Interval(-3, 1)**0
+    assert_equal Calc::Interval(Calc::Q(1, 4), 1), Calc::Interval(1, 2)**-2
+    assert_raises(ArgumentError) { Calc::Interval(1, 2)**Calc::Q(1, 2) }
+    assert_raises(ZeroDivisionError) { Calc::Interval(-1, 1)**-1 }
+  end
+
+  def assert_tight(x, interval, eps)
+    eps = Calc::Q(eps)
+    assert interval.include?(x), "#{ interval } doesn't include #{ x }"
+    assert interval.lo.ismult(eps), "#{ interval.lo } isn't a multiple of #{ eps }"
+    assert interval.hi.ismult(eps), "#{ interval.hi } isn't a multiple of #{ eps }"
+    assert interval.width <= eps * 4, "#{ interval } is too wide"
+  end
+
+  def test_point_functions
+    fine = Calc::Q("1e-60")
+    [Calc::Q(2), Calc::Q(-7, 3), Calc::Q("0.001")].each do |x|
+      point = Calc::Interval(x)
+      %w[1e-5 1e-30 0.5].each do |eps|
+        assert_tight x.exp(fine), point.exp(eps), eps
+        assert_tight x.sin(fine), point.sin(eps), eps
+        assert_tight x.cos(fine), point.cos(eps), eps
+        next unless x > 0
+        assert_tight x.ln(fine), point.ln(eps), eps
+        assert_tight x.sqrt(fine), point.sqrt(eps), eps
+      end
+    end
+    assert_equal Calc::Interval(Calc::Q("1.41420"), Calc::Q("1.41422")),
+                 Calc::Interval(2).sqrt("1e-5")
+    assert_tight Calc.pi(fine), Calc::Interval.pi("1e-40"), "1e-40"
+  end
+
+  def test_clamp
+    assert_equal Calc::Q(0), Calc::Interval(0, 1).sqrt("0.1").lo
+    assert_equal Calc::Q(0), Calc::Interval(-100).exp("0.1").lo
+    assert Calc::Interval(Calc.pi("1e-20") / 2).sin("1e-10").hi <= 1
+    assert Calc::Interval(0).cos("1e-10").hi <= 1
+  end
+
+  def test_turning_points
+    eps = Calc::Q("1e-20")
+    assert_equal Calc::Interval(-1, 1), Calc::Interval(0, 7).sin(eps)
+    assert_equal Calc::Interval(-1, 1), Calc::Interval(-10, 0).cos(eps)
+    s = Calc::Interval(1, 2).sin(eps)
+    assert_equal Calc::Q(1), s.hi
+    assert s.include?(Calc::Q(1).sin(eps))
+    refute s.include?(Calc::Q(1).sin(eps) - eps * 2)
+    s = Calc::Interval(4, 5).sin(eps)
+    assert_equal Calc::Q(-1), s.lo
+    assert s.include?(Calc::Q(4).sin(eps))
+    c = Calc::Interval("-0.1", "0.2").cos(eps)
+    assert_equal Calc::Q(1), c.hi
+    assert c.include?(Calc::Q("0.2").cos(eps))
+    c = Calc::Interval(3, "3.5").cos(eps)
+    assert_equal Calc::Q(-1), c.lo
+    # away from the turning points sin and cos are monotonic
+    s = Calc::Interval(-1, 1).sin(eps)
+    assert s.include?(Calc::Interval(Calc::Q(-1).sin(eps), Calc::Q(1).sin(eps)))
+    assert s.width <= Calc::Q(1).sin(eps) * 2 + eps * 4
+    c = Calc::Interval(20, 21).cos(eps)
+    assert c.hi < 1
+    assert c.lo > -1
+  end
+
+  def test_errors
+    assert_raises(Calc::MathError) { Calc::Interval(0, 1).ln }
+    assert_raises(Calc::MathError) { Calc::Interval(-1, 1).sqrt }
+    assert_raises(Calc::MathError) { Calc::Interval(1).exp(0) }
+    assert_raises(Calc::MathError) { Calc::Interval(1).exp(-1) }
+  end
+
+  def test_refine
+    calls = []
+    r = Calc::Interval.refine("1e-40", "0.01") do |eps|
+      calls << eps
+      (Calc::Interval(3).sqrt(eps) - 1).ln(eps)
+    end
+    assert r.width <= Calc::Q("1e-40")
+    assert r.include?((Calc::Q(3).sqrt("1e-60") - 1).ln("1e-60"))
+    assert_equal Calc::Q("0.01"), calls.first
+    assert calls.size <= 5
+    # stops at the first epsilon which is good enough
+    calls = []
+    Calc::Interval.refine(2, "0.5") { |eps| calls << eps && Calc::Interval(1).exp(eps) }
+    assert_equal [Calc::Q("0.5")], calls
+  end
+end
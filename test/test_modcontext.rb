@@ -0,0 +1,82 @@
+require "minitest_helper"
+
+class TestModContext < Minitest::Test
+  MODULI = [2, 10, 101, 2**64, 2**64 + 13, 2**127 - 1, 3 * 2**200, 2**521 - 1].freeze
+
+  def test_class_exists
+    refute_nil Calc::ModContext
+  end
+
+  def test_initialization
+    assert_rational_and_equal 101, Calc::ModContext.new(101).modulus
+    assert_raises(Calc::MathError) { Calc::ModContext.new(0) }
+    assert_raises(Calc::MathError) { Calc::ModContext.new(Rational(1, 2)) }
+  end
+
+  def test_pow
+    m = Calc::ModContext.new(10)
+    assert_rational_and_equal 8, m.pow(2, 3)
+    assert_rational_and_equal 2, m.pow(2, 5)
+    assert_rational_and_equal 1, m.pow(7, 0)
+    assert_rational_and_equal 7, m.pow(3, -1)
+    assert_raises(Calc::MathError) { m.pow(2, -1) }
+    assert_raises(Calc::MathError) { m.pow(2, Rational(1, 2)) }
+    assert_rational_and_equal 0, Calc::ModContext.new(1).pow(5, 3)
+  end
+
+  def test_pow_matches_pmod
+    MODULI.each do |md|
+      m = Calc::ModContext.new(md)
+      [0, 1, 2, 65_537, 3**150, 7**700].each do |e|
+        [-5, 2, md - 1, md + 3, 12_345_678_901_234_567].each do |b|
+          assert_equal Calc::Q(b).pmod(e, md), m.pow(b, e), "#{ b }^#{ e } mod #{ md }"
+        end
+      end
+    end
+  end
+
+  def test_pow_config_mod
+    m = Calc::ModContext.new(7)
+    with_config(:mod, 16) do
+      assert_equal Calc::Q(3).pmod(2, 7), m.pow(3, 2)
+      assert_equal Calc::Q(-5).pmod(1, 7), m.mul(-5, 1)
+    end
+  end
+
+  def test_pow_many
+    m = Calc::ModContext.new(2**127 - 1)
+    bases = [2, 3, 5, 2**100 + 1]
+    assert_equal bases.map { |b| m.pow(b, 3**80) }, m.pow_many(bases, 3**80)
+    assert_rational_array [4, 9, 6], Calc::ModContext.new(10).pow_many([2, 3, 4], 2)
+    assert_equal [], m.pow_many([], 5)
+    assert_raises(Calc::MathError) { Calc::ModContext.new(10).pow_many([3, 2], -1) }
+  end
+
+  def test_mul
+    m = Calc::ModContext.new(10)
+    assert_rational_and_equal 3, m.mul(7, 9)
+    assert_rational_and_equal 4, m.mul(-2, 3)
+    MODULI.each do |md|
+      m = Calc::ModContext.new(md)
+      a = 3**200 + 1
+      b = -(5**150)
+      assert_equal Calc::Q(a * b).mod(md), m.mul(a, b)
+    end
+    assert_raises(Calc::MathError) { m.mul(Rational(1, 2), 1) }
+  end
+
+  def test_inv
+    m = Calc::ModContext.new(10)
+    assert_rational_and_equal 7, m.inv(3)
+    assert_rational_and_equal 3, m.inv(-3)
+    assert_rational_and_equal 0, m.inv(4)
+    md = 2**127 - 1
+    assert_equal Calc::Q(12_345).minv(md), Calc::ModContext.new(md).inv(12_345)
+  end
+
+  def test_meq
+    m = Calc::ModContext.new(7)
+    assert m.meq?(5, 33)
+    refute m.meq?(5, 32)
+  end
+end
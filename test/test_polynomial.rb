@@ -0,0 +1,114 @@
+require "minitest_helper"
+
+class TestPolynomial < Minitest::Test
+  P = Calc::Polynomial
+
+  def test_class_exists
+    refute_nil Calc::Polynomial
+  end
+
+  def test_initialization
+    p = P.new([1, "1/2", Calc::Q(3), 0, 0])
+    assert_equal 2, p.degree
+    assert_rational_array [1, Rational(1, 2), 3], p.coefficients
+    assert_equal P.new([1, 2]), P[1, 2]
+    assert P.new.zero?
+    assert_equal(-1, P.new.degree)
+    assert_rational_and_equal 0, P[1, 2][5]
+    assert_rational_and_equal 2, P[1, 2].leading
+  end
+
+  def test_to_s
+    assert_equal "0", P.new.to_s
+    assert_equal "x^2 - 1", P[-1, 0, 1].to_s
+    assert_equal "-3*x^2 + 1/2*x", P[0, "1/2", -3].to_s
+    assert_equal "Calc::Polynomial(x + 1)", P[1, 1].inspect
+  end
+
+  def test_arithmetic
+    a = P[1, 1]
+    b = P[-1, 1]
+    assert_equal P[0, 2], a + b
+    assert_equal P[2], a - b
+    assert_equal P[-1, 0, 1], a * b
+    assert_equal P[2, 2], a * 2
+    assert_equal P[2, 2], 2 * a
+    assert_equal P[-1, -1], -a
+    assert_equal P[1, 3, 3, 1], a**3
+    assert_equal P[2, 6], P[1, 2, 3].derivative
+  end
+
+  def test_kronecker_mul
+    assert_rational_array [-1, 0, 1], P.kronecker_mul([1, 1], [-1, 1])
+    a = Array.new(20) { |i| (-1)**i * (2**70 + i) }
+    b = Array.new(30) { |i| 3**i - 2**40 }
+    expected = Array.new(49, 0)
+    a.each_with_index { |x, i| b.each_with_index { |y, j| expected[i + j] += x * y } }
+    assert_rational_array expected, P.kronecker_mul(a, b)
+    assert_raises(Calc::MathError) { P.kronecker_mul([Rational(1, 2)], [1]) }
+  end
+
+  def test_large_multiplication
+    a = P.new(Array.new(40) { |i| Rational((-1)**i * (i + 1), i % 5 + 1) })
+    b = P.new(Array.new(25) { |i| Rational(i * i - 7, 3) })
+    x = Calc::Q(5, 7)
+    assert_equal a.call(x) * b.call(x), (a * b).call(x)
+  end
+
+  def test_divmod
+    q, r = P[-1, 0, 1].divmod(P[1, 1])
+    assert_equal P[-1, 1], q
+    assert r.zero?
+    assert_equal P[1, 1], P[2, 1, 1] / P[0, 1]
+    assert_equal P[2], P[2, 1, 1] % P[0, 1]
+    assert_raises(Calc::MathError) { P[1, 1].divmod(P.new) }
+
+    # long enough to use newton iteration
+    a = P.new(Array.new(80) { |i| Rational(i * 7 % 11 - 5, i % 3 + 1) })
+    b = P.new(Array.new(10) { |i| i - 4 } + [3])
+    q, r = a.divmod(b)
+    assert_equal 69, q.degree
+    assert r.degree < b.degree
+    assert_equal a, q * b + r
+  end
+
+  def test_gcd
+    assert_equal P[1, 1], P[-1, 0, 1].gcd(P[1, 2, 1])
+    a = P[1, 1]**3 * P[2, 0, 1]
+    b = P[1, 1]**2 * P[3, 1]
+    assert_equal P[1, 2, 1], a.gcd(b)
+    assert_equal P[1], P[1, 1].gcd(P[2, 1])
+    assert_equal P["1/2", 1], P[1, 2].gcd(P.new)
+  end
+
+  def test_call
+    p = P[1, 2, 3]
+    assert_rational_and_equal 17, p.call(2)
+    assert_rational_and_equal Rational(11, 4), p.call("1/2")
+    assert_complex_parts [-2, 8], p.call(Complex(1, 1))
+  end
+
+  def test_evaluate_many
+    p = P.new(Array.new(30) { |i| Rational(i - 10, i + 1) })
+    points = Array.new(40) { |i| Rational(i - 20, 3) }
+    assert_equal points.map { |x| p.call(x) }, p.evaluate_many(points)
+    assert_equal [Calc::Q(1), Calc::Q(6), Calc::Q(17)], P[1, 2, 3].evaluate_many([0, 1, 2])
+  end
+
+  def test_from_roots
+    assert_equal P[-1, 0, 1], P.from_roots([1, -1])
+    p = P.from_roots((1..20).to_a)
+    assert_equal 20, p.degree
+    assert_rational_and_equal 0, p.call(7)
+    assert_equal P[1], P.from_roots([])
+  end
+
+  def test_interpolate
+    assert_equal P[1, 0, 1], P.interpolate([0, 1, 2], [1, 2, 5])
+    p = P.new(Array.new(25) { |i| Rational(3 * i - 20, i + 2) })
+    xs = Array.new(25) { |i| Rational(i, 2) - 3 }
+    assert_equal p, P.interpolate(xs, p.evaluate_many(xs))
+    assert_raises(ArgumentError) { P.interpolate([1, 2], [1]) }
+    assert_raises(Calc::MathError) { P.interpolate([1, 2, 1], [1, 2, 3]) }
+  end
+end
@@ -322,6 +322,8 @@ class TestQ < MiniTest::Test
     assert_equal 3628800, Calc::Q(10).fact
     assert_raises(Calc::MathError) { Calc::Q(-1).fact }
     assert_raises(Calc::MathError) { Calc::Q(1, 4).fact }
+    assert_raises(Calc::MathError) { Calc::Q(2**24).fact }
+    assert_equal (1..1000).inject(:*), Calc::Q(1000).fact
   end
 
   def test_to_f
@@ -691,8 +693,33 @@ class TestQ < MiniTest::Test
     assert_rational_and_equal 5, Calc::Q(5).fib
     assert_rational_and_equal 34, Calc::Q(9).fib
     assert_rational_and_equal 55, Calc::Q(10).fib
+    fibs = [0, 1]
+    1000.times { fibs << fibs[-1] + fibs[-2] }
+    assert_equal fibs[1000], Calc::Q(1000).fib
+    assert_equal(-fibs[1000], Calc::Q(-1000).fib)
+
+    assert_rational_and_equal 875, Calc::Q(1000).fib(1000)
+    assert_rational_and_equal 875, Calc::Q(10).power(100).fib(1000)
+    assert_rational_and_equal fibs[999] % 97, Calc::Q(-999).fib(97)
+    assert_rational_and_equal 0, Calc::Q(5).fib(5)
 
     assert_raises(Calc::MathError) { Calc::Q(0.5).fib }
+    assert_raises(Calc::MathError) { Calc::Q(2).power(31).fib }
+    assert_raises(Calc::MathError) { Calc::Q(5).fib(0) }
+    assert_raises(Calc::MathError) { Calc::Q(5).fib(-3) }
+    assert_raises(Calc::MathError) { Calc::Q(5).fib(0.5) }
+  end
+
+  def test_lucas
+    assert_rational_and_equal 2, Calc::Q(0).lucas
+    assert_rational_and_equal 1, Calc::Q(1).lucas
+    assert_rational_and_equal 123, Calc::Q(10).lucas
+    assert_rational_and_equal(-11, Calc::Q(-5).lucas)
+    assert_rational_and_equal 123, Calc::Q(-10).lucas
+    assert_equal Calc::Q(199).fib + Calc::Q(201).fib, Calc::Q(200).lucas
+    assert_rational_and_equal 123 % 7, Calc::Q(10).lucas(7)
+    assert_rational_and_equal(-11 % 7, Calc::Q(-5).lucas(7))
+    assert_raises(Calc::MathError) { Calc::Q(0.5).lucas }
   end
 
   def test_appr
@@ -902,6 +929,8 @@ class TestQ < MiniTest::Test
     x = Calc::Q(2).power(31)
     assert_rational_and_equal 2305843010287435776, (x + 1).comb(x - 1)
     assert_rational_and_equal Calc::Q("715/16"), Calc::Q("7.5").comb(3)
+    assert_equal (501..1000).inject(:*) / (1..500).inject(:*), Calc::Q(1000).comb(500)
+    assert_equal (9901..10_000).inject(:*) / (1..100).inject(:*), Calc::Q(10_000).comb(9900)
     assert_raises(Calc::MathError) { Calc::Q(7).comb(0.5) }
   end
 
@@ -912,6 +941,8 @@ class TestQ < MiniTest::Test
     assert_rational_and_equal 1, Calc::Q(3).perm(0)
     assert_rational_and_equal 1, Calc::Q(0).perm(0)
     assert_rational_and_equal 9903520314283042197045510144, (Calc::Q(2).power(31) + 1).perm(3)
+    assert_equal (401..1000).inject(:*), Calc::Q(1000).perm(600)
+    assert_equal (801..1000).inject(:*), Calc::Q(1000).perm(200)
     assert_raises(Calc::MathError) { Calc::Q(7).comb(0.5) }
   end
 
@@ -920,6 +951,50 @@ class TestQ < MiniTest::Test
     assert_alias Calc::Q(1), :conj, :conjugate
   end
 
+  def test_continued_fraction
+    assert_equal [4, 2, 6, 7], Calc::Q(415, 93).continued_fraction.to_a
+    assert_equal [-3, 1, 2], Calc::Q(-7, 3).continued_fraction.to_a
+    assert_equal [5], Calc::Q(5).continued_fraction.to_a
+    assert_equal [0, 2], Calc::Q(1, 2).continued_fraction.to_a
+    assert_equal [3, 7, 15, 1, 292], Calc.pi.continued_fraction.first(5)
+    assert_instance_of Calc::Q, Calc::Q(415, 93).continued_fraction.first
+    assert_instance_of Enumerator, Calc::Q(2).continued_fraction
+
+    # large enough for the multi-limb steps; check against plain euclid
+    x = Calc::Q(3**2000, 2**3000 + 1)
+    n = x.num.to_i
+    d = x.den.to_i
+    expected = []
+    until d.zero?
+      expected << n.div(d)
+      n, d = d, n % d
+    end
+    assert_equal expected, x.continued_fraction.to_a
+  end
+
+  def test_convergents
+    pi = Calc.pi
+    assert_equal %w(3 22/7 333/106 355/113), pi.convergents(den: 30000).map { |x| x.to_s(:frac) }
+    assert_equal %w(3 22/7 333/106), pi.convergents(den: 112.9).map { |x| x.to_s(:frac) }
+    assert_equal "103993/33102", pi.convergents(eps: 1e-9).to_a.last.to_s(:frac)
+    assert_equal "355/113", pi.convergents(eps: "1e-6").to_a.last.to_s(:frac)
+    assert_equal [], pi.convergents(den: 0).to_a
+    assert_equal [Calc::Q(-3), Calc::Q(-2), Calc::Q(-7, 3)], Calc::Q(-7, 3).convergents.to_a
+    assert_equal [Calc::Q(5)], Calc::Q(5).convergents.to_a
+    x = Calc::Q(415, 93)
+    assert_equal x, x.convergents.to_a.last
+    assert_equal x, x.convergents(eps: 0).to_a.last
+    assert_raises(Calc::MathError) { x.convergents(eps: -1).to_a }
+    assert_raises(Calc::MathError) { x.convergents(den: -1).to_a }
+
+    x = Calc::Q(3**2000, 2**3000 + 1)
+    eps = Calc::Q(1, 2**1000)
+    c = x.convergents(eps: eps).to_a
+    assert (x - c.last).abs <= eps
+    assert (x - c[-2]).abs > eps
+    assert_equal x.convergents.first(c.size), c
+  end
+
   def test_digit
     a = Calc::Q("123456.789")
     assert_rational_and_equal 0, a.digit(6)
@@ -996,6 +1071,37 @@ class TestQ < MiniTest::Test
     assert_rational_and_equal 179951, Calc::Q(2).power(59).-(1).factor
   end
 
+  def test_factorize
+    assert_equal [], Calc::Q(1).factorize
+    assert_equal [[2, 3], [3, 2], [5, 1]], Calc::Q(360).factorize
+    assert_equal [[-1, 1], [7, 1]], Calc::Q(-7).factorize
+    f = Calc::Q(360).factorize
+    assert_instance_of Calc::Q, f[0][0]
+    assert_instance_of Integer, f[0][1]
+    assert_equal [[641, 1], [6700417, 1]], Calc::Q(2**32 + 1).factorize
+    assert_equal [[274177, 1], [67280421310721, 1]], Calc::Q(2**64 + 1).factorize
+    assert_equal [[3, 40]], Calc::Q(3**40).factorize
+    assert_equal [[65537, 2], [2**61 - 1, 3]], Calc::Q((2**61 - 1)**3 * 65537**2).factorize
+    # rho/ECM
+    assert_equal [[59649589127497217, 1], [5704689200685129054721, 1]],
+                 Calc::Q(2**128 + 1).factorize
+    # quadratic sieve: two 20 digit primes
+    p1 = 10**19 + 51
+    p2 = 10**20 + 39
+    assert_equal [[p1, 1], [p2, 1]], Calc::Q(p1 * p2).factorize
+    # trial division always finishes, but the 180 bit semiprime left over
+    # can't be split before the time runs out; the result still multiplies
+    # back to n
+    m = (2**89 - 1) * (2**107 - 1)
+    n = 3**2 * 7 * m
+    f = Calc::Q(n).factorize(1e-9)
+    assert_equal [[3, 2], [7, 1], [m, 1]], f
+    assert_equal n, f.map { |p, e| p**e }.inject(:*)
+    assert_raises(Calc::MathError) { Calc::Q(0).factorize }
+    assert_raises(Calc::MathError) { Calc::Q(0.5).factorize }
+    assert_raises(Calc::MathError) { Calc::Q(5).factorize(0) }
+  end
+
   def test_fcnt
     assert_rational_and_equal 0, Calc::Q(7).fcnt(4)
     assert_rational_and_equal 1, Calc::Q(24).fcnt(4)
@@ -1112,8 +1218,17 @@ class TestQ < MiniTest::Test
     check_falsey Calc::Q(2)**31 - 9, :isprime, :prime?
     check_truthy Calc::Q(2)**31 - 1, :isprime, :prime?
     check_truthy Calc::Q(2)**31 + 11, :isprime, :prime?
-    assert_raises(Calc::MathError) { Calc::Q(2).**(32).+(1).prime? }
-    assert_raises(Calc::MathError) { Calc::Q(3).**(99).prime? }
+    check_falsey Calc::Q(2)**32 + 1, :isprime, :prime?
+    check_falsey Calc::Q(3)**99, :isprime, :prime?
+    check_truthy Calc::Q(2)**32 + 15, :isprime, :prime?
+    check_truthy Calc::Q(2)**61 - 1, :isprime, :prime?
+    check_truthy Calc::Q(2)**127 - 1, :isprime, :prime?
+    check_truthy(-Calc::Q(2)**89 + 1, :isprime, :prime?)
+    # strong pseudoprime to bases 2 through 23
+    check_falsey Calc::Q(3825123056546413051), :isprime, :prime?
+    check_falsey Calc::Q(4294967311)**2, :isprime, :prime?
+    check_falsey((Calc::Q(2)**61 - 1) * (Calc::Q(2)**31 - 1), :isprime, :prime?)
+    assert_raises(Calc::MathError) { Calc::Q(0.5).prime? }
     check_falsey Calc::Q(4)**99, :isprime, :prime?
   end
 
@@ -1172,6 +1287,7 @@ class TestQ < MiniTest::Test
     assert_rational_and_equal 360360, Calc::Q(13).lcmfact
     assert_rational_and_equal 360360, Calc::Q(14).lcmfact
     assert_rational_and_equal 360360, Calc::Q(15).lcmfact
+    assert_equal (1..1000).inject(:lcm), Calc::Q(1000).lcmfact
   end
 
   def test_lfactor
@@ -1294,7 +1410,9 @@ class TestQ < MiniTest::Test
     assert_rational_and_equal 1000003, Calc::Q("1e6").nextprime
     assert_rational_and_equal 4294967311, Calc::Q(2**32 - 1).nextprime
     assert_raises(Calc::MathError) { Calc::Q(0.5).nextprime }
-    assert_raises(Calc::MathError) { Calc::Q(2**32).nextprime }
+    assert_rational_and_equal 4294967311, Calc::Q(2**32).nextprime
+    assert_rational_and_equal 2**64 + 13, Calc::Q(2**64).nextprime
+    assert_rational_and_equal 2**89 - 1, Calc::Q(2**89 - 2).nextprime
   end
 
   def test_prevprime
@@ -1305,7 +1423,9 @@ class TestQ < MiniTest::Test
     assert_nil Calc::Q(2).prevprime
     assert_nil Calc::Q(1).prevprime
     assert_raises(Calc::MathError) { Calc::Q(0.5).prevprime }
-    assert_raises(Calc::MathError) { Calc::Q(2**32).prevprime }
+    assert_rational_and_equal 4294967291, Calc::Q(2**32).prevprime
+    assert_rational_and_equal 2**64 - 59, Calc::Q(2**64).prevprime
+    assert_rational_and_equal 2**89 - 1, Calc::Q(2**89).prevprime
   end
 
   def test_norm
@@ -1319,6 +1439,8 @@ class TestQ < MiniTest::Test
     ].each_with_index do |expected, i|
       assert_rational_and_equal expected, Calc::Q(i).pfact
     end
+    assert_equal (2..1000).select { |i| (2..Math.sqrt(i)).none? { |j| (i % j).zero? } }.inject(:*),
+                 Calc::Q(1000).pfact
     assert_raises(Calc::MathError) { Calc::Q(0.5).pfact }
     assert_raises(Calc::MathError) { Calc::Q(-1).pfact }
   end
@@ -1335,7 +1457,11 @@ class TestQ < MiniTest::Test
     assert_rational_and_equal 9592, Calc::Q("1e5").pix
     assert_rational_and_equal 78498, Calc::Q("1e6").pix
     assert_rational_and_equal 203280221, Calc::Q(2**32 - 1).pix
-    assert_raises(Calc::MathError) { Calc::Q(2**32).pix }
+    assert_rational_and_equal 203280221, Calc::Q(2**32).pix
+    assert_rational_and_equal 203280222, Calc::Q(2**32 + 15).pix
+    assert_rational_and_equal 455052511, Calc::Q(10**10).pix
+    assert_rational_and_equal 4118054813, Calc::Q(10**11).pix
+    assert_raises(Calc::MathError) { Calc::Q(2**56).pix }
     assert_raises(Calc::MathError) { Calc::Q(0.5).pix }
   end
 
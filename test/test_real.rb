@@ -0,0 +1,78 @@
+require "minitest_helper"
+
+class TestReal < Minitest::Test
+  def test_class_exists
+    refute_nil Calc::Real
+  end
+
+  def test_exact
+    x = Calc::Real("1/3")
+    assert_instance_of Calc::Real, x
+    assert_rational_and_equal Calc::Q(1, 3), x.approximate(100)
+    assert ((x + 1).approximate(100) - Calc::Q(4, 3)).abs <= Calc::Q(1, 2**100)
+    assert_equal "0.33333", x.to_s(5)
+    assert_equal "-0.50", Calc::Real(Calc::Q(-1, 2)).to_s(2)
+    assert_equal "1024.0", (Calc::Real(2)**10).to_s(1)
+    assert_equal "0.25", (Calc::Real(2)**-2).to_s(2)
+    assert_equal "1.0000000000", (Calc::Real(1) / 3 + Calc::Real(2) / 3).to_s(10)
+    assert_equal "-2.000", (1 - Calc::Real(3)).to_s(3)
+  end
+
+  def test_constants
+    assert_equal "3.14159265358979323846264338327950288419716939937511",
+                 Calc::Real.pi.to_s(50)
+    assert_equal "2.7182818284590452353602874713526624977572", Calc::Real.e.to_s(40)
+    assert (Calc::Real.pi.approximate(10) - Calc.pi("1e-30")).abs <= Calc::Q(1, 1024)
+  end
+
+  def test_chain
+    x = Calc::Real(2).sqrt.ln * Calc::Real.pi
+    assert_rational_and_equal Calc::Q("1.088793045151801065250344449119"), x.to_q("1e-30")
+    assert_equal "1.08879304515180106525034444911880697366929185018464", x.to_s(50)
+    y = (Calc::Real(Calc::Q(3, 2)).exp.sqrt + Calc::Real(3).sin).ln
+    eps = Calc::Q("1e-200")
+    expected = (Calc::Q(3, 2).exp("1e-230").sqrt("1e-230") + Calc::Q(3).sin("1e-230")).ln("1e-230")
+    assert (y.to_q(eps) - expected).abs <= eps
+  end
+
+  def test_to_q
+    assert_rational_and_equal Calc::Q("1.4142135624"), Calc::Real(2).sqrt.to_q("1e-10")
+    assert_rational_and_equal Calc::Q("1.4142135624"),
+                              (Calc::Real(2)**Calc::Q(1, 2)).to_q("1e-10")
+    with_config(:epsilon, "1e-5") do
+      assert_rational_and_equal Calc::Q("3.14159"), Calc::Real.pi.to_q
+    end
+    assert_raises(Calc::MathError) { Calc::Real.pi.to_q(0) }
+  end
+
+  def test_cancellation
+    # the result is tiny, so the terms have to be much more accurate than it
+    w = (Calc::Real(10)**-30 + Calc::Real.pi) - Calc::Real.pi
+    assert_equal "1000000000000000000000000000000.00", w.inverse.to_s(2)
+    assert_equal "1.0000000000000000000000000000000000000000",
+                 (Calc::Real(100).exp * Calc::Real(-100).exp).to_s(40)
+    z = Calc::Real(2).sqrt**2 - 2
+    assert_equal "0.000000000000000000000000000000", z.to_s(30)
+    assert_equal "0.0000000000", z.sqrt.to_s(10)
+  end
+
+  def test_trig
+    assert_equal "0.143836959436190935280030599136", Calc::Real(Calc::Q(1, 7)).tan.to_s(30)
+    assert_equal "0.785398163397448309615660845820", Calc::Real(1).atan.to_s(30)
+    assert_equal "1.000000000000000000000000000000",
+                 (Calc::Real(2).sin**2 + Calc::Real(2).cos**2).to_s(30)
+  end
+
+  def test_refinement_is_cached
+    x = Calc::Real(3).sqrt
+    a = x.approximate(100)
+    assert_same a, x.approximate(50)
+    assert (x.approximate(1000) - a).abs <= Calc::Q(1, 2**100)
+  end
+
+  def test_errors
+    assert_raises(Calc::MathError) { (1 / (Calc::Real(2).sqrt**2 - 2)).to_s }
+    assert_raises(Calc::MathError) { Calc::Real(-1).ln.to_s }
+    assert_raises(Calc::MathError) { Calc::Real(-1).sqrt.to_s }
+  end
+end
@@ -0,0 +1,113 @@
+require "minitest_helper"
+
+class TestUnreduced < Minitest::Test
+  def test_class_exists
+    refute_nil Calc::Unreduced
+  end
+
+  def test_initialization
+    x = Calc::Unreduced(2, 4)
+    assert_instance_of Calc::Unreduced, x
+    assert_rational_and_equal Calc::Q(1, 2), x.to_q
+    assert_rational_and_equal Calc::Q(3, 4), Calc::Unreduced("0.75").to_q
+    assert_rational_and_equal Calc::Q(5), Calc::Unreduced(5).to_q
+    assert_equal "0.5", x.to_s
+    assert_equal "1/2", x.to_s(:frac)
+    assert_equal "Calc::Unreduced(0.5)", x.inspect
+    assert_raises(ZeroDivisionError) { Calc::Unreduced(1, 0) }
+    y = x.dup
+    assert_equal x, y
+  end
+
+  def test_arithmetic_is_not_reduced
+    x = Calc::Unreduced(1, 6) + Calc::Q(1, 4)
+    assert_rational_and_equal Calc::Q(24), x.den
+    assert_rational_and_equal Calc::Q(10), x.num
+    assert_rational_and_equal Calc::Q(5, 12), x.to_q
+    # a denominator dividing ours doesn't grow it
+    x = Calc::Unreduced(1, 6) + Calc::Q(1, 3)
+    assert_rational_and_equal Calc::Q(6), x.den
+    assert_rational_and_equal Calc::Q(3), x.num
+    y = Calc::Unreduced(1, 2) * Calc::Q(2, 3)
+    assert_rational_and_equal Calc::Q(2), y.num
+    assert_rational_and_equal Calc::Q(6), y.den
+    # equal denominators just add numerators
+    z = Calc::Unreduced(1, 10) + Calc::Unreduced(3, 10)
+    assert_rational_and_equal Calc::Q(4), z.num
+    assert_rational_and_equal Calc::Q(10), z.den
+    # integers don't grow the denominator
+    w = Calc::Unreduced(1, 10) + 2
+    assert_rational_and_equal Calc::Q(21), w.num
+    assert_rational_and_equal Calc::Q(10), w.den
+  end
+
+  def test_arithmetic
+    a = Calc::Unreduced(3, 4)
+    b = Calc::Q(-5, 6)
+    assert_rational_and_equal Calc::Q(-1, 12), (a + b).to_q
+    assert_rational_and_equal Calc::Q(19, 12), (a - b).to_q
+    assert_rational_and_equal Calc::Q(-5, 8), (a * b).to_q
+    assert_rational_and_equal Calc::Q(-9, 10), (a / b).to_q
+    assert_rational_and_equal Calc::Q(-3, 4), (-a).to_q
+    assert_rational_and_equal Calc::Q(5, 4), (2 - a).to_q
+    assert_rational_and_equal Calc::Q(8, 3), (2 / a).to_q
+    assert_instance_of Calc::Unreduced, 2 - a
+    assert_instance_of Calc::Unreduced, b + a
+    assert_rational_and_equal Calc::Q(7, 4), (a + Rational(1)).to_q
+    assert_raises(ZeroDivisionError) { a / 0 }
+    assert_raises(ZeroDivisionError) { a / Calc::Unreduced(0) }
+    assert (a - a).zero?
+    refute a.zero?
+  end
+
+  def test_comparison
+    assert_equal Calc::Unreduced(2, 4), Calc::Unreduced(1, 2)
+    assert_equal 0, Calc::Unreduced(2, 4) <=> Calc::Q(1, 2)
+    assert_equal(-1, Calc::Unreduced(-2, 4) <=> 0)
+    assert_equal 1, Calc::Q(1) <=> Calc::Unreduced(1, 3)
+    assert_nil Calc::Unreduced(1) <=> "cat"
+    assert Calc::Unreduced(1, 3) < Calc::Unreduced(1, 2)
+  end
+
+  def test_harmonic_sum
+    expected = (1..300).reduce(Calc::Q(0)) { |s, k| s + Calc::Q(1, k) }
+    [0, 64, 1024, 1 << 20].each do |threshold|
+      with_config(:unreduced, threshold) do
+        x = (1..300).reduce(Calc::Unreduced(0)) { |s, k| s + Calc::Q(1, k) }
+        assert_equal expected, x.to_q
+      end
+    end
+  end
+
+  def test_threshold
+    with_config(:unreduced, 0) do
+      # reduced after every operation
+      x = Calc::Unreduced(1, 6) + Calc::Q(1, 3)
+      assert_rational_and_equal Calc::Q(2), x.den
+    end
+    with_config(:unreduced, 256) do
+      x = (1..200).reduce(Calc::Unreduced(1)) { |s, k| s * Calc::Q(k, k + 1) }
+      assert_rational_and_equal Calc::Q(1, 201), x.to_q
+      # reduced once the denominator passed 256 bits, and again whenever it
+      # doubled, so it never got near 200!
+      assert_operator x.den.ilog2, :<, 600
+    end
+  end
+
+  def test_matches_q
+    r = Random.new(46)
+    x = Calc::Unreduced(0)
+    q = Calc::Q(0)
+    with_config(:unreduced, 128) do
+      500.times do
+        y = Calc::Q(r.rand(-1000..1000), r.rand(1..50))
+        op = %i[+ - * /][r.rand(4)]
+        next if op == :/ && y.zero?
+        x = x.__send__(op, y)
+        q = q.__send__(op, y)
+        assert_equal q, x.to_q
+        assert_equal q <=> 1, x <=> 1
+      end
+    end
+  end
+end